@@ -0,0 +1,628 @@
+/*
+ * addr2line
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <symbolize.h>
+#include <demangle.h>
+#include <xmalloc.h>
+
+static const char *__exe = "a.out";
+static int __functions;
+static int __demangle;
+static int __basenames;
+static int __addresses;
+static int __pretty;
+static int __inlines;
+static int __server;
+static const char *__socket;
+static const char *__debug_dir = "/usr/lib/debug";
+static int __cache_size = 16;
+static const char *__cache_dir;
+
+/* innermost frame and the callers it was inlined into */
+#define A2L_MAX_FRAMES     32
+
+/*
+ * output buffer, responses of one input batch are written at once.
+ */
+struct a2l_buf {
+    char   *data;
+    size_t len;
+    size_t max;
+};
+
+static void a2l_printf(struct a2l_buf *out, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    for (;;) {
+        va_start(args, fmt);
+        n = vsnprintf(out->data + out->len, out->max - out->len, fmt, args);
+        va_end(args);
+        if (n >= 0 && (size_t)n < out->max - out->len)
+            break;
+        {
+            size_t max = out->max ? out->max * 2 : 65536;
+            char *tmp;
+
+            while (max - out->len <= (size_t)n)
+                max *= 2;
+            tmp = xmalloc(max);
+            if (out->data) {
+                memcpy(tmp, out->data, out->len);
+                xfree(out->data);
+            }
+            out->data = tmp;
+            out->max = max;
+        }
+    }
+    out->len += n;
+}
+
+static int a2l_write(int fd, struct a2l_buf *out)
+{
+    size_t done = 0;
+
+    while (done < out->len) {
+        ssize_t n = write(fd, out->data + done, out->len - done);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        done += n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+/*
+ * LRU cache of mapped binaries, most recently used first. The cache
+ * holds a handful of binaries and requests come in runs on the same
+ * one, so a list scan from the head beats hashing every key.
+ * @sym: NULL if binary failed to load, so it isn't retried.
+ */
+struct a2l_entry {
+    char              *key;
+    struct symbolizer *sym;
+    struct a2l_entry  *prev;
+    struct a2l_entry  *next;
+};
+
+static struct a2l_entry *lru_head;
+static struct a2l_entry *lru_tail;
+static int lru_numbers;
+
+static void lru_unlink(struct a2l_entry *e)
+{
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        lru_head = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        lru_tail = e->prev;
+}
+
+static void lru_push(struct a2l_entry *e)
+{
+    e->prev = NULL;
+    e->next = lru_head;
+    if (lru_head)
+        lru_head->prev = e;
+    lru_head = e;
+    if (!lru_tail)
+        lru_tail = e;
+}
+
+static void lru_evict(struct a2l_entry *e)
+{
+    lru_unlink(e);
+    lru_numbers--;
+    symbolizer_free(e->sym);
+    xfree(e->key);
+    xfree(e);
+    /* cached names may belong to the evicted binary only */
+    demangle_cache_free();
+}
+
+/*
+ * whether @key looks like a hex build-id
+ */
+static int a2l_is_hex(const char *key)
+{
+    size_t n = strspn(key, "0123456789abcdefABCDEF");
+
+    return !key[n] && n >= 8 && !(n & 1);
+}
+
+static struct symbolizer *a2l_load(const char *key)
+{
+    struct symbolizer *sym;
+    char path[4096];
+
+    /* a file of that name wins over the build-id directory */
+    if (a2l_is_hex(key) && access(key, F_OK)) {
+        snprintf(path, sizeof(path), "%s/.build-id/%.2s/%s.debug",
+                 __debug_dir, key, key + 2);
+        key = path;
+    }
+    sym = symbolizer_alloc(key, __cache_dir);
+    if (!sym)
+        fprintf(stderr, "addr2line: %s: %s\n", key, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+    return sym;
+}
+
+static void lru_touch(struct a2l_entry *e)
+{
+    if (e != lru_head) {
+        lru_unlink(e);
+        lru_push(e);
+    }
+}
+
+/*
+ * Binary for request key, loaded and indexed on first use. A build-id
+ * of a binary already mapped by path shares its entry.
+ */
+static struct symbolizer *a2l_lookup(const char *key)
+{
+    struct a2l_entry *e;
+
+    for (e = lru_head; e; e = e->next) {
+        if (!strcmp(e->key, key)) {
+            lru_touch(e);
+            return e->sym;
+        }
+    }
+    if (a2l_is_hex(key)) {
+        for (e = lru_head; e; e = e->next) {
+            if (e->sym && !strcasecmp(e->sym->build_id, key)) {
+                lru_touch(e);
+                return e->sym;
+            }
+        }
+    }
+
+    while (lru_numbers >= __cache_size && lru_tail)
+        lru_evict(lru_tail);
+    e = xmalloc(sizeof(struct a2l_entry));
+    e->key = xmalloc(strlen(key) + 1);
+    strcpy(e->key, key);
+    e->sym = a2l_load(key);
+    lru_push(e);
+    lru_numbers++;
+    return e->sym;
+}
+
+static const char *a2l_function(const char *name)
+{
+    if (!name)
+        return "??";
+    return __demangle ? demangle(name) : name;
+}
+
+static const char *a2l_file(struct symbolize_frame *frame, char *buf,
+                            size_t size)
+{
+    const char *path = symbolize_path(frame, buf, size);
+    const char *base;
+
+    if (__basenames && (base = strrchr(path, '/')))
+        return base + 1;
+    return path;
+}
+
+static void a2l_location(struct a2l_buf *out, struct symbolize_frame *frame,
+                         uint32_t discriminator)
+{
+    char path[4096];
+
+    if (!frame->file)
+        a2l_printf(out, "??:0");
+    else if (!frame->line)
+        a2l_printf(out, "%s:?", a2l_file(frame, path, sizeof(path)));
+    else
+        a2l_printf(out, "%s:%u", a2l_file(frame, path, sizeof(path)),
+                   frame->line);
+    if (discriminator)
+        a2l_printf(out, " (discriminator %u)", discriminator);
+    a2l_printf(out, "\n");
+}
+
+/*
+ * Print one address the way GNU addr2line does, with -i every
+ * inlined call gets its own frame.
+ */
+static void a2l_print(struct a2l_buf *out, struct symbolizer *sym,
+                      uint64_t address)
+{
+    struct symbolize_frame frames[A2L_MAX_FRAMES];
+    int i, n;
+
+    n = sym ? symbolizer_lookup(sym, address, frames,
+                                __inlines ? A2L_MAX_FRAMES : 1) : 0;
+    if (!n) {
+        memset(frames, 0, sizeof(frames[0]));
+        n = 1;
+    }
+
+    if (__addresses)
+        a2l_printf(out, __pretty ? "0x%08llx: " : "0x%08llx\n",
+                   (unsigned long long)address);
+    for (i = 0; i < n; i++) {
+        if (i && __pretty)
+            a2l_printf(out, " (inlined by) ");
+        if (__functions && __pretty && !frames[i].function &&
+            !frames[i].file)
+            a2l_printf(out, "?? ");
+        else if (__functions)
+            a2l_printf(out, __pretty ? "%s at " : "%s\n",
+                       a2l_function(frames[i].function));
+        /* GNU addr2line repeats the line's discriminator on callers */
+        a2l_location(out, &frames[i], frames[i].discriminator ?
+                     frames[i].discriminator : frames[0].discriminator);
+    }
+}
+
+/*
+ * Answer one server request "<path|build-id> <address>...", one
+ * tab separated line "address function file:line" per address. An
+ * inlined call adds "function file:line" of each caller after it.
+ */
+static void a2l_request(struct a2l_buf *out, char *line)
+{
+    struct symbolizer *sym;
+    char *key, *tok, *save;
+    int answered = 0;
+
+    key = strtok_r(line, " \t", &save);
+    if (!key) {
+        a2l_printf(out, "??\t??\t??:0\n");
+        return;
+    }
+    sym = a2l_lookup(key);
+    while ((tok = strtok_r(NULL, " \t", &save))) {
+        struct symbolize_frame frames[A2L_MAX_FRAMES];
+        uint64_t address;
+        char path[4096], *end;
+        int i, n = 0;
+
+        address = strtoull(tok, &end, 16);
+        answered = 1;
+        if (!*end && sym)
+            n = symbolizer_lookup(sym, address, frames,
+                                  __inlines ? A2L_MAX_FRAMES : 1);
+        if (!n) {
+            a2l_printf(out, "0x%llx\t??\t??:0\n",
+                       (unsigned long long)address);
+            continue;
+        }
+        a2l_printf(out, "0x%llx", (unsigned long long)address);
+        for (i = 0; i < n; i++)
+            a2l_printf(out, "\t%s\t%s:%u", a2l_function(frames[i].function),
+                       a2l_file(&frames[i], path, sizeof(path)),
+                       frames[i].line);
+        a2l_printf(out, "\n");
+    }
+    if (!answered)
+        a2l_printf(out, "??\t??\t??:0\n");
+}
+
+/*
+ * request stream of one client
+ */
+struct a2l_client {
+    int    fd;
+    char   *in;
+    size_t in_len;
+    size_t in_max;
+};
+
+/*
+ * Read what's available on client and answer every complete line,
+ * responses of the batch go out in one write.
+ * @return: 0 while client stays connected.
+ */
+static int a2l_client_read(struct a2l_client *c, struct a2l_buf *out)
+{
+    char *p, *nl;
+    ssize_t n;
+
+    if (c->in_max - c->in_len < 4096) {
+        char *tmp = xmalloc(c->in_max * 2);
+
+        memcpy(tmp, c->in, c->in_len);
+        xfree(c->in);
+        c->in = tmp;
+        c->in_max *= 2;
+    }
+    n = read(c->fd, c->in + c->in_len, c->in_max - c->in_len - 1);
+    if (n < 0 && errno == EINTR)
+        return 0;
+    if (n <= 0) {
+        /* answer an unterminated last request */
+        if (c->in_len) {
+            c->in[c->in_len] = 0;
+            a2l_request(out, c->in);
+            c->in_len = 0;
+            a2l_write(c->fd == 0 ? 1 : c->fd, out);
+        }
+        return -1;
+    }
+    c->in_len += n;
+
+    p = c->in;
+    while ((nl = memchr(p, '\n', c->in + c->in_len - p))) {
+        *nl = 0;
+        a2l_request(out, p);
+        p = nl + 1;
+    }
+    c->in_len -= p - c->in;
+    memmove(c->in, p, c->in_len);
+    return a2l_write(c->fd == 0 ? 1 : c->fd, out);
+}
+
+static void a2l_client_init(struct a2l_client *c, int fd)
+{
+    c->fd = fd;
+    c->in_max = 65536;
+    c->in = xmalloc(c->in_max);
+    c->in_len = 0;
+}
+
+static int a2l_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "addr2line: %s: socket path too long\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 16) < 0) {
+        fprintf(stderr, "addr2line: %s: %s\n", path, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#define A2L_MAX_CLIENTS    64
+
+/*
+ * Serve requests from stdin, or from clients of a Unix socket. One
+ * thread polls every stream so all of them share the warm cache.
+ */
+static int a2l_server(void)
+{
+    struct a2l_client clients[A2L_MAX_CLIENTS];
+    struct pollfd fds[A2L_MAX_CLIENTS + 1];
+    struct a2l_buf out = { NULL, 0, 0 };
+    int listen_fd = -1, numbers = 0, i;
+
+    if (__socket) {
+        listen_fd = a2l_listen(__socket);
+        if (listen_fd < 0)
+            return 1;
+    } else {
+        a2l_client_init(&clients[numbers++], 0);
+    }
+
+    while (numbers || listen_fd >= 0) {
+        int n = 0;
+
+        if (listen_fd >= 0) {
+            fds[n].fd = listen_fd;
+            fds[n++].events = POLLIN;
+        }
+        for (i = 0; i < numbers; i++) {
+            fds[n].fd = clients[i].fd;
+            fds[n++].events = POLLIN;
+        }
+        if (poll(fds, n, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        n = 0;
+        if (listen_fd >= 0 && (fds[n++].revents & POLLIN)) {
+            int fd = accept(listen_fd, NULL, NULL);
+
+            if (fd >= 0 && numbers < A2L_MAX_CLIENTS)
+                a2l_client_init(&clients[numbers++], fd);
+            else if (fd >= 0)
+                close(fd);
+        }
+        for (i = 0; i < numbers; i++, n++) {
+            if (!(fds[n].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (!a2l_client_read(&clients[i], &out))
+                continue;
+            if (clients[i].fd)
+                close(clients[i].fd);
+            xfree(clients[i].in);
+            /* keep pollfd slots in step with clients */
+            memmove(&clients[i], &clients[i + 1],
+                    sizeof(struct a2l_client) * (numbers - i - 1));
+            memmove(&fds[n], &fds[n + 1],
+                    sizeof(struct pollfd) * (numbers - i - 1));
+            numbers--;
+            i--;
+            n--;
+        }
+    }
+
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(__socket);
+    }
+    xfree(out.data);
+    return 0;
+}
+
+static void usage(void)
+{
+    printf("Usage: addr2line [option(s)] [addr(s)]\n");
+    printf(" Convert addresses into line number/file name pairs.\n");
+    printf(" If no addresses are specified on the command line, they will be read from stdin\n");
+    printf(" The options are:\n");
+    printf("  -a --addresses         Show addresses\n");
+    printf("  -e --exe=<executable>  Set the input file name (default is a.out)\n");
+    printf("  -p --pretty-print      Make the output easier to read for humans\n");
+    printf("  -s --basenames         Strip directory names\n");
+    printf("  -f --functions         Show function names\n");
+    printf("  -i --inlines           Unwind inlined functions\n");
+    printf("  -C --demangle          Demangle function names\n");
+    printf("                         (std::string stays short as with GNU addr2line,\n");
+    printf("                         not c++filt)\n");
+    printf("     --server            Answer \"<file|build-id> <addr>...\" requests\n");
+    printf("                         from stdin, keeping binaries mapped\n");
+    printf("     --socket=<path>     Serve requests on a Unix socket instead\n");
+    printf("     --cache-size=<n>    Keep <n> binaries mapped (default 16)\n");
+    printf("     --debug-dir=<dir>   Find build-ids under <dir>/.build-id\n");
+    printf("     --cache-dir=<dir>   Keep symbol and line indexes in <dir> across runs\n");
+    printf("  -h --help              Display this information\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"addresses", no_argument, NULL, 'a'},
+        {"exe", required_argument, NULL, 'e'},
+        {"pretty-print", no_argument, NULL, 'p'},
+        {"basenames", no_argument, NULL, 's'},
+        {"functions", no_argument, NULL, 'f'},
+        {"inlines", no_argument, NULL, 'i'},
+        {"demangle", no_argument, NULL, 'C'},
+        {"server", no_argument, NULL, 'S'},
+        {"socket", required_argument, NULL, 'U'},
+        {"cache-size", required_argument, NULL, 'Z'},
+        {"debug-dir", required_argument, NULL, 'D'},
+        {"cache-dir", required_argument, NULL, 'M'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *short_opts = "ae:psfiCh";
+    struct symbolizer *sym;
+    struct a2l_buf out = { NULL, 0, 0 };
+    int c, ret = 0;
+
+    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'a':
+            __addresses = 1;
+            break;
+        case 'e':
+            __exe = optarg;
+            break;
+        case 'p':
+            __pretty = 1;
+            break;
+        case 's':
+            __basenames = 1;
+            break;
+        case 'f':
+            __functions = 1;
+            break;
+        case 'i':
+            __inlines = 1;
+            break;
+        case 'C':
+            __demangle = 1;
+            break;
+        case 'S':
+            __server = 1;
+            break;
+        case 'U':
+            __server = 1;
+            __socket = optarg;
+            break;
+        case 'Z':
+            __cache_size = atoi(optarg);
+            if (__cache_size < 1)
+                __cache_size = 1;
+            break;
+        case 'D':
+            __debug_dir = optarg;
+            break;
+        case 'M':
+            __cache_dir = optarg;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (__server) {
+        ret = a2l_server();
+        while (lru_tail)
+            lru_evict(lru_tail);
+        return ret;
+    }
+
+    sym = symbolizer_alloc(__exe, __cache_dir);
+    if (!sym) {
+        fprintf(stderr, "addr2line: %s: %s\n", __exe, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+        return 1;
+    }
+
+    if (optind < argc) {
+        for (; optind < argc; optind++) {
+            a2l_print(&out, sym, strtoull(argv[optind], NULL, 16));
+            a2l_write(1, &out);
+        }
+    } else {
+        char line[256];
+
+        /* flush per address, callers pipe and wait for each answer */
+        while (fgets(line, sizeof(line), stdin)) {
+            a2l_print(&out, sym, strtoull(line, NULL, 16));
+            a2l_write(1, &out);
+        }
+    }
+
+    xfree(out.data);
+    symbolizer_free(sym);
+    demangle_cache_free();
+    return ret;
+}
@@ -0,0 +1,443 @@
+/*
+ * microbench: time hot library primitives
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include <elf.h>
+#include <symbolize.h>
+#include <json.h>
+#include <log.h>
+#include <hash.h>
+#include <xmalloc.h>
+
+#define BENCH_ADDRESSES    65536    /* addresses looked up per pass */
+#define BENCH_NAMES        256      /* sections looked up by name */
+#define BENCH_HEX          65536    /* numbers formatted per pass */
+#define BENCH_RECORDS      4096     /* JSON records per pass */
+#define BENCH_MESSAGES     1024     /* log messages per pass */
+
+static int __repeat = 31;
+static int __warmup = 3;
+static const char *__filter;
+
+/*
+ * inputs shared by benchmarks, set up once per file.
+ * @addresses: function addresses in shuffled order.
+ * @names: section names spread over the section table.
+ * @values: numbers to format.
+ */
+struct bench_ctx {
+    struct elf_file    *ef;
+    struct symbolizer  *sym;
+    Elf32_Shdr         *symtab;
+    uint64_t           *addresses;
+    int                address_numbers;
+    const char         **names;
+    int                name_numbers;
+    uint32_t           *values;
+    struct json_writer *json;
+};
+
+/*
+ * benchmark, one call is one pass over its elements.
+ * @run: returns elements handled, 0 if input has nothing to run on.
+ */
+struct bench {
+    const char *name;
+    long       (*run)(struct bench_ctx *ctx);
+};
+
+/* results feed this so passes can't be optimized away */
+static volatile unsigned long bench_sink;
+
+static uint64_t bench_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * time stamp counter, it ticks at a constant rate rather than core
+ * clock on current CPUs. 0 where there is none.
+ */
+static uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#else
+    return 0;
+#endif
+}
+
+static long bench_section_name(struct bench_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++)
+        sum += elf_file_section_name(ef, ef->section_table + i)[0];
+    bench_sink += sum;
+    return ef->section_numbers - 1;
+}
+
+static long bench_section_by_name(struct bench_ctx *ctx)
+{
+    unsigned long sum = 0;
+    int i;
+
+    for (i = 0; i < ctx->name_numbers; i++)
+        sum += (uintptr_t)elf_file_section_by_name(ctx->ef, ctx->names[i]);
+    bench_sink += sum;
+    return ctx->name_numbers;
+}
+
+static long bench_symbol_iter(struct bench_ctx *ctx)
+{
+    unsigned long sum = 0;
+    int i, n;
+
+    if (!ctx->symtab)
+        return 0;
+    n = elf_file_symbol_numbers(ctx->ef, ctx->symtab);
+    for (i = 0; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ctx->ef, ctx->symtab, i);
+        const char *name = elf_file_symbol_name(ctx->ef, ctx->symtab, sym);
+
+        sum += sym->st_value + (name ? name[0] : 0);
+    }
+    bench_sink += sum;
+    return n;
+}
+
+static long bench_addr_lookup(struct bench_ctx *ctx)
+{
+    struct symbolize_frame frame;
+    unsigned long sum = 0;
+    int i;
+
+    if (!ctx->sym)
+        return 0;
+    for (i = 0; i < ctx->address_numbers; i++)
+        if (symbolizer_lookup(ctx->sym, ctx->addresses[i], &frame, 1))
+            sum += frame.line + (frame.function ? 1 : 0);
+    bench_sink += sum;
+    return ctx->address_numbers;
+}
+
+static long bench_hex_printf(struct bench_ctx *ctx)
+{
+    unsigned long sum = 0;
+    char buf[16];
+    int i;
+
+    for (i = 0; i < BENCH_HEX; i++) {
+        snprintf(buf, sizeof(buf), "%08x", ctx->values[i]);
+        sum += buf[7];
+    }
+    bench_sink += sum;
+    return BENCH_HEX;
+}
+
+static long bench_hex_json(struct bench_ctx *ctx)
+{
+    int i;
+
+    for (i = 0; i < BENCH_RECORDS; i++) {
+        json_begin(ctx->json);
+        json_hex(ctx->json, "id", (unsigned char *)(ctx->values + i), 20);
+        json_end(ctx->json);
+    }
+    json_flush(ctx->json);
+    return BENCH_RECORDS;
+}
+
+#ifdef CONFIG_ENABLE_LOGGING
+static long bench_log_filtered(struct bench_ctx *ctx)
+{
+    int i;
+
+    log_set_level(LOG_LEVEL_WARNING);
+    for (i = 0; i < BENCH_MESSAGES; i++)
+        print_dbg("%s: value %u at %d", ctx->ef->filename, ctx->values[i], i);
+    return BENCH_MESSAGES;
+}
+
+/* cost on the logging thread, the log thread formats and writes */
+static long bench_log_debug(struct bench_ctx *ctx)
+{
+    int i;
+
+    log_set_level(LOG_LEVEL_DEBUG);
+    for (i = 0; i < BENCH_MESSAGES; i++)
+        print_dbg("%s: value %u at %d", ctx->ef->filename, ctx->values[i], i);
+    log_set_level(LOG_LEVEL_WARNING);
+    return BENCH_MESSAGES;
+}
+#endif
+
+#ifdef CONFIG_HASH
+/* elements are bytes of section contents */
+static long bench_hash(struct bench_ctx *ctx, int sha256)
+{
+    struct elf_file *ef = ctx->ef;
+    unsigned char digest[HASH_SHA256_SIZE];
+    unsigned long sum = 0;
+    long bytes = 0;
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        const unsigned char *contents = elf_file_section_contents(ef, st);
+
+        if (!contents)
+            continue;
+        if (sha256) {
+            hash_sha256(contents, st->sh_size, digest);
+            sum += digest[0];
+        } else {
+            sum += hash_xxh3(contents, st->sh_size);
+        }
+        bytes += st->sh_size;
+    }
+    bench_sink += sum;
+    return bytes;
+}
+
+static long bench_hash_xxh3(struct bench_ctx *ctx)
+{
+    return bench_hash(ctx, 0);
+}
+
+static long bench_hash_sha256(struct bench_ctx *ctx)
+{
+    return bench_hash(ctx, 1);
+}
+#endif
+
+static const struct bench benches[] = {
+    { "section_name",    bench_section_name },
+    { "section_by_name", bench_section_by_name },
+    { "symbol_iter",     bench_symbol_iter },
+    { "addr_lookup",     bench_addr_lookup },
+    { "hex_printf",      bench_hex_printf },
+    { "hex_json",        bench_hex_json },
+#ifdef CONFIG_ENABLE_LOGGING
+    { "log_filtered",    bench_log_filtered },
+    { "log_debug",       bench_log_debug },
+#endif
+#ifdef CONFIG_HASH
+    { "hash_xxh3",       bench_hash_xxh3 },
+    { "hash_sha256",     bench_hash_sha256 },
+#endif
+};
+
+static int bench_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Warm up, then time @__repeat passes. Median and 99th percentile
+ * are taken over passes, per element figures from the median.
+ */
+static void bench_run(const struct bench *b, struct bench_ctx *ctx)
+{
+    uint64_t *ns, *cycles;
+    long elements = 0;
+    int i, p99;
+
+    for (i = 0; i < __warmup; i++)
+        elements = b->run(ctx);
+    ns = xmalloc(sizeof(uint64_t) * __repeat);
+    cycles = xmalloc(sizeof(uint64_t) * __repeat);
+    for (i = 0; i < __repeat; i++) {
+        uint64_t t = bench_ns(), c = bench_cycles();
+
+        elements = b->run(ctx);
+        cycles[i] = bench_cycles() - c;
+        ns[i] = bench_ns() - t;
+    }
+    qsort(ns, __repeat, sizeof(uint64_t), bench_compare);
+    qsort(cycles, __repeat, sizeof(uint64_t), bench_compare);
+    p99 = (__repeat * 99 + 99) / 100 - 1;
+
+    if (!elements)
+        printf("%-16s %10s\n", b->name, "-");
+    else if (cycles[__repeat / 2])
+        printf("%-16s %10ld %12llu %12llu %10.3f %10.3f\n", b->name,
+               elements, (unsigned long long)ns[__repeat / 2],
+               (unsigned long long)ns[p99],
+               (double)ns[__repeat / 2] / elements,
+               (double)cycles[__repeat / 2] / elements);
+    else
+        printf("%-16s %10ld %12llu %12llu %10.3f %10s\n", b->name,
+               elements, (unsigned long long)ns[__repeat / 2],
+               (unsigned long long)ns[p99],
+               (double)ns[__repeat / 2] / elements, "-");
+    xfree(ns);
+    xfree(cycles);
+}
+
+/*
+ * Set up inputs of @filename. Everything is derived from the file
+ * and fixed seeds, so two runs on one file do the same work.
+ */
+static int bench_ctx_alloc(struct bench_ctx *ctx, const char *filename)
+{
+    uint32_t seed = 1;
+    int i, n, step;
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ef = elf_file_alloc(filename);
+    if (!ctx->ef) {
+        fprintf(stderr, "microbench: %s: not an ELF32 file\n", filename);
+        return -1;
+    }
+    ctx->symtab = elf_file_section_by_type(ctx->ef, SHT_SYMTAB);
+    ctx->sym = symbolizer_alloc(filename, NULL);
+
+    n = ctx->ef->section_numbers - 1;
+    ctx->name_numbers = n < BENCH_NAMES ? n : BENCH_NAMES;
+    ctx->names = xmalloc(sizeof(char *) * (ctx->name_numbers + 1));
+    step = ctx->name_numbers ? n / ctx->name_numbers : 1;
+    for (i = 0; i < ctx->name_numbers; i++)
+        ctx->names[i] = elf_file_section_name(ctx->ef,
+                        ctx->ef->section_table + 1 + i * step);
+
+    ctx->values = xmalloc(sizeof(uint32_t) * (BENCH_HEX + 8));
+    for (i = 0; i < BENCH_HEX + 8; i++) {
+        seed = seed * 1103515245 + 12345;
+        ctx->values[i] = seed;
+    }
+
+    /* function addresses, shuffled so lookups don't walk in order */
+    ctx->addresses = xmalloc(sizeof(uint64_t) * BENCH_ADDRESSES);
+    if (ctx->sym && ctx->sym->func_numbers) {
+        for (i = 0; i < BENCH_ADDRESSES; i++)
+            ctx->addresses[i] = ctx->sym->func_low[
+                                ctx->values[i] % ctx->sym->func_numbers];
+        ctx->address_numbers = BENCH_ADDRESSES;
+    }
+
+    ctx->json = json_writer_alloc(fopen("/dev/null", "w"));
+    return 0;
+}
+
+static void bench_ctx_free(struct bench_ctx *ctx)
+{
+    FILE *fp = ctx->json->fp;
+
+    json_writer_free(ctx->json);
+    fclose(fp);
+    xfree(ctx->addresses);
+    xfree(ctx->values);
+    xfree(ctx->names);
+    symbolizer_free(ctx->sym);
+    elf_file_free(ctx->ef);
+}
+
+static void usage(void)
+{
+    printf("Usage: microbench [option(s)] [file(s)]\n");
+    printf(" Times library primitives on ELF files\n");
+    printf(" If no input file(s) are specified, a.out is assumed\n");
+    printf(" The options are:\n");
+    printf("  -r        --repeat=<number>     Timed passes (default 31)\n");
+    printf("  -w        --warmup=<number>     Untimed passes first (default 3)\n");
+    printf("  -b        --bench=<name>        Run only benchmarks starting with <name>\n");
+    printf("  -l        --list                List benchmarks\n");
+    printf("  -h        --help                Display this information\n");
+    printf(" Times are medians and 99th percentiles over passes in ns, per\n");
+    printf(" element figures are from the median. Cycles are time stamp\n");
+    printf(" counter ticks, '-' where there is no counter.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"repeat", required_argument, NULL, 'r'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"bench", required_argument, NULL, 'b'},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    struct bench_ctx ctx;
+    int c, i, ret = 0;
+    size_t j;
+
+    while ((c = getopt_long(argc, argv, "r:w:b:lh", long_opts,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'r':
+            __repeat = atoi(optarg);
+            if (__repeat < 1) {
+                fprintf(stderr, "microbench: invalid repeat '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            __warmup = atoi(optarg);
+            break;
+        case 'b':
+            __filter = optarg;
+            break;
+        case 'l':
+            for (j = 0; j < sizeof(benches) / sizeof(benches[0]); j++)
+                printf("%s\n", benches[j].name);
+            return 0;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifdef CONFIG_ENABLE_LOGGING
+    /* messages of log_debug aren't for the terminal */
+    setenv("UTILSE_LOG_FILE", "/dev/null", 0);
+#endif
+    if (optind == argc)
+        argv[--optind] = "a.out";
+    for (i = optind; i < argc; i++) {
+        if (bench_ctx_alloc(&ctx, argv[i]) < 0) {
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        printf("# %s repeat %d warmup %d\n", argv[i], __repeat, __warmup);
+        printf("%-16s %10s %12s %12s %10s %10s\n", "bench", "elements",
+               "median_ns", "p99_ns", "ns/elem", "cycles/elem");
+        for (j = 0; j < sizeof(benches) / sizeof(benches[0]); j++)
+            if (!__filter || !strncmp(benches[j].name, __filter,
+                                      strlen(__filter)))
+                bench_run(&benches[j], &ctx);
+        bench_ctx_free(&ctx);
+    }
+    return ret;
+}
@@ -0,0 +1,722 @@
+/*
+ * nm
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <elf.h>
+#include <elf_batch.h>
+#include <archive.h>
+#include <metacache.h>
+#include <demangle.h>
+#include <radix.h>
+#include <trace.h>
+#include <xmalloc.h>
+
+#define SORT_NAME      0
+#define SORT_ADDRESS   1
+#define SORT_SIZE      2
+#define SORT_NONE      3
+
+static int __sort = SORT_NAME;
+static int __reverse;
+static int __print_size;
+static int __undefined_only;
+static int __defined_only;
+static int __extern_only;
+static int __debug_syms;
+static int __dynamic;
+static int __print_file_name;
+static int __demangle;
+static int __print_armap;
+static int __jobs;
+static const char *__cache_dir;
+static const char *__find;
+static int __io = ELF_BATCH_AUTO;
+
+/*
+ * symbol type letter, as nm(1) describes them.
+ */
+static char nm_symbol_type(struct elf_file *ef, Elf32_Sym *sym)
+{
+    int bind = ELF32_ST_BIND(sym->st_info);
+    int type = ELF32_ST_TYPE(sym->st_info);
+    Elf32_Shdr *st;
+    char c;
+
+    if (type == STT_GNU_IFUNC)
+        return 'i';
+    if (bind == STB_GNU_UNIQUE)
+        return 'u';
+    if (sym->st_shndx == SHN_UNDEF) {
+        if (bind == STB_WEAK)
+            return type == STT_OBJECT ? 'v' : 'w';
+        return 'U';
+    }
+    if (sym->st_shndx == SHN_COMMON)
+        return 'C';
+    if (bind == STB_WEAK)
+        return type == STT_OBJECT ? 'V' : 'W';
+
+    if (sym->st_shndx == SHN_ABS)
+        c = 'a';
+    else if (!(st = elf_file_section(ef, sym->st_shndx)))
+        c = '?';
+    else if (!(st->sh_flags & SHF_ALLOC))
+        c = 'n';
+    else if (st->sh_flags & SHF_EXECINSTR)
+        c = 't';
+    else if (st->sh_type == SHT_NOBITS)
+        c = 'b';
+    else if (st->sh_flags & SHF_WRITE)
+        c = 'd';
+    else
+        c = 'r';
+
+    /* debugging symbols are shown as 'N' regardless of binding */
+    if (c == 'n')
+        return 'N';
+    if (bind != STB_LOCAL && c != '?')
+        c -= 'a' - 'A';
+    return c;
+}
+
+/*
+ * symbol name, section symbols are named after their section.
+ */
+static const char *nm_symbol_name(struct elf_file *ef, Elf32_Shdr *symtab,
+                                  Elf32_Sym *sym)
+{
+    Elf32_Shdr *st;
+
+    if (ELF32_ST_TYPE(sym->st_info) == STT_SECTION &&
+        (st = elf_file_section(ef, sym->st_shndx)))
+        return elf_file_section_name(ef, st);
+    return elf_file_symbol_name(ef, symtab, sym);
+}
+
+/*
+ * whether symbol passes selected filters.
+ */
+static int nm_symbol_wanted(Elf32_Sym *sym)
+{
+    int type = ELF32_ST_TYPE(sym->st_info);
+    int bind = ELF32_ST_BIND(sym->st_info);
+
+    if (!__debug_syms && (type == STT_SECTION || type == STT_FILE))
+        return 0;
+    if (__undefined_only && sym->st_shndx != SHN_UNDEF)
+        return 0;
+    if (__defined_only && sym->st_shndx == SHN_UNDEF)
+        return 0;
+    if (__extern_only && bind == STB_LOCAL)
+        return 0;
+    if (__sort == SORT_SIZE && (sym->st_shndx == SHN_UNDEF || !sym->st_size))
+        return 0;
+    return 1;
+}
+
+/*
+ * name sort context, qsort has no user argument. Archive members
+ * are sorted on many threads at once, so it is per thread.
+ */
+static __thread struct elf_file *sort_ef;
+static __thread Elf32_Shdr *sort_symtab;
+
+static int nm_name_compare(const void *a, const void *b)
+{
+    Elf32_Sym *sa = elf_file_symbol(sort_ef, sort_symtab, *(uint32_t *)a);
+    Elf32_Sym *sb = elf_file_symbol(sort_ef, sort_symtab, *(uint32_t *)b);
+
+    return strcmp(nm_symbol_name(sort_ef, sort_symtab, sa),
+                  nm_symbol_name(sort_ef, sort_symtab, sb));
+}
+
+static void nm_reverse(uint32_t *index, int n)
+{
+    int i;
+
+    for (i = 0; i < n / 2; i++) {
+        uint32_t tmp = index[i];
+
+        index[i] = index[n - 1 - i];
+        index[n - 1 - i] = tmp;
+    }
+}
+
+/*
+ * Order symbol indexes. Address and size orders use a stable LSD
+ * radix sort, then only runs of equal keys are sorted by name, so
+ * ties are in name order like GNU nm prints them.
+ */
+static void nm_sort(struct elf_file *ef, Elf32_Shdr *symtab,
+                    uint32_t *index, int n)
+{
+    uint64_t *keys;
+    int i, j;
+
+    sort_ef = ef;
+    sort_symtab = symtab;
+    switch (__sort) {
+    case SORT_NAME:
+        qsort(index, n, sizeof(uint32_t), nm_name_compare);
+        break;
+    case SORT_ADDRESS:
+    case SORT_SIZE:
+        keys = xmalloc(sizeof(uint64_t) * n);
+        for (i = 0; i < n; i++) {
+            Elf32_Sym *sym = elf_file_symbol(ef, symtab, index[i]);
+
+            if (__sort == SORT_SIZE)
+                keys[i] = sym->st_size;
+            /* undefined symbols go first on address order */
+            else if (sym->st_shndx == SHN_UNDEF)
+                keys[i] = 0;
+            else
+                keys[i] = (uint64_t)sym->st_value + 1;
+        }
+        radix_sort_u64(keys, index, n);
+        for (i = 0; i < n; i = j) {
+            for (j = i + 1; j < n && keys[j] == keys[i]; j++)
+                ;
+            if (j - i > 1)
+                qsort(index + i, j - i, sizeof(uint32_t), nm_name_compare);
+        }
+        xfree(keys);
+        break;
+    }
+
+    if (__reverse)
+        nm_reverse(index, n);
+}
+
+/*
+ * Every symbol by name, from the metadata cache. On a miss the
+ * order is sorted once and stored for the next run.
+ * @index: room for @n indexes, symbols 1 to @n.
+ * @return: 0 if @index holds the order.
+ */
+static int nm_cached_name_order(struct elf_file *ef, Elf32_Shdr *symtab,
+                                uint32_t *index, int n)
+{
+    struct metacache_writer *w;
+    struct metacache *mc;
+    const uint32_t *order;
+    uint64_t size;
+    /* .symtab and -D .dynsym of one file have an order each */
+    int tag = symtab->sh_type == SHT_DYNSYM ? METACACHE_DYN_ORDER :
+              METACACHE_NAME_ORDER;
+    int i;
+
+    if (ef->borrowed)
+        return -1;
+    mc = metacache_alloc(__cache_dir, ef);
+    if (mc && (order = metacache_blob(mc, tag, &size)) &&
+        size == sizeof(uint32_t) * n) {
+        for (i = 0; i < n; i++)
+            if (order[i] < 1 || order[i] > (uint32_t)n)
+                break;
+        if (i == n) {
+            memcpy(index, order, size);
+            metacache_free(mc);
+            return 0;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        index[i] = i + 1;
+    sort_ef = ef;
+    sort_symtab = symtab;
+    qsort(index, n, sizeof(uint32_t), nm_name_compare);
+    if ((w = metacache_writer_alloc(__cache_dir, ef))) {
+        metacache_begin(w, tag);
+        metacache_append(w, index, sizeof(uint32_t) * n);
+        if (mc)
+            metacache_copy(w, mc);
+        metacache_commit(w);
+    }
+    metacache_free(mc);
+    return 0;
+}
+
+static void nm_print_symbol(struct elf_file *ef, Elf32_Shdr *symtab,
+                            Elf32_Sym *sym, const char *prefix)
+{
+    char type = nm_symbol_type(ef, sym);
+
+    if (__print_file_name)
+        printf("%s:", prefix);
+    /* --size-sort shows size in place of value, unless -S asks for both */
+    if (__sort == SORT_SIZE && !__print_size)
+        printf("%08x ", sym->st_size);
+    else if (type == 'U' || type == 'w' || type == 'v')
+        printf("%8s ", "");
+    else {
+        printf("%08x ", sym->st_value);
+        if (__print_size && sym->st_size)
+            printf("%08x ", sym->st_size);
+    }
+    /* sorting stays on mangled names, like GNU nm */
+    if (__demangle)
+        printf("%c %s\n", type, demangle(nm_symbol_name(ef, symtab, sym)));
+    else
+        printf("%c %s\n", type, nm_symbol_name(ef, symtab, sym));
+}
+
+/*
+ * symbols of one ELF file, selected and ordered for printing
+ * @ef: elf file handle, NULL if file couldn't be loaded.
+ * @symtab: symbol table, NULL if file has none.
+ * @index: symbol indexes in print order.
+ * @err: errno if file couldn't be loaded.
+ */
+struct nm_symbols {
+    struct elf_file *ef;
+    Elf32_Shdr      *symtab;
+    uint32_t        *index;
+    int             index_numbers;
+    int             err;
+};
+
+/*
+ * Select and sort symbols of loaded file. Nothing is printed, so
+ * archive members can go through here on any thread.
+ */
+static void nm_collect(struct nm_symbols *syms)
+{
+    struct elf_file *ef = syms->ef;
+    Elf32_Shdr *symtab;
+    int i, n, numbers;
+
+    symtab = elf_file_section_by_type(ef, __dynamic ? SHT_DYNSYM : SHT_SYMTAB);
+    if (!symtab)
+        return;
+
+    numbers = elf_file_symbol_numbers(ef, symtab);
+    syms->index = xmalloc(sizeof(uint32_t) * (numbers ? numbers : 1));
+    if (__sort == SORT_NAME && __cache_dir && numbers > 1 &&
+        !nm_cached_name_order(ef, symtab, syms->index, numbers - 1)) {
+        /* filtering keeps the order of the full table */
+        for (i = 0, n = 0; i < numbers - 1; i++) {
+            uint32_t index = syms->index[i];
+
+            if (nm_symbol_wanted(elf_file_symbol(ef, symtab, index)))
+                syms->index[n++] = index;
+        }
+        if (__reverse)
+            nm_reverse(syms->index, n);
+    } else {
+        for (i = 1, n = 0; i < numbers; i++) {
+            Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+
+            if (nm_symbol_wanted(sym))
+                syms->index[n++] = i;
+        }
+        if (__sort != SORT_NONE)
+            nm_sort(ef, symtab, syms->index, n);
+    }
+    syms->symtab = symtab;
+    syms->index_numbers = n;
+}
+
+/*
+ * Print collected symbols and release them.
+ * @prefix: printed before every symbol with -A.
+ * @return: 0 on success.
+ */
+static int nm_print(struct nm_symbols *syms, const char *name,
+                    const char *prefix)
+{
+    struct elf_file *ef = syms->ef;
+    int i;
+
+    if (!ef) {
+        fprintf(stderr, "nm: %s: %s\n", name, syms->err == EINVAL ?
+                "file format not recognized" : strerror(syms->err));
+        return 1;
+    }
+    if (!syms->symtab)
+        fprintf(stderr, "nm: %s: no symbols\n", name);
+    for (i = 0; i < syms->index_numbers; i++)
+        nm_print_symbol(ef, syms->symtab,
+                        elf_file_symbol(ef, syms->symtab, syms->index[i]),
+                        prefix);
+    xfree(syms->index);
+    elf_file_free(ef);
+    return 0;
+}
+
+static void nm_member(struct archive *ar, int index, void *data)
+{
+    struct nm_symbols *syms = (struct nm_symbols *)data + index;
+    struct trace_clock t;
+
+    trace_begin(&t);
+    syms->ef = archive_member_elf(ar, index);
+    if (!syms->ef)
+        syms->err = errno;
+    else
+        nm_collect(syms);
+    trace_end(&t, TRACE_FILE, ar->members[index].name, ar->filename);
+}
+
+/*
+ * List symbols of every member of archive. Members are loaded and
+ * sorted in parallel, then printed in archive order.
+ * @return: 0 on success.
+ */
+static int nm_archive(struct elf_batch_file *bf, int multiple)
+{
+    const char *filename = bf->filename;
+    struct nm_symbols *syms;
+    struct archive *ar;
+    char *prefix = NULL;
+    int i, ret = 0;
+
+    ar = archive_alloc_fd(filename, bf->fd, bf->size);
+    if (!ar) {
+        fprintf(stderr, "nm: %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+    /* unlike plain files, GNU nm names archives even with -A */
+    if (multiple)
+        printf("\n%s:\n", filename);
+
+    if (__print_armap && ar->symbol_numbers) {
+        printf("\nArchive index:\n");
+        for (i = 0; i < ar->symbol_numbers; i++)
+            printf("%s in %s\n", ar->symbols[i].name,
+                   ar->members[ar->symbols[i].member].name);
+    }
+
+    syms = xmalloc(sizeof(struct nm_symbols) * (ar->member_numbers ?
+                                                ar->member_numbers : 1));
+    memset(syms, 0, sizeof(struct nm_symbols) * ar->member_numbers);
+    archive_for_each(ar, __jobs, nm_member, syms);
+
+    for (i = 0; i < ar->member_numbers; i++) {
+        const char *name = ar->members[i].name;
+
+        if (__print_file_name) {
+            prefix = xmalloc(strlen(filename) + strlen(name) + 2);
+            sprintf(prefix, "%s:%s", filename, name);
+        } else if (syms[i].ef) {
+            printf("\n%s:\n", name);
+        }
+        ret |= nm_print(&syms[i], name, prefix);
+        xfree(prefix);
+        prefix = NULL;
+    }
+    xfree(syms);
+    archive_free(ar);
+    return ret;
+}
+
+/*
+ * List symbols of one plain file.
+ * @ef: loaded file, NULL with errno set if it couldn't be loaded.
+ * @return: 0 on success.
+ */
+static int nm_elf_file(const char *filename, struct elf_file *ef,
+                       int multiple)
+{
+    struct nm_symbols syms;
+
+    memset(&syms, 0, sizeof(syms));
+    syms.ef = ef;
+    if (!syms.ef)
+        syms.err = errno;
+    else {
+        if (multiple && !__print_file_name)
+            printf("\n%s:\n", filename);
+        nm_collect(&syms);
+    }
+    return nm_print(&syms, filename, filename);
+}
+
+/*
+ * inputs listed through a batch loader
+ * @found: --find symbol was defined in some input.
+ */
+struct nm_inputs {
+    int multiple;
+    int ret;
+    int found;
+};
+
+/*
+ * --find on archive. Only the symbol index is read, members are
+ * never parsed.
+ * @return: 0 on success, found or not.
+ */
+static int nm_find_archive(struct elf_batch_file *bf, struct nm_inputs *in)
+{
+    struct archive *ar;
+    int member;
+
+    ar = archive_alloc_fd(bf->filename, bf->fd, bf->size);
+    if (!ar) {
+        fprintf(stderr, "nm: %s: %s\n", bf->filename, strerror(errno));
+        return 1;
+    }
+    if (!ar->symbol_numbers) {
+        fprintf(stderr, "nm: %s: no archive index\n", bf->filename);
+        archive_free(ar);
+        return 1;
+    }
+    member = archive_lookup(ar, __find);
+    if (member >= 0) {
+        if (in->multiple)
+            printf("%s:", bf->filename);
+        printf("%s in %s\n", __find, ar->members[member].name);
+        in->found = 1;
+    }
+    archive_free(ar);
+    return 0;
+}
+
+/*
+ * --find on plain file, a global definition on its symbol table.
+ * @return: 0 on success, found or not.
+ */
+static int nm_find_elf(const char *filename, struct elf_file *ef,
+                       struct nm_inputs *in)
+{
+    Elf32_Shdr *symtab;
+    int i, numbers;
+
+    if (!ef) {
+        fprintf(stderr, "nm: %s: %s\n", filename, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+        return 1;
+    }
+    symtab = elf_file_section_by_type(ef, __dynamic ? SHT_DYNSYM : SHT_SYMTAB);
+    numbers = symtab ? elf_file_symbol_numbers(ef, symtab) : 0;
+    for (i = 1; i < numbers; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+
+        if (sym->st_shndx == SHN_UNDEF ||
+            ELF32_ST_BIND(sym->st_info) == STB_LOCAL ||
+            strcmp(elf_file_symbol_name(ef, symtab, sym), __find))
+            continue;
+        if (in->multiple)
+            printf("%s:", filename);
+        printf("%s in %s\n", __find, filename);
+        in->found = 1;
+        break;
+    }
+    elf_file_free(ef);
+    return 0;
+}
+
+/*
+ * Batch callback, lists one input file.
+ */
+static void nm_one_file(struct elf_batch_file *bf, int index, void *data)
+{
+    struct nm_inputs *inputs = data;
+    struct trace_clock t;
+
+    trace_begin(&t);
+    if (__find && !bf->err && archive_check_mem(bf->header, bf->header_size))
+        inputs->ret |= nm_find_archive(bf, inputs);
+    else if (__find)
+        inputs->ret |= nm_find_elf(bf->filename, elf_batch_elf(bf), inputs);
+    else if (!bf->err && archive_check_mem(bf->header, bf->header_size))
+        inputs->ret |= nm_archive(bf, inputs->multiple);
+    else
+        inputs->ret |= nm_elf_file(bf->filename, elf_batch_elf(bf),
+                                   inputs->multiple);
+    trace_end(&t, TRACE_FILE, bf->filename, NULL);
+}
+
+static void usage(void)
+{
+    printf("Usage: nm [option(s)] [file(s)]\n");
+    printf(" List symbols in [file(s)] (a.out by default).\n");
+    printf(" The options are:\n");
+    printf("  -a, --debug-syms       Display debugger-only symbols\n");
+    printf("  -A, --print-file-name  Print name of the input file before every symbol\n");
+    printf("  -C, --demangle         Decode low-level symbol names into user-level names\n");
+    printf("                         (std::string stays short as with GNU nm, not c++filt)\n");
+    printf("  -D, --dynamic          Display dynamic symbols instead of normal symbols\n");
+    printf("      --defined-only     Display only defined symbols\n");
+    printf("  -g, --extern-only      Display only external symbols\n");
+    printf("  -n, --numeric-sort     Sort symbols numerically by address\n");
+    printf("  -p, --no-sort          Do not sort the symbols\n");
+    printf("  -r, --reverse-sort     Reverse the sense of the sort\n");
+    printf("  -s, --print-armap      Include index for symbols from archive members\n");
+    printf("  -S, --print-size       Print size of defined symbols\n");
+    printf("      --size-sort        Sort symbols by size\n");
+    printf("  -u, --undefined-only   Display only undefined symbols\n");
+    printf("  -j, --jobs=N           Load archive members on N threads (default all CPUs)\n");
+    printf("      --cache-dir=DIR    Keep symbol name order in DIR across runs\n");
+    printf("      --find=SYMBOL      Print the member defining SYMBOL, from the archive\n");
+    printf("                         index without reading members; exit status 1 if\n");
+    printf("                         no input defines it\n");
+    printf("      --io=ENGINE        Open files through auto, uring or pread\n");
+    printf("      --trace=FILE       Write spans per file, phase and thread to FILE\n");
+    printf("                         as Chrome trace events\n");
+    printf("  -h, --help             Display this information\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"debug-syms", no_argument, NULL, 'a'},
+        {"print-file-name", no_argument, NULL, 'A'},
+        {"demangle", no_argument, NULL, 'C'},
+        {"dynamic", no_argument, NULL, 'D'},
+        {"defined-only", no_argument, NULL, 'F'},
+        {"extern-only", no_argument, NULL, 'g'},
+        {"numeric-sort", no_argument, NULL, 'n'},
+        {"no-sort", no_argument, NULL, 'p'},
+        {"reverse-sort", no_argument, NULL, 'r'},
+        {"print-armap", no_argument, NULL, 's'},
+        {"print-size", no_argument, NULL, 'S'},
+        {"size-sort", no_argument, NULL, 'Z'},
+        {"undefined-only", no_argument, NULL, 'u'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"cache-dir", required_argument, NULL, 'M'},
+        {"find", required_argument, NULL, 'L'},
+        {"io", required_argument, NULL, 'I'},
+        {"trace", required_argument, NULL, 'P'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *short_opts = "aACDgnvprsSuj:h";
+    const char *default_names[] = { "a.out" };
+    const char *trace_file = NULL;
+    struct nm_inputs inputs;
+    struct elf_batch *batch;
+    const char **names;
+    int c, n;
+
+    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'a':
+            __debug_syms = 1;
+            break;
+        case 'A':
+            __print_file_name = 1;
+            break;
+        case 'C':
+            __demangle = 1;
+            break;
+        case 'D':
+            __dynamic = 1;
+            break;
+        case 'F':
+            __defined_only = 1;
+            break;
+        case 'g':
+            __extern_only = 1;
+            break;
+        case 'n':
+        case 'v':
+            __sort = SORT_ADDRESS;
+            break;
+        case 'p':
+            __sort = SORT_NONE;
+            break;
+        case 'r':
+            __reverse = 1;
+            break;
+        case 's':
+            __print_armap = 1;
+            break;
+        case 'S':
+            __print_size = 1;
+            break;
+        case 'j':
+            __jobs = atoi(optarg);
+            break;
+        case 'M':
+            __cache_dir = optarg;
+            break;
+        case 'L':
+            __find = optarg;
+            break;
+        case 'I':
+            if (!strcmp(optarg, "auto"))
+                __io = ELF_BATCH_AUTO;
+            else if (!strcmp(optarg, "uring"))
+                __io = ELF_BATCH_URING;
+            else if (!strcmp(optarg, "pread"))
+                __io = ELF_BATCH_PREAD;
+            else {
+                fprintf(stderr, "nm: invalid argument to --io: %s\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P':
+            trace_file = optarg;
+            break;
+        case 'Z':
+            __sort = SORT_SIZE;
+            break;
+        case 'u':
+            __undefined_only = 1;
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (trace_file) {
+#ifdef CONFIG_TRACE
+        if (trace_open(trace_file)) {
+            fprintf(stderr, "nm: %s: %s\n", trace_file, strerror(errno));
+            return EXIT_FAILURE;
+        }
+#else
+        fprintf(stderr, "nm: --trace not configured (CONFIG_TRACE)\n");
+        return EXIT_FAILURE;
+#endif
+    }
+    if (optind == argc) {
+        names = default_names;
+        n = 1;
+    } else {
+        names = (const char **)argv + optind;
+        n = argc - optind;
+    }
+    inputs.multiple = n > 1;
+    inputs.ret = 0;
+    inputs.found = 0;
+    /* a ring only pays off with many files */
+    batch = elf_batch_alloc(n > 1 ? __io : ELF_BATCH_PREAD, 0);
+    elf_batch_run(batch, names, n, nm_one_file, &inputs);
+    elf_batch_free(batch);
+    demangle_cache_free();
+    archive_cache_free();
+#ifdef CONFIG_TRACE
+    if (trace_file && trace_close()) {
+        fprintf(stderr, "nm: %s: %s\n", trace_file, strerror(errno));
+        inputs.ret = 1;
+    }
+#endif
+    if (__find && !inputs.found)
+        inputs.ret = 1;
+    return inputs.ret;
+}
@@ -19,50 +19,916 @@
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
+#include <pthread.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 #include <elf.h>
+#include <archive.h>
+#include <demangle.h>
+#include <dwarf.h>
+#include <json.h>
+#include <columnar.h>
+#include <stats.h>
+#include <trace.h>
+#include <hash.h>
 #include <xmalloc.h>
 
+/* bytes of section contents in one file worth hashing on threads */
+#define DUMP_HASH_PARALLEL    (1024 * 1024)
+
+/* bytes of section contents memcmp() is asked about at once */
+#define DIFF_CHUNK            4096
+
+static int __dump_file_headers;
 static int __dump_headers;
+static int __dump_private;
 static int __dump_symtab;
+static int __dump_dynamic_symtab;
+static int __dump_reloc;
+static int __dump_dynamic_reloc;
+static int __demangle;
+static int __dump_debug_line;
+static int __dump_archive_headers;
+static int __dump_hashes;
+static int __hash_sha256;
+static int __jobs;
+static struct json_writer *__json;
+static const char *__export_file;
+static int __dump_any;
+
+/*
+ * BFD style section flags, bit N of a section mask selects
+ * SECTION_FLAGS[N].
+ */
+#define SEC_CONTENTS       (1 << 0)
+#define SEC_ALLOC          (1 << 1)
+#define SEC_LOAD           (1 << 2)
+#define SEC_RELOC          (1 << 3)
+#define SEC_READONLY       (1 << 4)
+#define SEC_CODE           (1 << 5)
+#define SEC_DATA           (1 << 6)
+#define SEC_DEBUGGING      (1 << 7)
+#define SEC_THREAD_LOCAL   (1 << 8)
+#define SEC_GROUP          (1 << 9)
+#define SEC_EXCLUDE        (1 << 10)
 
 static const char *SECTION_FLAGS[] = {
     "CONTENTS", "ALLOC", "LOAD", "RELOC",
-    "READONLY", "CODE",
+    "READONLY", "CODE", "DATA", "DEBUGGING",
+    "THREAD_LOCAL", "GROUP", "EXCLUDE",
+};
+
+/* section type names, indexed by sh_type */
+static const char *SECTION_TYPES[SHT_NUM] = {
+    [SHT_NULL]          = "NULL",
+    [SHT_PROGBITS]      = "PROGBITS",
+    [SHT_SYMTAB]        = "SYMTAB",
+    [SHT_STRTAB]        = "STRTAB",
+    [SHT_RELA]          = "RELA",
+    [SHT_HASH]          = "HASH",
+    [SHT_DYNAMIC]       = "DYNAMIC",
+    [SHT_NOTE]          = "NOTE",
+    [SHT_NOBITS]        = "NOBITS",
+    [SHT_REL]           = "REL",
+    [SHT_SHLIB]         = "SHLIB",
+    [SHT_DYNSYM]        = "DYNSYM",
+    [SHT_INIT_ARRAY]    = "INIT_ARRAY",
+    [SHT_FINI_ARRAY]    = "FINI_ARRAY",
+    [SHT_PREINIT_ARRAY] = "PREINIT_ARRAY",
+    [SHT_GROUP]         = "GROUP",
+    [SHT_SYMTAB_SHNDX]  = "SYMTAB SECTION INDICES",
+};
+
+/* OS specific section type names, indexed by sh_type - SHT_GNU_ATTRIBUTES */
+static const char *SECTION_GNU_TYPES[] = {
+    "GNU_ATTRIBUTES", "GNU_HASH", "GNU_LIBLIST", "CHECKSUM",
+    NULL, "SUNW_move", "SUNW_COMDAT", "SUNW_syminfo",
+    "VERDEF", "VERNEED", "VERSYM",
+};
+
+/* readelf section flag letters, indexed by sh_flags bit */
+static const char SECTION_FLAG_LETTERS[32] = {
+    [0] = 'W', [1] = 'A', [2] = 'X', [4] = 'M', [5] = 'S', [6] = 'I',
+    [7] = 'L', [8] = 'O', [9] = 'G', [10] = 'T', [11] = 'C', [31] = 'E',
+};
+
+/* segment type names, indexed by p_type */
+static const char *SEGMENT_TYPES[PT_NUM] = {
+    [PT_NULL]    = "NULL",
+    [PT_LOAD]    = "LOAD",
+    [PT_DYNAMIC] = "DYNAMIC",
+    [PT_INTERP]  = "INTERP",
+    [PT_NOTE]    = "NOTE",
+    [PT_SHLIB]   = "SHLIB",
+    [PT_PHDR]    = "PHDR",
+    [PT_TLS]     = "TLS",
+};
+
+/* GNU segment type names, indexed by p_type - PT_GNU_EH_FRAME */
+static const char *SEGMENT_GNU_TYPES[] = {
+    "EH_FRAME", "STACK", "RELRO", "PROPERTY",
+};
+
+/* dynamic tag names, indexed by d_tag */
+static const char *DYNAMIC_TAGS[DT_NUM] = {
+    [DT_NULL]            = "NULL",
+    [DT_NEEDED]          = "NEEDED",
+    [DT_PLTRELSZ]        = "PLTRELSZ",
+    [DT_PLTGOT]          = "PLTGOT",
+    [DT_HASH]            = "HASH",
+    [DT_STRTAB]          = "STRTAB",
+    [DT_SYMTAB]          = "SYMTAB",
+    [DT_RELA]            = "RELA",
+    [DT_RELASZ]          = "RELASZ",
+    [DT_RELAENT]         = "RELAENT",
+    [DT_STRSZ]           = "STRSZ",
+    [DT_SYMENT]          = "SYMENT",
+    [DT_INIT]            = "INIT",
+    [DT_FINI]            = "FINI",
+    [DT_SONAME]          = "SONAME",
+    [DT_RPATH]           = "RPATH",
+    [DT_SYMBOLIC]        = "SYMBOLIC",
+    [DT_REL]             = "REL",
+    [DT_RELSZ]           = "RELSZ",
+    [DT_RELENT]          = "RELENT",
+    [DT_PLTREL]          = "PLTREL",
+    [DT_DEBUG]           = "DEBUG",
+    [DT_TEXTREL]         = "TEXTREL",
+    [DT_JMPREL]          = "JMPREL",
+    [DT_BIND_NOW]        = "BIND_NOW",
+    [DT_INIT_ARRAY]      = "INIT_ARRAY",
+    [DT_FINI_ARRAY]      = "FINI_ARRAY",
+    [DT_INIT_ARRAYSZ]    = "INIT_ARRAYSZ",
+    [DT_FINI_ARRAYSZ]    = "FINI_ARRAYSZ",
+    [DT_RUNPATH]         = "RUNPATH",
+    [DT_FLAGS]           = "FLAGS",
+    [DT_PREINIT_ARRAY]   = "PREINIT_ARRAY",
+    [DT_PREINIT_ARRAYSZ] = "PREINIT_ARRAYSZ",
+};
+
+/* i386 relocation names, indexed by relocation type */
+static const char *RELOC_386_TYPES[R_386_NUM] = {
+    [R_386_NONE]          = "R_386_NONE",
+    [R_386_32]            = "R_386_32",
+    [R_386_PC32]          = "R_386_PC32",
+    [R_386_GOT32]         = "R_386_GOT32",
+    [R_386_PLT32]         = "R_386_PLT32",
+    [R_386_COPY]          = "R_386_COPY",
+    [R_386_GLOB_DAT]      = "R_386_GLOB_DAT",
+    [R_386_JMP_SLOT]      = "R_386_JUMP_SLOT",
+    [R_386_RELATIVE]      = "R_386_RELATIVE",
+    [R_386_GOTOFF]        = "R_386_GOTOFF",
+    [R_386_GOTPC]         = "R_386_GOTPC",
+    [R_386_32PLT]         = "R_386_32PLT",
+    [R_386_TLS_TPOFF]     = "R_386_TLS_TPOFF",
+    [R_386_TLS_IE]        = "R_386_TLS_IE",
+    [R_386_TLS_GOTIE]     = "R_386_TLS_GOTIE",
+    [R_386_TLS_LE]        = "R_386_TLS_LE",
+    [R_386_TLS_GD]        = "R_386_TLS_GD",
+    [R_386_TLS_LDM]       = "R_386_TLS_LDM",
+    [R_386_16]            = "R_386_16",
+    [R_386_PC16]          = "R_386_PC16",
+    [R_386_8]             = "R_386_8",
+    [R_386_PC8]           = "R_386_PC8",
+    [R_386_TLS_LDO_32]    = "R_386_TLS_LDO_32",
+    [R_386_TLS_DTPMOD32]  = "R_386_TLS_DTPMOD32",
+    [R_386_TLS_DTPOFF32]  = "R_386_TLS_DTPOFF32",
+    [R_386_TLS_TPOFF32]   = "R_386_TLS_TPOFF32",
+    [R_386_SIZE32]        = "R_386_SIZE32",
+    [R_386_TLS_GOTDESC]   = "R_386_TLS_GOTDESC",
+    [R_386_TLS_DESC_CALL] = "R_386_TLS_DESC_CALL",
+    [R_386_TLS_DESC]      = "R_386_TLS_DESC",
+    [R_386_IRELATIVE]     = "R_386_IRELATIVE",
+    [R_386_GOT32X]        = "R_386_GOT32X",
+};
+
+/* symbol visibility prefix, indexed by ELF32_ST_VISIBILITY() */
+static const char *SYMBOL_VISIBILITY[] = {
+    [STV_DEFAULT]   = "",
+    [STV_INTERNAL]  = ".internal ",
+    [STV_HIDDEN]    = ".hidden ",
+    [STV_PROTECTED] = ".protected ",
+};
+
+/* symbol binding names, indexed by ELF32_ST_BIND() */
+static const char *SYMBOL_BINDS[STB_GNU_UNIQUE + 1] = {
+    [STB_LOCAL]      = "LOCAL",
+    [STB_GLOBAL]     = "GLOBAL",
+    [STB_WEAK]       = "WEAK",
+    [STB_GNU_UNIQUE] = "UNIQUE",
+};
+
+/* symbol type names, indexed by ELF32_ST_TYPE() */
+static const char *SYMBOL_TYPES[STT_GNU_IFUNC + 1] = {
+    [STT_NOTYPE]    = "NOTYPE",
+    [STT_OBJECT]    = "OBJECT",
+    [STT_FUNC]      = "FUNC",
+    [STT_SECTION]   = "SECTION",
+    [STT_FILE]      = "FILE",
+    [STT_COMMON]    = "COMMON",
+    [STT_TLS]       = "TLS",
+    [STT_GNU_IFUNC] = "IFUNC",
+};
+
+/* symbol visibility names, indexed by ELF32_ST_VISIBILITY() */
+static const char *SYMBOL_VISIBILITY_NAMES[] = {
+    [STV_DEFAULT]   = "DEFAULT",
+    [STV_INTERNAL]  = "INTERNAL",
+    [STV_HIDDEN]    = "HIDDEN",
+    [STV_PROTECTED] = "PROTECTED",
+};
+
+/* object file type names, indexed by e_type */
+static const char *FILE_TYPES[ET_NUM] = {
+    [ET_NONE] = "NONE (None)",
+    [ET_REL]  = "REL (Relocatable file)",
+    [ET_EXEC] = "EXEC (Executable file)",
+    [ET_DYN]  = "DYN (Shared object file)",
+    [ET_CORE] = "CORE (Core file)",
+};
+
+/* BFD file format and architecture names */
+static const struct {
+    int        machine;
+    const char *format;
+    const char *arch;
+} ARCH_NAMES[] = {
+    { EM_386,     "elf32-i386",      "i386" },
+    { EM_X86_64,  "elf32-x86-64",    "i386:x64-32" },
+    { EM_ARM,     "elf32-littlearm", "arm" },
+    { EM_AARCH64, "elf32-littleaarch64", "aarch64:ilp32" },
+    { EM_MIPS,    "elf32-tradbigmips", "mips" },
+    { EM_PPC,     "elf32-powerpc",   "powerpc:common" },
+    { EM_SPARC,   "elf32-sparc",     "sparc" },
+    { EM_68K,     "elf32-m68k",      "m68k" },
+    { EM_SH,      "elf32-sh",        "sh" },
+    { EM_S390,    "elf32-s390",      "s390:31-bit" },
 };
 
 /*
- * Dump elf headers
+ * Everything derived from the section table that more than one dump
+ * needs, computed in a single pass over the handle.
+ * @ef: elf file handle.
+ * @sec_flags: BFD style flags for every section.
+ * @symtab: SHT_SYMTAB section, NULL if stripped.
+ * @dynsym: SHT_DYNSYM section, NULL if static.
+ * @dynamic: SHT_DYNAMIC section, NULL if static.
+ * @format: BFD file format name.
+ * @arch: BFD architecture name.
+ * @line: decoded .debug_line when it is going to be dumped.
+ * @hashes: content hashes per section when they are going to be dumped.
+ * @filename: file name, member name for archive members.
+ * @archive: archive file name, NULL for plain files.
+ */
+struct dump_ctx {
+    struct elf_file *ef;
+    unsigned int    *sec_flags;
+    Elf32_Shdr      *symtab;
+    Elf32_Shdr      *dynsym;
+    Elf32_Shdr      *dynamic;
+    const char      *format;
+    const char      *arch;
+    struct dwarf_line *line;
+    struct dump_hash *hashes;
+    const char      *filename;
+    const char      *archive;
+};
+
+/*
+ * content hashes of one section
+ * @done: section has contents in the file and was hashed.
+ */
+struct dump_hash {
+    uint64_t      xxh3;
+    unsigned char sha256[HASH_SHA256_SIZE];
+    int           done;
+};
+
+static int is_debug_section(const char *name)
+{
+    return !strncmp(name, ".debug", 6) || !strncmp(name, ".zdebug", 7) ||
+           !strncmp(name, ".stab", 5) || !strcmp(name, ".line");
+}
+
+static void dump_ctx_init(struct dump_ctx *ctx, struct elf_file *ef)
+{
+    int i, reloc = ef->header->e_type == ET_REL;
+    struct stats_clock c;
+
+    stats_begin(&c);
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ef = ef;
+    ctx->format = "elf32-little";
+    ctx->arch = "UNKNOWN!";
+    for (i = 0; i < sizeof(ARCH_NAMES) / sizeof(ARCH_NAMES[0]); i++) {
+        if (ARCH_NAMES[i].machine == ef->header->e_machine) {
+            ctx->format = ARCH_NAMES[i].format;
+            ctx->arch = ARCH_NAMES[i].arch;
+            break;
+        }
+    }
+
+    ctx->sec_flags = xmalloc(sizeof(unsigned int) *
+                             (ef->section_numbers ? ef->section_numbers : 1));
+    memset(ctx->sec_flags, 0, sizeof(unsigned int) *
+           (ef->section_numbers ? ef->section_numbers : 1));
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        unsigned int flags = ctx->sec_flags[i];
+
+        switch (st->sh_type) {
+        case SHT_SYMTAB:
+            if (!ctx->symtab)
+                ctx->symtab = st;
+            break;
+        case SHT_DYNSYM:
+            if (!ctx->dynsym)
+                ctx->dynsym = st;
+            break;
+        case SHT_DYNAMIC:
+            if (!ctx->dynamic)
+                ctx->dynamic = st;
+            break;
+        case SHT_REL:
+        case SHT_RELA:
+            /* relocations mark the section they apply to */
+            if (reloc && st->sh_info && st->sh_info < ef->section_numbers)
+                ctx->sec_flags[st->sh_info] |= SEC_RELOC;
+            break;
+        case SHT_GROUP:
+            flags |= SEC_GROUP;
+            break;
+        }
+
+        if (st->sh_type != SHT_NOBITS)
+            flags |= SEC_CONTENTS;
+        if (st->sh_flags & SHF_ALLOC) {
+            flags |= SEC_ALLOC;
+            if (st->sh_type != SHT_NOBITS)
+                flags |= SEC_LOAD;
+        }
+        if (!(st->sh_flags & SHF_WRITE) && st->sh_type != SHT_NOBITS)
+            flags |= SEC_READONLY;
+        if (st->sh_flags & SHF_EXECINSTR)
+            flags |= SEC_CODE;
+        else if ((flags & SEC_LOAD))
+            flags |= SEC_DATA;
+        if (st->sh_flags & SHF_TLS)
+            flags |= SEC_THREAD_LOCAL;
+        if (st->sh_flags & SHF_EXCLUDE)
+            flags |= SEC_EXCLUDE;
+        if (is_debug_section(elf_file_section_name(ef, st)))
+            flags |= SEC_DEBUGGING;
+        ctx->sec_flags[i] = flags;
+    }
+    stats_end(&c, STATS_SECTIONS);
+
+    if (__dump_debug_line) {
+        stats_begin(&c);
+        ctx->line = dwarf_line_alloc(ef);
+        stats_end(&c, STATS_DWARF);
+    }
+}
+
+/*
+ * sections of one file handed out to hashing threads
+ * @order: sections with contents, largest first.
+ */
+struct dump_hash_work {
+    struct dump_ctx *ctx;
+    struct {
+        Elf32_Word  size;
+        int         index;
+    }               *order;
+    int             numbers;
+    int             next;
+};
+
+static void dump_hash_section(struct dump_ctx *ctx, int index)
+{
+    Elf32_Shdr *st = elf_file_section(ctx->ef, index);
+    const unsigned char *contents = elf_file_section_contents(ctx->ef, st);
+    struct dump_hash *hash = &ctx->hashes[index];
+
+    if (!contents)
+        return;
+    hash->xxh3 = hash_xxh3(contents, st->sh_size);
+    if (__hash_sha256)
+        hash_sha256(contents, st->sh_size, hash->sha256);
+    hash->done = 1;
+}
+
+static void *dump_hash_worker(void *arg)
+{
+    struct dump_hash_work *work = arg;
+    int i;
+
+    while ((i = __sync_fetch_and_add(&work->next, 1)) < work->numbers)
+        dump_hash_section(work->ctx, work->order[i].index);
+    return NULL;
+}
+
+static int dump_hash_compare(const void *a, const void *b)
+{
+    Elf32_Word x = *(const Elf32_Word *)a, y = *(const Elf32_Word *)b;
+
+    return x > y ? -1 : x < y;
+}
+
+/*
+ * Hash contents of allocated sections. Sections are handed out to
+ * @jobs threads largest first, so one big .text doesn't start last,
+ * once the file has enough bytes to pay for the threads.
+ * @jobs: number of threads, all online CPUs if 0 or less.
+ */
+static void dump_hash_sections(struct dump_ctx *ctx, int jobs)
+{
+    struct elf_file *ef = ctx->ef;
+    int i, n, sections = ef->section_numbers ? ef->section_numbers : 1;
+    struct dump_hash_work work;
+    struct stats_clock c;
+    pthread_t *threads;
+    uint64_t bytes = 0;
+
+    stats_begin(&c);
+    ctx->hashes = xmalloc(sizeof(struct dump_hash) * sections);
+    memset(ctx->hashes, 0, sizeof(struct dump_hash) * sections);
+    work.ctx = ctx;
+    work.order = xmalloc(sizeof(*work.order) * sections);
+    work.numbers = 0;
+    work.next = 0;
+    for (i = 1; i < ef->section_numbers; i++) {
+        if (!(ctx->sec_flags[i] & SEC_LOAD))
+            continue;
+        work.order[work.numbers].size = elf_file_section(ef, i)->sh_size;
+        work.order[work.numbers].index = i;
+        bytes += work.order[work.numbers++].size;
+    }
+    qsort(work.order, work.numbers, sizeof(*work.order), dump_hash_compare);
+
+    if (jobs <= 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > work.numbers)
+        jobs = work.numbers;
+    if (jobs <= 1 || bytes < DUMP_HASH_PARALLEL) {
+        dump_hash_worker(&work);
+    } else {
+        /* caller is one of the workers */
+        threads = xmalloc(sizeof(pthread_t) * (jobs - 1));
+        for (n = 0; n < jobs - 1; n++)
+            if (pthread_create(&threads[n], NULL, dump_hash_worker, &work))
+                break;
+        dump_hash_worker(&work);
+        for (i = 0; i < n; i++)
+            pthread_join(threads[i], NULL);
+        xfree(threads);
+    }
+    xfree(work.order);
+    stats_end(&c, STATS_HASH);
+}
+
+static void dump_ctx_exit(struct dump_ctx *ctx)
+{
+    dwarf_line_free(ctx->line);
+    xfree(ctx->hashes);
+    xfree(ctx->sec_flags);
+}
+
+static const char *section_type_name(Elf32_Word type, char *buf, size_t len)
+{
+    if (type < SHT_NUM && SECTION_TYPES[type])
+        return SECTION_TYPES[type];
+    if (type >= SHT_GNU_ATTRIBUTES && type <= SHT_GNU_versym &&
+        SECTION_GNU_TYPES[type - SHT_GNU_ATTRIBUTES])
+        return SECTION_GNU_TYPES[type - SHT_GNU_ATTRIBUTES];
+    snprintf(buf, len, "%08x: <unknown>", type);
+    return buf;
+}
+
+/* readelf section flag letters of sh_flags, @buf takes 33 bytes */
+static const char *section_flag_letters(Elf32_Word flags, char *buf)
+{
+    int bit, n = 0;
+
+    for (bit = 0; bit < 32; bit++) {
+        if (!(flags & (1U << bit)))
+            continue;
+        if (SECTION_FLAG_LETTERS[bit])
+            buf[n++] = SECTION_FLAG_LETTERS[bit];
+        else if ((1U << bit) & SHF_MASKOS)
+            buf[n++] = 'o';
+        else if ((1U << bit) & SHF_MASKPROC)
+            buf[n++] = 'p';
+        else
+            buf[n++] = 'x';
+    }
+    buf[n] = '\0';
+    return buf;
+}
+
+static const char *segment_type_name(Elf32_Word type, char *buf, size_t len)
+{
+    if (type < PT_NUM && SEGMENT_TYPES[type])
+        return SEGMENT_TYPES[type];
+    if (type >= PT_GNU_EH_FRAME && type <= PT_GNU_PROPERTY)
+        return SEGMENT_GNU_TYPES[type - PT_GNU_EH_FRAME];
+    snprintf(buf, len, "0x%x", type);
+    return buf;
+}
+
+static const char *reloc_type_name(int machine, int type, char *buf,
+                                   size_t len)
+{
+    if (machine == EM_386 && type < R_386_NUM && RELOC_386_TYPES[type])
+        return RELOC_386_TYPES[type];
+    snprintf(buf, len, "*unknown*:%d", type);
+    return buf;
+}
+
+/* log2 of alignment, as BFD prints it */
+static int align_power(Elf32_Word align)
+{
+    int power = 0;
+
+    while (align > 1) {
+        align >>= 1;
+        power++;
+    }
+    return power;
+}
+
+/*
+ * symbol name, section symbols are named after their section.
+ * Demangled with -C.
+ */
+static const char *symbol_name(struct elf_file *ef, Elf32_Shdr *symtab,
+                               Elf32_Sym *sym)
+{
+    Elf32_Shdr *st;
+
+    if (ELF32_ST_TYPE(sym->st_info) == STT_SECTION &&
+        (st = elf_file_section(ef, sym->st_shndx)))
+        return elf_file_section_name(ef, st);
+    if (__demangle)
+        return demangle(elf_file_symbol_name(ef, symtab, sym));
+    return elf_file_symbol_name(ef, symtab, sym);
+}
+
+/* BFD name of section symbol is defined in */
+static const char *symbol_section_name(struct elf_file *ef, Elf32_Sym *sym)
+{
+    Elf32_Shdr *st;
+
+    if (sym->st_shndx == SHN_UNDEF)
+        return "*UND*";
+    if (sym->st_shndx == SHN_ABS)
+        return "*ABS*";
+    if (sym->st_shndx == SHN_COMMON)
+        return "*COM*";
+    if ((st = elf_file_section(ef, sym->st_shndx)))
+        return elf_file_section_name(ef, st);
+    return "*UNKNOWN*";
+}
+
+/*
+ * next note of SHT_NOTE contents, NULL at end or on a truncated note.
+ * @p: position on contents, moved past the note.
+ */
+static const Elf32_Nhdr *note_next(const unsigned char **p,
+                                   const unsigned char *end,
+                                   const char **name,
+                                   const unsigned char **desc)
+{
+    const Elf32_Nhdr *note = (const Elf32_Nhdr *)*p;
+
+    if (*p + sizeof(Elf32_Nhdr) > end)
+        return NULL;
+    *name = (const char *)(note + 1);
+    *desc = (const unsigned char *)*name + ((note->n_namesz + 3) & ~3);
+    if (*desc + note->n_descsz > end || *desc < *p)
+        return NULL;
+    *p = *desc + ((note->n_descsz + 3) & ~3);
+    return note;
+}
+
+/*
+ * Dump file header
  */
-static void dump_headers(const char *filename)
+static void dump_file_header(struct dump_ctx *ctx)
 {
-    Elf32_Ehdr *header;
-    Elf32_Shdr *section_table;
+    struct elf_file *ef = ctx->ef;
+    Elf32_Ehdr *header = ef->header;
+    unsigned int flags = 0;
+    const char *sep = "";
     int i;
 
-    /* get elf header */
-    header = elf_header_alloc(filename);
-    /* get section table */
-    section_table = elf_section_table_alloc(filename);
+    /* BFD file flags */
+    static const char *FILE_FLAGS[] = {
+        "HAS_RELOC", "EXEC_P", "HAS_LINENO", "HAS_DEBUG",
+        "HAS_SYMS", "HAS_LOCALS", "DYNAMIC", "WP_TEXT", "D_PAGED",
+    };
+
+    if (header->e_type == ET_REL) {
+        for (i = 1; i < ef->section_numbers; i++)
+            if (ctx->sec_flags[i] & SEC_RELOC)
+                flags |= 0x01;
+    }
+    if (header->e_type == ET_EXEC)
+        flags |= 0x02;
+    if (ctx->symtab && elf_file_symbol_numbers(ef, ctx->symtab) > 1)
+        flags |= 0x10;
+    if (header->e_type == ET_DYN)
+        flags |= 0x40;
+    if (ef->program_numbers)
+        flags |= 0x100;
+
+    printf("architecture: %s, flags 0x%08x:\n", ctx->arch, flags);
+    for (i = 0; i < 9; i++) {
+        if (flags & (1 << i)) {
+            printf("%s%s", sep, FILE_FLAGS[i]);
+            sep = ", ";
+        }
+    }
+    printf("\nstart address 0x%08x\n\n", header->e_entry);
+}
+
+/*
+ * Dump ELF header, readelf style.
+ */
+static void dump_elf_header(struct dump_ctx *ctx)
+{
+    Elf32_Ehdr *header = ctx->ef->header;
+    int type = elf_header_object_file_type(header);
+    int i;
+
+    printf("ELF Header:\n  Magic:  ");
+    for (i = 0; i < EI_NIDENT; i++)
+        printf(" %02x", header->e_ident[i]);
+    printf("\n");
+    printf("  %-34s %s\n", "Class:", elf_header_file_class(header) ==
+           ELFCLASS32 ? "ELF32" : "ELF64");
+    printf("  %-34s %s\n", "Data:", elf_header_data_encoding(header) ==
+           ELFDATA2MSB ? "2's complement, big endian" :
+           "2's complement, little endian");
+    printf("  %-34s %d\n", "Version:", elf_header_file_version(header));
+    printf("  %-34s %d\n", "OS/ABI:", elf_header_os_ABI(header));
+    printf("  %-34s %d\n", "ABI Version:", elf_header_ABI_version(header));
+    printf("  %-34s %s\n", "Type:", type < ET_NUM ? FILE_TYPES[type] :
+           "<unknown>");
+    printf("  %-34s %s\n", "Machine:", ctx->arch);
+    printf("  %-34s 0x%x\n", "Version:", header->e_version);
+    printf("  %-34s 0x%x\n", "Entry point address:", header->e_entry);
+    printf("  %-34s %u (bytes into file)\n", "Start of program headers:",
+           header->e_phoff);
+    printf("  %-34s %u (bytes into file)\n", "Start of section headers:",
+           header->e_shoff);
+    printf("  %-34s 0x%x\n", "Flags:", header->e_flags);
+    printf("  %-34s %u (bytes)\n", "Size of this header:", header->e_ehsize);
+    printf("  %-34s %u (bytes)\n", "Size of program headers:",
+           header->e_phentsize);
+    printf("  %-34s %u\n", "Number of program headers:", header->e_phnum);
+    printf("  %-34s %u (bytes)\n", "Size of section headers:",
+           header->e_shentsize);
+    printf("  %-34s %u\n", "Number of section headers:",
+           elf_header_section_numbers(header));
+    printf("  %-34s %u\n\n", "Section header string table index:",
+           header->e_shstrndx);
+}
+
+/*
+ * Dump program headers
+ */
+static void dump_program_headers(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    char buf[32];
+    int i;
+
+    if (!ef->program_numbers)
+        return;
+
+    printf("Program Header:\n");
+    for (i = 0; i < ef->program_numbers; i++) {
+        Elf32_Phdr *ph = elf_file_program_header(ef, i);
+
+        printf("%8s off    0x%08x vaddr 0x%08x paddr 0x%08x align 2**%d\n",
+               segment_type_name(ph->p_type, buf, sizeof(buf)),
+               ph->p_offset, ph->p_vaddr, ph->p_paddr,
+               align_power(ph->p_align));
+        printf("         filesz 0x%08x memsz 0x%08x flags %c%c%c\n",
+               ph->p_filesz, ph->p_memsz,
+               ph->p_flags & PF_R ? 'r' : '-',
+               ph->p_flags & PF_W ? 'w' : '-',
+               ph->p_flags & PF_X ? 'x' : '-');
+    }
+    printf("\n");
+}
+
+/*
+ * Dump section headers, readelf style with decoded sh_type and sh_flags.
+ */
+static void dump_section_table(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    char buf[32];
+    int i;
+
+    printf("Section Headers:\n");
+    printf("  [Nr] Name              Type            Addr     Off    "
+           "Size   ES Flg Lk Inf Al\n");
+    for (i = 0; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        char flags[33];
+
+        section_flag_letters(st->sh_flags, flags);
+        printf("  [%2d] %-17.17s %-15.15s %08x %06x %06x %02x %3s %2u %3u %2u\n",
+               i, elf_file_section_name(ef, st),
+               section_type_name(st->sh_type, buf, sizeof(buf)),
+               st->sh_addr, st->sh_offset, st->sh_size, st->sh_entsize,
+               flags, st->sh_link, st->sh_info, st->sh_addralign);
+    }
+    printf("Key to Flags:\n");
+    printf("  W (write), A (alloc), X (execute), M (merge), S (strings), "
+           "I (info),\n");
+    printf("  L (link order), O (extra OS processing required), G (group), "
+           "T (TLS),\n");
+    printf("  C (compressed), x (unknown), o (OS specific), E (exclude),\n");
+    printf("  p (processor specific)\n\n");
+}
+
+/*
+ * Dump dynamic section
+ */
+static void dump_dynamic(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    const Elf32_Dyn *dyn;
+    Elf32_Shdr *dynstr;
+    const char *strtab = NULL;
+    int i, n;
+
+    if (!ctx->dynamic)
+        return;
+    dyn = elf_file_section_contents(ef, ctx->dynamic);
+    if (!dyn)
+        return;
+    dynstr = elf_file_section(ef, ctx->dynamic->sh_link);
+    if (dynstr)
+        strtab = elf_file_section_contents(ef, dynstr);
+
+    printf("Dynamic Section:\n");
+    n = ctx->dynamic->sh_size / sizeof(Elf32_Dyn);
+    for (i = 0; i < n && dyn[i].d_tag != DT_NULL; i++) {
+        Elf32_Sword tag = dyn[i].d_tag;
+        char buf[32];
+        const char *name = buf;
+
+        if (tag >= 0 && tag < DT_NUM && DYNAMIC_TAGS[tag])
+            name = DYNAMIC_TAGS[tag];
+        else if (tag == DT_GNU_HASH)
+            name = "GNU_HASH";
+        else if (tag == DT_VERSYM)
+            name = "VERSYM";
+        else if (tag == DT_FLAGS_1)
+            name = "FLAGS_1";
+        else if (tag == DT_VERNEED)
+            name = "VERNEED";
+        else if (tag == DT_VERNEEDNUM)
+            name = "VERNEEDNUM";
+        else if (tag == DT_VERDEF)
+            name = "VERDEF";
+        else if (tag == DT_VERDEFNUM)
+            name = "VERDEFNUM";
+        else if (tag == DT_RELCOUNT)
+            name = "RELCOUNT";
+        else if (tag == DT_RELACOUNT)
+            name = "RELACOUNT";
+        else
+            snprintf(buf, sizeof(buf), "0x%08x", (unsigned int)tag);
+
+        printf("  %-20s ", name);
+        if ((tag == DT_NEEDED || tag == DT_SONAME || tag == DT_RPATH ||
+             tag == DT_RUNPATH) && strtab && dyn[i].d_un.d_val < dynstr->sh_size)
+            printf("%s\n", strtab + dyn[i].d_un.d_val);
+        else
+            printf("0x%08x\n", dyn[i].d_un.d_val);
+    }
+    printf("\n");
+}
+
+/*
+ * Dump notes of every SHT_NOTE section.
+ */
+static void dump_notes(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    int i;
 
-    printf("%s::     file format ", filename);
-    printf("%s-%s\n", elf_header_file_class(header) ? "elf32" : "unknown",
-           elf_header_arch_machine(header) ? "i386" : "unknown");
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        const unsigned char *p, *end, *desc;
+        const Elf32_Nhdr *note;
+        const char *name;
+
+        if (st->sh_type != SHT_NOTE)
+            continue;
+        p = elf_file_section_contents(ef, st);
+        if (!p)
+            continue;
+        end = p + st->sh_size;
+
+        printf("Displaying notes found in: %s\n",
+               elf_file_section_name(ef, st));
+        printf("  Owner                Data size\tDescription\n");
+        while ((note = note_next(&p, end, &name, &desc))) {
+            Elf32_Word j;
+
+            printf("  %-20.*s 0x%08x\t", (int)note->n_namesz, name,
+                   note->n_descsz);
+            if (note->n_namesz == 4 && !strcmp(name, ELF_NOTE_GNU) &&
+                note->n_type == NT_GNU_BUILD_ID) {
+                printf("NT_GNU_BUILD_ID (unique build ID bitstring)\n");
+                printf("    Build ID: ");
+                for (j = 0; j < note->n_descsz; j++)
+                    printf("%02x", desc[j]);
+            } else if (note->n_namesz == 4 && !strcmp(name, ELF_NOTE_GNU) &&
+                       note->n_type == NT_GNU_ABI_TAG &&
+                       note->n_descsz >= 16) {
+                const Elf32_Word *w = (const Elf32_Word *)desc;
+
+                printf("NT_GNU_ABI_TAG (ABI version tag)\n");
+                printf("    OS: %s, ABI: %u.%u.%u", w[0] == 0 ? "Linux" :
+                       "<unknown>", w[1], w[2], w[3]);
+            } else if (note->n_namesz == 4 && !strcmp(name, ELF_NOTE_GNU) &&
+                       note->n_type == NT_GNU_PROPERTY_TYPE_0) {
+                printf("NT_GNU_PROPERTY_TYPE_0");
+            } else {
+                printf("Unknown note type: (0x%08x)", note->n_type);
+            }
+            printf("\n");
+        }
+        printf("\n");
+    }
+}
+
+/*
+ * Hash manifest of allocated sections, one line per section. Sections
+ * without contents in the file, like .bss, have no hashes.
+ */
+static void dump_hashes(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    int i, j;
+
+    printf("Section hashes:\n");
+    printf("Idx Name          Size      XXH3");
+    if (__hash_sha256)
+        printf("              SHA-256");
+    printf("\n");
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        struct dump_hash *hash = &ctx->hashes[i];
+
+        if (!(ctx->sec_flags[i] & SEC_ALLOC))
+            continue;
+        printf("%3d %-13s %08x  ", i, elf_file_section_name(ef, st),
+               st->sh_size);
+        if (!hash->done) {
+            printf(__hash_sha256 ? "%-16s  -\n" : "%s\n", "-");
+            continue;
+        }
+        printf("%016llx", (unsigned long long)hash->xxh3);
+        if (__hash_sha256) {
+            printf("  ");
+            for (j = 0; j < HASH_SHA256_SIZE; j++)
+                printf("%02x", hash->sha256[j]);
+        }
+        printf("\n");
+    }
+}
 
-    printf("\nSections:\n");
+/*
+ * Dump elf headers
+ */
+static void dump_headers(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    int i, bit;
 
+    printf("Sections:\n");
     printf("Idx Name          Size      VMA       LMA       File off  Algn\n");
-    printf("  0 NULL          00000000  00000000  00000000  00000000  0--0\n");
-    for (i = 1; i < elf_header_section_numbers(header); i++) {
+    for (i = 1; i < ef->section_numbers; i++) {
         /* get specify section header */
-        Elf32_Shdr *st = elf_section_header_get_by_index(section_table, i);
-        char *name = elf_section_name_alloc(filename, st);        
-        
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        const char *sep = "";
+
         /* index */
         printf("%3d ", i);
         /* section name */
-        printf("%-14s", name);
+        printf("%-13s ", elf_file_section_name(ef, st));
         /* section size */
         printf("%08x  ", st->sh_size);
         /* vma address */
@@ -72,51 +938,1438 @@ static void dump_headers(const char *filename)
         /* File offset */
         printf("%08x  ", st->sh_offset);
         /* Alignment */
-        printf("%d--%d", st->sh_addralign, st->sh_addralign * 2);
+        printf("2**%d", align_power(st->sh_addralign));
         printf("\n                  ");
-        printf("CONTENTS, ALLOC, LOAD, RELOC, READONLY, CODE\n");
-        /* free */
-        elf_section_name_free(name);
+        /* flags */
+        for (bit = 0; bit < sizeof(SECTION_FLAGS) / sizeof(SECTION_FLAGS[0]);
+             bit++) {
+            if (ctx->sec_flags[i] & (1 << bit)) {
+                printf("%s%s", sep, SECTION_FLAGS[bit]);
+                sep = ", ";
+            }
+        }
+        printf("\n");
     }
-    elf_section_table_free(section_table);
-    elf_header_free(header);
 }
 
-/* Dump symbol table */
-static void dump_symtab(void)
+/*
+ * Dump symbol table
+ */
+static void dump_symtab(struct dump_ctx *ctx, Elf32_Shdr *symtab, int dynamic)
 {
-    printf("Hello World.\n");
+    struct elf_file *ef = ctx->ef;
+    int i, n;
+
+    if (!symtab) {
+        printf("%s:\n\nno symbols\n\n", dynamic ?
+               "DYNAMIC SYMBOL TABLE" : "SYMBOL TABLE");
+        return;
+    }
+
+    printf("%s:\n", dynamic ? "DYNAMIC SYMBOL TABLE" : "SYMBOL TABLE");
+    n = elf_file_symbol_numbers(ef, symtab);
+    for (i = 1; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+        int bind = ELF32_ST_BIND(sym->st_info);
+        int type = ELF32_ST_TYPE(sym->st_info);
+        int defined = sym->st_shndx != SHN_UNDEF &&
+                      sym->st_shndx != SHN_COMMON;
+
+        printf("%08x %c%c%c%c%c%c%c %s\t%08x %s%s\n",
+               sym->st_value,
+               !defined ? ' ' : bind == STB_LOCAL ? 'l' :
+               bind == STB_GLOBAL ? 'g' : bind == STB_GNU_UNIQUE ? 'u' : ' ',
+               bind == STB_WEAK ? 'w' : ' ',
+               ' ', ' ',
+               type == STT_GNU_IFUNC ? 'i' : ' ',
+               type == STT_SECTION || type == STT_FILE ? 'd' :
+               dynamic ? 'D' : ' ',
+               type == STT_FUNC || type == STT_GNU_IFUNC ? 'F' :
+               type == STT_FILE ? 'f' : type == STT_OBJECT ? 'O' : ' ',
+               symbol_section_name(ef, sym), sym->st_size, SYMBOL_VISIBILITY[
+               ELF32_ST_VISIBILITY(sym->st_other)],
+               symbol_name(ef, symtab, sym));
+    }
+    printf("\n\n");
 }
 
-int main(int argc, char *argv[])
+/*
+ * Dump relocation records of one SHT_REL/SHT_RELA section.
+ */
+static void dump_reloc_section(struct dump_ctx *ctx, Elf32_Shdr *rs,
+                               const char *title)
 {
-    const struct option long_opts[] = {
-        {"headers", no_argument, NULL, 'h'},
-        {"syms", no_argument, NULL, 't'},
-        {0, 0, 0, 0}
-    };
-    const char *short_opts = "ht";
-    int c;
+    struct elf_file *ef = ctx->ef;
+    Elf32_Shdr *symtab = elf_file_section(ef, rs->sh_link);
+    const unsigned char *contents = elf_file_section_contents(ef, rs);
+    size_t entsize = rs->sh_type == SHT_RELA ? sizeof(Elf32_Rela) :
+                     sizeof(Elf32_Rel);
+    int i, n, symbols = 0;
 
-    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
-        switch (c) {
-        case 'h':
-            __dump_headers = 1;
-            break;
-        case 't':
-            __dump_symtab = 1;
-            break;
-        default:
-            abort();
+    if (!contents)
+        return;
+    if (symtab)
+        symbols = elf_file_symbol_numbers(ef, symtab);
+
+    printf("%s\n", title);
+    printf("OFFSET   TYPE              VALUE\n");
+    n = rs->sh_size / entsize;
+    for (i = 0; i < n; i++) {
+        const Elf32_Rela *rel = (const Elf32_Rela *)(contents + i * entsize);
+        int sym = ELF32_R_SYM(rel->r_info);
+        char buf[32];
+
+        printf("%08x %-17s ", rel->r_offset,
+               reloc_type_name(ef->header->e_machine,
+                               ELF32_R_TYPE(rel->r_info), buf, sizeof(buf)));
+        if (sym && sym < symbols)
+            printf("%s", symbol_name(ef, symtab,
+                                     elf_file_symbol(ef, symtab, sym)));
+        else
+            printf("*ABS*");
+        if (rs->sh_type == SHT_RELA && rel->r_addend)
+            printf("%c0x%08x", rel->r_addend < 0 ? '-' : '+',
+                   rel->r_addend < 0 ? -rel->r_addend : rel->r_addend);
+        printf("\n");
+    }
+    printf("\n\n");
+}
+
+/*
+ * Dump relocations, static ones are listed per target section and
+ * dynamic ones are those which refer to dynamic symbol table.
+ */
+static void dump_reloc(struct dump_ctx *ctx, int dynamic)
+{
+    struct elf_file *ef = ctx->ef;
+    int i, found = 0;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *rs = elf_file_section(ef, i);
+        Elf32_Shdr *link, *target;
+        char title[256];
+
+        if (rs->sh_type != SHT_REL && rs->sh_type != SHT_RELA)
+            continue;
+        link = elf_file_section(ef, rs->sh_link);
+        if (dynamic != (link && link == ctx->dynsym))
+            continue;
+
+        if (dynamic) {
+            snprintf(title, sizeof(title), "DYNAMIC RELOCATION RECORDS");
+        } else {
+            target = elf_file_section(ef, rs->sh_info);
+            if (!target)
+                continue;
+            snprintf(title, sizeof(title), "RELOCATION RECORDS FOR [%s]:",
+                     elf_file_section_name(ef, target));
         }
+        dump_reloc_section(ctx, rs, title);
+        found = 1;
     }
+    if (dynamic && !found)
+        printf("DYNAMIC RELOCATION RECORDS (none)\n\n");
+}
 
-    if (__dump_headers) {
-        dump_headers(argv[argc - 1]);
+/*
+ * print "dir/name" of a line table file entry
+ */
+static void print_line_file(struct dwarf_line_file *file)
+{
+    if (!file) {
+        printf("<unknown>");
+        return;
     }
-    if (__dump_symtab) {
-        dump_symtab();
+    if (file->dir && file->name[0] != '/')
+        printf("%s/%s", file->dir, file->name);
+    else
+        printf("%s", file->name);
+}
+
+/*
+ * Dump decoded .debug_line, one row per line state machine row in
+ * the format of --dwarf=decodedline. View counts rows which share an
+ * address with the rows before them.
+ */
+static void dump_debug_line(struct dump_ctx *ctx)
+{
+    struct dwarf_line *dl = ctx->line;
+    int i, j;
+
+    if (!dl)
+        return;
+
+    printf("Contents of the .debug_line section:\n\n");
+    for (i = 0; i < dl->cu_numbers; i++) {
+        struct dwarf_line_cu *cu = &dl->cus[i];
+        uint32_t file = 1;
+        unsigned view = 0;
+
+        if (!cu->row_numbers)
+            continue;
+        /* DWARF 5 names the primary source file 0 */
+        printf("CU: ");
+        print_line_file(dwarf_line_file(cu, cu->version >= 5 ? 0 : 1));
+        printf(":\n");
+        printf("File name                            Line number    "
+               "Starting address    View    Stmt\n");
+
+        for (j = 0; j < cu->row_numbers; j++) {
+            struct dwarf_line_row *row = &cu->rows[j];
+            struct dwarf_line_file *entry;
+            const char *base;
+
+            if (row->file != file) {
+                file = row->file;
+                printf("\n");
+                print_line_file(dwarf_line_file(cu, file));
+                printf(":\n");
+            }
+            if (j && row->address == cu->rows[j - 1].address &&
+                !(cu->rows[j - 1].flags & DWARF_LINE_END_SEQUENCE))
+                view++;
+            else
+                view = 0;
+
+            entry = dwarf_line_file(cu, row->file);
+            base = entry ? strrchr(entry->name, '/') : NULL;
+            base = base ? base + 1 : entry ? entry->name : "<unknown>";
+            if (row->flags & DWARF_LINE_END_SEQUENCE) {
+                printf("%-35s  %11s  %#18llx\n", base, "-",
+                       (unsigned long long)row->address);
+                if (j + 1 < cu->row_numbers)
+                    printf("\n");
+                continue;
+            }
+            printf("%-35s  %11u  %#18llx", base, row->line,
+                   (unsigned long long)row->address);
+            if (view)
+                printf("  %6u", view);
+            else
+                printf("        ");
+            if (row->flags & DWARF_LINE_STMT)
+                printf("       x");
+            printf("\n");
+        }
+        printf("\n\n");
     }
-    
-    return 0;
+}
+
+/*
+ * start JSON record of given type, every record names the file
+ * it comes from.
+ */
+static void json_record(struct dump_ctx *ctx, const char *type)
+{
+    json_begin(__json);
+    json_str(__json, "type", type);
+    json_str(__json, "file", ctx->filename);
+    if (ctx->archive)
+        json_str(__json, "archive", ctx->archive);
+}
+
+static void json_file(struct dump_ctx *ctx, struct archive_member *member)
+{
+    Elf32_Ehdr *header = ctx->ef->header;
+
+    json_record(ctx, "file");
+    json_str(__json, "format", ctx->format);
+    json_str(__json, "arch", ctx->arch);
+    json_u64(__json, "e_type", header->e_type);
+    json_u64(__json, "e_machine", header->e_machine);
+    json_u64(__json, "e_flags", header->e_flags);
+    json_u64(__json, "entry", header->e_entry);
+    json_u64(__json, "sections", ctx->ef->section_numbers);
+    json_u64(__json, "segments", ctx->ef->program_numbers);
+    if (member) {
+        json_u64(__json, "size", member->size);
+        json_u64(__json, "date", member->date);
+        json_u64(__json, "uid", member->uid);
+        json_u64(__json, "gid", member->gid);
+        json_u64(__json, "mode", member->mode);
+    }
+    json_end(__json);
+}
+
+static void json_sections(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    char buf[33];
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        json_record(ctx, "section");
+        json_u64(__json, "index", i);
+        json_str(__json, "name", elf_file_section_name(ef, st));
+        json_str(__json, "sh_type",
+                 section_type_name(st->sh_type, buf, sizeof(buf)));
+        json_str(__json, "flags", section_flag_letters(st->sh_flags, buf));
+        json_u64(__json, "addr", st->sh_addr);
+        json_u64(__json, "offset", st->sh_offset);
+        json_u64(__json, "size", st->sh_size);
+        json_u64(__json, "align", st->sh_addralign);
+        json_u64(__json, "link", st->sh_link);
+        json_u64(__json, "info", st->sh_info);
+        json_u64(__json, "entsize", st->sh_entsize);
+        json_end(__json);
+    }
+}
+
+static void json_hashes(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    char buf[17];
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        struct dump_hash *hash = &ctx->hashes[i];
+
+        if (!(ctx->sec_flags[i] & SEC_ALLOC))
+            continue;
+        json_record(ctx, "section_hash");
+        json_u64(__json, "index", i);
+        json_str(__json, "name", elf_file_section_name(ef, st));
+        json_u64(__json, "size", st->sh_size);
+        /* as a string, readers parsing numbers as doubles lose bits */
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)hash->xxh3);
+        json_str(__json, "xxh3", hash->done ? buf : NULL);
+        if (__hash_sha256 && hash->done)
+            json_hex(__json, "sha256", hash->sha256, HASH_SHA256_SIZE);
+        else if (__hash_sha256)
+            json_str(__json, "sha256", NULL);
+        json_end(__json);
+    }
+}
+
+static void json_symbols(struct dump_ctx *ctx, Elf32_Shdr *symtab)
+{
+    struct elf_file *ef = ctx->ef;
+    const char *table = elf_file_section_name(ef, symtab);
+    int i, n;
+
+    n = elf_file_symbol_numbers(ef, symtab);
+    for (i = 1; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+        int bind = ELF32_ST_BIND(sym->st_info);
+        int type = ELF32_ST_TYPE(sym->st_info);
+
+        json_record(ctx, "symbol");
+        json_str(__json, "table", table);
+        json_u64(__json, "index", i);
+        json_str(__json, "name", symbol_name(ef, symtab, sym));
+        json_u64(__json, "value", sym->st_value);
+        json_u64(__json, "size", sym->st_size);
+        json_str(__json, "bind", bind <= STB_GNU_UNIQUE ?
+                 SYMBOL_BINDS[bind] : NULL);
+        json_str(__json, "sym_type", type <= STT_GNU_IFUNC ?
+                 SYMBOL_TYPES[type] : NULL);
+        json_str(__json, "visibility", SYMBOL_VISIBILITY_NAMES[
+                 ELF32_ST_VISIBILITY(sym->st_other)]);
+        json_str(__json, "section", symbol_section_name(ef, sym));
+        json_u64(__json, "shndx", sym->st_shndx);
+        json_end(__json);
+    }
+}
+
+/*
+ * relocations of every SHT_REL/SHT_RELA section, dynamic ones are
+ * those which refer to dynamic symbol table.
+ */
+static void json_relocs(struct dump_ctx *ctx, int statics, int dynamics)
+{
+    struct elf_file *ef = ctx->ef;
+    char buf[32];
+    int i, j;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *rs = elf_file_section(ef, i);
+        Elf32_Shdr *symtab, *target;
+        const unsigned char *contents;
+        const char *section, *target_name = NULL;
+        size_t entsize;
+        int n, dynamic, symbols = 0;
+
+        if (rs->sh_type != SHT_REL && rs->sh_type != SHT_RELA)
+            continue;
+        symtab = elf_file_section(ef, rs->sh_link);
+        dynamic = symtab && symtab == ctx->dynsym;
+        if (!(dynamic ? dynamics : statics))
+            continue;
+        contents = elf_file_section_contents(ef, rs);
+        if (!contents)
+            continue;
+        if (symtab)
+            symbols = elf_file_symbol_numbers(ef, symtab);
+        if (!dynamic && (target = elf_file_section(ef, rs->sh_info)))
+            target_name = elf_file_section_name(ef, target);
+        section = elf_file_section_name(ef, rs);
+
+        entsize = rs->sh_type == SHT_RELA ? sizeof(Elf32_Rela) :
+                  sizeof(Elf32_Rel);
+        n = rs->sh_size / entsize;
+        for (j = 0; j < n; j++) {
+            const Elf32_Rela *rel = (const Elf32_Rela *)(contents +
+                                                         j * entsize);
+            int sym = ELF32_R_SYM(rel->r_info);
+
+            json_record(ctx, "reloc");
+            json_str(__json, "section", section);
+            json_str(__json, "target", target_name);
+            json_bool(__json, "dynamic", dynamic);
+            json_u64(__json, "offset", rel->r_offset);
+            json_str(__json, "reloc_type",
+                     reloc_type_name(ef->header->e_machine,
+                                     ELF32_R_TYPE(rel->r_info), buf,
+                                     sizeof(buf)));
+            json_str(__json, "symbol", sym && sym < symbols ?
+                     symbol_name(ef, symtab,
+                                 elf_file_symbol(ef, symtab, sym)) : NULL);
+            json_i64(__json, "addend",
+                     rs->sh_type == SHT_RELA ? rel->r_addend : 0);
+            json_end(__json);
+        }
+    }
+}
+
+static void json_notes(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        const unsigned char *p, *end, *desc;
+        const Elf32_Nhdr *note;
+        const char *name, *section;
+
+        if (st->sh_type != SHT_NOTE)
+            continue;
+        p = elf_file_section_contents(ef, st);
+        if (!p)
+            continue;
+        end = p + st->sh_size;
+        section = elf_file_section_name(ef, st);
+
+        while ((note = note_next(&p, end, &name, &desc))) {
+            json_record(ctx, "note");
+            json_str(__json, "section", section);
+            /* owner is stored with its terminator */
+            json_strn(__json, "owner", name,
+                      note->n_namesz ? strnlen(name, note->n_namesz) : 0);
+            json_u64(__json, "note_type", note->n_type);
+            json_hex(__json, "desc", desc, note->n_descsz);
+            json_end(__json);
+        }
+    }
+}
+
+/*
+ * Dump one loaded file as JSON records, one per line. With no dump
+ * switch every kind of record is written.
+ * @member: archive member header, NULL for plain files.
+ */
+static void dump_ctx_json(struct dump_ctx *ctx, struct archive_member *member)
+{
+    struct stats_clock c;
+
+    json_file(ctx, member);
+    if (__dump_headers || __dump_private)
+        json_sections(ctx);
+    if (__dump_hashes)
+        json_hashes(ctx);
+    stats_begin(&c);
+    if (__dump_symtab && ctx->symtab)
+        json_symbols(ctx, ctx->symtab);
+    if (__dump_dynamic_symtab && ctx->dynsym)
+        json_symbols(ctx, ctx->dynsym);
+    stats_end(&c, STATS_SYMBOLS);
+    if (__dump_reloc || __dump_dynamic_reloc)
+        json_relocs(ctx, __dump_reloc, __dump_dynamic_reloc);
+    if (__dump_private)
+        json_notes(ctx);
+}
+
+/* ---------------------------------------
+ * columnar export, one row per section and per symbol of every file
+ */
+enum {
+    COL_SEC_FILE, COL_SEC_ARCHIVE, COL_SEC_INDEX, COL_SEC_NAME,
+    COL_SEC_TYPE, COL_SEC_FLAGS, COL_SEC_ADDR, COL_SEC_OFFSET,
+    COL_SEC_SIZE, COL_SEC_ALIGN, COL_SEC_LINK, COL_SEC_INFO,
+    COL_SEC_ENTSIZE,
+};
+
+static const char *EXPORT_SECTION_COLUMNS[] = {
+    "file", "archive", "index", "name", "type", "flags", "addr", "offset",
+    "size", "align", "link", "info", "entsize", NULL,
+};
+
+static const uint32_t EXPORT_SECTION_TYPES[] = {
+    COLUMNAR_STR, COLUMNAR_STR, COLUMNAR_U32, COLUMNAR_STR,
+    COLUMNAR_U32, COLUMNAR_U64, COLUMNAR_U64, COLUMNAR_U64,
+    COLUMNAR_U64, COLUMNAR_U64, COLUMNAR_U32, COLUMNAR_U32,
+    COLUMNAR_U64,
+};
+
+enum {
+    COL_SYM_FILE, COL_SYM_ARCHIVE, COL_SYM_TABLE, COL_SYM_INDEX,
+    COL_SYM_NAME, COL_SYM_VALUE, COL_SYM_SIZE, COL_SYM_BIND,
+    COL_SYM_TYPE, COL_SYM_VISIBILITY, COL_SYM_SHNDX,
+};
+
+static const char *EXPORT_SYMBOL_COLUMNS[] = {
+    "file", "archive", "table", "index", "name", "value", "size", "bind",
+    "type", "visibility", "shndx", NULL,
+};
+
+static const uint32_t EXPORT_SYMBOL_TYPES[] = {
+    COLUMNAR_STR, COLUMNAR_STR, COLUMNAR_STR, COLUMNAR_U32,
+    COLUMNAR_STR, COLUMNAR_U64, COLUMNAR_U64, COLUMNAR_U8,
+    COLUMNAR_U8, COLUMNAR_U8, COLUMNAR_U16,
+};
+
+static struct columnar *export;
+static struct columnar_table *export_sections;
+static struct columnar_table *export_symbols;
+
+static void export_symtab(struct dump_ctx *ctx, Elf32_Shdr *symtab)
+{
+    struct elf_file *ef = ctx->ef;
+    struct columnar_table *t = export_symbols;
+    const char *table = elf_file_section_name(ef, symtab);
+    int i, n;
+
+    n = elf_file_symbol_numbers(ef, symtab);
+    for (i = 1; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+
+        columnar_put_str(export, t, COL_SYM_FILE, ctx->filename);
+        columnar_put_str(export, t, COL_SYM_ARCHIVE, ctx->archive);
+        columnar_put_str(export, t, COL_SYM_TABLE, table);
+        columnar_put(t, COL_SYM_INDEX, i);
+        columnar_put_str(export, t, COL_SYM_NAME,
+                         symbol_name(ef, symtab, sym));
+        columnar_put(t, COL_SYM_VALUE, sym->st_value);
+        columnar_put(t, COL_SYM_SIZE, sym->st_size);
+        columnar_put(t, COL_SYM_BIND, ELF32_ST_BIND(sym->st_info));
+        columnar_put(t, COL_SYM_TYPE, ELF32_ST_TYPE(sym->st_info));
+        columnar_put(t, COL_SYM_VISIBILITY,
+                     ELF32_ST_VISIBILITY(sym->st_other));
+        columnar_put(t, COL_SYM_SHNDX, sym->st_shndx);
+    }
+}
+
+/*
+ * add section and symbol tables of one loaded file to export
+ */
+static void export_ctx(struct dump_ctx *ctx)
+{
+    struct elf_file *ef = ctx->ef;
+    struct columnar_table *t = export_sections;
+    struct stats_clock c;
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        columnar_put_str(export, t, COL_SEC_FILE, ctx->filename);
+        columnar_put_str(export, t, COL_SEC_ARCHIVE, ctx->archive);
+        columnar_put(t, COL_SEC_INDEX, i);
+        columnar_put_str(export, t, COL_SEC_NAME,
+                         elf_file_section_name(ef, st));
+        columnar_put(t, COL_SEC_TYPE, st->sh_type);
+        columnar_put(t, COL_SEC_FLAGS, st->sh_flags);
+        columnar_put(t, COL_SEC_ADDR, st->sh_addr);
+        columnar_put(t, COL_SEC_OFFSET, st->sh_offset);
+        columnar_put(t, COL_SEC_SIZE, st->sh_size);
+        columnar_put(t, COL_SEC_ALIGN, st->sh_addralign);
+        columnar_put(t, COL_SEC_LINK, st->sh_link);
+        columnar_put(t, COL_SEC_INFO, st->sh_info);
+        columnar_put(t, COL_SEC_ENTSIZE, st->sh_entsize);
+    }
+    stats_begin(&c);
+    if (ctx->symtab)
+        export_symtab(ctx, ctx->symtab);
+    if (ctx->dynsym)
+        export_symtab(ctx, ctx->dynsym);
+    stats_end(&c, STATS_SYMBOLS);
+}
+
+/*
+ * archive member header line, like ls -l
+ */
+static void dump_archive_header(struct archive_member *m)
+{
+    static const char rwx[] = "rwxrwxrwx";
+    char mode[10], date[32];
+    time_t when = m->date;
+    const char *t = ctime(&when);
+    int i;
+
+    for (i = 0; i < 9; i++)
+        mode[i] = m->mode & (0400 >> i) ? rwx[i] : '-';
+    mode[9] = 0;
+    if (m->mode & 04000)
+        mode[2] = mode[2] == 'x' ? 's' : 'S';
+    if (m->mode & 02000)
+        mode[5] = mode[5] == 'x' ? 's' : 'S';
+    if (m->mode & 01000)
+        mode[8] = mode[8] == 'x' ? 't' : 'T';
+    snprintf(date, sizeof(date), "%.12s %.4s", t ? t + 4 : "", t ? t + 20 : "");
+    printf("%s %u/%u %6llu %s %s\n", mode, m->uid, m->gid,
+           (unsigned long long)m->size, date, m->name);
+}
+
+/*
+ * Dump everything which was asked for on one loaded file.
+ * @member: archive member header, NULL for plain files.
+ */
+static void dump_ctx_print(struct dump_ctx *ctx, const char *filename,
+                           struct archive_member *member)
+{
+    struct stats_clock c;
+
+    printf("\n%s:     file format %s\n", filename, ctx->format);
+    if (member && __dump_archive_headers)
+        dump_archive_header(member);
+    printf("\n");
+    if (__dump_file_headers)
+        dump_file_header(ctx);
+    if (__dump_private) {
+        dump_elf_header(ctx);
+        dump_program_headers(ctx);
+        dump_section_table(ctx);
+        dump_dynamic(ctx);
+        dump_notes(ctx);
+    }
+    if (__dump_headers)
+        dump_headers(ctx);
+    if (__dump_hashes)
+        dump_hashes(ctx);
+    stats_begin(&c);
+    if (__dump_symtab)
+        dump_symtab(ctx, ctx->symtab, 0);
+    if (__dump_dynamic_symtab)
+        dump_symtab(ctx, ctx->dynsym, 1);
+    stats_end(&c, STATS_SYMBOLS);
+    if (__dump_reloc)
+        dump_reloc(ctx, 0);
+    if (__dump_dynamic_reloc)
+        dump_reloc(ctx, 1);
+    if (__dump_debug_line)
+        dump_debug_line(ctx);
+}
+
+/*
+ * loaded archive member
+ * @err: errno if member isn't an ELF file.
+ */
+struct dump_member {
+    struct dump_ctx ctx;
+    int             err;
+};
+
+static void dump_load_member(struct archive *ar, int index, void *data)
+{
+    struct dump_member *member = (struct dump_member *)data + index;
+    struct trace_clock t;
+    struct elf_file *ef;
+
+    trace_begin(&t);
+    ef = archive_member_elf(ar, index);
+    if (!ef) {
+        member->err = errno;
+    } else {
+        dump_ctx_init(&member->ctx, ef);
+        /* members are already spread over threads */
+        if (__dump_hashes)
+            dump_hash_sections(&member->ctx, 1);
+    }
+    trace_end(&t, TRACE_FILE, ar->members[index].name, ar->filename);
+}
+
+/*
+ * Dump every member of archive. Members are loaded in parallel and
+ * dumped in archive order.
+ * @fd: descriptor of archive, left open.
+ * @size: size of archive.
+ * @return: 0 on success.
+ */
+static int dump_archive(const char *filename, int fd, uint64_t size)
+{
+    struct dump_member *members;
+    struct stats_clock c;
+    struct archive *ar;
+    int i, ret = 0;
+
+    ar = archive_alloc_fd(filename, fd, size);
+    if (!ar) {
+        fprintf(stderr, "objdump: %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
+    if (!__json && (!export || __dump_any))
+        printf("In archive %s:\n", filename);
+
+    members = xmalloc(sizeof(struct dump_member) *
+                      (ar->member_numbers ? ar->member_numbers : 1));
+    memset(members, 0, sizeof(struct dump_member) * ar->member_numbers);
+    archive_for_each(ar, __jobs, dump_load_member, members);
+
+    for (i = 0; i < ar->member_numbers; i++) {
+        struct dump_ctx *ctx = &members[i].ctx;
+
+        if (members[i].err) {
+            if (__json)
+                json_flush(__json);
+            fflush(stdout);
+            fprintf(stderr, "objdump: %s: %s\n", ar->members[i].name,
+                    members[i].err == EINVAL ? "file format not recognized" :
+                    strerror(members[i].err));
+            ret = 1;
+            continue;
+        }
+        ctx->filename = ar->members[i].name;
+        ctx->archive = filename;
+        stats_begin(&c);
+        if (export)
+            export_ctx(ctx);
+        if (__json)
+            dump_ctx_json(ctx, &ar->members[i]);
+        else if (!export || __dump_any)
+            dump_ctx_print(ctx, ar->members[i].name, &ar->members[i]);
+        stats_end(&c, STATS_FORMAT);
+        elf_file_free(ctx->ef);
+        dump_ctx_exit(ctx);
+    }
+    xfree(members);
+    archive_free(ar);
+    return ret;
+}
+
+/*
+ * Dump everything which was asked for on one file, sharing one handle.
+ * @return: 0 on success.
+ */
+static int dump_file(const char *filename)
+{
+    char magic[ARCHIVE_MAGIC_SIZE];
+    struct elf_file *ef = NULL;
+    struct stats_clock c;
+    struct dump_ctx ctx;
+    struct stat sb;
+    int fd, ret, stated;
+    ssize_t n = 0;
+
+    /* file is opened once, archive magic is read on that descriptor */
+    stats_begin(&c);
+    stats_add(STATS_OPENS, 1);
+    fd = open(filename, O_RDONLY);
+    stated = fd >= 0 && !fstat(fd, &sb);
+    if (stated)
+        n = pread(fd, magic, sizeof(magic), 0);
+    stats_end(&c, STATS_OPEN);
+    if (stated) {
+        if (n == sizeof(magic) && archive_check_mem(magic, sizeof(magic))) {
+            ret = dump_archive(filename, fd, sb.st_size);
+            close(fd);
+            return ret;
+        }
+        ef = elf_file_alloc_fd(filename, fd, sb.st_size, sb.st_dev,
+                               sb.st_ino, (uint64_t)sb.st_mtim.tv_sec *
+                               1000000000 + sb.st_mtim.tv_nsec);
+    }
+    if (fd >= 0) {
+        ret = errno;
+        close(fd);
+        errno = ret;
+    }
+    if (!ef) {
+        if (__json)
+            json_flush(__json);
+        fflush(stdout);
+        fprintf(stderr, "objdump: %s: %s\n", filename, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+        return 1;
+    }
+    dump_ctx_init(&ctx, ef);
+    if (__dump_hashes)
+        dump_hash_sections(&ctx, __jobs);
+    ctx.filename = filename;
+    stats_begin(&c);
+    if (export)
+        export_ctx(&ctx);
+    if (__json)
+        dump_ctx_json(&ctx, NULL);
+    else if (!export || __dump_any)
+        dump_ctx_print(&ctx, filename, NULL);
+    stats_end(&c, STATS_FORMAT);
+    dump_ctx_exit(&ctx);
+    elf_file_free(ef);
+    return 0;
+}
+
+/* kinds of difference between two files */
+#define DIFF_ADDED         0
+#define DIFF_REMOVED       1
+#define DIFF_RESIZED       2
+#define DIFF_CHANGED       3    /* same size, other contents */
+#define DIFF_CHANGES       4
+
+static const char *DIFF_CHANGE_NAMES[DIFF_CHANGES] = {
+    [DIFF_ADDED]   = "added",
+    [DIFF_REMOVED] = "removed",
+    [DIFF_RESIZED] = "resized",
+    [DIFF_CHANGED] = "changed",
+};
+
+/*
+ * names of the old file hashed for joining with the new one. Linear
+ * probing keeps equal names in index order, so the Nth section or
+ * symbol of a name in one file pairs with the Nth in the other, which
+ * is what local symbols of many objects and section groups need.
+ * @table: hash and index + 1 of names, index 0 is an empty slot.
+ * @taken: name was paired already.
+ */
+struct diff_names {
+    struct {
+        uint32_t    hash;
+        int         index;
+    }               *table;
+    int             size;
+    const char      **names;
+    char            *taken;
+};
+
+/*
+ * one side of a diff
+ * @symbols: defined, named symbols of .symtab, of .dynsym if stripped.
+ * @alloc_size: bytes of allocated sections.
+ */
+struct diff_file {
+    struct dump_ctx ctx;
+    Elf32_Shdr      *symtab;
+    int             *symbols;
+    int             symbol_numbers;
+    uint64_t        alloc_size;
+};
+
+/*
+ * what was found different
+ * @sections: counts per kind.
+ * @symbols: counts per kind.
+ */
+struct diff_result {
+    const char      *old_file;
+    const char      *new_file;
+    int             sections[DIFF_CHANGES];
+    int             symbols[DIFF_CHANGES];
+};
+
+static uint32_t diff_hash(const char *name)
+{
+    return hash_xxh3(name, strlen(name));
+}
+
+static void diff_names_init(struct diff_names *d, const char **names, int n)
+{
+    int i;
+
+    d->size = 16;
+    while (d->size < n * 2)
+        d->size *= 2;
+    d->table = xmalloc(sizeof(*d->table) * d->size);
+    memset(d->table, 0, sizeof(*d->table) * d->size);
+    d->names = names;
+    d->taken = xmalloc(n ? n : 1);
+    memset(d->taken, 0, n ? n : 1);
+    for (i = 0; i < n; i++) {
+        uint32_t hash = diff_hash(names[i]);
+        int h = hash & (d->size - 1);
+
+        while (d->table[h].index)
+            h = (h + 1) & (d->size - 1);
+        d->table[h].hash = hash;
+        d->table[h].index = i + 1;
+    }
+}
+
+/*
+ * pair name of new file with the first unpaired equal name of old one.
+ * @return: index of old name, -1 if there is none.
+ */
+static int diff_names_take(struct diff_names *d, const char *name)
+{
+    uint32_t hash = diff_hash(name);
+    int h = hash & (d->size - 1);
+
+    for (; d->table[h].index; h = (h + 1) & (d->size - 1)) {
+        int i = d->table[h].index - 1;
+
+        if (d->table[h].hash == hash && !d->taken[i] &&
+            !strcmp(d->names[i], name)) {
+            d->taken[i] = 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void diff_names_exit(struct diff_names *d)
+{
+    xfree(d->table);
+    xfree(d->taken);
+}
+
+/*
+ * Compare bytes of two sections of one size. memcmp() of libc runs on
+ * vector units and is asked about whole chunks, only chunks which
+ * differ are walked byte by byte.
+ * @first: offset of first differing byte, if any.
+ * @return: number of differing bytes.
+ */
+static size_t diff_bytes(const unsigned char *a, const unsigned char *b,
+                         size_t len, size_t *first)
+{
+    size_t off, n, i, bytes = 0;
+
+    for (off = 0; off < len; off += n) {
+        n = len - off < DIFF_CHUNK ? len - off : DIFF_CHUNK;
+        if (!memcmp(a + off, b + off, n))
+            continue;
+        if (!bytes) {
+            for (i = 0; a[off + i] == b[off + i]; i++)
+                ;
+            *first = off + i;
+        }
+        for (i = 0; i < n; i++)
+            bytes += a[off + i] != b[off + i];
+    }
+    return bytes;
+}
+
+/*
+ * Print one difference, old or new size is -1 where there is no such
+ * section or symbol.
+ * @bytes: differing bytes for DIFF_CHANGED, from @first on.
+ */
+static void diff_print(struct diff_result *r, const char *type, int change,
+                       const char *name, int64_t old_size, int64_t new_size,
+                       size_t bytes, size_t first)
+{
+    int64_t delta = (new_size < 0 ? 0 : new_size) -
+                    (old_size < 0 ? 0 : old_size);
+    char old_buf[16], new_buf[16];
+
+    if (__json) {
+        json_begin(__json);
+        json_str(__json, "type", type);
+        json_str(__json, "old_file", r->old_file);
+        json_str(__json, "new_file", r->new_file);
+        json_str(__json, "change", DIFF_CHANGE_NAMES[change]);
+        json_str(__json, "name", name);
+        if (old_size >= 0)
+            json_u64(__json, "old_size", old_size);
+        if (new_size >= 0)
+            json_u64(__json, "new_size", new_size);
+        json_i64(__json, "delta", delta);
+        if (change == DIFF_CHANGED) {
+            json_u64(__json, "first_diff", first);
+            json_u64(__json, "bytes_differ", bytes);
+        }
+        json_end(__json);
+        return;
+    }
+
+    snprintf(old_buf, sizeof(old_buf), "%08llx", (unsigned long long)old_size);
+    snprintf(new_buf, sizeof(new_buf), "%08llx", (unsigned long long)new_size);
+    printf("%-8s %-8s  %-8s  %+9lld  %s", DIFF_CHANGE_NAMES[change],
+           old_size < 0 ? "-" : old_buf, new_size < 0 ? "-" : new_buf,
+           (long long)delta, name);
+    if (change == DIFF_CHANGED)
+        printf(" (%zu bytes differ from 0x%zx)", bytes, first);
+    printf("\n");
+}
+
+static int diff_file_alloc(struct diff_file *f, const char *filename)
+{
+    struct elf_file *ef;
+    int i, n;
+
+    ef = elf_file_alloc(filename);
+    if (!ef) {
+        fprintf(stderr, "objdump: %s: %s\n", filename, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+        return -1;
+    }
+    dump_ctx_init(&f->ctx, ef);
+    f->ctx.filename = filename;
+    f->alloc_size = 0;
+    for (i = 1; i < ef->section_numbers; i++)
+        if (f->ctx.sec_flags[i] & SEC_ALLOC)
+            f->alloc_size += elf_file_section(ef, i)->sh_size;
+
+    f->symtab = f->ctx.symtab ? f->ctx.symtab : f->ctx.dynsym;
+    f->symbol_numbers = 0;
+    n = f->symtab ? elf_file_symbol_numbers(ef, f->symtab) : 0;
+    f->symbols = xmalloc(sizeof(int) * (n ? n : 1));
+    for (i = 1; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, f->symtab, i);
+        const char *name = elf_file_symbol_name(ef, f->symtab, sym);
+        int type = ELF32_ST_TYPE(sym->st_info);
+
+        if (sym->st_shndx == SHN_UNDEF || type == STT_SECTION ||
+            type == STT_FILE || !name || !name[0])
+            continue;
+        f->symbols[f->symbol_numbers++] = i;
+    }
+    return 0;
+}
+
+static void diff_file_free(struct diff_file *f)
+{
+    struct elf_file *ef = f->ctx.ef;
+
+    xfree(f->symbols);
+    dump_ctx_exit(&f->ctx);
+    elf_file_free(ef);
+}
+
+static void diff_sections(struct diff_result *r, struct diff_file *a,
+                          struct diff_file *b)
+{
+    struct elf_file *ea = a->ctx.ef, *eb = b->ctx.ef;
+    struct diff_names names;
+    const char **old_names;
+    int i, j, n = ea->section_numbers ? ea->section_numbers - 1 : 0;
+
+    old_names = xmalloc(sizeof(char *) * (n ? n : 1));
+    for (i = 0; i < n; i++)
+        old_names[i] = elf_file_section_name(ea, elf_file_section(ea, i + 1));
+    diff_names_init(&names, old_names, n);
+
+    if (!__json) {
+        printf("Sections:\n");
+        printf("Change   Old size  New size      Delta  Name\n");
+    }
+    for (i = 1; i < eb->section_numbers; i++) {
+        Elf32_Shdr *sb = elf_file_section(eb, i), *sa;
+        const char *name = elf_file_section_name(eb, sb);
+        const unsigned char *ca, *cb;
+        size_t first = 0, bytes;
+
+        j = diff_names_take(&names, name);
+        if (j < 0) {
+            diff_print(r, "section_diff", DIFF_ADDED, name, -1, sb->sh_size,
+                       0, 0);
+            r->sections[DIFF_ADDED]++;
+            continue;
+        }
+        sa = elf_file_section(ea, j + 1);
+        if (sa->sh_size != sb->sh_size) {
+            diff_print(r, "section_diff", DIFF_RESIZED, name, sa->sh_size,
+                       sb->sh_size, 0, 0);
+            r->sections[DIFF_RESIZED]++;
+            continue;
+        }
+        ca = elf_file_section_contents(ea, sa);
+        cb = elf_file_section_contents(eb, sb);
+        if (!ca || !cb)
+            continue;
+        bytes = diff_bytes(ca, cb, sb->sh_size, &first);
+        if (bytes) {
+            diff_print(r, "section_diff", DIFF_CHANGED, name, sa->sh_size,
+                       sb->sh_size, bytes, first);
+            r->sections[DIFF_CHANGED]++;
+        }
+    }
+    for (i = 0; i < n; i++) {
+        if (names.taken[i])
+            continue;
+        diff_print(r, "section_diff", DIFF_REMOVED, old_names[i],
+                   elf_file_section(ea, i + 1)->sh_size, -1, 0, 0);
+        r->sections[DIFF_REMOVED]++;
+    }
+    diff_names_exit(&names);
+    xfree(old_names);
+}
+
+static void diff_symbols(struct diff_result *r, struct diff_file *a,
+                         struct diff_file *b)
+{
+    struct elf_file *ea = a->ctx.ef, *eb = b->ctx.ef;
+    struct diff_names names;
+    const char **old_names;
+    int i, j;
+
+    old_names = xmalloc(sizeof(char *) *
+                        (a->symbol_numbers ? a->symbol_numbers : 1));
+    for (i = 0; i < a->symbol_numbers; i++)
+        old_names[i] = elf_file_symbol_name(ea, a->symtab,
+                elf_file_symbol(ea, a->symtab, a->symbols[i]));
+    diff_names_init(&names, old_names, a->symbol_numbers);
+
+    if (!__json) {
+        printf("\nSymbols:\n");
+        printf("Change   Old size  New size      Delta  Name\n");
+    }
+    for (i = 0; i < b->symbol_numbers; i++) {
+        Elf32_Sym *sb = elf_file_symbol(eb, b->symtab, b->symbols[i]), *sa;
+        const char *name = elf_file_symbol_name(eb, b->symtab, sb);
+
+        j = diff_names_take(&names, name);
+        if (j < 0) {
+            diff_print(r, "symbol_diff", DIFF_ADDED,
+                       symbol_name(eb, b->symtab, sb), -1, sb->st_size,
+                       0, 0);
+            r->symbols[DIFF_ADDED]++;
+            continue;
+        }
+        sa = elf_file_symbol(ea, a->symtab, a->symbols[j]);
+        if (sa->st_size != sb->st_size) {
+            diff_print(r, "symbol_diff", DIFF_RESIZED,
+                       symbol_name(eb, b->symtab, sb), sa->st_size,
+                       sb->st_size, 0, 0);
+            r->symbols[DIFF_RESIZED]++;
+        }
+    }
+    for (i = 0; i < a->symbol_numbers; i++) {
+        Elf32_Sym *sa;
+
+        if (names.taken[i])
+            continue;
+        sa = elf_file_symbol(ea, a->symtab, a->symbols[i]);
+        diff_print(r, "symbol_diff", DIFF_REMOVED,
+                   symbol_name(ea, a->symtab, sa), sa->st_size, -1, 0, 0);
+        r->symbols[DIFF_REMOVED]++;
+    }
+    diff_names_exit(&names);
+    xfree(old_names);
+}
+
+/*
+ * Structural diff of two ELF files: added, removed and resized
+ * sections and symbols, and sections of one size whose contents
+ * differ. Sections and symbols are paired by name through a hash
+ * table of the old file.
+ * @return: 0 if nothing differs, 1 if something does, 2 on trouble,
+ *          like cmp.
+ */
+static int diff_files(const char *old_file, const char *new_file)
+{
+    struct diff_file a, b;
+    struct diff_result r;
+    int i, differ = 0;
+
+    if (diff_file_alloc(&a, old_file))
+        return 2;
+    if (diff_file_alloc(&b, new_file)) {
+        diff_file_free(&a);
+        return 2;
+    }
+    memset(&r, 0, sizeof(r));
+    r.old_file = old_file;
+    r.new_file = new_file;
+
+    if (!__json)
+        printf("--- %s\n+++ %s\n\n", old_file, new_file);
+    diff_sections(&r, &a, &b);
+    diff_symbols(&r, &a, &b);
+    for (i = 0; i < DIFF_CHANGES; i++)
+        differ |= r.sections[i] || r.symbols[i];
+
+    if (__json) {
+        json_begin(__json);
+        json_str(__json, "type", "diff_summary");
+        json_str(__json, "old_file", old_file);
+        json_str(__json, "new_file", new_file);
+        for (i = 0; i < DIFF_CHANGES; i++) {
+            char key[32];
+
+            snprintf(key, sizeof(key), "sections_%s", DIFF_CHANGE_NAMES[i]);
+            json_u64(__json, key, r.sections[i]);
+        }
+        /* symbols are only compared by size, none is "changed" */
+        for (i = 0; i < DIFF_CHANGED; i++) {
+            char key[32];
+
+            snprintf(key, sizeof(key), "symbols_%s", DIFF_CHANGE_NAMES[i]);
+            json_u64(__json, key, r.symbols[i]);
+        }
+        json_u64(__json, "old_alloc_size", a.alloc_size);
+        json_u64(__json, "new_alloc_size", b.alloc_size);
+        json_i64(__json, "alloc_delta",
+                 (int64_t)b.alloc_size - (int64_t)a.alloc_size);
+        json_end(__json);
+    } else {
+        printf("\nSections: %d added, %d removed, %d resized, %d changed\n",
+               r.sections[DIFF_ADDED], r.sections[DIFF_REMOVED],
+               r.sections[DIFF_RESIZED], r.sections[DIFF_CHANGED]);
+        printf("Symbols: %d added, %d removed, %d resized\n",
+               r.symbols[DIFF_ADDED], r.symbols[DIFF_REMOVED],
+               r.symbols[DIFF_RESIZED]);
+        printf("Allocated: %llu -> %llu (%+lld)\n",
+               (unsigned long long)a.alloc_size,
+               (unsigned long long)b.alloc_size,
+               (long long)b.alloc_size - (long long)a.alloc_size);
+    }
+    diff_file_free(&b);
+    diff_file_free(&a);
+    return differ;
+}
+
+static void usage(void)
+{
+    printf("Usage: objdump <option(s)> <file(s)>\n");
+    printf(" Display information from object <file(s)>.\n");
+    printf(" At least one of the following switches must be given:\n");
+    printf("  -a, --archive-headers    Display archive header information\n");
+    printf("  -f, --file-headers       Display the contents of the overall file header\n");
+    printf("  -p, --private-headers    Display ELF header, program headers, section\n");
+    printf("                           table, dynamic section and notes\n");
+    printf("  -h, --[section-]headers  Display the contents of the section headers\n");
+    printf("  -x, --all-headers        Display the contents of all headers\n");
+    printf("  -t, --syms               Display the contents of the symbol table(s)\n");
+    printf("  -T, --dynamic-syms       Display the contents of the dynamic symbol table\n");
+    printf("  -r, --reloc              Display the relocation entries in the file\n");
+    printf("  -R, --dynamic-reloc      Display the dynamic relocation entries in the file\n");
+    printf("  -W, --dwarf[=decodedline]\n");
+    printf("                           Display decoded DWARF line number tables\n");
+    printf("  -C, --demangle           Decode mangled/processed symbol names\n");
+    printf("                           (std::string stays short as with GNU objdump,\n");
+    printf("                           not c++filt)\n");
+    printf("      --diff OLD NEW       Display added, removed and resized sections and\n");
+    printf("                           symbols and changed section contents, exit\n");
+    printf("                           status 1 if there are any\n");
+    printf("      --hash[=sha256]      Display XXH3 (and SHA-256) of contents of every\n");
+    printf("                           allocated section\n");
+    printf("      --jobs=N             Load archive members or hash sections on N threads\n");
+    printf("                           (default all CPUs)\n");
+    printf("      --export=FILE        Write section and symbol tables of all files to\n");
+    printf("                           FILE as binary columns with a string heap\n");
+    printf("      --format=json        Write sections, symbols, relocations and notes as\n");
+    printf("                           one JSON object per line, all of them by default\n");
+    printf("      --stats              Print time per phase, file, syscall and allocation\n");
+    printf("                           counters on stderr\n");
+    printf("      --trace=FILE         Write spans per file, phase and thread to FILE\n");
+    printf("                           as Chrome trace events\n");
+    printf("  -H, --help               Display this information\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"archive-headers", no_argument, NULL, 'a'},
+        {"file-headers", no_argument, NULL, 'f'},
+        {"private-headers", no_argument, NULL, 'p'},
+        {"headers", no_argument, NULL, 'h'},
+        {"section-headers", no_argument, NULL, 'h'},
+        {"all-headers", no_argument, NULL, 'x'},
+        {"syms", no_argument, NULL, 't'},
+        {"dynamic-syms", no_argument, NULL, 'T'},
+        {"reloc", no_argument, NULL, 'r'},
+        {"dynamic-reloc", no_argument, NULL, 'R'},
+        {"demangle", no_argument, NULL, 'C'},
+        {"dwarf", optional_argument, NULL, 'W'},
+        {"diff", no_argument, NULL, 'D'},
+        {"hash", optional_argument, NULL, 'K'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"format", required_argument, NULL, 'F'},
+        {"export", required_argument, NULL, 'E'},
+        {"stats", no_argument, NULL, 'S'},
+        {"trace", required_argument, NULL, 'P'},
+        {"help", no_argument, NULL, 'H'},
+        {0, 0, 0, 0}
+    };
+    const char *short_opts = "afphxtTrRCW::H";
+    const char *trace_file = NULL;
+    struct trace_clock t;
+    int c, json = 0, stats = 0, diff = 0, ret = 0;
+
+    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'a':
+            __dump_archive_headers = 1;
+            break;
+        case 'f':
+            __dump_file_headers = 1;
+            break;
+        case 'p':
+            __dump_private = 1;
+            break;
+        case 'h':
+            __dump_headers = 1;
+            break;
+        case 'x':
+            __dump_archive_headers = 1;
+            __dump_file_headers = 1;
+            __dump_private = 1;
+            __dump_headers = 1;
+            __dump_symtab = 1;
+            __dump_reloc = 1;
+            break;
+        case 't':
+            __dump_symtab = 1;
+            break;
+        case 'T':
+            __dump_dynamic_symtab = 1;
+            break;
+        case 'r':
+            __dump_reloc = 1;
+            break;
+        case 'R':
+            __dump_dynamic_reloc = 1;
+            break;
+        case 'C':
+            __demangle = 1;
+            break;
+        case 'W':
+            /* only the decoded line tables are supported */
+            if (optarg && strcmp(optarg, "L") &&
+                strcmp(optarg, "decodedline")) {
+                fprintf(stderr, "objdump: unsupported DWARF dump '%s'\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            __dump_debug_line = 1;
+            break;
+        case 'D':
+            diff = 1;
+            break;
+        case 'K':
+            if (optarg && !strcmp(optarg, "sha256")) {
+                __hash_sha256 = 1;
+            } else if (optarg && strcmp(optarg, "xxh3")) {
+                fprintf(stderr, "objdump: unknown hash '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            __dump_hashes = 1;
+            break;
+        case 'j':
+            __jobs = atoi(optarg);
+            break;
+        case 'F':
+            if (!strcmp(optarg, "json")) {
+                json = 1;
+            } else if (strcmp(optarg, "text")) {
+                fprintf(stderr, "objdump: unknown output format '%s'\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'E':
+            __export_file = optarg;
+            break;
+        case 'S':
+            stats = 1;
+            break;
+        case 'P':
+            trace_file = optarg;
+            break;
+        case 'H':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    __dump_any = __dump_archive_headers || __dump_file_headers ||
+                 __dump_private || __dump_headers || __dump_symtab ||
+                 __dump_dynamic_symtab || __dump_reloc ||
+                 __dump_dynamic_reloc || __dump_debug_line ||
+                 __dump_hashes;
+    if (diff && argc - optind != 2) {
+        fprintf(stderr, "objdump: --diff takes two files\n");
+        return EXIT_FAILURE;
+    }
+    if (stats) {
+#ifdef CONFIG_STATS
+        FILE *out;
+
+        /* writes of stdout are timed as the output phase */
+        stats_enable();
+        out = stats_stream(STDOUT_FILENO);
+        if (out)
+            stdout = out;
+#else
+        fprintf(stderr, "objdump: --stats not configured (CONFIG_STATS)\n");
+        return EXIT_FAILURE;
+#endif
+    }
+    if (trace_file) {
+#ifdef CONFIG_TRACE
+        if (trace_open(trace_file)) {
+            fprintf(stderr, "objdump: %s: %s\n", trace_file, strerror(errno));
+            return EXIT_FAILURE;
+        }
+#else
+        fprintf(stderr, "objdump: --trace not configured (CONFIG_TRACE)\n");
+        return EXIT_FAILURE;
+#endif
+    }
+    if (__export_file) {
+        export = columnar_alloc();
+        export_sections = columnar_table(export, "sections",
+                                         EXPORT_SECTION_COLUMNS,
+                                         EXPORT_SECTION_TYPES);
+        export_symbols = columnar_table(export, "symbols",
+                                        EXPORT_SYMBOL_COLUMNS,
+                                        EXPORT_SYMBOL_TYPES);
+    }
+    if (json) {
+        /* line tables have no records, no switch means everything */
+        __dump_debug_line = 0;
+        if (!__dump_headers && !__dump_private && !__dump_symtab &&
+            !__dump_dynamic_symtab && !__dump_reloc &&
+            !__dump_dynamic_reloc && !__dump_hashes) {
+            __dump_private = 1;
+            __dump_symtab = 1;
+            __dump_dynamic_symtab = 1;
+            __dump_reloc = 1;
+            __dump_dynamic_reloc = 1;
+        }
+        __json = json_writer_alloc(stdout);
+    }
+
+    if (diff)
+        ret = diff_files(argv[optind], argv[optind + 1]);
+    else if (optind == argc)
+        ret = dump_file("a.out");
+    for (; !diff && optind < argc; optind++) {
+        trace_begin(&t);
+        ret |= dump_file(argv[optind]);
+        trace_end(&t, TRACE_FILE, argv[optind], NULL);
+    }
+    json_writer_free(__json);
+    if (export) {
+        struct stats_clock clock;
+
+        stats_begin(&clock);
+        if (columnar_write(export, __export_file)) {
+            fprintf(stderr, "objdump: %s: %s\n", __export_file,
+                    strerror(errno));
+            ret = 1;
+        }
+        stats_end(&clock, STATS_OUTPUT);
+    }
+    columnar_free(export);
+    demangle_cache_free();
+    archive_cache_free();
+#ifdef CONFIG_TRACE
+    if (trace_file && trace_close()) {
+        fprintf(stderr, "objdump: %s: %s\n", trace_file, strerror(errno));
+        ret = 1;
+    }
+#endif
+#ifdef CONFIG_STATS
+    if (stats) {
+        fflush(stdout);
+        stats_report(stderr, "objdump");
+    }
+#endif
+    return ret;
 }
@@ -0,0 +1,913 @@
+/*
+ * size
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <elf.h>
+#include <elf_batch.h>
+#include <archive.h>
+#include <trace.h>
+#include <size_profile.h>
+#include <xmalloc.h>
+
+#define FORMAT_BERKELEY    0
+#define FORMAT_SYSV        1
+
+#define PROFILE_ROWS       20    /* rows of a profile shown by default */
+
+static int __format = FORMAT_BERKELEY;
+static int __radix = 10;
+static int __totals;
+static int __jobs;
+static int __io = ELF_BATCH_AUTO;
+static int __profile = -1;
+static int __profile_rows = PROFILE_ROWS;
+
+static const char *PROFILE_HEADINGS[] = {
+    [SIZE_PROFILE_SECTIONS] = "Section",
+    [SIZE_PROFILE_SYMBOLS]  = "Symbol",
+    [SIZE_PROFILE_UNITS]    = "Compile unit",
+};
+
+/*
+ * size result of one input file
+ * @filename: input file, member name for archive members.
+ * @archive: archive holding member, NULL for plain files.
+ * @member: index of member on @archive.
+ * @text: code and read-only allocated sections.
+ * @data: writable allocated sections with contents.
+ * @bss: allocated sections without contents.
+ * @sysv: formatted SysV report, only used for FORMAT_SYSV.
+ * @err: errno if file couldn't be loaded.
+ * @done: measured already, by the batch scan of plain files.
+ */
+struct size_result {
+    const char         *filename;
+    struct archive     *archive;
+    int                member;
+    unsigned long long text;
+    unsigned long long data;
+    unsigned long long bss;
+    char               *sysv;
+    int                err;
+    int                done;
+};
+
+static struct size_result *results;
+static int result_numbers;
+static int result_max;
+static int next_result;
+static int size_archives;
+
+/*
+ * Berkeley classification of section, decided from section flags
+ * and type only. Section contents are never touched.
+ */
+static void size_classify(struct size_result *res, Elf32_Shdr *st)
+{
+    if (!(st->sh_flags & SHF_ALLOC))
+        return;
+    if (st->sh_type == SHT_NOBITS)
+        res->bss += st->sh_size;
+    else if ((st->sh_flags & SHF_EXECINSTR) || !(st->sh_flags & SHF_WRITE))
+        res->text += st->sh_size;
+    else
+        res->data += st->sh_size;
+}
+
+/*
+ * Print a number in current radix, zero is "0x0" and "00" in hex
+ * and octal like GNU size prints it.
+ * @return: width of number.
+ */
+static int size_number(char *buf, size_t size, unsigned long long val)
+{
+    return snprintf(buf, size, __radix == 16 ? "0x%llx" :
+                    __radix == 8 ? "0%llo" : "%llu", val);
+}
+
+static int size_number_width(unsigned long long val)
+{
+    char buf[32];
+
+    return size_number(buf, sizeof(buf), val);
+}
+
+static void sysv_print_number(FILE *fp, int width, unsigned long long val)
+{
+    char buf[32];
+
+    size_number(buf, sizeof(buf), val);
+    fprintf(fp, "%*s", width, buf);
+}
+
+/*
+ * Section is one BFD shows as a section of its own. Symbol tables,
+ * their string tables, the section name table and the relocations
+ * of a relocatable section are only file structure to it.
+ * @symtab: index of SHT_SYMTAB, 0 if file has none.
+ */
+static int size_sysv_listed(struct elf_file *ef, int index, int symtab)
+{
+    Elf32_Shdr *st = elf_file_section(ef, index);
+    Elf32_Shdr *target;
+
+    switch (st->sh_type) {
+    case SHT_SYMTAB:
+    case SHT_SYMTAB_SHNDX:
+        return 0;
+    case SHT_STRTAB:
+        if (index == ef->header->e_shstrndx)
+            return 0;
+        return !symtab ||
+               elf_file_section(ef, symtab)->sh_link != (Elf32_Word)index;
+    case SHT_REL:
+    case SHT_RELA:
+        if ((st->sh_flags & SHF_ALLOC) || !symtab ||
+            st->sh_link != (Elf32_Word)symtab)
+            return 1;
+        target = elf_file_section(ef, st->sh_info);
+        return !st->sh_info || !target || target->sh_type == SHT_REL ||
+               target->sh_type == SHT_RELA;
+    }
+    return 1;
+}
+
+/*
+ * Format SysV report for one file into a buffer, sections and
+ * columns are the ones GNU size prints.
+ */
+static char *size_sysv_format(struct size_result *res, struct elf_file *ef)
+{
+    unsigned long long total = 0, max_addr = 0;
+    int name_width = 0, size_width, addr_width, symtab = 0;
+    char *buffer = NULL;
+    size_t len = 0;
+    FILE *fp;
+    int i, n;
+
+    for (i = 1; i < ef->section_numbers && !symtab; i++)
+        if (elf_file_section(ef, i)->sh_type == SHT_SYMTAB)
+            symtab = i;
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        if (!size_sysv_listed(ef, i, symtab))
+            continue;
+        n = strlen(elf_file_section_name(ef, st));
+        if (n > name_width)
+            name_width = n;
+        if (st->sh_addr > max_addr)
+            max_addr = st->sh_addr;
+        total += st->sh_size;
+    }
+    size_width = size_number_width(total);
+    if (size_width < 4)
+        size_width = 4;
+    addr_width = size_number_width(max_addr);
+    if (addr_width < 4)
+        addr_width = 4;
+
+    fp = open_memstream(&buffer, &len);
+    if (!fp)
+        return NULL;
+    if (res->archive)
+        fprintf(fp, "%s   (ex %s):\n", res->filename, res->archive->filename);
+    else
+        fprintf(fp, "%s  :\n", res->filename);
+    fprintf(fp, "%-*s   %*s   %*s\n", name_width, "section",
+            size_width, "size", addr_width, "addr");
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        if (!size_sysv_listed(ef, i, symtab))
+            continue;
+        fprintf(fp, "%-*s   ", name_width, elf_file_section_name(ef, st));
+        sysv_print_number(fp, size_width, st->sh_size);
+        fprintf(fp, "   ");
+        sysv_print_number(fp, addr_width, st->sh_addr);
+        fputc('\n', fp);
+    }
+    fprintf(fp, "%-*s   ", name_width, "Total");
+    sysv_print_number(fp, size_width, total);
+    fprintf(fp, "\n\n\n");
+    fclose(fp);
+    return buffer;
+}
+
+/*
+ * Compute size of one file. Only the ELF header and the section
+ * table are read, so this is safe to run on many files at once.
+ * Archive members are read from the mapping of their archive.
+ */
+static void size_measure(struct size_result *res, struct elf_file *ef)
+{
+    int i;
+
+    if (!ef) {
+        res->err = errno;
+        return;
+    }
+    for (i = 1; i < ef->section_numbers; i++)
+        size_classify(res, elf_file_section(ef, i));
+    if (__format == FORMAT_SYSV)
+        res->sysv = size_sysv_format(res, ef);
+    elf_file_free(ef);
+}
+
+static void size_one_file(struct size_result *res)
+{
+    struct trace_clock t;
+
+    if (res->done)
+        return;
+    trace_begin(&t);
+    if (res->archive)
+        size_measure(res, archive_member_elf(res->archive, res->member));
+    else
+        size_measure(res, elf_file_alloc(res->filename));
+    trace_end(&t, TRACE_FILE, res->filename,
+              res->archive ? res->archive->filename : NULL);
+}
+
+/*
+ * Batch worker, claims next unprocessed input until all are done.
+ */
+static void *size_worker(void *arg)
+{
+    int index;
+
+    while ((index = __sync_fetch_and_add(&next_result, 1)) < result_numbers)
+        size_one_file(&results[index]);
+    return NULL;
+}
+
+static void size_run_batch(void)
+{
+    pthread_t *threads;
+    int i, n = __jobs;
+
+    if (n > result_numbers)
+        n = result_numbers;
+    if (n <= 1) {
+        size_worker(NULL);
+        return;
+    }
+
+    threads = xmalloc(sizeof(pthread_t) * n);
+    for (i = 0; i < n; i++)
+        if (pthread_create(&threads[i], NULL, size_worker, NULL))
+            break;
+    /* Whatever couldn't get a thread is done here */
+    size_worker(NULL);
+    while (i--)
+        pthread_join(threads[i], NULL);
+    xfree(threads);
+}
+
+static void berkeley_print(unsigned long long text, unsigned long long data,
+                           unsigned long long bss, const char *filename)
+{
+    unsigned long long total = text + data + bss;
+    char buf[32];
+
+    size_number(buf, sizeof(buf), text);
+    printf("%7s\t", buf);
+    size_number(buf, sizeof(buf), data);
+    printf("%7s\t", buf);
+    size_number(buf, sizeof(buf), bss);
+    printf("%7s\t", buf);
+    /* total is octal with -o, its header says "oct" then */
+    printf(__radix == 8 ? "%7llo\t%7llx\t%s\n" : "%7llu\t%7llx\t%s\n",
+           total, total, filename);
+}
+
+/*
+ * Print results in input order.
+ * @return: 0 if every file has been loaded.
+ */
+static int size_print(void)
+{
+    unsigned long long text = 0, data = 0, bss = 0;
+    int i, ret = 0;
+
+    if (__format == FORMAT_BERKELEY)
+        printf("   text\t   data\t    bss\t    %s\t    hex\tfilename\n",
+               __radix == 8 ? "oct" : "dec");
+
+    for (i = 0; i < result_numbers; i++) {
+        struct size_result *res = &results[i];
+
+        if (res->err) {
+            fprintf(stderr, "size: %s: %s\n", res->filename,
+                    res->err == EINVAL ? "file format not recognized" :
+                    strerror(res->err));
+            ret = 1;
+            continue;
+        }
+        if (__format == FORMAT_SYSV) {
+            if (res->sysv)
+                fputs(res->sysv, stdout);
+            free(res->sysv);
+            continue;
+        }
+        if (res->archive) {
+            char *name = xmalloc(strlen(res->filename) +
+                                 strlen(res->archive->filename) + 7);
+
+            sprintf(name, "%s (ex %s)", res->filename, res->archive->filename);
+            berkeley_print(res->text, res->data, res->bss, name);
+            xfree(name);
+        } else {
+            berkeley_print(res->text, res->data, res->bss, res->filename);
+        }
+        text += res->text;
+        data += res->data;
+        bss += res->bss;
+    }
+    if (__format == FORMAT_BERKELEY && __totals)
+        berkeley_print(text, data, bss, "(TOTALS)");
+    return ret;
+}
+
+/*
+ * Unmap archives, each one after its last member.
+ */
+static void size_free_archives(void)
+{
+    int i;
+
+    for (i = 0; i < result_numbers; i++)
+        if (results[i].archive && (i + 1 == result_numbers ||
+                                   results[i + 1].archive !=
+                                   results[i].archive))
+            archive_free(results[i].archive);
+}
+
+static struct size_result *size_new_result(void)
+{
+    if (result_numbers == result_max) {
+        struct size_result *tmp;
+
+        result_max = result_max ? result_max * 2 : 64;
+        tmp = xmalloc(sizeof(struct size_result) * result_max);
+        memset(tmp, 0, sizeof(struct size_result) * result_max);
+        if (results) {
+            memcpy(tmp, results, sizeof(struct size_result) * result_numbers);
+            xfree(results);
+        }
+        results = tmp;
+    }
+    return &results[result_numbers++];
+}
+
+/*
+ * Add input file, '@file' reads whitespace separated names from file.
+ */
+static void size_add_input(const char *name)
+{
+    if (name[0] == '@') {
+        FILE *fp = fopen(name + 1, "r");
+        char path[4096];
+
+        if (!fp) {
+            fprintf(stderr, "size: %s: %s\n", name + 1, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        while (fscanf(fp, "%4095s", path) == 1)
+            size_add_input(strdup(path));
+        fclose(fp);
+        return;
+    }
+    size_new_result()->filename = name;
+}
+
+/*
+ * Batch scan callback, plain ELF files are measured right away and
+ * archives are mapped on the batch's descriptor and left for
+ * size_expand_archives().
+ */
+static void size_scan(struct elf_batch_file *bf, int index, void *data)
+{
+    struct size_result *res = &results[index];
+    struct trace_clock t;
+
+    trace_begin(&t);
+    if (!bf->err && archive_check_mem(bf->header, bf->header_size)) {
+        res->archive = archive_alloc_fd(bf->filename, bf->fd, bf->size);
+        if (!res->archive)
+            res->err = errno;
+    } else {
+        size_measure(res, elf_batch_elf(bf));
+        res->done = 1;
+    }
+    trace_end(&t, TRACE_FILE, bf->filename, NULL);
+}
+
+/*
+ * Replace every archive input by one input per member.
+ */
+static void size_expand_archives(void)
+{
+    struct size_result *inputs = results;
+    int i, j, n = result_numbers;
+
+    results = NULL;
+    result_numbers = result_max = 0;
+    for (i = 0; i < n; i++) {
+        struct size_result *res;
+        struct archive *ar;
+
+        if (inputs[i].done) {
+            *size_new_result() = inputs[i];
+            continue;
+        }
+        ar = inputs[i].archive;
+        if (!ar) {
+            res = size_new_result();
+            res->filename = inputs[i].filename;
+            res->err = inputs[i].err;
+            continue;
+        }
+        for (j = 0; j < ar->member_numbers; j++) {
+            res = size_new_result();
+            res->filename = ar->members[j].name;
+            res->archive = ar;
+            res->member = j;
+        }
+        /* members are worth threads even if -j wasn't given */
+        size_archives++;
+        if (!ar->member_numbers)
+            archive_free(ar);
+    }
+    xfree(inputs);
+}
+
+/*
+ * Open and measure plain files in batches, which keeps many opens
+ * and reads in flight, then expand archives.
+ */
+static void size_scan_inputs(void)
+{
+    struct elf_batch *batch;
+    const char **names;
+    int i;
+
+    names = xmalloc(sizeof(char *) * (result_numbers ? result_numbers : 1));
+    for (i = 0; i < result_numbers; i++)
+        names[i] = results[i].filename;
+    batch = elf_batch_alloc(result_numbers > 1 ? __io : ELF_BATCH_PREAD, 0);
+    elf_batch_run(batch, names, result_numbers, size_scan, NULL);
+    elf_batch_free(batch);
+    xfree(names);
+    size_expand_archives();
+}
+
+/*
+ * change of one row between two profiles
+ * @old_file: bytes in old file, for the percentage.
+ */
+struct profile_delta {
+    const char *name;
+    int64_t    file;
+    int64_t    vm;
+    uint64_t   old_file;
+    uint64_t   old_vm;
+};
+
+static uint64_t profile_abs(int64_t v)
+{
+    return v < 0 ? -(uint64_t)v : (uint64_t)v;
+}
+
+/* biggest first, names break ties so output is stable */
+static int profile_compare(const void *a, const void *b)
+{
+    const struct size_profile_row *x = *(const struct size_profile_row **)a;
+    const struct size_profile_row *y = *(const struct size_profile_row **)b;
+
+    if (x->file != y->file)
+        return x->file > y->file ? -1 : 1;
+    if (x->vm != y->vm)
+        return x->vm > y->vm ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static int profile_delta_compare(const void *a, const void *b)
+{
+    const struct profile_delta *x = a, *y = b;
+
+    if (profile_abs(x->file) != profile_abs(y->file))
+        return profile_abs(x->file) > profile_abs(y->file) ? -1 : 1;
+    if (profile_abs(x->vm) != profile_abs(y->vm))
+        return profile_abs(x->vm) > profile_abs(y->vm) ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static double profile_percent(uint64_t part, uint64_t whole)
+{
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+static void profile_print_row(unsigned long long file,
+                              unsigned long long vm, struct size_profile *p,
+                              const char *name)
+{
+    printf("%10llu %5.1f%%  %10llu %5.1f%%  %s\n", file,
+           profile_percent(file, p->file), vm, profile_percent(vm, p->vm),
+           name);
+}
+
+/*
+ * Print rows biggest first, rows past __profile_rows folded into
+ * one.
+ */
+static void profile_print(struct size_profile *p)
+{
+    unsigned long long file = 0, vm = 0;
+    struct size_profile_row **rows;
+    int i, n = 0, others = 0;
+    char name[32];
+
+    rows = xmalloc(sizeof(*rows) * (p->row_numbers ? p->row_numbers : 1));
+    for (i = 0; i < p->row_numbers; i++)
+        if (p->rows[i].file || p->rows[i].vm)
+            rows[n++] = &p->rows[i];
+    qsort(rows, n, sizeof(*rows), profile_compare);
+
+    printf("%17s  %17s  %s\n", "File size", "VM size",
+           PROFILE_HEADINGS[__profile]);
+    for (i = 0; i < n; i++) {
+        if (__profile_rows && i >= __profile_rows) {
+            file += rows[i]->file;
+            vm += rows[i]->vm;
+            others++;
+            continue;
+        }
+        profile_print_row(rows[i]->file, rows[i]->vm, p, rows[i]->name);
+    }
+    if (others) {
+        snprintf(name, sizeof(name), "[%d others]", others);
+        profile_print_row(file, vm, p, name);
+    }
+    profile_print_row(p->file, p->vm, p, "TOTAL");
+    xfree(rows);
+}
+
+/* change relative to old size, [NEW] or [DEL] where there is none */
+static const char *profile_change(int64_t delta, uint64_t old, char *buf,
+                                  size_t len)
+{
+    if (!delta)
+        return "";
+    if (!old)
+        return "[NEW]";
+    if ((int64_t)old + delta == 0)
+        return "[DEL]";
+    snprintf(buf, len, "%+.1f%%", 100.0 * delta / old);
+    return buf;
+}
+
+static void profile_print_delta(struct profile_delta *d)
+{
+    char file_buf[32], vm_buf[32];
+
+    printf("%+10lld %7s  %+10lld %7s  %s\n", (long long)d->file,
+           profile_change(d->file, d->old_file, file_buf, sizeof(file_buf)),
+           (long long)d->vm,
+           profile_change(d->vm, d->old_vm, vm_buf, sizeof(vm_buf)),
+           d->name);
+}
+
+/*
+ * Print rows of two profiles that changed, biggest change first.
+ * Rows are joined by name through the old profile's hash table.
+ */
+static void profile_print_diff(struct size_profile *a, struct size_profile *b)
+{
+    struct profile_delta *deltas, others, total;
+    char *taken, name[32];
+    int i, j, n = 0;
+
+    deltas = xmalloc(sizeof(struct profile_delta) *
+                     (a->row_numbers + b->row_numbers + 1));
+    taken = xmalloc(a->row_numbers + 1);
+    memset(taken, 0, a->row_numbers + 1);
+    for (i = 0; i < b->row_numbers; i++) {
+        struct size_profile_row *row = &b->rows[i];
+        struct profile_delta *d = &deltas[n];
+
+        j = size_profile_find(a, row->name);
+        d->name = row->name;
+        d->file = row->file;
+        d->vm = row->vm;
+        d->old_file = 0;
+        d->old_vm = 0;
+        if (j >= 0) {
+            taken[j] = 1;
+            d->old_file = a->rows[j].file;
+            d->old_vm = a->rows[j].vm;
+            d->file -= a->rows[j].file;
+            d->vm -= a->rows[j].vm;
+        }
+        if (d->file || d->vm)
+            n++;
+    }
+    for (i = 0; i < a->row_numbers; i++) {
+        struct size_profile_row *row = &a->rows[i];
+        struct profile_delta *d = &deltas[n];
+
+        if (taken[i] || (!row->file && !row->vm))
+            continue;
+        d->name = row->name;
+        d->file = -(int64_t)row->file;
+        d->vm = -(int64_t)row->vm;
+        d->old_file = row->file;
+        d->old_vm = row->vm;
+        n++;
+    }
+    qsort(deltas, n, sizeof(struct profile_delta), profile_delta_compare);
+
+    printf("%17s  %17s  %s\n", "File delta", "VM delta",
+           PROFILE_HEADINGS[__profile]);
+    memset(&others, 0, sizeof(others));
+    for (i = 0; i < n; i++) {
+        if (__profile_rows && i >= __profile_rows) {
+            others.file += deltas[i].file;
+            others.vm += deltas[i].vm;
+            others.old_file += deltas[i].old_file;
+            others.old_vm += deltas[i].old_vm;
+            continue;
+        }
+        profile_print_delta(&deltas[i]);
+    }
+    if (__profile_rows && n > __profile_rows) {
+        snprintf(name, sizeof(name), "[%d others]", n - __profile_rows);
+        others.name = name;
+        profile_print_delta(&others);
+    }
+    total.name = "TOTAL";
+    total.file = (int64_t)b->file - (int64_t)a->file;
+    total.vm = (int64_t)b->vm - (int64_t)a->vm;
+    total.old_file = a->file;
+    total.old_vm = a->vm;
+    profile_print_delta(&total);
+    xfree(taken);
+    xfree(deltas);
+}
+
+static struct size_profile *profile_load(const char *filename)
+{
+    struct trace_clock t;
+    struct size_profile *p;
+    struct elf_file *ef;
+
+    trace_begin(&t);
+    ef = elf_file_alloc(filename);
+    if (!ef) {
+        fprintf(stderr, "size: %s: %s\n", filename, errno == EINVAL ?
+                "file format not recognized" : strerror(errno));
+        return NULL;
+    }
+    p = size_profile_alloc(ef, __profile);
+    trace_end(&t, TRACE_FILE, filename, NULL);
+    return p;
+}
+
+static void profile_free(struct size_profile *p)
+{
+    struct elf_file *ef = p->ef;
+
+    size_profile_free(p);
+    elf_file_free(ef);
+}
+
+/*
+ * Profile of every file, or with @diff the change from the first
+ * file to the second.
+ * @return: 0 if every file has been loaded.
+ */
+static int profile_files(char **files, int numbers, int diff)
+{
+    struct size_profile *a, *b;
+    int i, ret = 0;
+
+    if (diff) {
+        a = profile_load(files[0]);
+        b = a ? profile_load(files[1]) : NULL;
+        if (b)
+            profile_print_diff(a, b);
+        if (b)
+            profile_free(b);
+        if (a)
+            profile_free(a);
+        return !b;
+    }
+    for (i = 0; i < numbers; i++) {
+        a = profile_load(files[i]);
+        if (!a) {
+            ret = 1;
+            continue;
+        }
+        if (numbers > 1)
+            printf("%s%s:\n", i ? "\n" : "", files[i]);
+        profile_print(a);
+        profile_free(a);
+    }
+    return ret;
+}
+
+static void usage(void)
+{
+    printf("Usage: size [option(s)] [file(s)]\n");
+    printf(" Displays the sizes of sections inside ELF files\n");
+    printf(" If no input file(s) are specified, a.out is assumed\n");
+    printf(" The options are:\n");
+    printf("  -A|-B     --format={sysv|berkeley}  Select output style (default is berkeley)\n");
+    printf("  -o|-d|-x  --radix={8|10|16}         Display numbers in octal, decimal or hex\n");
+    printf("  -t        --totals                  Display the total sizes (Berkeley only)\n");
+    printf("  -j        --jobs=<number>           Process files with <number> threads\n");
+    printf("                                      (default 1, all CPUs for archives)\n");
+    printf("            --io={auto|uring|pread}   Select I/O engine for opening files\n");
+    printf("            --trace=<file>            Write spans per file, phase and thread to\n");
+    printf("                                      <file> as Chrome trace events\n");
+    printf("            --profile[={sections|symbols|units}]\n");
+    printf("                                      Attribute every byte of each file to\n");
+    printf("                                      sections, symbols or DWARF compile units\n");
+    printf("            --diff <old> <new>        Profile the change between two files,\n");
+    printf("                                      biggest first (sections by default)\n");
+    printf("            --rows=<number>           Rows of a profile to show, rest are\n");
+    printf("                                      folded (default 20, 0 for all)\n");
+    printf("  @<file>                             Read input file names from <file>\n");
+    printf("  -h        --help                    Display this information\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"format", required_argument, NULL, 'f'},
+        {"radix", required_argument, NULL, 'r'},
+        {"totals", no_argument, NULL, 't'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"io", required_argument, NULL, 'I'},
+        {"trace", required_argument, NULL, 'P'},
+        {"profile", optional_argument, NULL, 'S'},
+        {"diff", no_argument, NULL, 'D'},
+        {"rows", required_argument, NULL, 'n'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    const char *short_opts = "ABodxtj:h";
+    const char *trace_file = NULL;
+    int c, ret, diff = 0;
+
+    while ((c = getopt_long(argc, argv, short_opts, long_opts, NULL)) != -1) {
+        switch (c) {
+        case 'A':
+            __format = FORMAT_SYSV;
+            break;
+        case 'B':
+            __format = FORMAT_BERKELEY;
+            break;
+        case 'f':
+            if (optarg[0] == 's' || optarg[0] == 'S')
+                __format = FORMAT_SYSV;
+            else if (optarg[0] == 'b' || optarg[0] == 'B')
+                __format = FORMAT_BERKELEY;
+            else {
+                fprintf(stderr, "size: invalid argument to --format: %s\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            __radix = atoi(optarg);
+            if (__radix != 8 && __radix != 10 && __radix != 16) {
+                fprintf(stderr, "size: invalid radix: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o':
+            __radix = 8;
+            break;
+        case 'd':
+            __radix = 10;
+            break;
+        case 'x':
+            __radix = 16;
+            break;
+        case 't':
+            __totals = 1;
+            break;
+        case 'j':
+            __jobs = atoi(optarg);
+            if (__jobs <= 0)
+                __jobs = sysconf(_SC_NPROCESSORS_ONLN);
+            break;
+        case 'I':
+            if (!strcmp(optarg, "auto"))
+                __io = ELF_BATCH_AUTO;
+            else if (!strcmp(optarg, "uring"))
+                __io = ELF_BATCH_URING;
+            else if (!strcmp(optarg, "pread"))
+                __io = ELF_BATCH_PREAD;
+            else {
+                fprintf(stderr, "size: invalid argument to --io: %s\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P':
+            trace_file = optarg;
+            break;
+        case 'S':
+            if (!optarg || !strcmp(optarg, "sections"))
+                __profile = SIZE_PROFILE_SECTIONS;
+            else if (!strcmp(optarg, "symbols"))
+                __profile = SIZE_PROFILE_SYMBOLS;
+            else if (!strcmp(optarg, "units"))
+                __profile = SIZE_PROFILE_UNITS;
+            else {
+                fprintf(stderr, "size: invalid argument to --profile: %s\n",
+                        optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'D':
+            diff = 1;
+            break;
+        case 'n':
+            __profile_rows = atoi(optarg);
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (diff && argc - optind != 2) {
+        fprintf(stderr, "size: --diff takes two files\n");
+        return EXIT_FAILURE;
+    }
+    if (diff && __profile < 0)
+        __profile = SIZE_PROFILE_SECTIONS;
+    if (trace_file) {
+#ifdef CONFIG_TRACE
+        if (trace_open(trace_file)) {
+            fprintf(stderr, "size: %s: %s\n", trace_file, strerror(errno));
+            return EXIT_FAILURE;
+        }
+#else
+        fprintf(stderr, "size: --trace not configured (CONFIG_TRACE)\n");
+        return EXIT_FAILURE;
+#endif
+    }
+    if (__profile >= 0) {
+        char *a_out = "a.out";
+
+        if (optind == argc)
+            ret = profile_files(&a_out, 1, 0);
+        else
+            ret = profile_files(argv + optind, argc - optind, diff);
+    } else {
+        if (optind == argc)
+            size_add_input("a.out");
+        for (; optind < argc; optind++)
+            size_add_input(argv[optind]);
+        size_scan_inputs();
+
+        if (!__jobs)
+            __jobs = size_archives ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+        size_run_batch();
+        ret = size_print();
+        size_free_archives();
+        archive_cache_free();
+    }
+#ifdef CONFIG_TRACE
+    if (trace_file && trace_close()) {
+        fprintf(stderr, "size: %s: %s\n", trace_file, strerror(errno));
+        ret = 1;
+    }
+#endif
+    return ret;
+}
@@ -0,0 +1,112 @@
+#ifndef _ARCHIVE_H
+#define _ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <elf.h>
+
+#define ARCHIVE_MAGIC        "!<arch>\n"
+#define ARCHIVE_THIN_MAGIC   "!<thin>\n"
+#define ARCHIVE_MAGIC_SIZE   8
+
+/*
+ * member header of ar archive, all fields are ASCII padded with
+ * spaces.
+ */
+struct archive_header {
+    char name[16];
+    char date[12];
+    char uid[6];
+    char gid[6];
+    char mode[8];
+    char size[10];
+    char fmag[2];
+};
+
+/*
+ * one member of archive
+ * @name: member name, long names resolved. Members of thin archives
+ *        are named by their path.
+ * @header: offset of member header on archive, armap refers to it.
+ * @offset: offset of member contents on archive, 0 on thin archives.
+ * @size: size of member contents.
+ * @date: modification time, as given by header.
+ * @uid: owner, as given by header.
+ * @gid: group, as given by header.
+ * @mode: file mode, as given by header.
+ */
+struct archive_member {
+    const char *name;
+    uint64_t   header;
+    uint64_t   offset;
+    uint64_t   size;
+    uint64_t   date;
+    uint32_t   uid;
+    uint32_t   gid;
+    uint32_t   mode;
+};
+
+/*
+ * one entry of archive symbol index
+ * @name: symbol name on mapping.
+ * @member: index of defining member on member table.
+ */
+struct archive_symbol {
+    const char *name;
+    int        member;
+};
+
+/*
+ * archive handle, the archive is mapped once and members are read
+ * in place.
+ * @filename: file name which handle was opened from.
+ * @map: read-only mapping of the whole archive.
+ * @size: size of archive.
+ * @thin: members are files named relative to archive, not contents.
+ * @members: members in archive order, special members left out.
+ * @symbols: symbol index (armap) in archive order, NULL if archive
+ *           has none.
+ * @names: storage of member names.
+ * @hash: open addressing table of @symbols, built on first lookup.
+ */
+struct archive {
+    const char            *filename;
+    unsigned char         *map;
+    size_t                size;
+    int                   thin;
+    struct archive_member *members;
+    int                   member_numbers;
+    struct archive_symbol *symbols;
+    int                   symbol_numbers;
+    char                  *names;
+    int                   *hash;
+    int                   hash_size;
+};
+
+/* check whether first bytes of a file are an archive magic */
+extern int archive_check_mem(const void *data, size_t size);
+
+/* map archive and read its member table and symbol index */
+extern struct archive *archive_alloc(const char *filename);
+
+/* map archive on descriptor caller has opened */
+extern struct archive *archive_alloc_fd(const char *filename, int fd,
+      uint64_t size);
+
+/* unmap archive and free handle */
+extern void archive_free(struct archive *ar);
+
+/* elf file handle of member, borrowing the archive mapping */
+extern struct elf_file *archive_member_elf(struct archive *ar, int index);
+
+/* unmap files mapped for thin archive members */
+extern void archive_cache_free(void);
+
+/* member defining symbol, looked up on the symbol index */
+extern int archive_lookup(struct archive *ar, const char *name);
+
+/* run function on every member with a number of threads */
+extern void archive_for_each(struct archive *ar, int jobs,
+      void (*fn)(struct archive *ar, int index, void *data), void *data);
+
+#endif
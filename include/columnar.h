@@ -0,0 +1,114 @@
+#ifndef _COLUMNAR_H
+#define _COLUMNAR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COLUMNAR_MAGIC         "ELFCOLS1"
+#define COLUMNAR_VERSION       1
+#define COLUMNAR_NAME_SIZE     16
+
+/* column types */
+#define COLUMNAR_U8            1
+#define COLUMNAR_U16           2
+#define COLUMNAR_U32           3
+#define COLUMNAR_U64           4
+#define COLUMNAR_STR           5    /* uint32_t offset on string heap */
+
+/* ---------------------------------------
+ * file layout, little endian and 8-byte aligned throughout
+ *
+ *   struct columnar_header
+ *   blocks        uint64_t length, then data padded to 8 bytes.
+ *                 One block per column and one for the string heap.
+ *   directory     struct columnar_table_entry[table_numbers], then
+ *                 struct columnar_column_entry[] of all tables.
+ *
+ * Rows of a table are the same index on each of its columns, so a
+ * column is scanned straight from the mapping. Strings on the heap
+ * are NUL terminated and stored once, offset 0 is "".
+ */
+struct columnar_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t table_numbers;
+    uint64_t heap;
+    uint64_t directory;
+};
+
+struct columnar_table_entry {
+    char     name[COLUMNAR_NAME_SIZE];
+    uint64_t rows;
+    uint32_t column_first;
+    uint32_t column_numbers;
+};
+
+/*
+ * @offset: offset of column block, its length prefix comes first.
+ */
+struct columnar_column_entry {
+    char     name[COLUMNAR_NAME_SIZE];
+    uint32_t type;
+    uint32_t width;
+    uint64_t offset;
+};
+
+/*
+ * column being built
+ * @data: values, @width bytes each.
+ */
+struct columnar_column {
+    char          name[COLUMNAR_NAME_SIZE];
+    uint32_t      type;
+    uint32_t      width;
+    unsigned char *data;
+    size_t        size;
+    size_t        max;
+};
+
+struct columnar_table {
+    char                   name[COLUMNAR_NAME_SIZE];
+    struct columnar_column *columns;
+    int                    column_numbers;
+};
+
+/*
+ * export being built in memory, written out at once.
+ * @heap: deduplicated strings.
+ * @hash: open addressing table of heap offsets, 0 is empty.
+ * @overflow: string heap outgrew 32-bit offsets.
+ */
+struct columnar {
+    struct columnar_table **tables;
+    int                   table_numbers;
+    char                  *heap;
+    size_t                heap_size;
+    size_t                heap_max;
+    uint32_t              *hash;
+    size_t                hash_size;
+    size_t                hash_used;
+    int                   overflow;
+};
+
+/* empty export */
+extern struct columnar *columnar_alloc(void);
+
+/* free export */
+extern void columnar_free(struct columnar *c);
+
+/* add table with columns named and typed by NULL terminated lists */
+extern struct columnar_table *columnar_table(struct columnar *c,
+      const char *name, const char **columns, const uint32_t *types);
+
+/* append number to column */
+extern void columnar_put(struct columnar_table *t, int column,
+      uint64_t value);
+
+/* append string to column, stored once on string heap */
+extern void columnar_put_str(struct columnar *c, struct columnar_table *t,
+      int column, const char *s);
+
+/* write export to file */
+extern int columnar_write(struct columnar *c, const char *filename);
+
+#endif
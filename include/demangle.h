@@ -0,0 +1,18 @@
+#ifndef _DEMANGLE_H
+#define _DEMANGLE_H
+
+/*
+ * demangle Itanium C++ ABI name, returns @mangled if it can't. Names
+ * are the ones GNU nm -C prints: Ss, Si, So and Sd stay std::string
+ * and friends except before a constructor or destructor, c++filt
+ * expands them everywhere.
+ */
+extern const char *demangle(const char *mangled);
+
+/* demangle into arena without looking at cache, NULL on failure */
+extern const char *demangle_uncached(const char *mangled);
+
+/* free demangle cache and every name returned by demangle() */
+extern void demangle_cache_free(void);
+
+#endif
@@ -0,0 +1,541 @@
+#ifndef _DWARF_H
+#define _DWARF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <elf.h>
+
+/* Line number standard opcodes */
+#define DW_LNS_copy                  0x01
+#define DW_LNS_advance_pc            0x02
+#define DW_LNS_advance_line          0x03
+#define DW_LNS_set_file              0x04
+#define DW_LNS_set_column            0x05
+#define DW_LNS_negate_stmt           0x06
+#define DW_LNS_set_basic_block       0x07
+#define DW_LNS_const_add_pc          0x08
+#define DW_LNS_fixed_advance_pc      0x09
+#define DW_LNS_set_prologue_end      0x0a
+#define DW_LNS_set_epilogue_begin    0x0b
+#define DW_LNS_set_isa               0x0c
+
+/* Line number extended opcodes */
+#define DW_LNE_end_sequence          0x01
+#define DW_LNE_set_address           0x02
+#define DW_LNE_define_file           0x03
+#define DW_LNE_set_discriminator     0x04
+
+/* Line number header entry format (DWARF 5) */
+#define DW_LNCT_path                 0x1
+#define DW_LNCT_directory_index      0x2
+#define DW_LNCT_timestamp            0x3
+#define DW_LNCT_size                 0x4
+#define DW_LNCT_MD5                  0x5
+
+/* Attribute forms */
+#define DW_FORM_addr                 0x01
+#define DW_FORM_block2               0x03
+#define DW_FORM_block4               0x04
+#define DW_FORM_data2                0x05
+#define DW_FORM_data4                0x06
+#define DW_FORM_data8                0x07
+#define DW_FORM_string               0x08
+#define DW_FORM_block                0x09
+#define DW_FORM_block1               0x0a
+#define DW_FORM_data1                0x0b
+#define DW_FORM_flag                 0x0c
+#define DW_FORM_sdata                0x0d
+#define DW_FORM_strp                 0x0e
+#define DW_FORM_udata                0x0f
+#define DW_FORM_ref_addr             0x10
+#define DW_FORM_ref1                 0x11
+#define DW_FORM_ref2                 0x12
+#define DW_FORM_ref4                 0x13
+#define DW_FORM_ref8                 0x14
+#define DW_FORM_ref_udata            0x15
+#define DW_FORM_indirect             0x16
+#define DW_FORM_sec_offset           0x17
+#define DW_FORM_exprloc              0x18
+#define DW_FORM_flag_present         0x19
+#define DW_FORM_strx                 0x1a
+#define DW_FORM_addrx                0x1b
+#define DW_FORM_ref_sup4             0x1c
+#define DW_FORM_strp_sup             0x1d
+#define DW_FORM_data16               0x1e
+#define DW_FORM_line_strp            0x1f
+#define DW_FORM_ref_sig8             0x20
+#define DW_FORM_implicit_const       0x21
+#define DW_FORM_loclistx             0x22
+#define DW_FORM_rnglistx             0x23
+#define DW_FORM_ref_sup8             0x24
+#define DW_FORM_strx1                0x25
+#define DW_FORM_strx2                0x26
+#define DW_FORM_strx3                0x27
+#define DW_FORM_strx4                0x28
+#define DW_FORM_addrx1               0x29
+#define DW_FORM_addrx2               0x2a
+#define DW_FORM_addrx3               0x2b
+#define DW_FORM_addrx4               0x2c
+
+/* Unit types (DWARF 5) */
+#define DW_UT_compile                0x01
+#define DW_UT_type                   0x02
+#define DW_UT_partial                0x03
+#define DW_UT_skeleton               0x04
+#define DW_UT_split_compile          0x05
+#define DW_UT_split_type             0x06
+
+/* Tags used by lookups */
+#define DW_TAG_compile_unit          0x11
+#define DW_TAG_inlined_subroutine    0x1d
+#define DW_TAG_partial_unit          0x3c
+#define DW_TAG_subprogram            0x2e
+#define DW_TAG_skeleton_unit         0x4a
+
+/* Attributes used by lookups */
+#define DW_AT_sibling                0x01
+#define DW_AT_name                   0x03
+#define DW_AT_stmt_list              0x10
+#define DW_AT_low_pc                 0x11
+#define DW_AT_high_pc                0x12
+#define DW_AT_language               0x13
+#define DW_AT_comp_dir               0x1b
+#define DW_AT_abstract_origin        0x31
+#define DW_AT_specification          0x47
+#define DW_AT_ranges                 0x55
+#define DW_AT_call_file              0x58
+#define DW_AT_call_line              0x59
+#define DW_AT_call_column            0x57
+#define DW_AT_linkage_name           0x6e
+#define DW_AT_str_offsets_base       0x72
+#define DW_AT_addr_base              0x73
+#define DW_AT_rnglists_base          0x74
+#define DW_AT_MIPS_linkage_name      0x2007
+#define DW_AT_GNU_discriminator      0x2136
+
+/* Range list entries (DWARF 5) */
+#define DW_RLE_end_of_list           0x00
+#define DW_RLE_base_addressx         0x01
+#define DW_RLE_startx_endx           0x02
+#define DW_RLE_startx_length         0x03
+#define DW_RLE_offset_pair           0x04
+#define DW_RLE_base_address          0x05
+#define DW_RLE_start_end             0x06
+#define DW_RLE_start_length          0x07
+
+/* Name index attributes (DWARF 5 .debug_names) */
+#define DW_IDX_compile_unit          0x01
+#define DW_IDX_type_unit             0x02
+#define DW_IDX_die_offset            0x03
+#define DW_IDX_parent                0x04
+#define DW_IDX_type_hash             0x05
+
+/*
+ * bounded cursor on a DWARF section, every read checks @end and
+ * sets @err instead of running off the mapping.
+ */
+struct dwarf_reader {
+    const unsigned char *p;
+    const unsigned char *end;
+    int                 err;
+};
+
+static inline uint64_t dwarf_read_uleb(struct dwarf_reader *r)
+{
+    uint64_t val = 0;
+    int shift = 0;
+
+    /* one byte values are by far the most common */
+    if (r->p < r->end && !(*r->p & 0x80))
+        return *r->p++;
+    while (r->p < r->end) {
+        unsigned char c = *r->p++;
+
+        if (shift < 64)
+            val |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+        if (!(c & 0x80))
+            return val;
+    }
+    r->err = 1;
+    return 0;
+}
+
+static inline int64_t dwarf_read_sleb(struct dwarf_reader *r)
+{
+    uint64_t val = 0;
+    int shift = 0;
+
+    while (r->p < r->end) {
+        unsigned char c = *r->p++;
+
+        if (shift < 64)
+            val |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+        if (!(c & 0x80)) {
+            if (shift < 64 && (c & 0x40))
+                val |= -((uint64_t)1 << shift);
+            return (int64_t)val;
+        }
+    }
+    r->err = 1;
+    return 0;
+}
+
+/* little endian fixed size value of @size bytes */
+static inline uint64_t dwarf_read_u(struct dwarf_reader *r, int size)
+{
+    uint64_t val = 0;
+    int i;
+
+    if (r->end - r->p < size) {
+        r->err = 1;
+        r->p = r->end;
+        return 0;
+    }
+    for (i = 0; i < size; i++)
+        val |= (uint64_t)r->p[i] << (i * 8);
+    r->p += size;
+    return val;
+}
+
+/* NUL terminated string on section */
+static inline const char *dwarf_read_str(struct dwarf_reader *r)
+{
+    const char *s = (const char *)r->p;
+    const unsigned char *nul = memchr(r->p, 0, r->end - r->p);
+
+    if (!nul) {
+        r->err = 1;
+        r->p = r->end;
+        return "";
+    }
+    r->p = nul + 1;
+    return s;
+}
+
+/*
+ * one row of line table, as the line state machine emits it.
+ */
+#define DWARF_LINE_STMT          0x01
+#define DWARF_LINE_END_SEQUENCE  0x02
+
+struct dwarf_line_row {
+    uint64_t address;
+    uint32_t line;
+    uint32_t file;
+    uint32_t column;
+    uint32_t flags:8;
+    uint32_t discriminator:24;
+};
+
+/*
+ * file name entry, @name and @dir point into the mapped file.
+ */
+struct dwarf_line_file {
+    const char *name;
+    const char *dir;
+};
+
+/*
+ * Line table of one CU.
+ * @offset: offset of unit header on .debug_line.
+ * @version: DWARF version of line table.
+ * @files: file name table, indexed by DW_LNS_set_file operand.
+ * @rows: rows in state machine order.
+ */
+struct dwarf_line_cu {
+    uint64_t               offset;
+    int                    version;
+    struct dwarf_line_file *files;
+    int                    file_numbers;
+    struct dwarf_line_row  *rows;
+    int                    row_numbers;
+};
+
+/*
+ * address range covered by one sequence, rows of a sequence are
+ * ordered by address so a lookup is two binary searches.
+ * @max_high: highest @high of this and every lower sequence, bounds
+ *            the backward scan of a lookup.
+ */
+struct dwarf_line_seq {
+    uint64_t             low;
+    uint64_t             high;
+    uint64_t             max_high;
+    struct dwarf_line_cu *cu;
+    int                  first;
+    int                  last;
+};
+
+/*
+ * decoded .debug_line of one ELF file
+ * @seqs: every sequence of every CU, sorted by @low.
+ * @borrowed: rows live on a cache mapping and aren't freed.
+ */
+struct dwarf_line {
+    struct dwarf_line_cu  *cus;
+    int                   cu_numbers;
+    struct dwarf_line_seq *seqs;
+    int                   seq_numbers;
+    int                   borrowed;
+};
+
+/* decode .debug_line of ELF file, NULL if it has none */
+extern struct dwarf_line *dwarf_line_alloc(struct elf_file *ef);
+
+/* free decoded line tables */
+extern void dwarf_line_free(struct dwarf_line *dl);
+
+/* fill in @max_high of sequences once they are sorted */
+extern void dwarf_line_index(struct dwarf_line *dl);
+
+/* find row covering address, NULL if address has no line */
+extern struct dwarf_line_row *dwarf_line_lookup(struct dwarf_line *dl,
+      uint64_t address, struct dwarf_line_cu **cu);
+
+/* file entry of row, NULL for a bad file index */
+extern struct dwarf_line_file *dwarf_line_file(struct dwarf_line_cu *cu,
+      uint32_t index);
+
+/*
+ * contents of one debug section, empty if the file lacks it.
+ */
+struct dwarf_section {
+    const unsigned char *data;
+    uint64_t            size;
+};
+
+/*
+ * one attribute specification of an abbreviation.
+ */
+struct dwarf_abbrev_attr {
+    uint32_t name;
+    uint32_t form;
+    int64_t  implicit_const;
+};
+
+struct dwarf_abbrev {
+    uint64_t                 code;
+    uint32_t                 tag;
+    int                      has_children;
+    int                      attr_numbers;
+    struct dwarf_abbrev_attr *attrs;
+};
+
+/*
+ * abbreviation table at one .debug_abbrev offset, shared by every
+ * unit referring to it.
+ * @dense: abbrevs[code - 1] is code, true for every producer seen.
+ */
+struct dwarf_abbrev_table {
+    uint64_t                 offset;
+    struct dwarf_abbrev      *abbrevs;
+    int                      abbrev_numbers;
+    int                      dense;
+    struct dwarf_abbrev_attr *attrs;
+};
+
+/*
+ * one DIE of a parsed unit, attributes are read from the section
+ * on demand.
+ * @parent: index of parent DIE, -1 for unit DIE.
+ * @sibling: index of next DIE after this DIE's subtree.
+ */
+struct dwarf_die {
+    uint64_t            offset;
+    struct dwarf_abbrev *abbrev;
+    int                 parent;
+    int                 sibling;
+};
+
+/*
+ * inlined subroutine range inside a function
+ * @max_high: highest @high of this and every lower entry, bounds
+ *            the backward scan of a lookup.
+ * @die: index of DW_TAG_inlined_subroutine on unit.
+ * @depth: nesting level of inlining, 1 for a direct callee.
+ */
+struct dwarf_inline {
+    uint64_t low;
+    uint64_t high;
+    uint64_t max_high;
+    int      die;
+    int      depth;
+};
+
+/*
+ * Function with code, its inline index is built the first time an
+ * address in it is looked up.
+ * @die: index of DW_TAG_subprogram on unit.
+ */
+struct dwarf_func {
+    int                 die;
+    int                 inlines_read;
+    struct dwarf_inline *inlines;
+    int                 inline_numbers;
+};
+
+/*
+ * one range of a function, functions split in hot and cold parts
+ * have several.
+ */
+struct dwarf_func_range {
+    uint64_t          low;
+    uint64_t          high;
+    uint64_t          max_high;
+    struct dwarf_func *func;
+};
+
+/*
+ * Unit of .debug_info. Only the header is read when the file is
+ * opened, unit DIE bases on first attribute read and the DIE tree
+ * by dwarf_cu_parse().
+ * @offset: offset of unit header.
+ * @end: offset just past the unit.
+ * @die_offset: offset of unit DIE.
+ */
+struct dwarf_cu {
+    uint64_t                  offset;
+    uint64_t                  end;
+    uint64_t                  die_offset;
+    int                       version;
+    int                       unit_type;
+    int                       addr_size;
+    int                       offset_size;
+    struct dwarf_abbrev_table *abbrevs;
+    int                       root_read;
+    uint64_t                  low_pc;
+    uint64_t                  str_offsets_base;
+    uint64_t                  addr_base;
+    uint64_t                  rnglists_base;
+    struct dwarf_die          *dies;
+    int                       die_numbers;
+    int                       funcs_read;
+    struct dwarf_func         *funcs;
+    int                       func_numbers;
+    struct dwarf_func_range   *func_ranges;
+    int                       func_range_numbers;
+};
+
+/*
+ * decoded attribute value
+ * @value: constant, address, flag, section offset, or .debug_info
+ *         offset of a reference.
+ * @str: string forms.
+ * @block: block and exprloc forms, @value holds the size.
+ */
+struct dwarf_attr {
+    uint32_t            name;
+    uint32_t            form;
+    uint64_t            value;
+    const char          *str;
+    const unsigned char *block;
+};
+
+/*
+ * address range of a unit, from .debug_aranges or unit DIE ranges
+ */
+struct dwarf_arange {
+    uint64_t low;
+    uint64_t high;
+    int      cu;
+};
+
+/*
+ * lazy .debug_info index of one ELF file
+ */
+struct dwarf_info {
+    struct elf_file           *ef;
+    struct dwarf_section      info;
+    struct dwarf_section      abbrev;
+    struct dwarf_section      str;
+    struct dwarf_section      line_str;
+    struct dwarf_section      str_offsets;
+    struct dwarf_section      addr;
+    struct dwarf_section      ranges;
+    struct dwarf_section      rnglists;
+    struct dwarf_section      aranges;
+    struct dwarf_section      names;
+    struct dwarf_cu           *cus;
+    int                       cu_numbers;
+    struct dwarf_abbrev_table *tables;
+    int                       table_numbers;
+    struct dwarf_arange       *arange_table;
+    int                       arange_numbers;
+    int                       aranges_read;
+};
+
+/*
+ * address ranges of a DIE, walked without allocating
+ */
+struct dwarf_ranges {
+    struct dwarf_info   *di;
+    struct dwarf_cu     *cu;
+    struct dwarf_reader r;
+    uint64_t            base;
+    uint64_t            low;
+    uint64_t            high;
+    int                 kind;
+};
+
+/* index units and abbreviation tables of ELF file, NULL if none */
+extern struct dwarf_info *dwarf_info_alloc(struct elf_file *ef);
+
+/* free index and every parsed unit */
+extern void dwarf_info_free(struct dwarf_info *di);
+
+/* unit containing .debug_info offset */
+extern struct dwarf_cu *dwarf_info_cu_by_offset(struct dwarf_info *di,
+      uint64_t offset);
+
+/* unit whose code covers address, NULL if none */
+extern struct dwarf_cu *dwarf_info_cu_by_address(struct dwarf_info *di,
+      uint64_t address);
+
+/* find name on .debug_names, 0 on success */
+extern int dwarf_info_lookup_name(struct dwarf_info *di, const char *name,
+      struct dwarf_cu **cu, uint64_t *die_offset);
+
+/* parse DIE tree of unit, 0 on success */
+extern int dwarf_cu_parse(struct dwarf_info *di, struct dwarf_cu *cu);
+
+/* drop DIE tree of unit, it's parsed again on next use */
+extern void dwarf_cu_release(struct dwarf_cu *cu);
+
+/* DIE of parsed unit at .debug_info offset */
+extern struct dwarf_die *dwarf_cu_die(struct dwarf_cu *cu, uint64_t offset);
+
+/* read attribute of DIE, 0 on success */
+extern int dwarf_die_attr(struct dwarf_info *di, struct dwarf_cu *cu,
+      struct dwarf_die *die, uint32_t name, struct dwarf_attr *attr);
+
+/* name of DIE, through abstract origin and specification */
+extern const char *dwarf_die_name(struct dwarf_info *di,
+      struct dwarf_cu *cu, struct dwarf_die *die);
+
+/* function of parsed unit covering address, NULL if none */
+extern struct dwarf_func *dwarf_cu_function(struct dwarf_info *di,
+      struct dwarf_cu *cu, uint64_t address);
+
+/* inlined subroutines of function covering address, innermost first */
+extern int dwarf_func_inlines(struct dwarf_info *di, struct dwarf_cu *cu,
+      struct dwarf_func *func, uint64_t address, int *chain, int max);
+
+/* free function and inline indexes of unit */
+extern void dwarf_cu_funcs_free(struct dwarf_cu *cu);
+
+/* start walking address ranges of DIE, -1 if DIE has no code */
+extern int dwarf_ranges_init(struct dwarf_info *di, struct dwarf_cu *cu,
+      struct dwarf_die *die, struct dwarf_ranges *it);
+
+/* next [low, high) range, 0 when exhausted */
+extern int dwarf_ranges_next(struct dwarf_ranges *it, uint64_t *low,
+      uint64_t *high);
+
+/* whether address is in DIE's ranges */
+extern int dwarf_die_contains(struct dwarf_info *di, struct dwarf_cu *cu,
+      struct dwarf_die *die, uint64_t address);
+
+#endif
@@ -323,6 +323,16 @@ typedef struct
 #define STT_LOPROC      13              /* Start of processor-specific */
 #define STT_HIPROC      15              /* End of processor-specific */
 
+/* How to extract and insert information held in the st_other field.  */
+
+#define ELF32_ST_VISIBILITY(o)          ((o) & 0x03)
+
+/* Symbol visibility specification encoded in the st_other field.  */
+#define STV_DEFAULT     0               /* Default symbol visibility rules */
+#define STV_INTERNAL    1               /* Processor specific hidden class */
+#define STV_HIDDEN      2               /* Sym unavailable in other modules */
+#define STV_PROTECTED   3               /* Not preemptible, not exported */
+
 /* Special section indices.  */
 
 #define SHN_UNDEF       0               /* Undefined section */
@@ -361,4 +371,200 @@ typedef struct
 #define SHF_EXCLUDE          (1U << 31) /* Section is excluded unless
                                            referenced or allocated (Solaris).*/
 
+/* Type for signed 32-bit quantities. */
+typedef int32_t  Elf32_Sword;
+
+/* Program segment header.  */
+
+typedef struct
+{
+    Elf32_Word    p_type;           /* Segment type */
+    Elf32_Off     p_offset;         /* Segment file offset */
+    Elf32_Addr    p_vaddr;          /* Segment virtual address */
+    Elf32_Addr    p_paddr;          /* Segment physical address */
+    Elf32_Word    p_filesz;         /* Segment size in file */
+    Elf32_Word    p_memsz;          /* Segment size in memory */
+    Elf32_Word    p_flags;          /* Segment flags */
+    Elf32_Word    p_align;          /* Segment alignment */
+} Elf32_Phdr;
+
+/* Legal values for p_type (segment type).  */
+
+#define PT_NULL         0               /* Program header table entry unused */
+#define PT_LOAD         1               /* Loadable program segment */
+#define PT_DYNAMIC      2               /* Dynamic linking information */
+#define PT_INTERP       3               /* Program interpreter */
+#define PT_NOTE         4               /* Auxiliary information */
+#define PT_SHLIB        5               /* Reserved */
+#define PT_PHDR         6               /* Entry for header table itself */
+#define PT_TLS          7               /* Thread-local storage segment */
+#define PT_NUM          8               /* Number of defined types */
+#define PT_LOOS         0x60000000      /* Start of OS-specific */
+#define PT_GNU_EH_FRAME 0x6474e550      /* GCC .eh_frame_hdr segment */
+#define PT_GNU_STACK    0x6474e551      /* Indicates stack executability */
+#define PT_GNU_RELRO    0x6474e552      /* Read-only after relocation */
+#define PT_GNU_PROPERTY 0x6474e553      /* GNU property notes */
+#define PT_HIOS         0x6fffffff      /* End of OS-specific */
+#define PT_LOPROC       0x70000000      /* Start of processor-specific */
+#define PT_HIPROC       0x7fffffff      /* End of processor-specific */
+
+/* Legal values for p_flags (segment flags).  */
+
+#define PF_X            (1 << 0)        /* Segment is executable */
+#define PF_W            (1 << 1)        /* Segment is writable */
+#define PF_R            (1 << 2)        /* Segment is readable */
+
+/* Relocation table entry without addend (in section of type SHT_REL).  */
+
+typedef struct
+{
+    Elf32_Addr    r_offset;         /* Address */
+    Elf32_Word    r_info;           /* Relocation type and symbol index */
+} Elf32_Rel;
+
+/* Relocation table entry with addend (in section of type SHT_RELA).  */
+
+typedef struct
+{
+    Elf32_Addr    r_offset;         /* Address */
+    Elf32_Word    r_info;           /* Relocation type and symbol index */
+    Elf32_Sword   r_addend;         /* Addend */
+} Elf32_Rela;
+
+/* How to extract and insert information held in the r_info field.  */
+
+#define ELF32_R_SYM(val)                ((val) >> 8)
+#define ELF32_R_TYPE(val)               ((val) & 0xff)
+#define ELF32_R_INFO(sym, type)         (((sym) << 8) + ((type) & 0xff))
+
+/* i386 relocs.  */
+
+#define R_386_NONE         0            /* No reloc */
+#define R_386_32           1            /* Direct 32 bit  */
+#define R_386_PC32         2            /* PC relative 32 bit */
+#define R_386_GOT32        3            /* 32 bit GOT entry */
+#define R_386_PLT32        4            /* 32 bit PLT address */
+#define R_386_COPY         5            /* Copy symbol at runtime */
+#define R_386_GLOB_DAT     6            /* Create GOT entry */
+#define R_386_JMP_SLOT     7            /* Create PLT entry */
+#define R_386_RELATIVE     8            /* Adjust by program base */
+#define R_386_GOTOFF       9            /* 32 bit offset to GOT */
+#define R_386_GOTPC        10           /* 32 bit PC relative offset to GOT */
+#define R_386_32PLT        11
+#define R_386_TLS_TPOFF    14           /* Offset in static TLS block */
+#define R_386_TLS_IE       15           /* Address of GOT entry for static TLS
+                                           block offset */
+#define R_386_TLS_GOTIE    16           /* GOT entry for static TLS block
+                                           offset */
+#define R_386_TLS_LE       17           /* Offset relative to static TLS
+                                           block */
+#define R_386_TLS_GD       18           /* Direct 32 bit for GNU version of
+                                           general dynamic thread local data */
+#define R_386_TLS_LDM      19           /* Direct 32 bit for GNU version of
+                                           local dynamic thread local data
+                                           in LE code */
+#define R_386_16           20
+#define R_386_PC16         21
+#define R_386_8            22
+#define R_386_PC8          23
+#define R_386_TLS_LDO_32   32           /* Offset relative to TLS block */
+#define R_386_TLS_DTPMOD32 35           /* ID of module containing symbol */
+#define R_386_TLS_DTPOFF32 36           /* Offset in TLS block */
+#define R_386_TLS_TPOFF32  37           /* Negated offset in static TLS block */
+#define R_386_SIZE32       38           /* 32-bit symbol size */
+#define R_386_TLS_GOTDESC  39           /* GOT offset for TLS descriptor.  */
+#define R_386_TLS_DESC_CALL 40          /* Marker of call through TLS
+                                           descriptor for relaxation.  */
+#define R_386_TLS_DESC     41           /* TLS descriptor containing
+                                           pointer to code and to
+                                           argument, returning the TLS
+                                           offset for the symbol.  */
+#define R_386_IRELATIVE    42           /* Adjust indirectly by program base */
+#define R_386_GOT32X       43           /* Load from 32 bit GOT entry,
+                                           relaxable. */
+#define R_386_NUM          44
+
+/* Dynamic section entry.  */
+
+typedef struct
+{
+    Elf32_Sword   d_tag;            /* Dynamic entry type */
+    union
+    {
+        Elf32_Word d_val;           /* Integer value */
+        Elf32_Addr d_ptr;           /* Address value */
+    } d_un;
+} Elf32_Dyn;
+
+/* Legal values for d_tag (dynamic entry type).  */
+
+#define DT_NULL         0               /* Marks end of dynamic section */
+#define DT_NEEDED       1               /* Name of needed library */
+#define DT_PLTRELSZ     2               /* Size in bytes of PLT relocs */
+#define DT_PLTGOT       3               /* Processor defined value */
+#define DT_HASH         4               /* Address of symbol hash table */
+#define DT_STRTAB       5               /* Address of string table */
+#define DT_SYMTAB       6               /* Address of symbol table */
+#define DT_RELA         7               /* Address of Rela relocs */
+#define DT_RELASZ       8               /* Total size of Rela relocs */
+#define DT_RELAENT      9               /* Size of one Rela reloc */
+#define DT_STRSZ        10              /* Size of string table */
+#define DT_SYMENT       11              /* Size of one symbol table entry */
+#define DT_INIT         12              /* Address of init function */
+#define DT_FINI         13              /* Address of termination function */
+#define DT_SONAME       14              /* Name of shared object */
+#define DT_RPATH        15              /* Library search path (deprecated) */
+#define DT_SYMBOLIC     16              /* Start symbol search here */
+#define DT_REL          17              /* Address of Rel relocs */
+#define DT_RELSZ        18              /* Total size of Rel relocs */
+#define DT_RELENT       19              /* Size of one Rel reloc */
+#define DT_PLTREL       20              /* Type of reloc in PLT */
+#define DT_DEBUG        21              /* For debugging; unspecified */
+#define DT_TEXTREL      22              /* Reloc might modify .text */
+#define DT_JMPREL       23              /* Address of PLT relocs */
+#define DT_BIND_NOW     24              /* Process relocations of object */
+#define DT_INIT_ARRAY   25              /* Array with addresses of init fct */
+#define DT_FINI_ARRAY   26              /* Array with addresses of fini fct */
+#define DT_INIT_ARRAYSZ 27              /* Size in bytes of DT_INIT_ARRAY */
+#define DT_FINI_ARRAYSZ 28              /* Size in bytes of DT_FINI_ARRAY */
+#define DT_RUNPATH      29              /* Library search path */
+#define DT_FLAGS        30              /* Flags for the object being loaded */
+#define DT_ENCODING     32              /* Start of encoded range */
+#define DT_PREINIT_ARRAY 32             /* Array with addresses of preinit fct*/
+#define DT_PREINIT_ARRAYSZ 33           /* size in bytes of DT_PREINIT_ARRAY */
+#define DT_NUM          34              /* Number used */
+#define DT_GNU_HASH     0x6ffffef5      /* GNU-style hash table.  */
+#define DT_VERSYM       0x6ffffff0
+#define DT_RELACOUNT    0x6ffffff9
+#define DT_RELCOUNT     0x6ffffffa
+#define DT_FLAGS_1      0x6ffffffb      /* State flags, see DF_1_* below.  */
+#define DT_VERDEF       0x6ffffffc      /* Address of version definition
+                                           table */
+#define DT_VERDEFNUM    0x6ffffffd      /* Number of version definitions */
+#define DT_VERNEED      0x6ffffffe      /* Address of table with needed
+                                           versions */
+#define DT_VERNEEDNUM   0x6fffffff      /* Number of needed versions */
+
+/* Note section contents.  Each entry in the note section begins with
+   a header of a fixed form.  */
+
+typedef struct
+{
+    Elf32_Word n_namesz;            /* Length of the note's name.  */
+    Elf32_Word n_descsz;            /* Length of the note's descriptor.  */
+    Elf32_Word n_type;              /* Type of the note.  */
+} Elf32_Nhdr;
+
+/* Note entries for GNU systems have this name.  */
+#define ELF_NOTE_GNU            "GNU"
+
+#define NT_GNU_ABI_TAG          1       /* ABI information */
+#define NT_GNU_HWCAP            2       /* Synthetic hwcap information */
+#define NT_GNU_BUILD_ID         3       /* Build ID bits as generated by
+                                           ld --build-id. */
+#define NT_GNU_GOLD_VERSION     4       /* Version note generated by GNU
+                                           gold containing a version
+                                           string.  */
+#define NT_GNU_PROPERTY_TYPE_0  5       /* Program property.  */
+
 #endif
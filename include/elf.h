@@ -1,8 +1,67 @@
 #ifndef _ELF_H
 #define _ELF_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <elf-in.h>
 
+/*
+ * elf file handle
+ * @filename: file name which handle was opened from.
+ * @map: read-only mapping of the whole file.
+ * @size: size of file (and mapping).
+ * @header: elf header on mapping.
+ * @section_table: section table on mapping, NULL if file hasn't one.
+ * @section_numbers: entries on section table.
+ * @shstrtab: section name string table on mapping.
+ * @shstrtab_size: size of section name string table.
+ * @program_table: program header table on mapping, NULL if file hasn't one.
+ * @program_numbers: entries on program header table.
+ * @borrowed: mapping isn't owned by handle, e.g. an archive member.
+ * @validated: every table, string table and section range has been
+ *             checked at open, accessors take their unchecked path.
+ * @dev: device of file, 0 for borrowed mappings.
+ * @ino: inode of file, 0 for borrowed mappings.
+ * @mtime: modification time of file in ns.
+ */
+struct elf_file {
+    const char    *filename;
+    unsigned char *map;
+    size_t        size;
+    Elf32_Ehdr    *header;
+    Elf32_Shdr    *section_table;
+    int           section_numbers;
+    const char    *shstrtab;
+    size_t        shstrtab_size;
+    Elf32_Phdr    *program_table;
+    int           program_numbers;
+    int           borrowed;
+    int           validated;
+    uint64_t      dev;
+    uint64_t      ino;
+    uint64_t      mtime;
+};
+
+#define ELF_STREAM_WINDOW    (64UL << 20)
+
+/*
+ * section read in windows
+ * @offset: offset of section on file.
+ * @size: size of section.
+ * @pos: bytes of section handed out so far.
+ * @window: bytes per window.
+ * @map: current window mapping, page aligned.
+ */
+struct elf_section_stream {
+    int      fd;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t pos;
+    size_t   window;
+    void     *map;
+    size_t   map_size;
+};
+
 /*  elf file class */
 extern int elf_header_file_class(Elf32_Ehdr *elf);
 
@@ -82,4 +141,64 @@ extern char *elf_section_name_alloc(const char *filename, Elf32_Shdr *st);
 /* free section name */
 extern void elf_section_name_free(void *name);
 
+/* alloc elf file handle */
+extern struct elf_file *elf_file_alloc(const char *filename);
+
+/* open section for reading in windows */
+extern struct elf_section_stream *elf_section_stream_alloc(
+      const char *filename, Elf32_Shdr *st, size_t window);
+
+/* next window of section, NULL at end */
+extern const void *elf_section_stream_next(struct elf_section_stream *s,
+      size_t *len);
+
+/* close section stream */
+extern void elf_section_stream_free(struct elf_section_stream *s);
+
+/* elf file handle of an opened file */
+extern struct elf_file *elf_file_alloc_fd(const char *filename, int fd,
+      uint64_t size, uint64_t dev, uint64_t ino, uint64_t mtime);
+
+/* alloc elf file handle on memory mapped by caller */
+extern struct elf_file *elf_file_alloc_mem(const char *filename,
+      const void *map, size_t size);
+
+/* free elf file handle */
+extern void elf_file_free(struct elf_file *ef);
+
+/* get section header from file handle */
+extern Elf32_Shdr *elf_file_section(struct elf_file *ef, int index);
+
+/* get section name from file handle */
+extern const char *elf_file_section_name(struct elf_file *ef, Elf32_Shdr *st);
+
+/* get section contents from file handle */
+extern const void *elf_file_section_contents(struct elf_file *ef,
+      Elf32_Shdr *st);
+
+/* get program header from file handle */
+extern Elf32_Phdr *elf_file_program_header(struct elf_file *ef, int index);
+
+/* find first section of type from file handle */
+extern Elf32_Shdr *elf_file_section_by_type(struct elf_file *ef,
+      Elf32_Word type);
+
+/* find section by name from file handle */
+extern Elf32_Shdr *elf_file_section_by_name(struct elf_file *ef,
+      const char *name);
+
+/* GNU build-id of file, returns its length or 0 */
+extern int elf_file_build_id(struct elf_file *ef, const unsigned char **id);
+
+/* number of symbols on symbol table */
+extern int elf_file_symbol_numbers(struct elf_file *ef, Elf32_Shdr *symtab);
+
+/* get symbol from symbol table */
+extern Elf32_Sym *elf_file_symbol(struct elf_file *ef, Elf32_Shdr *symtab,
+      int index);
+
+/* get symbol name from string table of symbol table */
+extern const char *elf_file_symbol_name(struct elf_file *ef,
+      Elf32_Shdr *symtab, Elf32_Sym *sym);
+
 #endif
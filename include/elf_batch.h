@@ -0,0 +1,78 @@
+#ifndef _ELF_BATCH_H
+#define _ELF_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <elf.h>
+
+/* I/O backends */
+#define ELF_BATCH_AUTO         0    /* io_uring if kernel allows, else pread */
+#define ELF_BATCH_URING        1
+#define ELF_BATCH_PREAD        2
+
+#define ELF_BATCH_DEPTH        256  /* files opened and read at once */
+#define ELF_BATCH_HEADER_SIZE  4096 /* bytes read from start of file */
+
+/*
+ * one file of a batch, valid during callback only
+ * @filename: file name.
+ * @fd: open descriptor, -1 if open failed.
+ * @err: errno if file couldn't be opened or read.
+ * @size: size of file.
+ * @dev: device of file.
+ * @ino: inode of file.
+ * @mtime: modification time in ns.
+ * @header: first bytes of file.
+ * @header_size: bytes on @header.
+ * @buf: scratch for section table and section names.
+ * @buf_size: bytes last read into @buf.
+ */
+struct elf_batch_file {
+    const char    *filename;
+    int           fd;
+    int           err;
+    uint64_t      size;
+    uint64_t      dev;
+    uint64_t      ino;
+    uint64_t      mtime;
+    unsigned char *header;
+    size_t        header_size;
+    unsigned char *buf;
+    size_t        buf_size;
+    size_t        buf_max;
+};
+
+struct elf_uring;
+
+/*
+ * batch loader, files are opened and the parts every tool reads
+ * first - header, section table, section names - are read for up to
+ * @depth files at once before any of them is handed out.
+ * @backend: ELF_BATCH_URING or ELF_BATCH_PREAD, as resolved.
+ */
+struct elf_batch {
+    int                   backend;
+    int                   depth;
+    struct elf_uring      *ring;
+    struct elf_batch_file *files;
+    unsigned char         *headers;
+};
+
+/* batch loader on given backend */
+extern struct elf_batch *elf_batch_alloc(int backend, int depth);
+
+/* free batch loader */
+extern void elf_batch_free(struct elf_batch *b);
+
+/* backend name, for diagnostics */
+extern const char *elf_batch_backend_name(struct elf_batch *b);
+
+/* load files and call function on each of them in order */
+extern void elf_batch_run(struct elf_batch *b, const char **filenames,
+      int numbers, void (*fn)(struct elf_batch_file *bf, int index,
+      void *data), void *data);
+
+/* elf file handle of batch file, usable after callback */
+extern struct elf_file *elf_batch_elf(struct elf_batch_file *bf);
+
+#endif
@@ -3,6 +3,25 @@
  * objdump Configuration
  */
 #define CONFIG_OBJDUMP 1
+#define CONFIG_SIZE 1
+#define CONFIG_NM 1
+#define CONFIG_ADDR2LINE 1
+#define CONFIG_MICROBENCH 1
 #define CONFIG_ELF_API 1
 #define CONFIG_XMALLOC 1
+#define CONFIG_RADIX_SORT 1
+#define CONFIG_DEMANGLE 1
+#define CONFIG_DWARF 1
+#define CONFIG_SYMBOLIZE 1
+#define CONFIG_ARCHIVE 1
+#define CONFIG_METACACHE 1
+#define CONFIG_JSON 1
+#define CONFIG_COLUMNAR 1
+#define CONFIG_ELF_BATCH 1
+#define CONFIG_STATS 1
+#define CONFIG_HASH 1
+#define CONFIG_SIZE_PROFILE 1
+#define CONFIG_RING 1
+#define CONFIG_TRACE 1
+#define CONFIG_ENABLE_LOGGING 1
 #define CONFIG_CROSS_COMPILE ""
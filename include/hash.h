@@ -0,0 +1,23 @@
+#ifndef _HASH_H
+#define _HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_SHA256_SIZE   32    /* bytes of SHA-256 digest */
+
+/*
+ * XXH3 64 bit hash with seed 0, same value as xxhsum -H3. Fast, not
+ * for use against an adversary.
+ */
+extern uint64_t hash_xxh3(const void *data, size_t len);
+
+/* SHA-256 digest of data */
+extern void hash_sha256(const void *data, size_t len,
+      unsigned char digest[HASH_SHA256_SIZE]);
+
+/* names of kernels picked for this CPU, "scalar", "sse2", "avx2", "sha" */
+extern const char *hash_xxh3_kernel(void);
+extern const char *hash_sha256_kernel(void);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _JSON_H
+#define _JSON_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_BUFFER_SIZE    (64 * 1024)
+
+/*
+ * streaming writer of newline delimited JSON objects. Nothing is
+ * kept once written, fields go straight into the output buffer.
+ * @fp: output stream, written in JSON_BUFFER_SIZE chunks.
+ * @fields: fields written to current object.
+ */
+struct json_writer {
+    FILE   *fp;
+    char   *buf;
+    size_t len;
+    int    fields;
+};
+
+/* writer on stream */
+extern struct json_writer *json_writer_alloc(FILE *fp);
+
+/* flush and free writer */
+extern void json_writer_free(struct json_writer *w);
+
+/* write out buffered output */
+extern void json_flush(struct json_writer *w);
+
+/* start object */
+extern void json_begin(struct json_writer *w);
+
+/* end object and line */
+extern void json_end(struct json_writer *w);
+
+/* string field, NULL is written as null */
+extern void json_str(struct json_writer *w, const char *key,
+      const char *value);
+
+/* string field of given length */
+extern void json_strn(struct json_writer *w, const char *key,
+      const char *value, size_t len);
+
+/* unsigned number field */
+extern void json_u64(struct json_writer *w, const char *key, uint64_t value);
+
+/* signed number field */
+extern void json_i64(struct json_writer *w, const char *key, int64_t value);
+
+/* boolean field */
+extern void json_bool(struct json_writer *w, const char *key, int value);
+
+/* string field of bytes as lowercase hex digits */
+extern void json_hex(struct json_writer *w, const char *key,
+      const unsigned char *data, size_t len);
+
+#endif
@@ -6,11 +6,31 @@
 #define LOG_LEVEL_INFO     2
 #define LOG_LEVEL_DEBUG    3
 
+#define LOG_RING_SIZE      (256 * 1024)    /* bytes of messages per thread */
+#define LOG_RECORD_MAX     4096            /* largest encoded message */
 
-void print_log(int level, const char *function, const char *format, ...);
+/* messages above this level are dropped where they are logged */
+extern int log_level;
+
+/*
+ * format is kept by pointer and formatted later on the log thread, it
+ * must stay valid - a string literal, as the macros below pass.
+ */
+void print_log(int level, const char *function, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+/* set level, UTILSE_LOG=error|warning|info|debug sets it at start */
+void log_set_level(int level);
+
+/* wait until messages logged so far are written */
+void log_flush(void);
 
 #ifdef CONFIG_ENABLE_LOGGING
-#define _print_log(level, ...) print_log(level, __FUNCTION__, __VA_ARGS__)
+#define _print_log(level, ...) \
+    do { \
+        if ((level) <= log_level) \
+            print_log(level, __FUNCTION__, __VA_ARGS__); \
+    } while (0)
 #else
 #define _print_log(level, ...) do {} while(0)
 #endif
@@ -0,0 +1,132 @@
+#ifndef _METACACHE_H
+#define _METACACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <elf.h>
+#include <dwarf.h>
+
+#define METACACHE_MAGIC        "ELFMETA2"
+
+/* blob tags */
+#define METACACHE_NAME_ORDER   1    /* uint32_t .symtab indexes by name */
+#define METACACHE_FUNC_LOW     2    /* uint64_t function addresses */
+#define METACACHE_FUNC_INDEX   3    /* uint32_t function symbol indexes */
+#define METACACHE_LINE_CUS     4    /* struct metacache_line_cu[] */
+#define METACACHE_LINE_FILES   5    /* struct metacache_line_file[] */
+#define METACACHE_LINE_ROWS    6    /* struct dwarf_line_row[] */
+#define METACACHE_LINE_SEQS    7    /* struct metacache_line_seq[] */
+#define METACACHE_DYN_ORDER    8    /* uint32_t .dynsym indexes by name */
+
+/*
+ * header of cache entry file, followed by blobs and the blob table.
+ * Blobs are 8-byte aligned, so arrays are used straight from the
+ * mapping.
+ * @file_size: size of ELF file entry was built from.
+ * @mtime: modification time in ns, only checked with @by_inode.
+ * @blob_table: offset of blob table, written last.
+ * @by_inode: entry is keyed by inode, file has no build-id.
+ */
+struct metacache_header {
+    char     magic[8];
+    uint64_t file_size;
+    uint64_t mtime;
+    uint64_t blob_table;
+    uint32_t by_inode;
+    uint32_t blob_numbers;
+};
+
+struct metacache_blob {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/*
+ * line table records, strings are offsets on the ELF mapping and
+ * UINT64_MAX stands for NULL.
+ */
+struct metacache_line_cu {
+    uint64_t offset;
+    uint64_t row_first;
+    uint32_t row_numbers;
+    uint32_t file_first;
+    uint32_t file_numbers;
+    uint32_t version;
+};
+
+struct metacache_line_file {
+    uint64_t name;
+    uint64_t dir;
+};
+
+struct metacache_line_seq {
+    uint64_t low;
+    uint64_t high;
+    uint32_t cu;
+    int32_t  first;
+    int32_t  last;
+    uint32_t reserved;
+};
+
+/*
+ * mapped cache entry of one ELF file
+ */
+struct metacache {
+    unsigned char           *map;
+    size_t                  size;
+    struct metacache_header *header;
+    struct metacache_blob   *blobs;
+};
+
+/*
+ * cache entry being written, it replaces the old entry on commit.
+ */
+struct metacache_writer {
+    FILE                    *fp;
+    char                    *path;
+    char                    *tmp;
+    struct metacache_header header;
+    struct metacache_blob   *blobs;
+    int                     blob_max;
+    uint64_t                pos;
+};
+
+/* map cache entry of ELF file, NULL on miss */
+extern struct metacache *metacache_alloc(const char *dir,
+      struct elf_file *ef);
+
+/* unmap cache entry */
+extern void metacache_free(struct metacache *mc);
+
+/* contents of blob, NULL if entry hasn't one */
+extern const void *metacache_blob(struct metacache *mc, uint32_t tag,
+      uint64_t *size);
+
+/* start a new cache entry of ELF file, NULL on error */
+extern struct metacache_writer *metacache_writer_alloc(const char *dir,
+      struct elf_file *ef);
+
+/* start blob, following appends go into it */
+extern void metacache_begin(struct metacache_writer *w, uint32_t tag);
+
+/* append data to current blob */
+extern void metacache_append(struct metacache_writer *w, const void *data,
+      uint64_t size);
+
+/* copy blobs of old entry writer hasn't got */
+extern void metacache_copy(struct metacache_writer *w, struct metacache *mc);
+
+/* write blob table and publish entry, frees writer */
+extern int metacache_commit(struct metacache_writer *w);
+
+/* store decoded line tables */
+extern void metacache_save_lines(struct metacache_writer *w,
+      struct elf_file *ef, struct dwarf_line *dl);
+
+/* line tables from cache entry, rows stay on its mapping */
+extern struct dwarf_line *metacache_load_lines(struct metacache *mc,
+      struct elf_file *ef);
+
+#endif
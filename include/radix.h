@@ -0,0 +1,10 @@
+#ifndef _RADIX_H
+#define _RADIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* LSD radix sort of 64-bit keys carrying a 32-bit payload */
+extern void radix_sort_u64(uint64_t *keys, uint32_t *vals, size_t n);
+
+#endif
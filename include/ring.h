@@ -0,0 +1,83 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define RING_RECORD_MAX    (64 * 1024)  /* largest record */
+#define RING_DRAIN_NS      1000000      /* drain thread polls every ms */
+
+struct ring_set;
+
+/*
+ * byte ring of one thread, records are appended by the owner and
+ * taken by the drain thread of the set.
+ * @head: bytes ever written, only moved by owner.
+ * @tail: bytes ever read, only moved by drain thread.
+ * @pending: bytes of record reserved but not committed.
+ * @waits: times the owner waited for room.
+ * @id: number of ring on set, from 0.
+ * @used: owned by a live thread.
+ * @main: owned by the thread which allocated the set.
+ */
+struct ring {
+    char            *buf;
+    uint64_t        head;
+    uint64_t        tail;
+    size_t          pending;
+    uint64_t        waits;
+    int             id;
+    int             used;
+    int             main;
+    struct ring     *next;
+    struct ring_set *set;
+};
+
+/*
+ * rings of all threads and the thread draining them
+ * @size: bytes per ring, power of two.
+ * @fn: called on drain thread for every record, in order per ring.
+ * @idle: called on drain thread when rings ran empty, may be NULL.
+ * @record: scratch of drain thread, records are copied out of ring.
+ */
+struct ring_set {
+    size_t        size;
+    struct ring   *rings;
+    int           ring_numbers;
+    int           stop;
+    pthread_key_t key;
+    pthread_t     owner;
+    pthread_t     thread;
+    void          (*fn)(struct ring *r, const void *record, size_t len,
+                        void *data);
+    void          (*idle)(void *data);
+    void          *data;
+    char          *record;
+};
+
+/* set of rings with running drain thread */
+extern struct ring_set *ring_set_alloc(size_t size,
+      void (*fn)(struct ring *r, const void *record, size_t len, void *data),
+      void (*idle)(void *data), void *data);
+
+/* drain all records and stop drain thread */
+extern void ring_set_stop(struct ring_set *s);
+
+/* free stopped set and its rings */
+extern void ring_set_free(struct ring_set *s);
+
+/* ring of calling thread */
+extern struct ring *ring_attach(struct ring_set *s);
+
+/* reserve record, waits for room */
+extern uint64_t ring_reserve(struct ring *r, size_t len);
+
+/* copy into reserved record */
+extern void ring_put(struct ring *r, uint64_t pos, const void *data,
+      size_t len);
+
+/* hand reserved record to drain thread */
+extern void ring_commit(struct ring *r);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef _SIZE_PROFILE_H
+#define _SIZE_PROFILE_H
+
+#include <stdint.h>
+#include <elf.h>
+
+/* what bytes are attributed to */
+#define SIZE_PROFILE_SECTIONS    0
+#define SIZE_PROFILE_SYMBOLS     1
+#define SIZE_PROFILE_UNITS       2    /* DWARF compile units */
+
+/*
+ * bytes attributed to one name. Bytes no symbol or unit covers go
+ * to "[section NAME]", headers to "[ELF headers]" and file bytes
+ * outside every section to "[unmapped]".
+ * @name: points into the mapping, or owned if @owned.
+ * @file: bytes of file.
+ * @vm: bytes of memory image.
+ */
+struct size_profile_row {
+    const char *name;
+    uint64_t   file;
+    uint64_t   vm;
+    uint32_t   hash;
+    int        owned;
+};
+
+/*
+ * every byte of one ELF file attributed to rows
+ * @table: row index + 1 by name hash, 0 is an empty slot.
+ * @file: bytes of file, sum of @file of rows.
+ * @vm: bytes of memory image, sum of @vm of rows.
+ */
+struct size_profile {
+    struct elf_file         *ef;
+    int                     source;
+    struct size_profile_row *rows;
+    int                     row_numbers;
+    int                     row_max;
+    int                     *table;
+    int                     table_size;
+    uint64_t                file;
+    uint64_t                vm;
+};
+
+/* attribute bytes of ELF file, which must outlive the profile */
+extern struct size_profile *size_profile_alloc(struct elf_file *ef,
+      int source);
+
+/* free profile, not the ELF file */
+extern void size_profile_free(struct size_profile *p);
+
+/* row of name, -1 if profile has none */
+extern int size_profile_find(struct size_profile *p, const char *name);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* phases of a run, time is kept per phase */
+#define STATS_OPEN         0    /* open, stat, magic read and mmap */
+#define STATS_HEADER       1    /* ELF header and table placement */
+#define STATS_SECTIONS     2    /* section and segment table checks */
+#define STATS_STRINGS      3    /* string table checks */
+#define STATS_SYMBOLS      4    /* walking and printing symbol tables */
+#define STATS_DWARF        5    /* decoding DWARF */
+#define STATS_FORMAT       6    /* all other dumping */
+#define STATS_HASH         7    /* hashing section contents */
+#define STATS_OUTPUT       8    /* writing output */
+#define STATS_PHASES       9
+
+/* counters */
+#define STATS_FILES        0    /* input files and archive members */
+#define STATS_OPENS        1
+#define STATS_MMAPS        2
+#define STATS_MAPPED       3    /* bytes mapped */
+#define STATS_ALLOCS       4    /* xmalloc() calls */
+#define STATS_ALLOCATED    5    /* bytes asked of xmalloc() */
+#define STATS_TOUCHED      6    /* bytes of mappings faulted in */
+#define STATS_COUNTERS     7
+
+/*
+ * start of a phase on the calling thread.
+ * @nested: time of phases ended inside this one so far, which is
+ *          taken off this phase.
+ */
+struct stats_clock {
+    uint64_t wall;
+    uint64_t cpu;
+    uint64_t nested_wall;
+    uint64_t nested_cpu;
+};
+
+#ifdef CONFIG_STATS
+extern int stats_enabled;
+
+/* start keeping statistics */
+extern void stats_enable(void);
+
+/* stream on descriptor whose writes are timed as STATS_OUTPUT */
+extern FILE *stats_stream(int fd);
+
+/* print statistics */
+extern void stats_report(FILE *fp, const char *tool);
+
+extern void __stats_begin(struct stats_clock *c);
+extern void __stats_end(struct stats_clock *c, int phase);
+extern void __stats_add(int counter, uint64_t n);
+extern void __stats_unmap(const void *map, size_t size);
+
+#define stats_begin(c) \
+    do { if (stats_enabled) __stats_begin(c); } while (0)
+#define stats_end(c, phase) \
+    do { if (stats_enabled) __stats_end(c, phase); } while (0)
+#define stats_add(counter, n) \
+    do { if (stats_enabled) __stats_add(counter, n); } while (0)
+/* call before munmap() of a file mapping, counts what was touched */
+#define stats_unmap(map, size) \
+    do { if (stats_enabled) __stats_unmap(map, size); } while (0)
+#else
+#define stats_begin(c) do { (void)(c); } while (0)
+#define stats_end(c, phase) do { (void)(c); } while (0)
+#define stats_add(counter, n) do {} while (0)
+#define stats_unmap(map, size) do {} while (0)
+#endif
+
+#endif
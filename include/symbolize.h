@@ -0,0 +1,62 @@
+#ifndef _SYMBOLIZE_H
+#define _SYMBOLIZE_H
+
+#include <stdint.h>
+#include <elf.h>
+#include <dwarf.h>
+#include <metacache.h>
+
+/*
+ * one source frame of an address, strings point into the mapping.
+ * @function: symbol name as found, NULL if unknown.
+ * @comp_dir: compilation directory of unit, NULL if unknown.
+ * @dir: directory of line table file entry, NULL if none.
+ * @file: file name, NULL if address has no line.
+ * @line: line number, 0 if unknown.
+ * @discriminator: block of line, 0 if line has one.
+ */
+struct symbolize_frame {
+    const char *function;
+    const char *comp_dir;
+    const char *dir;
+    const char *file;
+    uint32_t   line;
+    uint32_t   discriminator;
+};
+
+/*
+ * Symbol and line indexes of one mapped binary, built once and kept
+ * for as many lookups as the caller wants.
+ * @funcs: defined function symbols ordered by address.
+ * @build_id: hex build-id, "" if binary has none.
+ * @cache: metadata cache entry @funcs, @func_low and line rows were
+ *         loaded from, NULL if they were built.
+ */
+struct symbolizer {
+    struct elf_file   *ef;
+    struct dwarf_line *line;
+    struct dwarf_info *info;
+    Elf32_Shdr        *symtab;
+    uint64_t          *func_low;
+    uint32_t          *funcs;
+    int               func_numbers;
+    char              *build_id;
+    struct metacache  *cache;
+};
+
+/* map binary and build or load its indexes, NULL on error */
+extern struct symbolizer *symbolizer_alloc(const char *filename,
+      const char *cache_dir);
+
+/* unmap binary and free its indexes */
+extern void symbolizer_free(struct symbolizer *s);
+
+/* frames of address, returns number of frames filled */
+extern int symbolizer_lookup(struct symbolizer *s, uint64_t address,
+      struct symbolize_frame *frames, int max);
+
+/* full path of frame's file into buffer */
+extern const char *symbolize_path(struct symbolize_frame *frame, char *buf,
+      size_t size);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+/* categories of spans */
+#define TRACE_FILE         0    /* one input file or archive member */
+#define TRACE_PHASE        1    /* one phase of stats.h */
+#define TRACE_IO           2    /* batched opens and reads */
+#define TRACE_CATEGORIES   3
+
+#define TRACE_RING_SIZE    (1 << 20)    /* bytes of events per thread */
+
+/*
+ * start of a span on the calling thread
+ */
+struct trace_clock {
+    uint64_t begin;
+};
+
+#ifdef CONFIG_TRACE
+extern int trace_enabled;
+
+/* start writing spans of all threads to file */
+extern int trace_open(const char *filename);
+
+/* write out remaining spans and close file */
+extern int trace_close(void);
+
+extern void __trace_begin(struct trace_clock *t);
+extern void __trace_span(int cat, const char *name, const char *archive,
+      uint64_t begin, uint64_t end);
+extern void __trace_end(struct trace_clock *t, int cat, const char *name,
+      const char *archive);
+
+#define trace_begin(t) \
+    do { if (trace_enabled) __trace_begin(t); } while (0)
+#define trace_end(t, cat, name, archive) \
+    do { if (trace_enabled) __trace_end(t, cat, name, archive); } while (0)
+#else
+#define trace_begin(t) do { (void)(t); } while (0)
+#define trace_end(t, cat, name, archive) do { (void)(t); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,756 @@
+/*
+ * ar archive
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <xmalloc.h>
+#include <archive.h>
+#include <stats.h>
+#include <log.h>
+
+/* ---------------------------------------
+ *   "!<arch>\n"
+ *   header "/"          GNU symbol index, "/SYM64/" for 64-bit
+ *   header "//"         GNU long name table
+ *   header "name/"      member, "/N" names offset N on long names
+ *   ...
+ *
+ *   BSD archives carry their index as "__.SYMDEF" and put long
+ *   names as "#1/N" right in front of member contents.
+ *
+ *   "!<thin>\n" archives have the same headers but keep no member
+ *   contents, member names are paths relative to the archive.
+ * ---------------------------------------
+ */
+
+/*
+ * ASCII number of header field, fields are padded with spaces.
+ * @base: 10, or 8 for mode.
+ */
+static uint64_t archive_field(const char *p, int len, int base)
+{
+    uint64_t val = 0;
+    int i;
+
+    for (i = 0; i < len && p[i] >= '0' && p[i] < '0' + base; i++)
+        val = val * base + p[i] - '0';
+    return val;
+}
+
+static uint32_t archive_be32(const unsigned char *p)
+{
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static uint64_t archive_be64(const unsigned char *p)
+{
+    return (uint64_t)archive_be32(p) << 32 | archive_be32(p + 4);
+}
+
+static uint64_t archive_le(const unsigned char *p, int size)
+{
+    uint64_t val = 0;
+
+    while (size--)
+        val = val << 8 | p[size];
+    return val;
+}
+
+static void *archive_grow(void *array, int *max, int need, size_t size)
+{
+    void *tmp;
+    int n;
+
+    if (need <= *max)
+        return array;
+    n = *max ? *max * 2 : 64;
+    while (n < need)
+        n *= 2;
+    tmp = xmalloc(size * n);
+    if (array) {
+        memcpy(tmp, array, size * *max);
+        xfree(array);
+    }
+    *max = n;
+    return tmp;
+}
+
+/*
+ * state of one pass over archive headers
+ * @armap: contents of symbol index member, NULL if none.
+ * @armap_kind: 32 or 64 for GNU index, -32 or -64 for BSD one.
+ * @longnames: contents of GNU long name table.
+ */
+struct archive_reader {
+    struct archive      *ar;
+    int                 member_max;
+    size_t              names_size;
+    size_t              names_max;
+    const unsigned char *armap;
+    uint64_t            armap_size;
+    int                 armap_kind;
+    const char          *longnames;
+    uint64_t            longnames_size;
+};
+
+/*
+ * Append name to name storage.
+ * @return: offset of name on storage.
+ */
+static size_t archive_add_name(struct archive_reader *r, const char *name,
+                               size_t len)
+{
+    struct archive *ar = r->ar;
+    size_t offset = r->names_size;
+
+    if (r->names_size + len + 1 > r->names_max) {
+        size_t n = r->names_max ? r->names_max * 2 : 4096;
+        char *tmp;
+
+        while (n < r->names_size + len + 1)
+            n *= 2;
+        tmp = xmalloc(n);
+        if (ar->names) {
+            memcpy(tmp, ar->names, r->names_size);
+            xfree(ar->names);
+        }
+        ar->names = tmp;
+        r->names_max = n;
+    }
+    memcpy(ar->names + offset, name, len);
+    ar->names[offset + len] = 0;
+    r->names_size += len + 1;
+    return offset;
+}
+
+/*
+ * Name of member from its header. BSD long names are stored in
+ * front of member contents, which are skipped here.
+ * @return: 0 if header names a member, -1 on broken name.
+ */
+static int archive_member_name(struct archive_reader *r,
+                               struct archive_header *hdr,
+                               uint64_t *offset, uint64_t *size,
+                               const char **name, size_t *len)
+{
+    const char *p = hdr->name;
+    size_t n;
+
+    if (p[0] == '/' && p[1] >= '0' && p[1] <= '9') {
+        /* GNU "/N", name ends with "/\n" on long name table */
+        uint64_t at = archive_field(p + 1, 15, 10);
+
+        if (!r->longnames || at >= r->longnames_size)
+            return -1;
+        *name = r->longnames + at;
+        for (n = 0; at + n < r->longnames_size && (*name)[n] != '\n'; n++)
+            ;
+        if (n && (*name)[n - 1] == '/')
+            n--;
+        *len = n;
+        return 0;
+    }
+    if (!memcmp(p, "#1/", 3)) {
+        /* BSD "#1/N", N bytes of NUL padded name lead contents */
+        uint64_t size_name = archive_field(p + 3, 13, 10);
+
+        if (size_name > *size)
+            return -1;
+        *name = (const char *)r->ar->map + *offset;
+        *len = strnlen(*name, size_name);
+        *offset += size_name;
+        *size -= size_name;
+        return 0;
+    }
+    /* short name, "/" terminated (GNU) or space padded (BSD) */
+    for (n = 0; n < sizeof(hdr->name) && p[n] != '/'; n++)
+        ;
+    if (n == sizeof(hdr->name))
+        while (n && p[n - 1] == ' ')
+            n--;
+    *name = p;
+    *len = n;
+    return 0;
+}
+
+/*
+ * Add member to member table.
+ */
+static void archive_add_member(struct archive_reader *r,
+                               struct archive_header *hdr, uint64_t pos,
+                               uint64_t offset, uint64_t size,
+                               const char *name, size_t len)
+{
+    struct archive *ar = r->ar;
+    struct archive_member *m;
+
+    ar->members = archive_grow(ar->members, &r->member_max,
+                               ar->member_numbers + 1,
+                               sizeof(struct archive_member));
+    m = &ar->members[ar->member_numbers++];
+    /* name offset until name storage stops moving */
+    m->name = (const char *)(uintptr_t)archive_add_name(r, name, len);
+    m->header = pos;
+    m->offset = offset;
+    m->size = size;
+    m->date = archive_field(hdr->date, sizeof(hdr->date), 10);
+    m->uid = archive_field(hdr->uid, sizeof(hdr->uid), 10);
+    m->gid = archive_field(hdr->gid, sizeof(hdr->gid), 10);
+    m->mode = archive_field(hdr->mode, sizeof(hdr->mode), 8);
+}
+
+/*
+ * Add member of thin archive, named by its path relative to working
+ * directory like GNU binutils do.
+ */
+static void archive_add_thin_member(struct archive_reader *r,
+                                    struct archive_header *hdr, uint64_t pos,
+                                    uint64_t size, const char *name,
+                                    size_t len)
+{
+    const char *filename = r->ar->filename;
+    const char *slash = strrchr(filename, '/');
+    char path[PATH_MAX];
+    int n;
+
+    if (name[0] != '/' && slash) {
+        n = snprintf(path, sizeof(path), "%.*s/%.*s",
+                     (int)(slash - filename), filename, (int)len, name);
+        name = path;
+        len = n < (int)sizeof(path) ? n : (int)sizeof(path) - 1;
+    }
+    archive_add_member(r, hdr, pos, 0, size, name, len);
+}
+
+/*
+ * Walk member headers and build member table.
+ */
+static void archive_read_members(struct archive_reader *r)
+{
+    struct archive *ar = r->ar;
+    uint64_t pos = ARCHIVE_MAGIC_SIZE;
+    int i;
+
+    while (pos + sizeof(struct archive_header) <= ar->size) {
+        struct archive_header *hdr = (struct archive_header *)(ar->map + pos);
+        uint64_t offset = pos + sizeof(struct archive_header);
+        uint64_t size = archive_field(hdr->size, sizeof(hdr->size), 10);
+        int special = !memcmp(hdr->name, "/ ", 2) ||
+                      !memcmp(hdr->name, "/SYM64/", 7) ||
+                      !memcmp(hdr->name, "// ", 3);
+        const char *name;
+        size_t len;
+
+        if (memcmp(hdr->fmag, "`\n", 2))
+            break;
+        if (ar->thin && !special) {
+            /* contents of thin members stay in their own files */
+            if (!archive_member_name(r, hdr, &offset, &size, &name, &len))
+                archive_add_thin_member(r, hdr, pos, size, name, len);
+            pos = offset;
+            continue;
+        }
+        if (size > ar->size - offset)
+            break;
+
+        if (special && hdr->name[1] != '/') {
+            if (!r->armap) {
+                r->armap = ar->map + offset;
+                r->armap_size = size;
+                r->armap_kind = hdr->name[1] == ' ' ? 32 : 64;
+            }
+        } else if (special) {
+            r->longnames = (const char *)ar->map + offset;
+            r->longnames_size = size;
+        } else if (!archive_member_name(r, hdr, &offset, &size,
+                                        &name, &len)) {
+            if (len >= 9 && !memcmp(name, "__.SYMDEF", 9)) {
+                if (!r->armap) {
+                    r->armap = ar->map + offset;
+                    r->armap_size = size;
+                    r->armap_kind = len >= 12 &&
+                                    !memcmp(name + 9, "_64", 3) ? -64 : -32;
+                }
+            } else {
+                archive_add_member(r, hdr, pos, offset, size, name, len);
+            }
+        }
+        /* members are 2-byte aligned */
+        pos = offset + size;
+        pos += pos & 1;
+    }
+    for (i = 0; i < ar->member_numbers; i++)
+        ar->members[i].name = ar->names + (uintptr_t)ar->members[i].name;
+}
+
+/*
+ * member whose header sits at offset.
+ * @return: index on member table, -1 if none.
+ */
+static int archive_member_at(struct archive *ar, uint64_t header)
+{
+    int lo = 0, hi = ar->member_numbers;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (ar->members[mid].header < header)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == ar->member_numbers || ar->members[lo].header != header)
+        return -1;
+    return lo;
+}
+
+/*
+ * Decode symbol index, entries naming no member are dropped.
+ */
+static void archive_read_armap(struct archive_reader *r)
+{
+    struct archive *ar = r->ar;
+    const unsigned char *p = r->armap;
+    uint64_t count, size = r->armap_size, strsize;
+    const char *strings;
+    int word = r->armap_kind < 0 ? -r->armap_kind / 8 : r->armap_kind / 8;
+    uint64_t i, at = 0;
+
+    if (r->armap_kind > 0) {
+        /* GNU: count, member offsets, NUL terminated names */
+        if (size < (uint64_t)word)
+            return;
+        count = word == 8 ? archive_be64(p) : archive_be32(p);
+        if (count > (size - word) / word)
+            return;
+        strings = (const char *)p + word + count * word;
+        strsize = size - word - count * word;
+    } else {
+        /* BSD: ranlib bytes, {name, member offset} pairs, names */
+        uint64_t ranlib;
+
+        if (size < (uint64_t)word)
+            return;
+        ranlib = archive_le(p, word);
+        if (ranlib > size - 2 * word)
+            return;
+        count = ranlib / (2 * word);
+        strsize = archive_le(p + word + ranlib, word);
+        strings = (const char *)p + 2 * word + ranlib;
+        if (strsize > size - 2 * word - ranlib)
+            return;
+    }
+
+    ar->symbols = xmalloc(sizeof(struct archive_symbol) * (count ? count : 1));
+    for (i = 0; i < count; i++) {
+        struct archive_symbol *sym = &ar->symbols[ar->symbol_numbers];
+        uint64_t header, name;
+        const char *end;
+
+        if (r->armap_kind > 0) {
+            const unsigned char *q = p + word + i * word;
+
+            header = word == 8 ? archive_be64(q) : archive_be32(q);
+            /* names follow each other in index order */
+            name = at;
+        } else {
+            const unsigned char *q = p + word + i * 2 * word;
+
+            name = archive_le(q, word);
+            header = archive_le(q + word, word);
+        }
+        if (name >= strsize)
+            break;
+        end = memchr(strings + name, 0, strsize - name);
+        if (!end)
+            break;
+        at = end - strings + 1;
+        sym->name = strings + name;
+        sym->member = archive_member_at(ar, header);
+        if (sym->member >= 0)
+            ar->symbol_numbers++;
+    }
+}
+
+/* (OK)
+ * check whether data read from start of a file is an archive.
+ * @data: first bytes of file.
+ * @size: number of bytes read.
+ *
+ * @return: 1 if @data starts an ar archive, thin or not, else 0.
+ */
+int archive_check_mem(const void *data, size_t size)
+{
+    return size >= ARCHIVE_MAGIC_SIZE &&
+           (!memcmp(data, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) ||
+            !memcmp(data, ARCHIVE_THIN_MAGIC, ARCHIVE_MAGIC_SIZE));
+}
+
+/* (OK)
+ * map archive and read its member table and symbol index.
+ * @filename: archive file name.
+ *
+ * @return: archive handle, NULL on failure with errno set, EINVAL
+ *          if file isn't an archive.
+ */
+struct archive *archive_alloc(const char *filename)
+{
+    struct stats_clock c;
+    struct archive *ar;
+    struct stat sb;
+    int fd;
+
+    stats_begin(&c);
+    stats_add(STATS_OPENS, 1);
+    fd = open(filename, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &sb) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    stats_end(&c, STATS_OPEN);
+    if (fd < 0)
+        return NULL;
+    ar = archive_alloc_fd(filename, fd, sb.st_size);
+    close(fd);
+    return ar;
+}
+
+/* (OK)
+ * map archive which caller has opened already, so a file whose magic
+ * was just read isn't opened again.
+ * @filename: archive file name.
+ * @fd: descriptor of archive, left open.
+ * @size: size of archive.
+ *
+ * @return: archive handle, NULL on failure with errno set, EINVAL
+ *          if file isn't an archive.
+ */
+struct archive *archive_alloc_fd(const char *filename, int fd, uint64_t size)
+{
+    struct archive_reader r;
+    struct stats_clock c;
+    struct archive *ar;
+    unsigned char *map;
+
+    if (size < ARCHIVE_MAGIC_SIZE) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (size > SIZE_MAX) {
+        errno = EFBIG;
+        return NULL;
+    }
+    stats_begin(&c);
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    stats_end(&c, STATS_OPEN);
+    if (map == MAP_FAILED)
+        return NULL;
+    stats_add(STATS_MMAPS, 1);
+    stats_add(STATS_MAPPED, size);
+    if (memcmp(map, ARCHIVE_MAGIC, ARCHIVE_MAGIC_SIZE) &&
+        memcmp(map, ARCHIVE_THIN_MAGIC, ARCHIVE_MAGIC_SIZE)) {
+        stats_unmap(map, size);
+        munmap(map, size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ar = xmalloc(sizeof(struct archive));
+    memset(ar, 0, sizeof(struct archive));
+    ar->filename = filename;
+    ar->map = map;
+    ar->size = size;
+    ar->thin = !memcmp(map, ARCHIVE_THIN_MAGIC, ARCHIVE_MAGIC_SIZE);
+
+    memset(&r, 0, sizeof(r));
+    r.ar = ar;
+    archive_read_members(&r);
+    if (r.armap)
+        archive_read_armap(&r);
+    print_dbg("%s: %d members, %d index symbols%s", filename,
+              ar->member_numbers, ar->symbol_numbers, ar->thin ? ", thin" : "");
+    return ar;
+}
+
+/* (OK)
+ * unmap archive and free handle.
+ * @ar: archive handle, member handles must be freed already.
+ */
+void archive_free(struct archive *ar)
+{
+    if (!ar)
+        return;
+    stats_unmap(ar->map, ar->size);
+    munmap(ar->map, ar->size);
+    xfree(ar->members);
+    xfree(ar->symbols);
+    xfree(ar->names);
+    xfree(ar->hash);
+    xfree(ar);
+}
+
+/*
+ * Files referenced by thin archives, mapped once per run however
+ * many archives list them. Entries are keyed by device and inode so
+ * different paths to one file share a mapping.
+ */
+struct archive_cache_entry {
+    dev_t                     dev;
+    ino_t                     ino;
+    unsigned char             *map;
+    size_t                    size;
+    struct archive_cache_entry *next;
+};
+
+#define ARCHIVE_CACHE_BUCKETS    4096
+
+static struct archive_cache_entry *archive_cache[ARCHIVE_CACHE_BUCKETS];
+static pthread_mutex_t archive_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Mapping of file from cache, file is mapped on first use.
+ * @return: 0 on success, -1 with errno set.
+ */
+static int archive_cache_map(const char *path, unsigned char **map,
+                             size_t *size)
+{
+    struct archive_cache_entry *entry;
+    struct stats_clock c;
+    struct stat sb;
+    int fd, bucket;
+
+    stats_begin(&c);
+    stats_add(STATS_OPENS, 1);
+    fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &sb) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    stats_end(&c, STATS_OPEN);
+    if (fd < 0)
+        return -1;
+    bucket = (sb.st_ino ^ sb.st_dev) % ARCHIVE_CACHE_BUCKETS;
+
+    pthread_mutex_lock(&archive_cache_lock);
+    for (entry = archive_cache[bucket]; entry; entry = entry->next)
+        if (entry->ino == sb.st_ino && entry->dev == sb.st_dev)
+            break;
+    if (!entry) {
+        unsigned char *p = MAP_FAILED;
+
+        stats_begin(&c);
+        if (sb.st_size)
+            p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        stats_end(&c, STATS_OPEN);
+        if (p == MAP_FAILED) {
+            pthread_mutex_unlock(&archive_cache_lock);
+            close(fd);
+            errno = EINVAL;
+            return -1;
+        }
+        stats_add(STATS_MMAPS, 1);
+        stats_add(STATS_MAPPED, sb.st_size);
+        entry = xmalloc(sizeof(struct archive_cache_entry));
+        entry->dev = sb.st_dev;
+        entry->ino = sb.st_ino;
+        entry->map = p;
+        entry->size = sb.st_size;
+        entry->next = archive_cache[bucket];
+        archive_cache[bucket] = entry;
+    }
+    *map = entry->map;
+    *size = entry->size;
+    pthread_mutex_unlock(&archive_cache_lock);
+    close(fd);
+    return 0;
+}
+
+/* (OK)
+ * unmap every file mapped for thin archive members.
+ * Member handles of thin archives must be freed already.
+ */
+void archive_cache_free(void)
+{
+    int i;
+
+    for (i = 0; i < ARCHIVE_CACHE_BUCKETS; i++) {
+        while (archive_cache[i]) {
+            struct archive_cache_entry *entry = archive_cache[i];
+
+            archive_cache[i] = entry->next;
+            stats_unmap(entry->map, entry->size);
+            munmap(entry->map, entry->size);
+            xfree(entry);
+        }
+    }
+}
+
+/* (OK)
+ * elf file handle of member, contents are read in place. Members of
+ * thin archives are mapped through the per-run file cache.
+ * @ar: archive handle.
+ * @index: index on member table.
+ *
+ * @return: elf file handle named after member, NULL with errno
+ *          EINVAL if member isn't an ELF32 object.
+ */
+struct elf_file *archive_member_elf(struct archive *ar, int index)
+{
+    struct archive_member *m;
+    unsigned char *map;
+    size_t size;
+
+    if (index < 0 || index >= ar->member_numbers) {
+        errno = EINVAL;
+        return NULL;
+    }
+    m = &ar->members[index];
+    if (ar->thin) {
+        if (archive_cache_map(m->name, &map, &size) < 0)
+            return NULL;
+    } else {
+        map = ar->map + m->offset;
+        size = m->size;
+    }
+    return elf_file_alloc_mem(m->name, map, size);
+}
+
+static uint32_t archive_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h;
+}
+
+/*
+ * Hash symbol index. Linear probing keeps equal names in index
+ * order, so a lookup finds the first definition like a linker.
+ */
+static void archive_hash_symbols(struct archive *ar)
+{
+    int i, size = 16;
+
+    while (size < ar->symbol_numbers * 2)
+        size *= 2;
+    ar->hash = xmalloc(sizeof(int) * size);
+    memset(ar->hash, 0, sizeof(int) * size);
+    ar->hash_size = size;
+    for (i = 0; i < ar->symbol_numbers; i++) {
+        uint32_t h = archive_hash(ar->symbols[i].name) & (size - 1);
+
+        while (ar->hash[h])
+            h = (h + 1) & (size - 1);
+        ar->hash[h] = i + 1;
+    }
+}
+
+/* (OK)
+ * member defining symbol, no member is parsed.
+ * @ar: archive handle.
+ * @name: symbol name.
+ *
+ * @return: index on member table, -1 if symbol index hasn't name.
+ *          First call hashes symbol index, so it is not thread-safe.
+ */
+int archive_lookup(struct archive *ar, const char *name)
+{
+    uint32_t h;
+
+    if (!ar->symbol_numbers)
+        return -1;
+    if (!ar->hash)
+        archive_hash_symbols(ar);
+    h = archive_hash(name) & (ar->hash_size - 1);
+    while (ar->hash[h]) {
+        struct archive_symbol *sym = &ar->symbols[ar->hash[h] - 1];
+
+        if (!strcmp(sym->name, name))
+            return sym->member;
+        h = (h + 1) & (ar->hash_size - 1);
+    }
+    return -1;
+}
+
+/*
+ * shared state of archive_for_each() workers
+ */
+struct archive_work {
+    struct archive *ar;
+    void           (*fn)(struct archive *ar, int index, void *data);
+    void           *data;
+    int            next;
+};
+
+static void *archive_worker(void *arg)
+{
+    struct archive_work *work = arg;
+    int index;
+
+    while ((index = __sync_fetch_and_add(&work->next, 1)) <
+           work->ar->member_numbers)
+        work->fn(work->ar, index, work->data);
+    return NULL;
+}
+
+/* (OK)
+ * run function on every member.
+ * @ar: archive handle.
+ * @jobs: number of threads, all online CPUs if 0 or less.
+ * @fn: called once per member index, from any thread and in no
+ *      particular order.
+ * @data: passed to @fn.
+ */
+void archive_for_each(struct archive *ar, int jobs,
+                      void (*fn)(struct archive *ar, int index, void *data),
+                      void *data)
+{
+    struct archive_work work;
+    pthread_t *threads;
+    int i, n;
+
+    work.ar = ar;
+    work.fn = fn;
+    work.data = data;
+    work.next = 0;
+
+    if (jobs <= 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs > ar->member_numbers)
+        jobs = ar->member_numbers;
+    if (jobs <= 1) {
+        archive_worker(&work);
+        return;
+    }
+
+    /* caller is one of the workers */
+    threads = xmalloc(sizeof(pthread_t) * (jobs - 1));
+    for (n = 0; n < jobs - 1; n++)
+        if (pthread_create(&threads[n], NULL, archive_worker, &work))
+            break;
+    archive_worker(&work);
+    for (i = 0; i < n; i++)
+        pthread_join(threads[i], NULL);
+    xfree(threads);
+}
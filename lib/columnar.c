@@ -0,0 +1,343 @@
+/*
+ * columnar binary export
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <xmalloc.h>
+#include <columnar.h>
+
+static const uint32_t columnar_widths[] = {
+    [COLUMNAR_U8]  = 1,
+    [COLUMNAR_U16] = 2,
+    [COLUMNAR_U32] = 4,
+    [COLUMNAR_U64] = 8,
+    [COLUMNAR_STR] = 4,
+};
+
+/*
+ * make room for @need bytes on a growable buffer.
+ */
+static void *columnar_grow(void *buf, size_t *max, size_t need)
+{
+    void *tmp;
+    size_t n;
+
+    if (need <= *max)
+        return buf;
+    n = *max ? *max * 2 : 4096;
+    while (n < need)
+        n *= 2;
+    tmp = xmalloc(n);
+    if (buf) {
+        memcpy(tmp, buf, *max);
+        xfree(buf);
+    }
+    *max = n;
+    return tmp;
+}
+
+static uint64_t columnar_hash(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (len--)
+        h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+    return h;
+}
+
+static void columnar_hash_grow(struct columnar *c)
+{
+    uint32_t *old = c->hash;
+    size_t i, old_size = c->hash_size;
+
+    c->hash_size = c->hash_size ? c->hash_size * 2 : 4096;
+    c->hash = xmalloc(sizeof(uint32_t) * c->hash_size);
+    memset(c->hash, 0, sizeof(uint32_t) * c->hash_size);
+    for (i = 0; i < old_size; i++) {
+        const char *s;
+        size_t j;
+
+        if (!old[i])
+            continue;
+        s = c->heap + old[i];
+        j = columnar_hash(s, strlen(s)) & (c->hash_size - 1);
+        while (c->hash[j])
+            j = (j + 1) & (c->hash_size - 1);
+        c->hash[j] = old[i];
+    }
+    xfree(old);
+}
+
+/*
+ * offset of string on heap, appending it on first use.
+ */
+static uint32_t columnar_intern(struct columnar *c, const char *s)
+{
+    size_t len, i;
+    uint64_t h;
+
+    if (!s || !*s)
+        return 0;
+    if (c->hash_used * 2 >= c->hash_size)
+        columnar_hash_grow(c);
+
+    len = strlen(s);
+    h = columnar_hash(s, len);
+    for (i = h & (c->hash_size - 1); c->hash[i];
+         i = (i + 1) & (c->hash_size - 1))
+        if (!strcmp(c->heap + c->hash[i], s))
+            return c->hash[i];
+
+    if (c->heap_size + len + 1 > UINT32_MAX) {
+        c->overflow = 1;
+        return 0;
+    }
+    c->heap = columnar_grow(c->heap, &c->heap_max, c->heap_size + len + 1);
+    memcpy(c->heap + c->heap_size, s, len + 1);
+    c->hash[i] = c->heap_size;
+    c->hash_used++;
+    c->heap_size += len + 1;
+    return c->hash[i];
+}
+
+/* (OK)
+ * empty export, the string heap starts with "".
+ *
+ * @return: export, NULL on failure.
+ */
+struct columnar *columnar_alloc(void)
+{
+    struct columnar *c;
+
+    c = xmalloc(sizeof(*c));
+    if (!c)
+        return NULL;
+    memset(c, 0, sizeof(*c));
+    c->heap = columnar_grow(NULL, &c->heap_max, 1);
+    c->heap[0] = '\0';
+    c->heap_size = 1;
+    return c;
+}
+
+/* (OK)
+ * free export and its tables.
+ * @c: export.
+ */
+void columnar_free(struct columnar *c)
+{
+    int i, j;
+
+    if (!c)
+        return;
+    for (i = 0; i < c->table_numbers; i++) {
+        struct columnar_table *t = c->tables[i];
+
+        for (j = 0; j < t->column_numbers; j++)
+            xfree(t->columns[j].data);
+        xfree(t->columns);
+        xfree(t);
+    }
+    xfree(c->tables);
+    xfree(c->heap);
+    xfree(c->hash);
+    xfree(c);
+}
+
+/* (OK)
+ * add table to export.
+ * @c: export.
+ * @name: table name, up to 15 characters.
+ * @columns: column names, NULL terminated.
+ * @types: column types, as many as @columns.
+ *
+ * @return: table, valid until columnar_free().
+ */
+struct columnar_table *columnar_table(struct columnar *c, const char *name,
+                                      const char **columns,
+                                      const uint32_t *types)
+{
+    struct columnar_table **tables, *t;
+    int i;
+
+    t = xmalloc(sizeof(*t));
+    memset(t, 0, sizeof(*t));
+    strncpy(t->name, name, COLUMNAR_NAME_SIZE - 1);
+    while (columns[t->column_numbers])
+        t->column_numbers++;
+    t->columns = xmalloc(sizeof(struct columnar_column) *
+                         (t->column_numbers ? t->column_numbers : 1));
+    memset(t->columns, 0, sizeof(struct columnar_column) * t->column_numbers);
+    for (i = 0; i < t->column_numbers; i++) {
+        strncpy(t->columns[i].name, columns[i], COLUMNAR_NAME_SIZE - 1);
+        t->columns[i].type = types[i];
+        t->columns[i].width = columnar_widths[types[i]];
+    }
+
+    tables = xmalloc(sizeof(*tables) * (c->table_numbers + 1));
+    if (c->tables) {
+        memcpy(tables, c->tables, sizeof(*tables) * c->table_numbers);
+        xfree(c->tables);
+    }
+    c->tables = tables;
+    c->tables[c->table_numbers++] = t;
+    return t;
+}
+
+/* (OK)
+ * append number to column, truncated to column width.
+ * @t: table.
+ * @column: column index.
+ * @value: number.
+ */
+void columnar_put(struct columnar_table *t, int column, uint64_t value)
+{
+    struct columnar_column *col = &t->columns[column];
+    unsigned char *p;
+
+    col->data = columnar_grow(col->data, &col->max, col->size + col->width);
+    p = col->data + col->size;
+    col->size += col->width;
+    switch (col->width) {
+    case 1:
+        *p = value;
+        break;
+    case 2:
+        *(uint16_t *)p = value;
+        break;
+    case 4:
+        *(uint32_t *)p = value;
+        break;
+    default:
+        *(uint64_t *)p = value;
+        break;
+    }
+}
+
+/* (OK)
+ * append string to column, the column stores its heap offset.
+ * @c: export.
+ * @t: table.
+ * @column: column index.
+ * @s: string, NULL is stored as "".
+ */
+void columnar_put_str(struct columnar *c, struct columnar_table *t,
+                      int column, const char *s)
+{
+    columnar_put(t, column, columnar_intern(c, s));
+}
+
+/*
+ * write length prefixed block padded to 8 bytes.
+ * @pos: file position, moved past block.
+ */
+static void columnar_block(FILE *fp, uint64_t *pos, const void *data,
+                           uint64_t size)
+{
+    static const char pad[8];
+
+    fwrite(&size, sizeof(size), 1, fp);
+    if (size)
+        fwrite(data, 1, size, fp);
+    fwrite(pad, 1, -size & 7, fp);
+    *pos += sizeof(size) + size + (-size & 7);
+}
+
+/* (OK)
+ * write export to file.
+ * @c: export.
+ * @filename: output file name.
+ *
+ * @return: 0 on success, -1 with errno set. EINVAL if columns of a
+ *          table differ in rows, EFBIG if strings outgrew the heap.
+ */
+int columnar_write(struct columnar *c, const char *filename)
+{
+    struct columnar_column_entry *entries;
+    struct columnar_header header;
+    uint32_t column_first = 0;
+    uint64_t pos;
+    int i, j, n = 0, ret = 0;
+    FILE *fp;
+
+    if (c->overflow) {
+        errno = EFBIG;
+        return -1;
+    }
+    for (i = 0; i < c->table_numbers; i++) {
+        struct columnar_table *t = c->tables[i];
+
+        for (j = 1; j < t->column_numbers; j++) {
+            if (t->columns[j].size / t->columns[j].width !=
+                t->columns[0].size / t->columns[0].width) {
+                errno = EINVAL;
+                return -1;
+            }
+        }
+        n += t->column_numbers;
+    }
+
+    fp = fopen(filename, "wb");
+    if (!fp)
+        return -1;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+    header.version = COLUMNAR_VERSION;
+    header.table_numbers = c->table_numbers;
+    fwrite(&header, sizeof(header), 1, fp);
+    pos = sizeof(header);
+
+    entries = xmalloc(sizeof(*entries) * (n ? n : 1));
+    memset(entries, 0, sizeof(*entries) * n);
+    for (i = 0, n = 0; i < c->table_numbers; i++) {
+        struct columnar_table *t = c->tables[i];
+
+        for (j = 0; j < t->column_numbers; j++, n++) {
+            struct columnar_column *col = &t->columns[j];
+
+            memcpy(entries[n].name, col->name, COLUMNAR_NAME_SIZE);
+            entries[n].type = col->type;
+            entries[n].width = col->width;
+            entries[n].offset = pos;
+            columnar_block(fp, &pos, col->data, col->size);
+        }
+    }
+    header.heap = pos;
+    columnar_block(fp, &pos, c->heap, c->heap_size);
+
+    header.directory = pos;
+    for (i = 0; i < c->table_numbers; i++) {
+        struct columnar_table *t = c->tables[i];
+        struct columnar_table_entry entry;
+
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, t->name, COLUMNAR_NAME_SIZE);
+        entry.rows = t->column_numbers ?
+                     t->columns[0].size / t->columns[0].width : 0;
+        entry.column_first = column_first;
+        entry.column_numbers = t->column_numbers;
+        column_first += t->column_numbers;
+        fwrite(&entry, sizeof(entry), 1, fp);
+    }
+    fwrite(entries, sizeof(*entries), n, fp);
+    xfree(entries);
+
+    if (fseek(fp, 0, SEEK_SET) ||
+        fwrite(&header, sizeof(header), 1, fp) != 1)
+        ret = -1;
+    if (fclose(fp) || ret)
+        return -1;
+    return 0;
+}
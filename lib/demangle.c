@@ -0,0 +1,1581 @@
+/*
+ * Itanium C++ ABI demangler
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <demangle.h>
+
+/* ---------------------------------------
+ *   mangled name (const char *)
+ *       | |
+ *   recursive descent parser (struct dm_ctx)
+ *       | |  every piece is a string on arena
+ *   demangled name (arena)
+ *       | |
+ *   cache (hash of mangled name -> demangled name)
+ * ---------------------------------------
+ */
+
+#define DM_CHUNK_SIZE      (64 * 1024)
+#define DM_MAX_SUBS        512
+#define DM_MAX_TPARAMS     64
+#define DM_MAX_DEPTH       256
+
+/*
+ * arena chunk, strings are bump allocated and released all at once.
+ */
+struct dm_chunk {
+    struct dm_chunk *next;
+    size_t          size;
+    size_t          used;
+    char            data[];
+};
+
+struct dm_arena {
+    struct dm_chunk *head;
+};
+
+/* kind of a demangled type, decides how declarators are wrapped */
+#define DM_PLAIN      0
+#define DM_FUNCTION   1
+#define DM_ARRAY      2
+#define DM_DECL       3
+#define DM_PACK       4
+
+/*
+ * demangled type. The declarator of pointers to functions and arrays
+ * goes between @prefix and @suffix: "void (*" ")(int)". An argument
+ * pack keeps its @elems, declarators apply to each of them.
+ */
+struct dm_type {
+    const char     *prefix;
+    const char     *suffix;
+    int            kind;
+    struct dm_type *elems;
+    int            nelems;
+};
+
+/*
+ * parser state
+ * @p: current position on mangled name.
+ * @subs: substitution table, S_ S0_ ...
+ * @tparams: template parameters of current encoding, T_ T0_ ...
+ * @depth: type nesting, template parameters are recorded on level 0.
+ * @no_return_type: next encoding is a local name scope, printed
+ *                  without return type.
+ */
+struct dm_ctx {
+    const char      *p;
+    struct dm_arena *arena;
+    struct dm_type  subs[DM_MAX_SUBS];
+    int             nsubs;
+    struct dm_type  tparams[DM_MAX_TPARAMS];
+    int             ntparams;
+    int             depth;
+    int             failed;
+    const char      *last_source_name;
+    int             name_is_template;
+    int             name_is_cdtor;
+    int             no_return_type;
+};
+
+static struct dm_arena work_arena;
+
+/* ---------------------------------------------------------------- */
+
+static void *dm_alloc(struct dm_arena *arena, size_t size)
+{
+    struct dm_chunk *c = arena->head;
+    void *ret;
+
+    if (!c || c->used + size > c->size) {
+        size_t n = size > DM_CHUNK_SIZE ? size : DM_CHUNK_SIZE;
+
+        c = xmalloc(sizeof(struct dm_chunk) + n);
+        c->size = n;
+        c->used = 0;
+        c->next = arena->head;
+        arena->head = c;
+    }
+    ret = c->data + c->used;
+    c->used += size;
+    return ret;
+}
+
+/*
+ * release everything but the first chunk, so a steady state of
+ * demangling doesn't touch malloc at all.
+ */
+static void dm_arena_reset(struct dm_arena *arena)
+{
+    struct dm_chunk *c = arena->head;
+
+    if (!c)
+        return;
+    while (c->next) {
+        struct dm_chunk *next = c->next;
+
+        xfree(c);
+        c = next;
+    }
+    c->used = 0;
+    arena->head = c;
+}
+
+static void dm_arena_free(struct dm_arena *arena)
+{
+    dm_arena_reset(arena);
+    xfree(arena->head);
+    arena->head = NULL;
+}
+
+static const char *dm_strndup(struct dm_ctx *ctx, const char *s, size_t n)
+{
+    char *ret = dm_alloc(ctx->arena, n + 1);
+
+    memcpy(ret, s, n);
+    ret[n] = '\0';
+    return ret;
+}
+
+/*
+ * concatenate strings on arena, list is terminated by NULL.
+ */
+static const char *dm_cat(struct dm_ctx *ctx, ...)
+{
+    const char *s;
+    size_t len = 0;
+    va_list ap;
+    char *ret, *q;
+
+    va_start(ap, ctx);
+    while ((s = va_arg(ap, const char *)))
+        len += strlen(s);
+    va_end(ap);
+
+    ret = q = dm_alloc(ctx->arena, len + 1);
+    va_start(ap, ctx);
+    while ((s = va_arg(ap, const char *))) {
+        size_t n = strlen(s);
+
+        memcpy(q, s, n);
+        q += n;
+    }
+    va_end(ap);
+    *q = '\0';
+    return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+static struct dm_type dm_plain(const char *s)
+{
+    struct dm_type t = { s, "", DM_PLAIN };
+
+    return t;
+}
+
+static const char *dm_type_str(struct dm_ctx *ctx, struct dm_type t)
+{
+    switch (t.kind) {
+    case DM_FUNCTION:
+    case DM_ARRAY:
+        return dm_cat(ctx, t.prefix, " ", t.suffix, NULL);
+    case DM_DECL:
+        return dm_cat(ctx, t.prefix, t.suffix, NULL);
+    default:
+        return t.prefix;
+    }
+}
+
+/* pack of @n elements, printed comma separated */
+static struct dm_type dm_pack(struct dm_ctx *ctx, struct dm_type *elems, int n)
+{
+    struct dm_type t = dm_plain("");
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (elems[i].prefix[0] || elems[i].suffix[0])
+            t.prefix = dm_cat(ctx, t.prefix, t.prefix[0] ? ", " : "",
+                              dm_type_str(ctx, elems[i]), NULL);
+    t.kind = DM_PACK;
+    t.elems = elems;
+    t.nelems = n;
+    return t;
+}
+
+static void dm_add_sub(struct dm_ctx *ctx, struct dm_type t)
+{
+    if (ctx->nsubs < DM_MAX_SUBS)
+        ctx->subs[ctx->nsubs++] = t;
+}
+
+static int dm_fail(struct dm_ctx *ctx)
+{
+    ctx->failed = 1;
+    return 0;
+}
+
+static int dm_eat(struct dm_ctx *ctx, const char *s)
+{
+    size_t n = strlen(s);
+
+    if (strncmp(ctx->p, s, n))
+        return 0;
+    ctx->p += n;
+    return 1;
+}
+
+static int dm_number(struct dm_ctx *ctx, long *val)
+{
+    int neg = dm_eat(ctx, "n");
+    long v = 0;
+
+    if (*ctx->p < '0' || *ctx->p > '9')
+        return dm_fail(ctx);
+    while (*ctx->p >= '0' && *ctx->p <= '9')
+        v = v * 10 + (*ctx->p++ - '0');
+    *val = neg ? -v : v;
+    return 1;
+}
+
+/* <seq-id> _ , base 36 with upper case letters */
+static int dm_seq_id(struct dm_ctx *ctx, int *index)
+{
+    int v = 0;
+
+    if (dm_eat(ctx, "_")) {
+        *index = 0;
+        return 1;
+    }
+    while (*ctx->p && *ctx->p != '_') {
+        char c = *ctx->p++;
+
+        if (c >= '0' && c <= '9')
+            v = v * 36 + (c - '0');
+        else if (c >= 'A' && c <= 'Z')
+            v = v * 36 + (c - 'A' + 10);
+        else
+            return dm_fail(ctx);
+    }
+    if (!dm_eat(ctx, "_"))
+        return dm_fail(ctx);
+    *index = v + 1;
+    return 1;
+}
+
+/* ---------------------------------------------------------------- */
+
+static struct dm_type dm_type(struct dm_ctx *ctx);
+static const char *dm_encoding(struct dm_ctx *ctx);
+static const char *dm_template_args(struct dm_ctx *ctx);
+static const char *dm_name(struct dm_ctx *ctx, const char **cv);
+
+static const struct {
+    const char *code;
+    const char *name;
+} DM_BUILTIN[] = {
+    { "v", "void" }, { "w", "wchar_t" }, { "b", "bool" }, { "c", "char" },
+    { "a", "signed char" }, { "h", "unsigned char" }, { "s", "short" },
+    { "t", "unsigned short" }, { "i", "int" }, { "j", "unsigned int" },
+    { "l", "long" }, { "m", "unsigned long" }, { "x", "long long" },
+    { "y", "unsigned long long" }, { "n", "__int128" },
+    { "o", "unsigned __int128" }, { "f", "float" }, { "d", "double" },
+    { "e", "long double" }, { "g", "__float128" }, { "z", "..." },
+    { "Dd", "decimal64" }, { "De", "decimal128" }, { "Df", "decimal32" },
+    { "Dh", "half" }, { "Di", "char32_t" }, { "Ds", "char16_t" },
+    { "Du", "char8_t" }, { "Da", "auto" }, { "Dc", "decltype(auto)" },
+    { "Dn", "decltype(nullptr)" },
+};
+
+static const struct {
+    const char *code;
+    const char *name;
+} DM_OPERATORS[] = {
+    { "nw", "new" }, { "na", "new[]" }, { "dl", "delete" },
+    { "da", "delete[]" }, { "ps", "+" }, { "ng", "-" }, { "ad", "&" },
+    { "de", "*" }, { "co", "~" }, { "pl", "+" }, { "mi", "-" },
+    { "ml", "*" }, { "dv", "/" }, { "rm", "%" }, { "an", "&" },
+    { "or", "|" }, { "eo", "^" }, { "aS", "=" }, { "pL", "+=" },
+    { "mI", "-=" }, { "mL", "*=" }, { "dV", "/=" }, { "rM", "%=" },
+    { "aN", "&=" }, { "oR", "|=" }, { "eO", "^=" }, { "ls", "<<" },
+    { "rs", ">>" }, { "lS", "<<=" }, { "rS", ">>=" }, { "eq", "==" },
+    { "ne", "!=" }, { "lt", "<" }, { "gt", ">" }, { "le", "<=" },
+    { "ge", ">=" }, { "ss", "<=>" }, { "nt", "!" }, { "aa", "&&" },
+    { "oo", "||" }, { "pp", "++" }, { "mm", "--" }, { "cm", "," },
+    { "pm", "->*" }, { "pt", "->" }, { "cl", "()" }, { "ix", "[]" },
+    { "qu", "?" }, { "aw", "co_await" },
+};
+
+/* <source-name> ::= <length> <identifier> */
+static const char *dm_source_name(struct dm_ctx *ctx)
+{
+    const char *name;
+    long len;
+
+    if (!dm_number(ctx, &len) || len <= 0 || strlen(ctx->p) < (size_t)len) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    /* GCC's name for anonymous namespace */
+    if (len >= 10 && !strncmp(ctx->p, "_GLOBAL_", 8) &&
+        (ctx->p[8] == '.' || ctx->p[8] == '_' || ctx->p[8] == '$') &&
+        ctx->p[9] == 'N')
+        name = "(anonymous namespace)";
+    else
+        name = dm_strndup(ctx, ctx->p, len);
+    ctx->p += len;
+    ctx->last_source_name = name;
+    return name;
+}
+
+/* [B <source-name>]* */
+static const char *dm_abi_tags(struct dm_ctx *ctx, const char *name)
+{
+    const char *last_source_name = ctx->last_source_name;
+
+    while (!ctx->failed && dm_eat(ctx, "B")) {
+        const char *tag = dm_source_name(ctx);
+
+        if (!tag)
+            return NULL;
+        name = dm_cat(ctx, name, "[abi:", tag, "]", NULL);
+    }
+    /* tags are not part of a constructor name */
+    ctx->last_source_name = last_source_name;
+    return name;
+}
+
+/*
+ * <unqualified-name> ::= <operator-name> | <ctor-dtor-name>
+ *                      | <source-name> | <unnamed-type-name>
+ */
+static const char *dm_unqualified_name(struct dm_ctx *ctx)
+{
+    const char *name = NULL;
+    int i;
+
+    ctx->name_is_cdtor = 0;
+    if (*ctx->p >= '0' && *ctx->p <= '9') {
+        name = dm_source_name(ctx);
+    } else if (dm_eat(ctx, "C")) {
+        dm_eat(ctx, "I");
+        if (*ctx->p < '1' || *ctx->p > '5' || !ctx->last_source_name) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        ctx->p++;
+        name = ctx->last_source_name;
+        ctx->name_is_cdtor = 1;
+    } else if (ctx->p[0] == 'D' && ctx->p[1] >= '0' && ctx->p[1] <= '5') {
+        ctx->p += 2;
+        if (!ctx->last_source_name) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        name = dm_cat(ctx, "~", ctx->last_source_name, NULL);
+        ctx->name_is_cdtor = 1;
+    } else if (dm_eat(ctx, "Ut")) {
+        long n = -1;
+
+        if (*ctx->p != '_')
+            dm_number(ctx, &n);
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        {
+            char buf[48];
+
+            snprintf(buf, sizeof(buf), "{unnamed type#%ld}", n + 2);
+            name = dm_strndup(ctx, buf, strlen(buf));
+        }
+    } else if (dm_eat(ctx, "Ul")) {
+        const char *params = "";
+        char buf[32];
+        long n = -1;
+
+        ctx->depth++;
+        while (!ctx->failed && *ctx->p && *ctx->p != 'E') {
+            struct dm_type t = dm_type(ctx);
+
+            if (strcmp(t.prefix, "void"))
+                params = dm_cat(ctx, params, params[0] ? ", " : "",
+                                dm_type_str(ctx, t), NULL);
+        }
+        ctx->depth--;
+        if (!dm_eat(ctx, "E")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        if (*ctx->p != '_')
+            dm_number(ctx, &n);
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        snprintf(buf, sizeof(buf), ")#%ld}", n + 2);
+        name = dm_cat(ctx, "{lambda(", params, buf, NULL);
+    } else if (dm_eat(ctx, "cv")) {
+        struct dm_type t;
+
+        ctx->depth++;
+        t = dm_type(ctx);
+        ctx->depth--;
+        name = dm_cat(ctx, "operator ", dm_type_str(ctx, t), NULL);
+        ctx->name_is_cdtor = 1;
+    } else if (dm_eat(ctx, "li")) {
+        const char *s = dm_source_name(ctx);
+
+        if (s)
+            name = dm_cat(ctx, "operator\"\" ", s, NULL);
+    } else {
+        for (i = 0; i < sizeof(DM_OPERATORS) / sizeof(DM_OPERATORS[0]); i++) {
+            if (dm_eat(ctx, DM_OPERATORS[i].code)) {
+                const char *op = DM_OPERATORS[i].name;
+
+                name = dm_cat(ctx, "operator",
+                              op[0] >= 'a' && op[0] <= 'z' ? " " : "",
+                              op, NULL);
+                break;
+            }
+        }
+        if (!name) {
+            dm_fail(ctx);
+            return NULL;
+        }
+    }
+    if (!name)
+        return NULL;
+    return dm_abi_tags(ctx, name);
+}
+
+/*
+ * last component of a qualified name without template arguments,
+ * a constructor after a substitution is named after it.
+ */
+static const char *dm_last_component(struct dm_ctx *ctx, const char *name)
+{
+    const char *start = name, *end = NULL, *q;
+    int depth = 0;
+
+    for (q = name; *q; q++) {
+        if (*q == '<') {
+            if (!depth)
+                end = q;
+            depth++;
+        } else if (*q == '>') {
+            depth--;
+        } else if (!depth && q[0] == ':' && q[1] == ':') {
+            start = q + 2;
+            end = NULL;
+        }
+    }
+    return dm_strndup(ctx, start, (end ? end : q) - start);
+}
+
+/*
+ * <substitution> ::= S <seq-id> _ | S_ | St | Sa | Sb | Ss | Si | So | Sd
+ * Like libiberty without DMGL_VERBOSE, which nm -C and objdump -C use,
+ * Ss/Si/So/Sd are only expanded to the class template when naming a
+ * constructor or destructor. c++filt passes DMGL_VERBOSE and expands
+ * them everywhere.
+ */
+static int dm_substitution(struct dm_ctx *ctx, struct dm_type *t)
+{
+    static const struct {
+        char       code;
+        const char *name;
+        const char *full;
+    } SPECIAL[] = {
+        { 'a', "std::allocator", NULL },
+        { 'b', "std::basic_string", NULL },
+        { 's', "std::string", "std::basic_string<char, std::char_traits<char>,"
+               " std::allocator<char> >" },
+        { 'i', "std::istream", "std::basic_istream<char,"
+               " std::char_traits<char> >" },
+        { 'o', "std::ostream", "std::basic_ostream<char,"
+               " std::char_traits<char> >" },
+        { 'd', "std::iostream", "std::basic_iostream<char,"
+               " std::char_traits<char> >" },
+    };
+    int i, index;
+
+    if (!dm_eat(ctx, "S"))
+        return dm_fail(ctx);
+    for (i = 0; i < sizeof(SPECIAL) / sizeof(SPECIAL[0]); i++) {
+        if (*ctx->p == SPECIAL[i].code) {
+            ctx->p++;
+            /* constructors and destructors need the real class name */
+            if (SPECIAL[i].full && (*ctx->p == 'C' || (*ctx->p == 'D' &&
+                ctx->p[1] >= '0' && ctx->p[1] <= '5')))
+                *t = dm_plain(SPECIAL[i].full);
+            else
+                *t = dm_plain(SPECIAL[i].name);
+            ctx->last_source_name = dm_last_component(ctx, t->prefix);
+            return 1;
+        }
+    }
+    if (!dm_seq_id(ctx, &index))
+        return 0;
+    if (index >= ctx->nsubs)
+        return dm_fail(ctx);
+    *t = ctx->subs[index];
+    return 1;
+}
+
+/* <template-param> ::= T_ | T <number> _ */
+static int dm_template_param(struct dm_ctx *ctx, struct dm_type *t)
+{
+    long n = -1;
+
+    if (!dm_eat(ctx, "T"))
+        return dm_fail(ctx);
+    if (*ctx->p != '_' && !dm_number(ctx, &n))
+        return 0;
+    if (!dm_eat(ctx, "_"))
+        return dm_fail(ctx);
+    if (n + 1 >= ctx->ntparams)
+        return dm_fail(ctx);
+    *t = ctx->tparams[n + 1];
+    return 1;
+}
+
+/*
+ * <nested-name> ::= N [<CV-qualifiers>] [<ref-qualifier>] <prefix> E
+ * Every prefix but the complete name is a substitution candidate.
+ */
+static const char *dm_nested_name(struct dm_ctx *ctx, const char **cv)
+{
+    const char *name = NULL;
+    const char *quals = "";
+    int components = 0;
+
+    if (!dm_eat(ctx, "N")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    while (*ctx->p == 'r' || *ctx->p == 'V' || *ctx->p == 'K') {
+        char c = *ctx->p++;
+
+        quals = dm_cat(ctx, quals, c == 'r' ? " restrict" :
+                       c == 'V' ? " volatile" : " const", NULL);
+    }
+    if (dm_eat(ctx, "R"))
+        quals = dm_cat(ctx, quals, " &", NULL);
+    else if (dm_eat(ctx, "O"))
+        quals = dm_cat(ctx, quals, " &&", NULL);
+    if (cv)
+        *cv = quals;
+
+    ctx->name_is_template = 0;
+    while (!ctx->failed && !dm_eat(ctx, "E")) {
+        const char *part;
+
+        if (!*ctx->p) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        /* previous prefix is a candidate once something follows it */
+        if (components && *ctx->p != 'I' && *ctx->p != 'M')
+            dm_add_sub(ctx, dm_plain(name));
+
+        if (*ctx->p == 'S' && ctx->p[1] == 't') {
+            ctx->p += 2;
+            part = dm_unqualified_name(ctx);
+            if (!part)
+                return NULL;
+            name = dm_cat(ctx, "std::", part, NULL);
+            ctx->name_is_template = 0;
+        } else if (*ctx->p == 'S') {
+            struct dm_type t;
+
+            if (!dm_substitution(ctx, &t))
+                return NULL;
+            name = t.prefix;
+            ctx->last_source_name = dm_last_component(ctx, name);
+            ctx->name_is_template = 0;
+            /* a substitution isn't a new candidate */
+            components = 0;
+            continue;
+        } else if (*ctx->p == 'T') {
+            struct dm_type t;
+
+            if (!dm_template_param(ctx, &t))
+                return NULL;
+            name = dm_type_str(ctx, t);
+            ctx->name_is_template = 0;
+        } else if (*ctx->p == 'I') {
+            const char *args;
+
+            if (!name) {
+                dm_fail(ctx);
+                return NULL;
+            }
+            /* template prefix is a candidate before its arguments */
+            if (components)
+                dm_add_sub(ctx, dm_plain(name));
+            args = dm_template_args(ctx);
+            if (!args)
+                return NULL;
+            name = dm_cat(ctx, name, name[strlen(name) - 1] == '<' ?
+                          " " : "", args, NULL);
+            ctx->name_is_template = 1;
+            components = 1;
+            /* a complete template-id is followed by E or more prefix */
+            if (*ctx->p != 'E')
+                dm_add_sub(ctx, dm_plain(name));
+            components = *ctx->p == 'E';
+            continue;
+        } else if (dm_eat(ctx, "M")) {
+            /* <data-member-prefix> of closure types */
+            continue;
+        } else {
+            part = dm_unqualified_name(ctx);
+            if (!part)
+                return NULL;
+            name = name ? dm_cat(ctx, name, "::", part, NULL) : part;
+            ctx->name_is_template = 0;
+        }
+        components = 1;
+    }
+    if (!name)
+        dm_fail(ctx);
+    return ctx->failed ? NULL : name;
+}
+
+/*
+ * <local-name> ::= Z <encoding> E <entity name> [<discriminator>]
+ *              ::= Z <encoding> E s [<discriminator>]
+ */
+static const char *dm_local_name(struct dm_ctx *ctx)
+{
+    const char *enc, *name;
+    long n;
+
+    if (!dm_eat(ctx, "Z")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    ctx->no_return_type = 1;
+    enc = dm_encoding(ctx);
+    if (!enc || !dm_eat(ctx, "E")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    if (dm_eat(ctx, "s")) {
+        name = dm_cat(ctx, enc, "::string literal", NULL);
+    } else {
+        if (dm_eat(ctx, "d")) {
+            if (*ctx->p != '_')
+                dm_number(ctx, &n);
+            dm_eat(ctx, "_");
+        }
+        name = dm_name(ctx, NULL);
+        if (!name)
+            return NULL;
+        name = dm_cat(ctx, enc, "::", name, NULL);
+    }
+    /* <discriminator> := _ <digit> | __ <number> _ */
+    if (dm_eat(ctx, "__")) {
+        dm_number(ctx, &n);
+        dm_eat(ctx, "_");
+    } else if (ctx->p[0] == '_' && ctx->p[1] >= '0' && ctx->p[1] <= '9') {
+        ctx->p += 2;
+    }
+    return name;
+}
+
+/*
+ * <name> ::= <nested-name> | <local-name>
+ *        ::= <unscoped-name> | <unscoped-template-name> <template-args>
+ */
+static const char *dm_name(struct dm_ctx *ctx, const char **cv)
+{
+    const char *name;
+
+    if (cv)
+        *cv = "";
+    if (*ctx->p == 'N')
+        return dm_nested_name(ctx, cv);
+    if (*ctx->p == 'Z')
+        return dm_local_name(ctx);
+
+    ctx->name_is_template = 0;
+    if (*ctx->p == 'S' && ctx->p[1] != 't') {
+        struct dm_type t;
+
+        /* only an <unscoped-template-name> can be a substitution here */
+        if (!dm_substitution(ctx, &t))
+            return NULL;
+        if (*ctx->p != 'I') {
+            dm_fail(ctx);
+            return NULL;
+        }
+        name = t.prefix;
+    } else {
+        int std = dm_eat(ctx, "St");
+
+        name = dm_unqualified_name(ctx);
+        if (!name)
+            return NULL;
+        if (std)
+            name = dm_cat(ctx, "std::", name, NULL);
+        if (*ctx->p == 'I')
+            dm_add_sub(ctx, dm_plain(name));
+    }
+    if (*ctx->p == 'I') {
+        const char *args = dm_template_args(ctx);
+
+        if (!args)
+            return NULL;
+        name = dm_cat(ctx, name, name[strlen(name) - 1] == '<' ? " " : "",
+                      args, NULL);
+        ctx->name_is_template = 1;
+    }
+    return name;
+}
+
+/* L <type> <value> E | L <mangled-name> E */
+static const char *dm_literal(struct dm_ctx *ctx)
+{
+    const char *val, *start;
+    struct dm_type t;
+    int neg;
+
+    if (!dm_eat(ctx, "L")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    if (dm_eat(ctx, "_Z")) {
+        val = dm_encoding(ctx);
+        if (!val || !dm_eat(ctx, "E")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        return val;
+    }
+
+    ctx->depth++;
+    t = dm_type(ctx);
+    ctx->depth--;
+    if (ctx->failed)
+        return NULL;
+    neg = dm_eat(ctx, "n");
+    start = ctx->p;
+    while (*ctx->p && *ctx->p != 'E')
+        ctx->p++;
+    if (!dm_eat(ctx, "E")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    val = dm_strndup(ctx, start, ctx->p - 1 - start);
+    if (neg)
+        val = dm_cat(ctx, "-", val, NULL);
+
+    if (!strcmp(t.prefix, "bool"))
+        return !strcmp(val, "0") ? "false" : "true";
+    if (!strcmp(t.prefix, "int"))
+        return val;
+    if (!strcmp(t.prefix, "unsigned int"))
+        return dm_cat(ctx, val, "u", NULL);
+    if (!strcmp(t.prefix, "long"))
+        return dm_cat(ctx, val, "l", NULL);
+    if (!strcmp(t.prefix, "unsigned long"))
+        return dm_cat(ctx, val, "ul", NULL);
+    if (!strcmp(t.prefix, "long long"))
+        return dm_cat(ctx, val, "ll", NULL);
+    if (!strcmp(t.prefix, "unsigned long long"))
+        return dm_cat(ctx, val, "ull", NULL);
+    return dm_cat(ctx, "(", dm_type_str(ctx, t), ")", val, NULL);
+}
+
+/* <simple-id> ::= <source-name> [<template-args>] */
+static const char *dm_unresolved_name(struct dm_ctx *ctx)
+{
+    const char *s = dm_unqualified_name(ctx);
+
+    if (s && *ctx->p == 'I') {
+        const char *args = dm_template_args(ctx);
+
+        s = args ? dm_cat(ctx, s, args, NULL) : NULL;
+    }
+    return s;
+}
+
+/*
+ * <expression>, only what shows up in template arguments of common
+ * library code: template parameters, literals, pack expansions and
+ * dependent names. Anything else fails and the name stays mangled.
+ */
+static const char *dm_expression(struct dm_ctx *ctx)
+{
+    struct dm_type t;
+    const char *s;
+
+    if (*ctx->p == 'T') {
+        if (!dm_template_param(ctx, &t))
+            return NULL;
+        return dm_type_str(ctx, t);
+    }
+    if (*ctx->p == 'L')
+        return dm_literal(ctx);
+    if (dm_eat(ctx, "sp"))
+        return dm_expression(ctx);
+    if (dm_eat(ctx, "sr")) {
+        int levels = dm_eat(ctx, "N");
+
+        /* sr <type> <name>, srN <type> <level>* E <name>, sr <level>+ E <name> */
+        if (levels || (*ctx->p < '0' || *ctx->p > '9')) {
+            ctx->depth++;
+            t = dm_type(ctx);
+            ctx->depth--;
+            if (ctx->failed)
+                return NULL;
+            s = dm_type_str(ctx, t);
+        } else {
+            s = NULL;
+            levels = 1;
+        }
+        while (levels && !ctx->failed && !dm_eat(ctx, "E")) {
+            const char *level = dm_unresolved_name(ctx);
+
+            if (!level)
+                return NULL;
+            s = s ? dm_cat(ctx, s, "::", level, NULL) : level;
+        }
+        t.prefix = dm_unresolved_name(ctx);
+        if (!t.prefix || !s)
+            return NULL;
+        return dm_cat(ctx, s, "::", t.prefix, NULL);
+    }
+    dm_fail(ctx);
+    return NULL;
+}
+
+/* one <template-arg> */
+static const char *dm_template_arg(struct dm_ctx *ctx, struct dm_type *t)
+{
+    const char *s;
+
+    if (*ctx->p == 'L') {
+        s = dm_literal(ctx);
+        if (s)
+            *t = dm_plain(s);
+        return s;
+    }
+    if (dm_eat(ctx, "J")) {
+        /* argument pack */
+        struct dm_type elems[DM_MAX_TPARAMS], *copy;
+        int n = 0;
+
+        while (!ctx->failed && !dm_eat(ctx, "E")) {
+            if (!*ctx->p || n == DM_MAX_TPARAMS ||
+                !dm_template_arg(ctx, &elems[n])) {
+                dm_fail(ctx);
+                return NULL;
+            }
+            n++;
+        }
+        copy = dm_alloc(ctx->arena, sizeof(struct dm_type) * (n ? n : 1));
+        memcpy(copy, elems, sizeof(struct dm_type) * n);
+        *t = dm_pack(ctx, copy, n);
+        return t->prefix;
+    }
+    if (dm_eat(ctx, "X")) {
+        s = dm_expression(ctx);
+        if (!s || !dm_eat(ctx, "E")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        *t = dm_plain(s);
+        return s;
+    }
+    *t = dm_type(ctx);
+    return ctx->failed ? NULL : dm_type_str(ctx, *t);
+}
+
+/*
+ * <template-args> ::= I <template-arg>+ E
+ * Arguments of the outermost name become the template parameters.
+ */
+static const char *dm_template_args(struct dm_ctx *ctx)
+{
+    struct dm_type args[DM_MAX_TPARAMS];
+    const char *s = "<";
+    const char *last_source_name = ctx->last_source_name;
+    int is_template = ctx->name_is_template, is_cdtor = ctx->name_is_cdtor;
+    int n = 0, record = ctx->depth == 0, empty_pack = 0;
+    size_t len;
+
+    if (!dm_eat(ctx, "I")) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    ctx->depth++;
+    while (!ctx->failed && !dm_eat(ctx, "E")) {
+        struct dm_type t;
+        const char *arg;
+
+        if (!*ctx->p) {
+            dm_fail(ctx);
+            break;
+        }
+        arg = dm_template_arg(ctx, &t);
+        if (!arg)
+            break;
+        if (n < DM_MAX_TPARAMS)
+            args[n] = t;
+        /* an empty pack adds no argument */
+        empty_pack = !arg[0] && t.kind == DM_PACK;
+        if (!empty_pack)
+            s = dm_cat(ctx, s, s[1] ? ", " : "", arg, NULL);
+        n++;
+    }
+    ctx->depth--;
+    if (ctx->failed)
+        return NULL;
+    /* names inside arguments don't change what the outer name is */
+    ctx->last_source_name = last_source_name;
+    ctx->name_is_template = is_template;
+    ctx->name_is_cdtor = is_cdtor;
+
+    if (record) {
+        ctx->ntparams = n < DM_MAX_TPARAMS ? n : DM_MAX_TPARAMS;
+        memcpy(ctx->tparams, args, sizeof(struct dm_type) * ctx->ntparams);
+    }
+    /* GNU doesn't space the brackets after a trailing empty pack */
+    len = strlen(s);
+    return dm_cat(ctx, s, len && s[len - 1] == '>' && !empty_pack ?
+                  " >" : ">", NULL);
+}
+
+/*
+ * parameter list of a function type, "(int, char)".
+ */
+static int dm_parameters_end(struct dm_ctx *ctx, const char *end)
+{
+    /* a ref-qualifier of a function type ends the list too */
+    return !*ctx->p || strchr(end, *ctx->p) ||
+           ((ctx->p[0] == 'R' || ctx->p[0] == 'O') && ctx->p[1] == 'E');
+}
+
+static const char *dm_parameters(struct dm_ctx *ctx, const char *end)
+{
+    const char *s = "";
+    int n = 0;
+
+    while (!ctx->failed && !dm_parameters_end(ctx, end)) {
+        struct dm_type t = dm_type(ctx);
+
+        if (ctx->failed)
+            return NULL;
+        /* (void) is printed as () */
+        if (n == 0 && t.kind == DM_PLAIN && !strcmp(t.prefix, "void") &&
+            dm_parameters_end(ctx, end)) {
+            n++;
+            break;
+        }
+        /* an empty pack expansion prints nothing */
+        if (t.prefix[0])
+            s = dm_cat(ctx, s, s[0] ? ", " : "", dm_type_str(ctx, t), NULL);
+        n++;
+    }
+    if (!n) {
+        dm_fail(ctx);
+        return NULL;
+    }
+    return dm_cat(ctx, "(", s, ")", NULL);
+}
+
+/* F [Y] <return type> <parameter types> [<ref-qualifier>] E */
+static struct dm_type dm_function_type(struct dm_ctx *ctx)
+{
+    struct dm_type ret, t = dm_plain("");
+    const char *params, *ref = "";
+
+    dm_eat(ctx, "F");
+    dm_eat(ctx, "Y");
+    ret = dm_type(ctx);
+    if (ctx->failed)
+        return t;
+    /* functions returning pointers to functions are not supported */
+    if (ret.kind == DM_DECL) {
+        dm_fail(ctx);
+        return t;
+    }
+    params = dm_parameters(ctx, "E");
+    if (!params)
+        return t;
+    if (ctx->p[0] == 'R' && ctx->p[1] == 'E') {
+        ctx->p++;
+        ref = " &";
+    } else if (ctx->p[0] == 'O' && ctx->p[1] == 'E') {
+        ctx->p++;
+        ref = " &&";
+    }
+    if (!dm_eat(ctx, "E")) {
+        dm_fail(ctx);
+        return t;
+    }
+    t.prefix = dm_type_str(ctx, ret);
+    t.suffix = dm_cat(ctx, params, ref, NULL);
+    t.kind = DM_FUNCTION;
+    return t;
+}
+
+/* apply pointer, reference or pointer to member declarator */
+static struct dm_type dm_declarator(struct dm_ctx *ctx, struct dm_type t,
+                                    const char *op)
+{
+    size_t len = strlen(t.prefix);
+
+    /* reference collapsing, & wins over && */
+    if (op[0] == '&' && t.kind != DM_FUNCTION && t.kind != DM_ARRAY &&
+        t.kind != DM_PACK && len && t.prefix[len - 1] == '&') {
+        if (op[1] == '\0' && len > 1 && t.prefix[len - 2] == '&')
+            t.prefix = dm_strndup(ctx, t.prefix, len - 1);
+        return t;
+    }
+
+    switch (t.kind) {
+    case DM_FUNCTION:
+        t.prefix = dm_cat(ctx, t.prefix, " (", op, NULL);
+        t.suffix = dm_cat(ctx, ")", t.suffix, NULL);
+        t.kind = DM_DECL;
+        break;
+    case DM_ARRAY:
+        t.prefix = dm_cat(ctx, t.prefix, " (", op, NULL);
+        t.suffix = dm_cat(ctx, ") ", t.suffix, NULL);
+        t.kind = DM_DECL;
+        break;
+    case DM_DECL:
+        t.prefix = dm_cat(ctx, t.prefix, op, NULL);
+        break;
+    case DM_PACK: {
+        /* applies to every element of an argument pack */
+        struct dm_type *elems;
+        int i;
+
+        elems = dm_alloc(ctx->arena, sizeof(struct dm_type) *
+                         (t.nelems ? t.nelems : 1));
+        for (i = 0; i < t.nelems; i++)
+            elems[i] = dm_declarator(ctx, t.elems[i], op);
+        t = dm_pack(ctx, elems, t.nelems);
+        break;
+    }
+    default:
+        t.prefix = dm_cat(ctx, t.prefix, op[0] >= 'A' ? " " : "", op, NULL);
+        break;
+    }
+    return t;
+}
+
+/* apply cv-qualifiers */
+static struct dm_type dm_qualify(struct dm_ctx *ctx, struct dm_type t,
+                                 const char *quals)
+{
+    struct dm_type *elems;
+    size_t len;
+    int i;
+
+    switch (t.kind) {
+    case DM_FUNCTION:
+        t.suffix = dm_cat(ctx, t.suffix, quals, NULL);
+        break;
+    case DM_PACK:
+        elems = dm_alloc(ctx->arena, sizeof(struct dm_type) *
+                         (t.nelems ? t.nelems : 1));
+        for (i = 0; i < t.nelems; i++)
+            elems[i] = dm_qualify(ctx, t.elems[i], quals);
+        t = dm_pack(ctx, elems, t.nelems);
+        break;
+    default:
+        /* qualifying a qualified template parameter again is a no-op */
+        len = strlen(t.prefix);
+        if (len < strlen(quals) ||
+            strcmp(t.prefix + len - strlen(quals), quals))
+            t.prefix = dm_cat(ctx, t.prefix, quals, NULL);
+        break;
+    }
+    return t;
+}
+
+/*
+ * <type>, every non builtin type is a substitution candidate.
+ */
+static struct dm_type dm_type(struct dm_ctx *ctx)
+{
+    struct dm_type t = dm_plain("");
+    const char *s;
+    int i;
+
+    if (ctx->failed)
+        return t;
+    if (++ctx->depth > DM_MAX_DEPTH) {
+        dm_fail(ctx);
+        return t;
+    }
+
+    switch (*ctx->p) {
+    case 'r':
+    case 'V':
+    case 'K': {
+        const char *quals = "";
+
+        while (*ctx->p == 'r' || *ctx->p == 'V' || *ctx->p == 'K') {
+            char c = *ctx->p++;
+
+            /* innermost qualifier is printed first */
+            quals = dm_cat(ctx, c == 'r' ? " restrict" : c == 'V' ?
+                           " volatile" : " const", quals, NULL);
+        }
+        /*
+         * qualifiers before a function type belong to 'this', the
+         * unqualified function type is not a candidate then.
+         */
+        if (*ctx->p == 'F')
+            t = dm_function_type(ctx);
+        else
+            t = dm_type(ctx);
+        if (ctx->failed)
+            break;
+        t = dm_qualify(ctx, t, quals);
+        dm_add_sub(ctx, t);
+        break;
+    }
+    case 'P':
+    case 'R':
+    case 'O': {
+        char c = *ctx->p++;
+
+        t = dm_type(ctx);
+        if (ctx->failed)
+            break;
+        t = dm_declarator(ctx, t, c == 'P' ? "*" : c == 'R' ? "&" : "&&");
+        dm_add_sub(ctx, t);
+        break;
+    }
+    case 'F':
+        t = dm_function_type(ctx);
+        if (!ctx->failed)
+            dm_add_sub(ctx, t);
+        break;
+    case 'A': {
+        const char *dim = "";
+        struct dm_type elem;
+
+        ctx->p++;
+        if (*ctx->p >= '0' && *ctx->p <= '9') {
+            const char *start = ctx->p;
+
+            while (*ctx->p >= '0' && *ctx->p <= '9')
+                ctx->p++;
+            dim = dm_strndup(ctx, start, ctx->p - start);
+        } else if (*ctx->p == 'T') {
+            struct dm_type param;
+
+            if (!dm_template_param(ctx, &param))
+                break;
+            dim = dm_type_str(ctx, param);
+        }
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            break;
+        }
+        elem = dm_type(ctx);
+        if (ctx->failed)
+            break;
+        if (elem.kind == DM_ARRAY) {
+            t.prefix = elem.prefix;
+            t.suffix = dm_cat(ctx, "[", dim, "]", elem.suffix, NULL);
+        } else if (elem.kind == DM_DECL) {
+            t.prefix = dm_cat(ctx, elem.prefix, "[", dim, "]", NULL);
+            t.suffix = elem.suffix;
+            t.kind = DM_DECL;
+            dm_add_sub(ctx, t);
+            break;
+        } else {
+            t.prefix = dm_type_str(ctx, elem);
+            t.suffix = dm_cat(ctx, "[", dim, "]", NULL);
+        }
+        t.kind = DM_ARRAY;
+        dm_add_sub(ctx, t);
+        break;
+    }
+    case 'M': {
+        struct dm_type cls, member;
+
+        ctx->p++;
+        cls = dm_type(ctx);
+        member = dm_type(ctx);
+        if (ctx->failed)
+            break;
+        t = dm_declarator(ctx, member,
+                          dm_cat(ctx, dm_type_str(ctx, cls), "::*", NULL));
+        dm_add_sub(ctx, t);
+        break;
+    }
+    case 'T':
+        if (!dm_template_param(ctx, &t))
+            break;
+        dm_add_sub(ctx, t);
+        if (*ctx->p == 'I') {
+            s = dm_template_args(ctx);
+            if (!s)
+                break;
+            t = dm_plain(dm_cat(ctx, dm_type_str(ctx, t), s, NULL));
+            dm_add_sub(ctx, t);
+        }
+        break;
+    case 'S':
+        if (ctx->p[1] == 't') {
+            s = dm_name(ctx, NULL);
+            if (!s)
+                break;
+            t = dm_plain(s);
+            dm_add_sub(ctx, t);
+            break;
+        }
+        if (!dm_substitution(ctx, &t))
+            break;
+        if (*ctx->p == 'I') {
+            s = dm_template_args(ctx);
+            if (!s)
+                break;
+            t = dm_plain(dm_cat(ctx, t.prefix, s, NULL));
+            dm_add_sub(ctx, t);
+        }
+        break;
+    case 'D':
+        if (ctx->p[1] == 'p') {
+            ctx->p += 2;
+            t = dm_type(ctx);
+            if (ctx->failed)
+                break;
+            /* expansion of a known argument pack is the pack itself */
+            if (t.kind == DM_PACK)
+                t.kind = DM_PLAIN;
+            else
+                t = dm_plain(dm_cat(ctx, dm_type_str(ctx, t), "...", NULL));
+            dm_add_sub(ctx, t);
+            break;
+        }
+        /* fall through for D builtin types */
+    default:
+        for (i = 0; i < sizeof(DM_BUILTIN) / sizeof(DM_BUILTIN[0]); i++) {
+            if (dm_eat(ctx, DM_BUILTIN[i].code)) {
+                t = dm_plain(DM_BUILTIN[i].name);
+                goto out;
+            }
+        }
+        if (dm_eat(ctx, "u")) {
+            s = dm_source_name(ctx);
+            if (s)
+                t = dm_plain(s);
+            break;
+        }
+        /* <class-enum-type> */
+        if (dm_eat(ctx, "Ts") || dm_eat(ctx, "Tu") || dm_eat(ctx, "Te"))
+            ;
+        if ((*ctx->p >= '0' && *ctx->p <= '9') || *ctx->p == 'N' ||
+            *ctx->p == 'Z') {
+            s = dm_name(ctx, NULL);
+            if (!s)
+                break;
+            t = dm_plain(s);
+            dm_add_sub(ctx, t);
+            break;
+        }
+        dm_fail(ctx);
+        break;
+    }
+out:
+    ctx->depth--;
+    return t;
+}
+
+/*
+ * <special-name> ::= TV | TT | TI | TS | Th | Tv | GV | GR | GTt | TH | TW
+ */
+static const char *dm_special_name(struct dm_ctx *ctx)
+{
+    static const struct {
+        const char *code;
+        const char *text;
+        int        is_type;
+    } SPECIAL[] = {
+        { "TV", "vtable for ", 1 },
+        { "TT", "VTT for ", 1 },
+        { "TI", "typeinfo for ", 1 },
+        { "TS", "typeinfo name for ", 1 },
+        { "TH", "TLS init function for ", 0 },
+        { "TW", "TLS wrapper function for ", 0 },
+        { "GV", "guard variable for ", 0 },
+        { "GR", "reference temporary for ", 0 },
+    };
+    const char *s;
+    long n;
+    int i;
+
+    for (i = 0; i < sizeof(SPECIAL) / sizeof(SPECIAL[0]); i++) {
+        if (!dm_eat(ctx, SPECIAL[i].code))
+            continue;
+        if (SPECIAL[i].is_type) {
+            struct dm_type t = dm_type(ctx);
+
+            return ctx->failed ? NULL :
+                   dm_cat(ctx, SPECIAL[i].text, dm_type_str(ctx, t), NULL);
+        }
+        s = dm_name(ctx, NULL);
+        /* GR <name> [<seq-id>] _ */
+        if (s && !strcmp(SPECIAL[i].code, "GR") && *ctx->p &&
+            *ctx->p != '.') {
+            int index;
+
+            if (!dm_seq_id(ctx, &index))
+                return NULL;
+        }
+        return s ? dm_cat(ctx, SPECIAL[i].text, s, NULL) : NULL;
+    }
+
+    if (dm_eat(ctx, "GTt")) {
+        s = dm_encoding(ctx);
+        return s ? dm_cat(ctx, "transaction clone for ", s, NULL) : NULL;
+    }
+    if (dm_eat(ctx, "Th")) {
+        dm_number(ctx, &n);
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        s = dm_encoding(ctx);
+        return s ? dm_cat(ctx, "non-virtual thunk to ", s, NULL) : NULL;
+    }
+    if (dm_eat(ctx, "Tv")) {
+        dm_number(ctx, &n);
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        dm_number(ctx, &n);
+        if (!dm_eat(ctx, "_")) {
+            dm_fail(ctx);
+            return NULL;
+        }
+        s = dm_encoding(ctx);
+        return s ? dm_cat(ctx, "virtual thunk to ", s, NULL) : NULL;
+    }
+    dm_fail(ctx);
+    return NULL;
+}
+
+/*
+ * <encoding> ::= <name> <bare-function-type> | <name> | <special-name>
+ */
+static const char *dm_encoding(struct dm_ctx *ctx)
+{
+    const char *name, *cv, *params;
+    struct dm_type ret;
+    int has_return, no_return_type = ctx->no_return_type;
+
+    ctx->no_return_type = 0;
+    if (*ctx->p == 'T' || (*ctx->p == 'G' && (ctx->p[1] == 'V' ||
+                                              ctx->p[1] == 'R' ||
+                                              ctx->p[1] == 'T')))
+        return dm_special_name(ctx);
+
+    name = dm_name(ctx, &cv);
+    if (!name)
+        return NULL;
+    /* data object */
+    if (!*ctx->p || *ctx->p == 'E' || *ctx->p == '.')
+        return name;
+
+    has_return = ctx->name_is_template && !ctx->name_is_cdtor;
+    ctx->depth++;
+    if (has_return) {
+        ret = dm_type(ctx);
+        if (ctx->failed) {
+            ctx->depth--;
+            return NULL;
+        }
+    }
+    params = dm_parameters(ctx, "E.");
+    ctx->depth--;
+    if (!params)
+        return NULL;
+    if (has_return && !no_return_type)
+        return dm_cat(ctx, dm_type_str(ctx, ret), " ", name, params, cv,
+                      NULL);
+    return dm_cat(ctx, name, params, cv, NULL);
+}
+
+/*
+ * GCC clone suffixes, "f.constprop.0.cold" -> " [clone .constprop.0]
+ * [clone .cold]".
+ */
+static const char *dm_clone_suffix(struct dm_ctx *ctx, const char *s)
+{
+    while (*ctx->p == '.' && ((ctx->p[1] >= 'a' && ctx->p[1] <= 'z') ||
+                              ctx->p[1] == '_' ||
+                              (ctx->p[1] >= '0' && ctx->p[1] <= '9'))) {
+        const char *start = ctx->p++;
+
+        while ((*ctx->p >= 'a' && *ctx->p <= 'z') || *ctx->p == '_')
+            ctx->p++;
+        while (*ctx->p == '.' && ctx->p[1] >= '0' && ctx->p[1] <= '9') {
+            ctx->p++;
+            while (*ctx->p >= '0' && *ctx->p <= '9')
+                ctx->p++;
+        }
+        s = dm_cat(ctx, s, " [clone ",
+                   dm_strndup(ctx, start, ctx->p - start), "]", NULL);
+    }
+    return s;
+}
+
+/* (OK)
+ * demangle into work arena, result is valid until next call.
+ * @mangled: symbol name.
+ *
+ * @return: demangled name, NULL if name isn't a valid mangled name.
+ */
+const char *demangle_uncached(const char *mangled)
+{
+    static struct dm_ctx ctx;
+    const char *s;
+
+    if (strncmp(mangled, "_Z", 2))
+        return NULL;
+
+    dm_arena_reset(&work_arena);
+    ctx.p = mangled + 2;
+    ctx.arena = &work_arena;
+    ctx.nsubs = 0;
+    ctx.ntparams = 0;
+    ctx.depth = 0;
+    ctx.failed = 0;
+    ctx.last_source_name = NULL;
+    ctx.name_is_template = 0;
+    ctx.name_is_cdtor = 0;
+
+    s = dm_encoding(&ctx);
+    if (!s || ctx.failed)
+        return NULL;
+    s = dm_clone_suffix(&ctx, s);
+    /* anything left over means we didn't understand the name */
+    if (*ctx.p)
+        return NULL;
+    return s;
+}
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * cache entry, @mangled and @demangled live on cache arena.
+ */
+struct dm_cache_entry {
+    uint64_t   hash;
+    const char *mangled;
+    const char *demangled;
+};
+
+static struct dm_cache_entry *cache;
+static size_t cache_size;
+static size_t cache_used;
+static struct dm_arena cache_arena;
+
+static uint64_t dm_hash(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 0x100000001b3ULL;
+    return h;
+}
+
+static void dm_cache_grow(void)
+{
+    struct dm_cache_entry *old = cache;
+    size_t i, old_size = cache_size;
+
+    cache_size = cache_size ? cache_size * 2 : 4096;
+    cache = xmalloc(sizeof(struct dm_cache_entry) * cache_size);
+    memset(cache, 0, sizeof(struct dm_cache_entry) * cache_size);
+    for (i = 0; i < old_size; i++) {
+        size_t j;
+
+        if (!old[i].mangled)
+            continue;
+        j = old[i].hash & (cache_size - 1);
+        while (cache[j].mangled)
+            j = (j + 1) & (cache_size - 1);
+        cache[j] = old[i];
+    }
+    xfree(old);
+}
+
+/* (OK)
+ * demangle with a cache keyed by hash of mangled name, template heavy
+ * programs repeat the same names over and over.
+ * @mangled: symbol name.
+ *
+ * @return: demangled name, or @mangled itself if it isn't mangled.
+ *          Valid until demangle_cache_free().
+ */
+const char *demangle(const char *mangled)
+{
+    struct dm_ctx tmp;
+    const char *s;
+    uint64_t hash;
+    size_t i;
+
+    if (mangled[0] != '_' || mangled[1] != 'Z')
+        return mangled;
+
+    if (cache_used * 2 >= cache_size)
+        dm_cache_grow();
+
+    hash = dm_hash(mangled);
+    for (i = hash & (cache_size - 1); cache[i].mangled;
+         i = (i + 1) & (cache_size - 1))
+        if (cache[i].hash == hash && !strcmp(cache[i].mangled, mangled))
+            return cache[i].demangled ? cache[i].demangled : mangled;
+
+    s = demangle_uncached(mangled);
+    tmp.arena = &cache_arena;
+    cache[i].hash = hash;
+    cache[i].mangled = dm_strndup(&tmp, mangled, strlen(mangled));
+    cache[i].demangled = s ? dm_strndup(&tmp, s, strlen(s)) : NULL;
+    cache_used++;
+    return s ? cache[i].demangled : mangled;
+}
+
+/* (OK)
+ * free demangle cache.
+ */
+void demangle_cache_free(void)
+{
+    xfree(cache);
+    cache = NULL;
+    cache_size = cache_used = 0;
+    dm_arena_free(&cache_arena);
+    dm_arena_free(&work_arena);
+}
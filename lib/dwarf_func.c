@@ -0,0 +1,308 @@
+/*
+ * DWARF function and inlined subroutine index
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <radix.h>
+#include <dwarf.h>
+
+/*
+ * Ranges of a unit nest: a function holds its inlined subroutines and
+ * they hold theirs. Both indexes are kept sorted by low address with
+ * a running maximum of high addresses, so a lookup is a binary search
+ * followed by a backward scan which stops as soon as no lower entry
+ * can reach the address.
+ */
+
+static void *func_grow(void *array, int *max, int need, size_t size)
+{
+    void *tmp;
+    int n;
+
+    if (need <= *max)
+        return array;
+    n = *max ? *max * 2 : 16;
+    while (n < need)
+        n *= 2;
+    tmp = xmalloc(size * n);
+    if (array) {
+        memcpy(tmp, array, size * *max);
+        xfree(array);
+    }
+    *max = n;
+    return tmp;
+}
+
+/*
+ * sort @n entries of @size bytes by their leading uint64_t low
+ * address and fill in running maximum of high addresses.
+ */
+static void func_sort(void *array, int n, size_t size)
+{
+    unsigned char *base = array, *sorted;
+    uint64_t *keys, max_high = 0;
+    uint32_t *index;
+    int i;
+
+    if (n < 2) {
+        if (n)
+            ((uint64_t *)base)[2] = ((uint64_t *)base)[1];
+        return;
+    }
+    keys = xmalloc(sizeof(uint64_t) * n);
+    index = xmalloc(sizeof(uint32_t) * n);
+    sorted = xmalloc(size * n);
+    for (i = 0; i < n; i++) {
+        keys[i] = *(uint64_t *)(base + size * i);
+        index[i] = i;
+    }
+    radix_sort_u64(keys, index, n);
+    for (i = 0; i < n; i++) {
+        uint64_t *entry = (uint64_t *)(sorted + size * i);
+
+        memcpy(entry, base + size * index[i], size);
+        /* low, high and max_high lead both entry types */
+        if (entry[1] > max_high)
+            max_high = entry[1];
+        entry[2] = max_high;
+    }
+    memcpy(base, sorted, size * n);
+    xfree(sorted);
+    xfree(keys);
+    xfree(index);
+}
+
+/*
+ * Index every subprogram with code of parsed unit.
+ */
+static void func_index(struct dwarf_info *di, struct dwarf_cu *cu)
+{
+    int func_max = 0, range_max = 0, i;
+
+    cu->funcs_read = 1;
+    for (i = 0; i < cu->die_numbers; i++) {
+        struct dwarf_die *die = &cu->dies[i];
+        struct dwarf_ranges it;
+        uint64_t low, high;
+        int first = 1;
+
+        if (die->abbrev->tag != DW_TAG_subprogram ||
+            dwarf_ranges_init(di, cu, die, &it) < 0)
+            continue;
+        while (dwarf_ranges_next(&it, &low, &high)) {
+            struct dwarf_func_range *range;
+
+            if (first) {
+                cu->funcs = func_grow(cu->funcs, &func_max,
+                                      cu->func_numbers + 1,
+                                      sizeof(struct dwarf_func));
+                memset(&cu->funcs[cu->func_numbers], 0,
+                       sizeof(struct dwarf_func));
+                cu->funcs[cu->func_numbers++].die = i;
+                first = 0;
+            }
+            cu->func_ranges = func_grow(cu->func_ranges, &range_max,
+                                        cu->func_range_numbers + 1,
+                                        sizeof(struct dwarf_func_range));
+            range = &cu->func_ranges[cu->func_range_numbers++];
+            range->low = low;
+            range->high = high;
+            /* function index until funcs stops moving */
+            range->func = (struct dwarf_func *)(uintptr_t)
+                          (cu->func_numbers - 1);
+        }
+    }
+    for (i = 0; i < cu->func_range_numbers; i++)
+        cu->func_ranges[i].func = cu->funcs +
+                                  (uintptr_t)cu->func_ranges[i].func;
+    func_sort(cu->func_ranges, cu->func_range_numbers,
+              sizeof(struct dwarf_func_range));
+}
+
+/* (OK)
+ * function of parsed unit covering address.
+ * @cu: unit, DIE tree must be parsed.
+ *
+ * @return: innermost function covering @address, NULL if none.
+ */
+struct dwarf_func *dwarf_cu_function(struct dwarf_info *di,
+                                     struct dwarf_cu *cu, uint64_t address)
+{
+    int lo = 0, hi, i;
+
+    if (!cu->funcs_read)
+        func_index(di, cu);
+    hi = cu->func_range_numbers;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (cu->func_ranges[mid].low <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (i = lo - 1; i >= 0 && cu->func_ranges[i].max_high > address; i--)
+        if (address < cu->func_ranges[i].high)
+            return cu->func_ranges[i].func;
+    return NULL;
+}
+
+/*
+ * Index inlined subroutines in subtree of function DIE.
+ */
+static void func_index_inlines(struct dwarf_info *di, struct dwarf_cu *cu,
+                               struct dwarf_func *func)
+{
+    int end = cu->dies[func->die].sibling, max = 0, i;
+
+    func->inlines_read = 1;
+    for (i = func->die + 1; i < end; i++) {
+        struct dwarf_die *die = &cu->dies[i];
+        struct dwarf_ranges it;
+        uint64_t low, high;
+        int depth = 1, p;
+
+        if (die->abbrev->tag != DW_TAG_inlined_subroutine ||
+            dwarf_ranges_init(di, cu, die, &it) < 0)
+            continue;
+        for (p = die->parent; p > func->die; p = cu->dies[p].parent)
+            if (cu->dies[p].abbrev->tag == DW_TAG_inlined_subroutine)
+                depth++;
+        while (dwarf_ranges_next(&it, &low, &high)) {
+            struct dwarf_inline *in;
+
+            func->inlines = func_grow(func->inlines, &max,
+                                      func->inline_numbers + 1,
+                                      sizeof(struct dwarf_inline));
+            in = &func->inlines[func->inline_numbers++];
+            in->low = low;
+            in->high = high;
+            in->die = i;
+            in->depth = depth;
+        }
+    }
+    func_sort(func->inlines, func->inline_numbers,
+              sizeof(struct dwarf_inline));
+}
+
+/* (OK)
+ * inlined subroutines of function covering address.
+ * @func: function from dwarf_cu_function().
+ * @chain: set to DIE indexes, innermost first.
+ * @max: room on @chain.
+ *
+ * @return: number of DIE indexes on @chain.
+ */
+int dwarf_func_inlines(struct dwarf_info *di, struct dwarf_cu *cu,
+                       struct dwarf_func *func, uint64_t address,
+                       int *chain, int max)
+{
+    int lo = 0, hi, i, n = 0;
+
+    if (!func->inlines_read)
+        func_index_inlines(di, cu, func);
+    hi = func->inline_numbers;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (func->inlines[mid].low <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /*
+     * one covering entry per depth, deeper ones go first and the
+     * shallowest are dropped when @chain is full.
+     */
+    for (i = lo - 1; i >= 0 && func->inlines[i].max_high > address; i--) {
+        struct dwarf_inline *in = &func->inlines[i];
+        int j;
+
+        if (address >= in->high || max < 1)
+            continue;
+        for (j = 0; j < n; j++)
+            if (func->inlines[chain[j]].depth == in->depth)
+                break;
+        if (j < n)
+            continue;
+        if (n == max) {
+            if (func->inlines[chain[n - 1]].depth >= in->depth)
+                continue;
+            n--;
+        }
+        for (j = n; j > 0 && func->inlines[chain[j - 1]].depth <
+                             in->depth; j--)
+            chain[j] = chain[j - 1];
+        chain[j] = i;
+        n++;
+    }
+    for (i = 0; i < n; i++)
+        chain[i] = func->inlines[chain[i]].die;
+    return n;
+}
+
+/* (OK)
+ * free function and inline indexes of unit.
+ */
+void dwarf_cu_funcs_free(struct dwarf_cu *cu)
+{
+    int i;
+
+    for (i = 0; i < cu->func_numbers; i++)
+        xfree(cu->funcs[i].inlines);
+    xfree(cu->funcs);
+    xfree(cu->func_ranges);
+    cu->funcs = NULL;
+    cu->func_ranges = NULL;
+    cu->func_numbers = 0;
+    cu->func_range_numbers = 0;
+    cu->funcs_read = 0;
+}
+
+/* (OK)
+ * name of DIE.
+ * @die: DIE of parsed unit.
+ *
+ * @return: linkage name if DIE has one, else its name, looked up
+ *          through DW_AT_abstract_origin and DW_AT_specification.
+ *          NULL if DIE is nameless.
+ */
+const char *dwarf_die_name(struct dwarf_info *di, struct dwarf_cu *cu,
+                           struct dwarf_die *die)
+{
+    struct dwarf_attr attr;
+    int hops;
+
+    for (hops = 0; die && hops < 8; hops++) {
+        if (!dwarf_die_attr(di, cu, die, DW_AT_linkage_name, &attr) ||
+            !dwarf_die_attr(di, cu, die, DW_AT_MIPS_linkage_name, &attr) ||
+            !dwarf_die_attr(di, cu, die, DW_AT_name, &attr))
+            return attr.str;
+        if (dwarf_die_attr(di, cu, die, DW_AT_abstract_origin, &attr) &&
+            dwarf_die_attr(di, cu, die, DW_AT_specification, &attr))
+            return NULL;
+        /* DW_FORM_ref_addr may point into another unit */
+        if (attr.value < cu->offset || attr.value >= cu->end) {
+            cu = dwarf_info_cu_by_offset(di, attr.value);
+            if (!cu || dwarf_cu_parse(di, cu) < 0)
+                return NULL;
+        }
+        die = dwarf_cu_die(cu, attr.value);
+    }
+    return NULL;
+}
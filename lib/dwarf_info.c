@@ -0,0 +1,1317 @@
+/*
+ * DWARF .debug_info lazy index
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <radix.h>
+#include <dwarf.h>
+
+/* --------------------------------------------------------------
+ *   dwarf_info_alloc()
+ *       | unit headers, abbreviation tables
+ *   dwarf_info_cu_by_address() / dwarf_info_lookup_name()
+ *       | .debug_aranges / .debug_names, unit DIE ranges
+ *   dwarf_cu_parse()
+ *       | DIE tree of the units a query touches
+ *   dwarf_die_attr()
+ *       | attribute values read from the mapping
+ * --------------------------------------------------------------
+ */
+
+static void dwarf_section_get(struct elf_file *ef, const char *name,
+                              struct dwarf_section *sec)
+{
+    Elf32_Shdr *st = elf_file_section_by_name(ef, name);
+
+    sec->data = st ? elf_file_section_contents(ef, st) : NULL;
+    sec->size = sec->data ? st->sh_size : 0;
+}
+
+static void dwarf_reader_at(struct dwarf_reader *r,
+                            struct dwarf_section *sec, uint64_t offset)
+{
+    if (offset > sec->size) {
+        r->p = r->end = sec->data;
+        r->err = 1;
+        return;
+    }
+    r->p = sec->data + offset;
+    r->end = sec->data + sec->size;
+    r->err = 0;
+}
+
+static const char *dwarf_section_str(struct dwarf_section *sec,
+                                     uint64_t offset)
+{
+    const char *s = (const char *)sec->data;
+
+    if (offset >= sec->size || !memchr(s + offset, 0, sec->size - offset))
+        return NULL;
+    return s + offset;
+}
+
+/*
+ * Read value of @form.
+ * @cu: unit giving address and offset sizes, references are made
+ *      absolute against it.
+ *
+ * @return: 0 on success, -1 on unknown form or truncated data.
+ */
+static int dwarf_form_read(struct dwarf_info *di, struct dwarf_cu *cu,
+                           struct dwarf_reader *r, uint32_t form,
+                           int64_t implicit_const, struct dwarf_attr *attr)
+{
+    attr->form = form;
+    attr->value = 0;
+    attr->str = NULL;
+    attr->block = NULL;
+
+    switch (form) {
+    case DW_FORM_addr:
+        attr->value = dwarf_read_u(r, cu->addr_size);
+        break;
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        attr->value = dwarf_read_u(r, 1);
+        break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        attr->value = dwarf_read_u(r, 2);
+        break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        attr->value = dwarf_read_u(r, 3);
+        break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        attr->value = dwarf_read_u(r, 4);
+        break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        attr->value = dwarf_read_u(r, 8);
+        break;
+    case DW_FORM_data16:
+        attr->block = r->p;
+        attr->value = 16;
+        dwarf_read_u(r, 8);
+        dwarf_read_u(r, 8);
+        break;
+    case DW_FORM_sdata:
+        attr->value = dwarf_read_sleb(r);
+        break;
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+        attr->value = dwarf_read_uleb(r);
+        break;
+    case DW_FORM_ref_addr:
+        attr->value = dwarf_read_u(r, cu->version <= 2 ? cu->addr_size :
+                                   cu->offset_size);
+        break;
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp_sup:
+        attr->value = dwarf_read_u(r, cu->offset_size);
+        break;
+    case DW_FORM_strp:
+        attr->value = dwarf_read_u(r, cu->offset_size);
+        attr->str = dwarf_section_str(&di->str, attr->value);
+        break;
+    case DW_FORM_line_strp:
+        attr->value = dwarf_read_u(r, cu->offset_size);
+        attr->str = dwarf_section_str(&di->line_str, attr->value);
+        break;
+    case DW_FORM_string:
+        attr->str = dwarf_read_str(r);
+        break;
+    case DW_FORM_flag_present:
+        attr->value = 1;
+        break;
+    case DW_FORM_implicit_const:
+        attr->value = implicit_const;
+        break;
+    case DW_FORM_block1:
+    case DW_FORM_block2:
+    case DW_FORM_block4:
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+        if (form == DW_FORM_block1)
+            attr->value = dwarf_read_u(r, 1);
+        else if (form == DW_FORM_block2)
+            attr->value = dwarf_read_u(r, 2);
+        else if (form == DW_FORM_block4)
+            attr->value = dwarf_read_u(r, 4);
+        else
+            attr->value = dwarf_read_uleb(r);
+        if (attr->value > (uint64_t)(r->end - r->p)) {
+            r->err = 1;
+            return -1;
+        }
+        attr->block = r->p;
+        r->p += attr->value;
+        break;
+    case DW_FORM_indirect:
+        form = dwarf_read_uleb(r);
+        if (r->err || form == DW_FORM_indirect)
+            return -1;
+        return dwarf_form_read(di, cu, r, form, implicit_const, attr);
+    default:
+        return -1;
+    }
+
+    /* unit relative references become .debug_info offsets */
+    switch (form) {
+    case DW_FORM_ref1:
+    case DW_FORM_ref2:
+    case DW_FORM_ref4:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_udata:
+        attr->value += cu->offset;
+        break;
+    }
+    return r->err ? -1 : 0;
+}
+
+/*
+ * Skip value of @form, the inner loop of DIE tree parsing.
+ */
+static int dwarf_form_skip(struct dwarf_cu *cu, struct dwarf_reader *r,
+                           uint32_t form)
+{
+    uint64_t size;
+
+    switch (form) {
+    case DW_FORM_flag_present:
+    case DW_FORM_implicit_const:
+        return 0;
+    case DW_FORM_data1:
+    case DW_FORM_ref1:
+    case DW_FORM_flag:
+    case DW_FORM_strx1:
+    case DW_FORM_addrx1:
+        size = 1;
+        break;
+    case DW_FORM_data2:
+    case DW_FORM_ref2:
+    case DW_FORM_strx2:
+    case DW_FORM_addrx2:
+        size = 2;
+        break;
+    case DW_FORM_strx3:
+    case DW_FORM_addrx3:
+        size = 3;
+        break;
+    case DW_FORM_data4:
+    case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
+    case DW_FORM_strx4:
+    case DW_FORM_addrx4:
+        size = 4;
+        break;
+    case DW_FORM_data8:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
+        size = 8;
+        break;
+    case DW_FORM_data16:
+        size = 16;
+        break;
+    case DW_FORM_addr:
+        size = cu->addr_size;
+        break;
+    case DW_FORM_ref_addr:
+        size = cu->version <= 2 ? cu->addr_size : cu->offset_size;
+        break;
+    case DW_FORM_sec_offset:
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+        size = cu->offset_size;
+        break;
+    case DW_FORM_sdata:
+    case DW_FORM_udata:
+    case DW_FORM_ref_udata:
+    case DW_FORM_strx:
+    case DW_FORM_addrx:
+    case DW_FORM_loclistx:
+    case DW_FORM_rnglistx:
+        dwarf_read_uleb(r);
+        return r->err ? -1 : 0;
+    case DW_FORM_string:
+        dwarf_read_str(r);
+        return r->err ? -1 : 0;
+    case DW_FORM_block1:
+        size = dwarf_read_u(r, 1);
+        break;
+    case DW_FORM_block2:
+        size = dwarf_read_u(r, 2);
+        break;
+    case DW_FORM_block4:
+        size = dwarf_read_u(r, 4);
+        break;
+    case DW_FORM_block:
+    case DW_FORM_exprloc:
+        size = dwarf_read_uleb(r);
+        break;
+    case DW_FORM_indirect:
+        form = dwarf_read_uleb(r);
+        if (r->err || form == DW_FORM_indirect)
+            return -1;
+        return dwarf_form_skip(cu, r, form);
+    default:
+        return -1;
+    }
+    if (r->err || size > (uint64_t)(r->end - r->p)) {
+        r->err = 1;
+        return -1;
+    }
+    r->p += size;
+    return 0;
+}
+
+/*
+ * Parse abbreviation table at @table->offset. Counted first so one
+ * allocation holds every attribute specification of the table.
+ */
+static int dwarf_abbrev_parse(struct dwarf_info *di,
+                              struct dwarf_abbrev_table *table)
+{
+    struct dwarf_reader r;
+    int abbrevs = 0, attrs = 0, i, a;
+
+    dwarf_reader_at(&r, &di->abbrev, table->offset);
+    while (!r.err && dwarf_read_uleb(&r)) {
+        dwarf_read_uleb(&r);
+        dwarf_read_u(&r, 1);
+        for (;;) {
+            uint64_t name = dwarf_read_uleb(&r);
+            uint64_t form = dwarf_read_uleb(&r);
+
+            if (r.err || (!name && !form))
+                break;
+            if (form == DW_FORM_implicit_const)
+                dwarf_read_sleb(&r);
+            attrs++;
+        }
+        abbrevs++;
+    }
+    if (r.err)
+        return -1;
+
+    table->abbrevs = xmalloc(sizeof(struct dwarf_abbrev) *
+                             (abbrevs ? abbrevs : 1));
+    table->attrs = xmalloc(sizeof(struct dwarf_abbrev_attr) *
+                           (attrs ? attrs : 1));
+    table->abbrev_numbers = abbrevs;
+    table->dense = 1;
+
+    dwarf_reader_at(&r, &di->abbrev, table->offset);
+    for (i = 0, a = 0; i < abbrevs; i++) {
+        struct dwarf_abbrev *ab = &table->abbrevs[i];
+
+        ab->code = dwarf_read_uleb(&r);
+        ab->tag = dwarf_read_uleb(&r);
+        ab->has_children = dwarf_read_u(&r, 1);
+        ab->attrs = &table->attrs[a];
+        ab->attr_numbers = 0;
+        for (;;) {
+            uint64_t name = dwarf_read_uleb(&r);
+            uint64_t form = dwarf_read_uleb(&r);
+            struct dwarf_abbrev_attr *spec;
+
+            /* terminator was not counted, it has no slot */
+            if (!name && !form)
+                break;
+            spec = &table->attrs[a++];
+            spec->name = name;
+            spec->form = form;
+            spec->implicit_const = form == DW_FORM_implicit_const ?
+                                   dwarf_read_sleb(&r) : 0;
+            ab->attr_numbers++;
+        }
+        if (ab->code != (uint64_t)i + 1)
+            table->dense = 0;
+    }
+    return 0;
+}
+
+static struct dwarf_abbrev *dwarf_abbrev_find(struct dwarf_abbrev_table *t,
+                                              uint64_t code)
+{
+    int i;
+
+    if (t->dense)
+        return code && code <= (uint64_t)t->abbrev_numbers ?
+               &t->abbrevs[code - 1] : NULL;
+    for (i = 0; i < t->abbrev_numbers; i++)
+        if (t->abbrevs[i].code == code)
+            return &t->abbrevs[i];
+    return NULL;
+}
+
+/*
+ * Read unit header at @offset.
+ * @return: 0 on success, -1 if header is malformed.
+ */
+static int dwarf_cu_header(struct dwarf_info *di, uint64_t offset,
+                           struct dwarf_cu *cu, uint64_t *abbrev_offset)
+{
+    struct dwarf_reader r;
+    uint64_t length;
+
+    memset(cu, 0, sizeof(*cu));
+    cu->offset = offset;
+    cu->offset_size = 4;
+    dwarf_reader_at(&r, &di->info, offset);
+    length = dwarf_read_u(&r, 4);
+    if (length == 0xffffffff) {
+        length = dwarf_read_u(&r, 8);
+        cu->offset_size = 8;
+    }
+    if (r.err || length > (uint64_t)(r.end - r.p))
+        return -1;
+    cu->end = (r.p - di->info.data) + length;
+
+    cu->version = dwarf_read_u(&r, 2);
+    if (cu->version < 2 || cu->version > 5)
+        return -1;
+    if (cu->version >= 5) {
+        cu->unit_type = dwarf_read_u(&r, 1);
+        cu->addr_size = dwarf_read_u(&r, 1);
+        *abbrev_offset = dwarf_read_u(&r, cu->offset_size);
+        switch (cu->unit_type) {
+        case DW_UT_skeleton:
+        case DW_UT_split_compile:
+            /* dwo_id */
+            dwarf_read_u(&r, 8);
+            break;
+        case DW_UT_type:
+        case DW_UT_split_type:
+            /* type_signature and type_offset */
+            dwarf_read_u(&r, 8);
+            dwarf_read_u(&r, cu->offset_size);
+            break;
+        }
+    } else {
+        cu->unit_type = DW_UT_compile;
+        *abbrev_offset = dwarf_read_u(&r, cu->offset_size);
+        cu->addr_size = dwarf_read_u(&r, 1);
+    }
+    if (r.err || (cu->addr_size != 4 && cu->addr_size != 8))
+        return -1;
+    cu->die_offset = r.p - di->info.data;
+    return 0;
+}
+
+/*
+ * Index units of .debug_info. Abbreviation offsets are radix sorted
+ * so each table is parsed once however many units share it.
+ */
+static int dwarf_index_units(struct dwarf_info *di)
+{
+    uint64_t offset = 0, *keys;
+    uint32_t *index;
+    int cu_max = 0, i, n;
+
+    while (offset < di->info.size) {
+        struct dwarf_cu cu;
+        uint64_t abbrev_offset;
+
+        if (dwarf_cu_header(di, offset, &cu, &abbrev_offset) < 0)
+            break;
+        if (di->cu_numbers == cu_max) {
+            struct dwarf_cu *tmp;
+
+            cu_max = cu_max ? cu_max * 2 : 16;
+            tmp = xmalloc(sizeof(struct dwarf_cu) * cu_max);
+            if (di->cus) {
+                memcpy(tmp, di->cus, sizeof(struct dwarf_cu) *
+                       di->cu_numbers);
+                xfree(di->cus);
+            }
+            di->cus = tmp;
+        }
+        /* abbreviation offset parked until tables exist */
+        cu.low_pc = abbrev_offset;
+        di->cus[di->cu_numbers++] = cu;
+        offset = cu.end;
+    }
+
+    n = di->cu_numbers;
+    if (!n)
+        return -1;
+    keys = xmalloc(sizeof(uint64_t) * n);
+    index = xmalloc(sizeof(uint32_t) * n);
+    for (i = 0; i < n; i++) {
+        keys[i] = di->cus[i].low_pc;
+        index[i] = i;
+    }
+    radix_sort_u64(keys, index, n);
+
+    di->tables = xmalloc(sizeof(struct dwarf_abbrev_table) * n);
+    for (i = 0; i < n; i++) {
+        struct dwarf_abbrev_table *t;
+        struct dwarf_cu *cu = &di->cus[index[i]];
+
+        if (!i || keys[i] != keys[i - 1]) {
+            t = &di->tables[di->table_numbers];
+            memset(t, 0, sizeof(*t));
+            t->offset = keys[i];
+            if (dwarf_abbrev_parse(di, t) < 0) {
+                xfree(t->abbrevs);
+                xfree(t->attrs);
+                t->abbrevs = NULL;
+                t->attrs = NULL;
+                t->abbrev_numbers = 0;
+            }
+            di->table_numbers++;
+        }
+        cu->abbrevs = &di->tables[di->table_numbers - 1];
+        cu->low_pc = 0;
+    }
+    xfree(keys);
+    xfree(index);
+    return 0;
+}
+
+/*
+ * Read attribute @name of DIE at @offset without DIE tree.
+ * @return: 0 if DIE has attribute.
+ */
+static int dwarf_attr_at(struct dwarf_info *di, struct dwarf_cu *cu,
+                         uint64_t offset, struct dwarf_abbrev *ab,
+                         uint32_t name, struct dwarf_attr *attr)
+{
+    struct dwarf_reader r;
+    uint64_t code;
+    int i;
+
+    dwarf_reader_at(&r, &di->info, offset);
+    r.end = di->info.data + cu->end;
+    code = dwarf_read_uleb(&r);
+    if (!ab)
+        ab = dwarf_abbrev_find(cu->abbrevs, code);
+    if (!ab)
+        return -1;
+    for (i = 0; i < ab->attr_numbers; i++) {
+        struct dwarf_abbrev_attr *spec = &ab->attrs[i];
+
+        if (spec->name == name) {
+            attr->name = name;
+            return dwarf_form_read(di, cu, &r, spec->form,
+                                   spec->implicit_const, attr);
+        }
+        if (dwarf_form_skip(cu, &r, spec->form) < 0)
+            return -1;
+    }
+    return -1;
+}
+
+/*
+ * Base offsets of unit DIE, needed before strx, addrx or rnglistx
+ * values of the unit can be resolved.
+ */
+static void dwarf_cu_root(struct dwarf_info *di, struct dwarf_cu *cu)
+{
+    struct dwarf_attr attr;
+
+    if (cu->root_read)
+        return;
+    cu->root_read = 1;
+    if (!dwarf_attr_at(di, cu, cu->die_offset, NULL,
+                       DW_AT_str_offsets_base, &attr))
+        cu->str_offsets_base = attr.value;
+    else if (cu->version >= 5)
+        cu->str_offsets_base = cu->offset_size == 8 ? 16 : 8;
+    if (!dwarf_attr_at(di, cu, cu->die_offset, NULL, DW_AT_addr_base, &attr))
+        cu->addr_base = attr.value;
+    if (!dwarf_attr_at(di, cu, cu->die_offset, NULL,
+                       DW_AT_rnglists_base, &attr))
+        cu->rnglists_base = attr.value;
+    if (!dwarf_attr_at(di, cu, cu->die_offset, NULL, DW_AT_low_pc, &attr)) {
+        if (attr.form == DW_FORM_addr) {
+            cu->low_pc = attr.value;
+        } else {
+            struct dwarf_reader r;
+
+            dwarf_reader_at(&r, &di->addr, cu->addr_base +
+                            attr.value * cu->addr_size);
+            cu->low_pc = dwarf_read_u(&r, cu->addr_size);
+        }
+    }
+}
+
+/*
+ * resolve indexed forms of @attr against unit bases
+ */
+static void dwarf_attr_resolve(struct dwarf_info *di, struct dwarf_cu *cu,
+                               struct dwarf_attr *attr)
+{
+    struct dwarf_reader r;
+
+    switch (attr->form) {
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4:
+        dwarf_cu_root(di, cu);
+        dwarf_reader_at(&r, &di->str_offsets, cu->str_offsets_base +
+                        attr->value * cu->offset_size);
+        attr->str = dwarf_section_str(&di->str,
+                                      dwarf_read_u(&r, cu->offset_size));
+        break;
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+        dwarf_cu_root(di, cu);
+        dwarf_reader_at(&r, &di->addr, cu->addr_base +
+                        attr->value * cu->addr_size);
+        attr->value = dwarf_read_u(&r, cu->addr_size);
+        break;
+    }
+}
+
+static uint64_t dwarf_addrx(struct dwarf_info *di, struct dwarf_cu *cu,
+                            uint64_t index)
+{
+    struct dwarf_reader r;
+
+    dwarf_reader_at(&r, &di->addr, cu->addr_base + index * cu->addr_size);
+    return dwarf_read_u(&r, cu->addr_size);
+}
+
+/*
+ * Ranges of DIE at @offset, from low_pc/high_pc or DW_AT_ranges.
+ */
+static int dwarf_ranges_at(struct dwarf_info *di, struct dwarf_cu *cu,
+                           uint64_t offset, struct dwarf_abbrev *ab,
+                           struct dwarf_ranges *it)
+{
+    struct dwarf_attr attr;
+
+    memset(it, 0, sizeof(*it));
+    it->di = di;
+    it->cu = cu;
+    dwarf_cu_root(di, cu);
+    it->base = cu->low_pc;
+
+    if (!dwarf_attr_at(di, cu, offset, ab, DW_AT_ranges, &attr)) {
+        uint64_t off = attr.value;
+
+        if (cu->version < 5) {
+            it->kind = 1;
+            dwarf_reader_at(&it->r, &di->ranges, off);
+            return it->r.err ? -1 : 0;
+        }
+        if (attr.form == DW_FORM_rnglistx) {
+            struct dwarf_reader r;
+
+            dwarf_reader_at(&r, &di->rnglists, cu->rnglists_base +
+                            off * cu->offset_size);
+            off = cu->rnglists_base + dwarf_read_u(&r, cu->offset_size);
+        }
+        it->kind = 2;
+        dwarf_reader_at(&it->r, &di->rnglists, off);
+        return it->r.err ? -1 : 0;
+    }
+
+    if (dwarf_attr_at(di, cu, offset, ab, DW_AT_low_pc, &attr))
+        return -1;
+    dwarf_attr_resolve(di, cu, &attr);
+    it->low = attr.value;
+    if (dwarf_attr_at(di, cu, offset, ab, DW_AT_high_pc, &attr))
+        return -1;
+    dwarf_attr_resolve(di, cu, &attr);
+    /* DWARF 4 high_pc of constant class is a length */
+    it->high = attr.form == DW_FORM_addr || attr.form == DW_FORM_addrx ||
+               (attr.form >= DW_FORM_addrx1 && attr.form <= DW_FORM_addrx4) ?
+               attr.value : it->low + attr.value;
+    return 0;
+}
+
+/* (OK)
+ * start walking address ranges of DIE.
+ * @it: iterator to fill.
+ *
+ * @return: 0 on success, -1 if DIE covers no code.
+ */
+int dwarf_ranges_init(struct dwarf_info *di, struct dwarf_cu *cu,
+                      struct dwarf_die *die, struct dwarf_ranges *it)
+{
+    return dwarf_ranges_at(di, cu, die->offset, die->abbrev, it);
+}
+
+/* (OK)
+ * next address range.
+ * @it: iterator set up by dwarf_ranges_init().
+ * @low: set to first address of range.
+ * @high: set to first address past range.
+ *
+ * @return: 1 if a range was returned, 0 when exhausted.
+ */
+int dwarf_ranges_next(struct dwarf_ranges *it, uint64_t *low,
+                      uint64_t *high)
+{
+    struct dwarf_reader *r = &it->r;
+    int size = it->cu->addr_size;
+    uint64_t max = size == 8 ? ~(uint64_t)0 : 0xffffffff;
+
+    if (it->kind == 0) {
+        it->kind = -1;
+        *low = it->low;
+        *high = it->high;
+        return *low < *high;
+    }
+
+    while (it->kind == 1 && !r->err) {
+        uint64_t a = dwarf_read_u(r, size);
+        uint64_t b = dwarf_read_u(r, size);
+
+        if (r->err || (!a && !b))
+            break;
+        if (a == max) {
+            it->base = b;
+            continue;
+        }
+        if (a == b)
+            continue;
+        *low = it->base + a;
+        *high = it->base + b;
+        return 1;
+    }
+
+    while (it->kind == 2 && !r->err) {
+        uint64_t a, b;
+
+        switch (dwarf_read_u(r, 1)) {
+        case DW_RLE_base_addressx:
+            it->base = dwarf_addrx(it->di, it->cu, dwarf_read_uleb(r));
+            continue;
+        case DW_RLE_startx_endx:
+            a = dwarf_addrx(it->di, it->cu, dwarf_read_uleb(r));
+            b = dwarf_addrx(it->di, it->cu, dwarf_read_uleb(r));
+            break;
+        case DW_RLE_startx_length:
+            a = dwarf_addrx(it->di, it->cu, dwarf_read_uleb(r));
+            b = a + dwarf_read_uleb(r);
+            break;
+        case DW_RLE_offset_pair:
+            a = it->base + dwarf_read_uleb(r);
+            b = it->base + dwarf_read_uleb(r);
+            break;
+        case DW_RLE_base_address:
+            it->base = dwarf_read_u(r, size);
+            continue;
+        case DW_RLE_start_end:
+            a = dwarf_read_u(r, size);
+            b = dwarf_read_u(r, size);
+            break;
+        case DW_RLE_start_length:
+            a = dwarf_read_u(r, size);
+            b = a + dwarf_read_uleb(r);
+            break;
+        default:
+            it->kind = -1;
+            return 0;
+        }
+        if (r->err)
+            break;
+        if (a == b)
+            continue;
+        *low = a;
+        *high = b;
+        return 1;
+    }
+    it->kind = -1;
+    return 0;
+}
+
+/* (OK)
+ * whether address is covered by DIE.
+ */
+int dwarf_die_contains(struct dwarf_info *di, struct dwarf_cu *cu,
+                       struct dwarf_die *die, uint64_t address)
+{
+    struct dwarf_ranges it;
+    uint64_t low, high;
+
+    if (dwarf_ranges_init(di, cu, die, &it) < 0)
+        return 0;
+    while (dwarf_ranges_next(&it, &low, &high))
+        if (address >= low && address < high)
+            return 1;
+    return 0;
+}
+
+static void dwarf_arange_add(struct dwarf_arange **table, int *numbers,
+                             int *max, uint64_t low, uint64_t high, int cu)
+{
+    if (*numbers == *max) {
+        struct dwarf_arange *tmp;
+
+        *max = *max ? *max * 2 : 64;
+        tmp = xmalloc(sizeof(struct dwarf_arange) * *max);
+        if (*table) {
+            memcpy(tmp, *table, sizeof(struct dwarf_arange) * *numbers);
+            xfree(*table);
+        }
+        *table = tmp;
+    }
+    (*table)[*numbers].low = low;
+    (*table)[*numbers].high = high;
+    (*table)[*numbers].cu = cu;
+    (*numbers)++;
+}
+
+/*
+ * Build address to unit table, .debug_aranges first and unit DIE
+ * ranges of the units it doesn't list, e.g. when it's missing.
+ */
+static void dwarf_aranges_read(struct dwarf_info *di)
+{
+    struct dwarf_arange *table = NULL, *sorted;
+    struct dwarf_reader r;
+    char *listed;
+    uint64_t *keys;
+    uint32_t *index;
+    int numbers = 0, max = 0, i;
+
+    di->aranges_read = 1;
+    listed = xmalloc(di->cu_numbers);
+    memset(listed, 0, di->cu_numbers);
+
+    dwarf_reader_at(&r, &di->aranges, 0);
+    while (di->aranges.size && r.p < r.end && !r.err) {
+        const unsigned char *start = r.p;
+        struct dwarf_reader unit;
+        struct dwarf_cu *cu;
+        uint64_t length;
+        int offset_size = 4, addr_size, tuple;
+
+        length = dwarf_read_u(&r, 4);
+        if (length == 0xffffffff) {
+            length = dwarf_read_u(&r, 8);
+            offset_size = 8;
+        }
+        if (r.err || length > (uint64_t)(r.end - r.p))
+            break;
+        unit.p = r.p;
+        unit.end = r.p + length;
+        unit.err = 0;
+        r.p = unit.end;
+
+        dwarf_read_u(&unit, 2);
+        cu = dwarf_info_cu_by_offset(di, dwarf_read_u(&unit, offset_size));
+        addr_size = dwarf_read_u(&unit, 1);
+        dwarf_read_u(&unit, 1);
+        if (unit.err || !cu || (addr_size != 4 && addr_size != 8))
+            continue;
+        /* tuples are aligned to twice the address size */
+        tuple = 2 * addr_size;
+        unit.p = start + ((unit.p - start + tuple - 1) / tuple) * tuple;
+
+        while (!unit.err) {
+            uint64_t addr = dwarf_read_u(&unit, addr_size);
+            uint64_t len = dwarf_read_u(&unit, addr_size);
+
+            if (unit.err || (!addr && !len))
+                break;
+            if (len)
+                dwarf_arange_add(&table, &numbers, &max, addr, addr + len,
+                                 cu - di->cus);
+        }
+        listed[cu - di->cus] = 1;
+    }
+
+    for (i = 0; i < di->cu_numbers; i++) {
+        struct dwarf_ranges it;
+        uint64_t low, high;
+
+        if (listed[i] || dwarf_ranges_at(di, &di->cus[i],
+                                         di->cus[i].die_offset, NULL, &it))
+            continue;
+        while (dwarf_ranges_next(&it, &low, &high))
+            dwarf_arange_add(&table, &numbers, &max, low, high, i);
+    }
+    xfree(listed);
+
+    keys = xmalloc(sizeof(uint64_t) * (numbers ? numbers : 1));
+    index = xmalloc(sizeof(uint32_t) * (numbers ? numbers : 1));
+    sorted = xmalloc(sizeof(struct dwarf_arange) * (numbers ? numbers : 1));
+    for (i = 0; i < numbers; i++) {
+        keys[i] = table[i].low;
+        index[i] = i;
+    }
+    radix_sort_u64(keys, index, numbers);
+    for (i = 0; i < numbers; i++)
+        sorted[i] = table[index[i]];
+    xfree(keys);
+    xfree(index);
+    xfree(table);
+    di->arange_table = sorted;
+    di->arange_numbers = numbers;
+}
+
+/* (OK)
+ * unit containing .debug_info offset.
+ * @return: unit, NULL if offset is outside every unit.
+ */
+struct dwarf_cu *dwarf_info_cu_by_offset(struct dwarf_info *di,
+                                         uint64_t offset)
+{
+    int lo = 0, hi = di->cu_numbers;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (di->cus[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo || offset >= di->cus[lo - 1].end)
+        return NULL;
+    return &di->cus[lo - 1];
+}
+
+/* (OK)
+ * unit whose code covers address.
+ * @return: unit, NULL if no unit covers @address.
+ */
+struct dwarf_cu *dwarf_info_cu_by_address(struct dwarf_info *di,
+                                          uint64_t address)
+{
+    int lo = 0, hi, i;
+
+    if (!di->aranges_read)
+        dwarf_aranges_read(di);
+    hi = di->arange_numbers;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (di->arange_table[mid].low <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    /* ranges of relocatable objects all start at zero */
+    for (i = lo - 1; i >= 0; i--)
+        if (address < di->arange_table[i].high)
+            return &di->cus[di->arange_table[i].cu];
+    return NULL;
+}
+
+/*
+ * DJB hash of .debug_names
+ */
+static uint32_t dwarf_names_hash(const char *name)
+{
+    uint32_t h = 5381;
+
+    while (*name)
+        h = h * 33 + (unsigned char)*name++;
+    return h;
+}
+
+/*
+ * Find entry for @name in one .debug_names unit.
+ * @return: 0 on success, -1 if not found.
+ */
+static int dwarf_names_unit(struct dwarf_info *di, struct dwarf_reader *r,
+                            int offset_size, const char *name,
+                            struct dwarf_cu **cup, uint64_t *die_offset)
+{
+    uint32_t cus, ltus, ftus, buckets, names, abbrev_size, aug_size;
+    const unsigned char *cu_list, *bucket_list, *hash_list, *str_list,
+                        *entry_list, *abbrev_table, *pool;
+    struct dwarf_cu form_cu;
+    uint32_t hash = dwarf_names_hash(name), i, first, last;
+
+    dwarf_read_u(r, 2);
+    dwarf_read_u(r, 2);
+    cus = dwarf_read_u(r, 4);
+    ltus = dwarf_read_u(r, 4);
+    ftus = dwarf_read_u(r, 4);
+    buckets = dwarf_read_u(r, 4);
+    names = dwarf_read_u(r, 4);
+    abbrev_size = dwarf_read_u(r, 4);
+    aug_size = dwarf_read_u(r, 4);
+    if (r->err || aug_size > (uint64_t)(r->end - r->p))
+        return -1;
+    r->p += aug_size;
+
+    cu_list = r->p;
+    bucket_list = cu_list + (uint64_t)(cus + ltus) * offset_size +
+                  (uint64_t)ftus * 8;
+    hash_list = bucket_list + (uint64_t)buckets * 4;
+    str_list = hash_list + (buckets ? (uint64_t)names * 4 : 0);
+    entry_list = str_list + (uint64_t)names * offset_size;
+    abbrev_table = entry_list + (uint64_t)names * offset_size;
+    pool = abbrev_table + abbrev_size;
+    if (pool > r->end || pool < cu_list)
+        return -1;
+
+    if (buckets) {
+        struct dwarf_reader b = { bucket_list + (hash % buckets) * 4,
+                                  hash_list, 0 };
+
+        first = dwarf_read_u(&b, 4);
+        if (!first)
+            return -1;
+        last = names;
+    } else {
+        first = 1;
+        last = names;
+    }
+
+    /* entry attributes use unit sizes, no address forms occur */
+    memset(&form_cu, 0, sizeof(form_cu));
+    form_cu.offset_size = offset_size;
+    form_cu.addr_size = 8;
+    form_cu.version = 5;
+
+    for (i = first; i <= last; i++) {
+        struct dwarf_reader s, e, a;
+        uint64_t code;
+
+        if (buckets) {
+            struct dwarf_reader h = { hash_list + (i - 1) * 4, str_list, 0 };
+            uint32_t hi = dwarf_read_u(&h, 4);
+
+            if (hi % buckets != hash % buckets)
+                break;
+            if (hi != hash)
+                continue;
+        }
+        s.p = str_list + (uint64_t)(i - 1) * offset_size;
+        s.end = entry_list;
+        s.err = 0;
+        {
+            const char *str = dwarf_section_str(&di->str,
+                                                dwarf_read_u(&s, offset_size));
+
+            if (!str || strcmp(str, name))
+                continue;
+        }
+
+        e.p = entry_list + (uint64_t)(i - 1) * offset_size;
+        e.end = abbrev_table;
+        e.err = 0;
+        e.p = pool + dwarf_read_u(&e, offset_size);
+        e.end = r->end;
+        if (e.err || e.p >= e.end)
+            return -1;
+
+        /* first entry of the name which has a DIE offset */
+        while ((code = dwarf_read_uleb(&e)) && !e.err) {
+            uint64_t cu_index = 0, die = 0;
+            int has_die = 0;
+
+            a.p = abbrev_table;
+            a.end = pool;
+            a.err = 0;
+            for (;;) {
+                uint64_t c = dwarf_read_uleb(&a);
+
+                if (!c || a.err)
+                    return -1;
+                dwarf_read_uleb(&a);
+                if (c == code)
+                    break;
+                while (!a.err && (dwarf_read_uleb(&a) | dwarf_read_uleb(&a)))
+                    ;
+            }
+            for (;;) {
+                uint64_t idx = dwarf_read_uleb(&a);
+                uint64_t form = dwarf_read_uleb(&a);
+                struct dwarf_attr attr;
+
+                if (a.err || (!idx && !form))
+                    break;
+                if (dwarf_form_read(di, &form_cu, &e, form, 0, &attr) < 0)
+                    return -1;
+                if (idx == DW_IDX_compile_unit) {
+                    cu_index = attr.value;
+                } else if (idx == DW_IDX_die_offset) {
+                    die = attr.value;
+                    has_die = 1;
+                }
+            }
+            if (has_die && cu_index < cus) {
+                struct dwarf_reader c = { cu_list + cu_index * offset_size,
+                                          bucket_list, 0 };
+                uint64_t cu_offset = dwarf_read_u(&c, offset_size);
+
+                *cup = dwarf_info_cu_by_offset(di, cu_offset);
+                if (!*cup)
+                    return -1;
+                *die_offset = cu_offset + die;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    return -1;
+}
+
+/* (OK)
+ * find name on .debug_names.
+ * @name: name to find.
+ * @cu: set to unit of DIE.
+ * @die_offset: set to .debug_info offset of DIE.
+ *
+ * @return: 0 on success, -1 if file has no index or name isn't in it.
+ */
+int dwarf_info_lookup_name(struct dwarf_info *di, const char *name,
+                           struct dwarf_cu **cu, uint64_t *die_offset)
+{
+    struct dwarf_reader r;
+
+    dwarf_reader_at(&r, &di->names, 0);
+    while (di->names.size && r.p < r.end && !r.err) {
+        struct dwarf_reader unit;
+        uint64_t length;
+        int offset_size = 4;
+
+        length = dwarf_read_u(&r, 4);
+        if (length == 0xffffffff) {
+            length = dwarf_read_u(&r, 8);
+            offset_size = 8;
+        }
+        if (r.err || length > (uint64_t)(r.end - r.p))
+            break;
+        unit.p = r.p;
+        unit.end = r.p + length;
+        unit.err = 0;
+        r.p = unit.end;
+        if (!dwarf_names_unit(di, &unit, offset_size, name, cu, die_offset))
+            return 0;
+    }
+    return -1;
+}
+
+/* (OK)
+ * parse DIE tree of unit.
+ * @return: 0 on success, -1 if unit is malformed.
+ */
+int dwarf_cu_parse(struct dwarf_info *di, struct dwarf_cu *cu)
+{
+    struct dwarf_reader r;
+    struct dwarf_die *dies;
+    int *stack, depth = 0, stack_max = 16, die_max, n = 0;
+
+    if (cu->dies)
+        return 0;
+    if (!cu->abbrevs || !cu->abbrevs->abbrev_numbers)
+        return -1;
+
+    dwarf_reader_at(&r, &di->info, cu->die_offset);
+    r.end = di->info.data + cu->end;
+    /* a DIE takes about eight bytes */
+    die_max = (r.end - r.p) / 8 + 16;
+    dies = xmalloc(sizeof(struct dwarf_die) * die_max);
+    stack = xmalloc(sizeof(int) * stack_max);
+
+    while (r.p < r.end && !r.err) {
+        uint64_t offset = r.p - di->info.data;
+        uint64_t code = dwarf_read_uleb(&r);
+        struct dwarf_abbrev *ab;
+        struct dwarf_die *die;
+        int i;
+
+        if (!code) {
+            /* end of children, padding after the unit DIE */
+            if (!depth)
+                continue;
+            depth--;
+            dies[stack[depth]].sibling = n;
+            if (!depth)
+                break;
+            continue;
+        }
+        ab = dwarf_abbrev_find(cu->abbrevs, code);
+        if (!ab) {
+            r.err = 1;
+            break;
+        }
+        if (n == die_max) {
+            struct dwarf_die *tmp = xmalloc(sizeof(struct dwarf_die) *
+                                            die_max * 2);
+
+            memcpy(tmp, dies, sizeof(struct dwarf_die) * n);
+            xfree(dies);
+            dies = tmp;
+            die_max *= 2;
+        }
+        die = &dies[n];
+        die->offset = offset;
+        die->abbrev = ab;
+        die->parent = depth ? stack[depth - 1] : -1;
+        die->sibling = n + 1;
+
+        for (i = 0; i < ab->attr_numbers; i++)
+            if (dwarf_form_skip(cu, &r, ab->attrs[i].form) < 0)
+                break;
+        if (r.err)
+            break;
+        if (ab->has_children) {
+            if (depth == stack_max) {
+                int *tmp = xmalloc(sizeof(int) * stack_max * 2);
+
+                memcpy(tmp, stack, sizeof(int) * stack_max);
+                xfree(stack);
+                stack = tmp;
+                stack_max *= 2;
+            }
+            stack[depth++] = n;
+        }
+        n++;
+        if (!depth)
+            break;
+    }
+    xfree(stack);
+
+    if (r.err || !n) {
+        xfree(dies);
+        return -1;
+    }
+    cu->dies = dies;
+    cu->die_numbers = n;
+    return 0;
+}
+
+/* (OK)
+ * drop DIE tree of unit, keeping memory bounded by the units in use.
+ */
+void dwarf_cu_release(struct dwarf_cu *cu)
+{
+    dwarf_cu_funcs_free(cu);
+    xfree(cu->dies);
+    cu->dies = NULL;
+    cu->die_numbers = 0;
+}
+
+/* (OK)
+ * DIE of parsed unit at .debug_info offset.
+ * @return: DIE, NULL if no DIE starts at @offset.
+ */
+struct dwarf_die *dwarf_cu_die(struct dwarf_cu *cu, uint64_t offset)
+{
+    int lo = 0, hi = cu->die_numbers;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (cu->dies[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == cu->die_numbers || cu->dies[lo].offset != offset)
+        return NULL;
+    return &cu->dies[lo];
+}
+
+/* (OK)
+ * read attribute of DIE.
+ * @name: DW_AT_* of attribute.
+ * @attr: value, indexed strings and addresses resolved.
+ *
+ * @return: 0 on success, -1 if DIE lacks attribute.
+ */
+int dwarf_die_attr(struct dwarf_info *di, struct dwarf_cu *cu,
+                   struct dwarf_die *die, uint32_t name,
+                   struct dwarf_attr *attr)
+{
+    if (dwarf_attr_at(di, cu, die->offset, die->abbrev, name, attr) < 0)
+        return -1;
+    dwarf_attr_resolve(di, cu, attr);
+    return 0;
+}
+
+/* (OK)
+ * index units of .debug_info.
+ * @ef: elf file handle.
+ *
+ * @return: index holding unit headers and abbreviation tables, NULL
+ *          if file has no .debug_info.
+ */
+struct dwarf_info *dwarf_info_alloc(struct elf_file *ef)
+{
+    struct dwarf_info *di;
+
+    di = xmalloc(sizeof(struct dwarf_info));
+    memset(di, 0, sizeof(*di));
+    di->ef = ef;
+    dwarf_section_get(ef, ".debug_info", &di->info);
+    dwarf_section_get(ef, ".debug_abbrev", &di->abbrev);
+    if (!di->info.size || !di->abbrev.size) {
+        xfree(di);
+        return NULL;
+    }
+    dwarf_section_get(ef, ".debug_str", &di->str);
+    dwarf_section_get(ef, ".debug_line_str", &di->line_str);
+    dwarf_section_get(ef, ".debug_str_offsets", &di->str_offsets);
+    dwarf_section_get(ef, ".debug_addr", &di->addr);
+    dwarf_section_get(ef, ".debug_ranges", &di->ranges);
+    dwarf_section_get(ef, ".debug_rnglists", &di->rnglists);
+    dwarf_section_get(ef, ".debug_aranges", &di->aranges);
+    dwarf_section_get(ef, ".debug_names", &di->names);
+
+    if (dwarf_index_units(di) < 0) {
+        dwarf_info_free(di);
+        return NULL;
+    }
+    return di;
+}
+
+/* (OK)
+ * free index and every parsed unit.
+ */
+void dwarf_info_free(struct dwarf_info *di)
+{
+    int i;
+
+    if (!di)
+        return;
+    for (i = 0; i < di->cu_numbers; i++)
+        dwarf_cu_release(&di->cus[i]);
+    for (i = 0; i < di->table_numbers; i++) {
+        xfree(di->tables[i].abbrevs);
+        xfree(di->tables[i].attrs);
+    }
+    xfree(di->tables);
+    xfree(di->cus);
+    xfree(di->arange_table);
+    xfree(di);
+}
@@ -0,0 +1,654 @@
+/*
+ * DWARF .debug_line decoder
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <radix.h>
+#include <dwarf.h>
+
+/*
+ * decoder state shared by every CU of one file
+ * @line_str: .debug_line_str contents, DW_FORM_line_strp.
+ * @str: .debug_str contents, DW_FORM_strp.
+ * @dirs: scratch directory table, reused across CUs.
+ * @dir_numbers: entries of @dirs read for the current CU.
+ * @seqs: sequences found so far, CUs are referenced by index
+ *        until the CU array stops moving.
+ */
+struct line_decoder {
+    const char            *line_str;
+    size_t                line_str_size;
+    const char            *str;
+    size_t                str_size;
+    const char            **dirs;
+    int                   dir_max;
+    int                   dir_numbers;
+    struct dwarf_line_cu  *cus;
+    int                   cu_max;
+    int                   cu_numbers;
+    struct dwarf_line_seq *seqs;
+    int                   seq_max;
+    int                   seq_numbers;
+};
+
+/*
+ * grow array of @size sized elements to hold @need elements.
+ */
+static void *line_grow(void *array, int *max, int need, size_t size)
+{
+    void *tmp;
+    int n;
+
+    if (need <= *max)
+        return array;
+    n = *max ? *max * 2 : 16;
+    while (n < need)
+        n *= 2;
+    tmp = xmalloc(size * n);
+    if (array) {
+        memcpy(tmp, array, size * *max);
+        xfree(array);
+    }
+    *max = n;
+    return tmp;
+}
+
+/*
+ * string from a string section, NULL if @offset is out of it.
+ */
+static const char *line_section_str(const char *sec, size_t size,
+                                    uint64_t offset)
+{
+    if (!sec || offset >= size || !memchr(sec + offset, 0, size - offset))
+        return NULL;
+    return sec + offset;
+}
+
+/*
+ * Read one DWARF 5 entry format field.
+ * @str: set for string forms.
+ * @val: set for constant forms.
+ *
+ * @return: 0 on success, -1 for unsupported form.
+ */
+static int line_read_form(struct line_decoder *d, struct dwarf_reader *r,
+                          uint64_t form, int offset_size,
+                          const char **str, uint64_t *val)
+{
+    uint64_t off;
+
+    *str = NULL;
+    *val = 0;
+    switch (form) {
+    case DW_FORM_string:
+        *str = dwarf_read_str(r);
+        break;
+    case DW_FORM_line_strp:
+        off = dwarf_read_u(r, offset_size);
+        *str = line_section_str(d->line_str, d->line_str_size, off);
+        break;
+    case DW_FORM_strp:
+        off = dwarf_read_u(r, offset_size);
+        *str = line_section_str(d->str, d->str_size, off);
+        break;
+    case DW_FORM_udata:
+        *val = dwarf_read_uleb(r);
+        break;
+    case DW_FORM_data1:
+        *val = dwarf_read_u(r, 1);
+        break;
+    case DW_FORM_data2:
+        *val = dwarf_read_u(r, 2);
+        break;
+    case DW_FORM_data4:
+        *val = dwarf_read_u(r, 4);
+        break;
+    case DW_FORM_data8:
+        *val = dwarf_read_u(r, 8);
+        break;
+    case DW_FORM_data16:
+        dwarf_read_u(r, 8);
+        dwarf_read_u(r, 8);
+        break;
+    case DW_FORM_block:
+        off = dwarf_read_uleb(r);
+        if (off > (uint64_t)(r->end - r->p))
+            return -1;
+        r->p += off;
+        break;
+    default:
+        return -1;
+    }
+    return r->err ? -1 : 0;
+}
+
+/*
+ * DWARF 5 directory or file name table.
+ * @files: NULL to fill directory scratch table.
+ *
+ * @return: number of entries, -1 on error.
+ */
+static int line_read_entries(struct line_decoder *d, struct dwarf_reader *r,
+                             int offset_size, struct dwarf_line_cu *cu)
+{
+    uint64_t format[16][2];
+    int i, j, formats, count, file_max = 0;
+
+    formats = dwarf_read_u(r, 1);
+    if (formats > 16)
+        return -1;
+    for (i = 0; i < formats; i++) {
+        format[i][0] = dwarf_read_uleb(r);
+        format[i][1] = dwarf_read_uleb(r);
+    }
+    count = dwarf_read_uleb(r);
+    if (r->err || count < 0 || count > r->end - r->p)
+        return -1;
+
+    if (cu) {
+        cu->files = line_grow(NULL, &file_max, count ? count : 1,
+                              sizeof(struct dwarf_line_file));
+        cu->file_numbers = count;
+    } else {
+        d->dirs = line_grow(d->dirs, &d->dir_max, count ? count : 1,
+                            sizeof(const char *));
+        d->dir_numbers = 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        const char *path = NULL;
+        uint64_t dir = 0;
+
+        for (j = 0; j < formats; j++) {
+            const char *str;
+            uint64_t val;
+
+            if (line_read_form(d, r, format[j][1], offset_size, &str, &val))
+                return -1;
+            if (format[j][0] == DW_LNCT_path)
+                path = str;
+            else if (format[j][0] == DW_LNCT_directory_index)
+                dir = val;
+        }
+        if (cu) {
+            cu->files[i].name = path;
+            cu->files[i].dir = NULL;
+            /* directory table is read before file table */
+            if (dir < (uint64_t)d->dir_numbers)
+                cu->files[i].dir = d->dirs[dir];
+        } else {
+            d->dirs[i] = path;
+            d->dir_numbers++;
+        }
+    }
+    return count;
+}
+
+/*
+ * DWARF 2-4 include_directories and file_names. File index 0 is
+ * unused before DWARF 5, so slot 0 stays empty.
+ */
+static int line_read_v4_entries(struct line_decoder *d,
+                                struct dwarf_reader *r,
+                                struct dwarf_line_cu *cu)
+{
+    int file_max = 0;
+
+    d->dirs = line_grow(d->dirs, &d->dir_max, 1, sizeof(const char *));
+    d->dirs[0] = NULL;
+    d->dir_numbers = 1;
+    while (r->p < r->end && *r->p) {
+        d->dirs = line_grow(d->dirs, &d->dir_max, d->dir_numbers + 1,
+                            sizeof(const char *));
+        d->dirs[d->dir_numbers++] = dwarf_read_str(r);
+    }
+    r->p++;
+
+    cu->files = line_grow(NULL, &file_max, 8, sizeof(struct dwarf_line_file));
+    cu->files[0].name = NULL;
+    cu->files[0].dir = NULL;
+    cu->file_numbers = 1;
+    while (r->p < r->end && *r->p) {
+        const char *name = dwarf_read_str(r);
+        uint64_t dir = dwarf_read_uleb(r);
+
+        dwarf_read_uleb(r);
+        dwarf_read_uleb(r);
+        cu->files = line_grow(cu->files, &file_max, cu->file_numbers + 1,
+                              sizeof(struct dwarf_line_file));
+        cu->files[cu->file_numbers].name = name;
+        cu->files[cu->file_numbers].dir = dir < (uint64_t)d->dir_numbers ?
+                                          d->dirs[dir] : NULL;
+        cu->file_numbers++;
+    }
+    r->p++;
+    return r->err || r->p > r->end ? -1 : 0;
+}
+
+/*
+ * line number program header
+ */
+struct line_header {
+    int                 min_inst_length;
+    int                 max_ops;
+    int                 default_is_stmt;
+    int                 line_base;
+    int                 line_range;
+    int                 opcode_base;
+    const unsigned char *opcode_lengths;
+};
+
+/*
+ * Run line number program of one CU. Special opcodes are handled
+ * first, they are the bulk of every program.
+ */
+static int line_run_program(struct line_decoder *d, struct dwarf_reader *r,
+                            struct line_header *h, struct dwarf_line_cu *cu)
+{
+    struct dwarf_line_row row, *rows = NULL;
+    int row_max = 0, rows_used = 0, seq_first = 0;
+    unsigned op_index = 0;
+
+    memset(&row, 0, sizeof(row));
+    row.file = 1;
+    row.line = 1;
+    row.flags = h->default_is_stmt ? DWARF_LINE_STMT : 0;
+
+    /* about one row every three bytes of program */
+    rows = line_grow(NULL, &row_max, (r->end - r->p) / 3 + 1,
+                     sizeof(struct dwarf_line_row));
+
+    while (r->p < r->end && !r->err) {
+        unsigned op = *r->p++;
+        uint64_t advance;
+
+        if (op >= (unsigned)h->opcode_base) {
+            unsigned adj = op - h->opcode_base;
+
+            advance = adj / h->line_range;
+            if (h->max_ops == 1) {
+                row.address += advance * h->min_inst_length;
+            } else {
+                row.address += h->min_inst_length *
+                               ((op_index + advance) / h->max_ops);
+                op_index = (op_index + advance) % h->max_ops;
+            }
+            row.line += h->line_base + (int)(adj % h->line_range);
+            goto emit;
+        }
+
+        switch (op) {
+        case 0: {
+            uint64_t len = dwarf_read_uleb(r);
+            const unsigned char *next = r->p + len;
+
+            if (!len || len > (uint64_t)(r->end - r->p)) {
+                r->err = 1;
+                break;
+            }
+            switch (*r->p++) {
+            case DW_LNE_end_sequence:
+                row.flags |= DWARF_LINE_END_SEQUENCE;
+                break;
+            case DW_LNE_set_address:
+                row.address = dwarf_read_u(r, len - 1 > 8 ? 8 : len - 1);
+                op_index = 0;
+                break;
+            case DW_LNE_define_file:
+                /* obsolete, never produced by current tools */
+                break;
+            case DW_LNE_set_discriminator:
+                row.discriminator = dwarf_read_uleb(r);
+                break;
+            }
+            r->p = next;
+            if (row.flags & DWARF_LINE_END_SEQUENCE)
+                goto emit;
+            continue;
+        }
+        case DW_LNS_copy:
+            goto emit;
+        case DW_LNS_advance_pc:
+            advance = dwarf_read_uleb(r);
+            if (h->max_ops == 1) {
+                row.address += advance * h->min_inst_length;
+            } else {
+                row.address += h->min_inst_length *
+                               ((op_index + advance) / h->max_ops);
+                op_index = (op_index + advance) % h->max_ops;
+            }
+            continue;
+        case DW_LNS_advance_line:
+            row.line += dwarf_read_sleb(r);
+            continue;
+        case DW_LNS_set_file:
+            row.file = dwarf_read_uleb(r);
+            continue;
+        case DW_LNS_set_column:
+            row.column = dwarf_read_uleb(r);
+            continue;
+        case DW_LNS_negate_stmt:
+            row.flags ^= DWARF_LINE_STMT;
+            continue;
+        case DW_LNS_const_add_pc:
+            advance = (255 - h->opcode_base) / h->line_range;
+            if (h->max_ops == 1) {
+                row.address += advance * h->min_inst_length;
+            } else {
+                row.address += h->min_inst_length *
+                               ((op_index + advance) / h->max_ops);
+                op_index = (op_index + advance) % h->max_ops;
+            }
+            continue;
+        case DW_LNS_fixed_advance_pc:
+            row.address += dwarf_read_u(r, 2);
+            op_index = 0;
+            continue;
+        default: {
+            /* unknown standard opcode, skip its operands */
+            int n = h->opcode_lengths[op - 1];
+
+            while (n--)
+                dwarf_read_uleb(r);
+            continue;
+        }
+        }
+        continue;
+
+emit:
+        if (rows_used == row_max)
+            rows = line_grow(rows, &row_max, rows_used + 1,
+                             sizeof(struct dwarf_line_row));
+        rows[rows_used++] = row;
+        row.discriminator = 0;
+        if (row.flags & DWARF_LINE_END_SEQUENCE) {
+            struct dwarf_line_seq *seq;
+
+            d->seqs = line_grow(d->seqs, &d->seq_max, d->seq_numbers + 1,
+                                sizeof(struct dwarf_line_seq));
+            seq = &d->seqs[d->seq_numbers++];
+            seq->low = rows[seq_first].address;
+            seq->high = row.address;
+            /* CU index, turned into a pointer once all CUs are read */
+            seq->cu = (struct dwarf_line_cu *)(uintptr_t)d->cu_numbers;
+            seq->first = seq_first;
+            seq->last = rows_used - 1;
+            seq_first = rows_used;
+
+            memset(&row, 0, sizeof(row));
+            row.file = 1;
+            row.line = 1;
+            row.flags = h->default_is_stmt ? DWARF_LINE_STMT : 0;
+            op_index = 0;
+        }
+    }
+
+    cu->rows = rows;
+    cu->row_numbers = rows_used;
+    return r->err ? -1 : 0;
+}
+
+/*
+ * Decode one line table unit starting at @r.
+ * @return: 0 on success, -1 if unit is malformed.
+ */
+static int line_decode_unit(struct line_decoder *d, struct dwarf_reader *r,
+                            const unsigned char *base)
+{
+    struct dwarf_line_cu *cu;
+    struct dwarf_reader unit, prog;
+    struct line_header h;
+    uint64_t length, header_length;
+    int offset_size = 4;
+
+    d->cus = line_grow(d->cus, &d->cu_max, d->cu_numbers + 1,
+                       sizeof(struct dwarf_line_cu));
+    cu = &d->cus[d->cu_numbers];
+    memset(cu, 0, sizeof(*cu));
+    cu->offset = r->p - base;
+
+    length = dwarf_read_u(r, 4);
+    if (length == 0xffffffff) {
+        length = dwarf_read_u(r, 8);
+        offset_size = 8;
+    }
+    if (r->err || length > (uint64_t)(r->end - r->p))
+        return -1;
+    unit.p = r->p;
+    unit.end = r->p + length;
+    unit.err = 0;
+    r->p = unit.end;
+
+    cu->version = dwarf_read_u(&unit, 2);
+    if (cu->version < 2 || cu->version > 5)
+        return -1;
+    if (cu->version >= 5) {
+        /* address_size and segment_selector_size */
+        dwarf_read_u(&unit, 1);
+        dwarf_read_u(&unit, 1);
+    }
+    header_length = dwarf_read_u(&unit, offset_size);
+    if (unit.err || header_length > (uint64_t)(unit.end - unit.p))
+        return -1;
+    prog.p = unit.p + header_length;
+    prog.end = unit.end;
+    prog.err = 0;
+    unit.end = prog.p;
+
+    h.min_inst_length = dwarf_read_u(&unit, 1);
+    h.max_ops = cu->version >= 4 ? dwarf_read_u(&unit, 1) : 1;
+    h.default_is_stmt = dwarf_read_u(&unit, 1);
+    h.line_base = (signed char)dwarf_read_u(&unit, 1);
+    h.line_range = dwarf_read_u(&unit, 1);
+    h.opcode_base = dwarf_read_u(&unit, 1);
+    h.opcode_lengths = unit.p;
+    if (unit.err || !h.line_range || !h.max_ops || !h.opcode_base ||
+        unit.end - unit.p < h.opcode_base - 1)
+        return -1;
+    unit.p += h.opcode_base - 1;
+
+    if (cu->version >= 5) {
+        if (line_read_entries(d, &unit, offset_size, NULL) < 0 ||
+            line_read_entries(d, &unit, offset_size, cu) < 0)
+            goto fail;
+    } else if (line_read_v4_entries(d, &unit, cu) < 0) {
+        goto fail;
+    }
+
+    if (line_run_program(d, &prog, &h, cu) < 0) {
+        xfree(cu->rows);
+        goto fail;
+    }
+    d->cu_numbers++;
+    return 0;
+
+fail:
+    /* entry readers may leave a partly filled file table */
+    xfree(cu->files);
+    return -1;
+}
+
+/*
+ * sort sequences by start address, CU indexes become pointers.
+ */
+static void line_sort_seqs(struct dwarf_line *dl, struct line_decoder *d)
+{
+    uint64_t *keys;
+    uint32_t *index;
+    int i, n = d->seq_numbers;
+
+    dl->seqs = xmalloc(sizeof(struct dwarf_line_seq) * (n ? n : 1));
+    dl->seq_numbers = n;
+    keys = xmalloc(sizeof(uint64_t) * (n ? n : 1));
+    index = xmalloc(sizeof(uint32_t) * (n ? n : 1));
+    for (i = 0; i < n; i++) {
+        keys[i] = d->seqs[i].low;
+        index[i] = i;
+    }
+    radix_sort_u64(keys, index, n);
+    for (i = 0; i < n; i++) {
+        dl->seqs[i] = d->seqs[index[i]];
+        dl->seqs[i].cu = dl->cus + (uintptr_t)dl->seqs[i].cu;
+    }
+    dwarf_line_index(dl);
+    xfree(keys);
+    xfree(index);
+}
+
+/* (OK)
+ * decode every line table on .debug_line.
+ * @ef: elf file handle.
+ *
+ * @return: decoded tables, NULL if file has no .debug_line. A
+ *          malformed unit ends decoding, earlier units are kept.
+ */
+struct dwarf_line *dwarf_line_alloc(struct elf_file *ef)
+{
+    struct line_decoder d;
+    struct dwarf_reader r;
+    struct dwarf_line *dl;
+    Elf32_Shdr *st;
+
+    st = elf_file_section_by_name(ef, ".debug_line");
+    if (!st || !(r.p = elf_file_section_contents(ef, st)))
+        return NULL;
+    r.end = r.p + st->sh_size;
+    r.err = 0;
+
+    memset(&d, 0, sizeof(d));
+    st = elf_file_section_by_name(ef, ".debug_line_str");
+    if (st && (d.line_str = elf_file_section_contents(ef, st)))
+        d.line_str_size = st->sh_size;
+    st = elf_file_section_by_name(ef, ".debug_str");
+    if (st && (d.str = elf_file_section_contents(ef, st)))
+        d.str_size = st->sh_size;
+
+    {
+        const unsigned char *base = r.p;
+
+        while (r.p < r.end && !r.err)
+            if (line_decode_unit(&d, &r, base) < 0)
+                break;
+    }
+
+    dl = xmalloc(sizeof(struct dwarf_line));
+    dl->borrowed = 0;
+    dl->cus = d.cus;
+    dl->cu_numbers = d.cu_numbers;
+    line_sort_seqs(dl, &d);
+    xfree(d.seqs);
+    xfree(d.dirs);
+    return dl;
+}
+
+/* (OK)
+ * free decoded line tables.
+ */
+void dwarf_line_free(struct dwarf_line *dl)
+{
+    int i;
+
+    if (!dl)
+        return;
+    for (i = 0; i < dl->cu_numbers; i++) {
+        if (!dl->borrowed)
+            xfree(dl->cus[i].rows);
+        xfree(dl->cus[i].files);
+    }
+    xfree(dl->cus);
+    xfree(dl->seqs);
+    xfree(dl);
+}
+
+/* (OK)
+ * fill in running maximum of high addresses of sorted sequences.
+ * @dl: line tables whose @seqs are sorted by low address.
+ */
+void dwarf_line_index(struct dwarf_line *dl)
+{
+    uint64_t max_high = 0;
+    int i;
+
+    for (i = 0; i < dl->seq_numbers; i++) {
+        if (dl->seqs[i].high > max_high)
+            max_high = dl->seqs[i].high;
+        dl->seqs[i].max_high = max_high;
+    }
+}
+
+/* (OK)
+ * find row covering address.
+ * @dl: decoded line tables.
+ * @address: code address.
+ * @cu: set to CU of row if not NULL.
+ *
+ * @return: last row at or before @address in the sequence containing
+ *          it, NULL if no sequence contains @address.
+ */
+struct dwarf_line_row *dwarf_line_lookup(struct dwarf_line *dl,
+                                         uint64_t address,
+                                         struct dwarf_line_cu **cu)
+{
+    int lo = 0, hi = dl->seq_numbers, i;
+
+    /* first sequence starting after address */
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (dl->seqs[mid].low <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* sequences of relocatable objects may overlap */
+    for (i = lo - 1; i >= 0 && dl->seqs[i].max_high > address; i--) {
+        struct dwarf_line_seq *seq = &dl->seqs[i];
+        struct dwarf_line_row *rows = seq->cu->rows;
+        int first = seq->first, last = seq->last;
+
+        if (address >= seq->high)
+            continue;
+        while (first < last) {
+            int mid = first + (last - first) / 2;
+
+            if (rows[mid].address <= address)
+                first = mid + 1;
+            else
+                last = mid;
+        }
+        if (cu)
+            *cu = seq->cu;
+        return &rows[first - 1];
+    }
+    return NULL;
+}
+
+/* (OK)
+ * file entry of line table.
+ * @cu: line table.
+ * @index: file index of a row.
+ *
+ * @return: file entry, NULL if @index isn't valid.
+ */
+struct dwarf_line_file *dwarf_line_file(struct dwarf_line_cu *cu,
+                                        uint32_t index)
+{
+    if (index >= (uint32_t)cu->file_numbers || !cu->files[index].name)
+        return NULL;
+    return &cu->files[index];
+}
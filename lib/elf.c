@@ -18,9 +18,15 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <xmalloc.h>
 #include <elf.h>
+#include <stats.h>
+
+/* largest single read, Linux transfers at most 2GB per call */
+#define ELF_IO_CHUNK    (1UL << 30)
 /* --------------------------------------- 
  *   elf file (const char *)
  *       | | 
@@ -155,27 +161,72 @@ Elf32_Shdr *elf_section_header_get_by_index(Elf32_Shdr *st, int index)
     return (st) + index;
 }
 
+/*
+ * read whole range of file, pread may return less than asked for.
+ * Bytes past end of file read as zeros.
+ * @return: 0 on success, -1 with errno set.
+ */
+static int elf_pread_full(int fd, void *buf, uint64_t size, uint64_t offset)
+{
+    unsigned char *p = buf;
+
+    while (size) {
+        size_t len = size < ELF_IO_CHUNK ? size : ELF_IO_CHUNK;
+        ssize_t n = pread(fd, p, len, offset);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (!n) {
+            memset(p, 0, size);
+            break;
+        }
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/*
+ * read range of file into a new buffer.
+ * @return: buffer, NULL with errno set. EFBIG if range doesn't fit
+ *          into address space.
+ */
+static void *elf_read_alloc(const char *filename, uint64_t offset,
+                            uint64_t size)
+{
+    void *buf;
+    int fd;
+
+    if (size > SIZE_MAX) {
+        errno = EFBIG;
+        return NULL;
+    }
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    buf = xmalloc(size ? size : 1);
+    if (elf_pread_full(fd, buf, size, offset)) {
+        close(fd);
+        xfree(buf);
+        return NULL;
+    }
+    close(fd);
+    return buf;
+}
+
 /* (OK)
  * alloc elf header struct for specify file.
  * @filename: file name.
  *
- * @return: Elf32 header.
+ * @return: Elf32 header, NULL with errno set.
  */
 Elf32_Ehdr *elf_header_alloc(const char *filename)
 {
-    int fd;
-    Elf32_Ehdr *tmp_header;
-
-    /* allocate memory for elf_header */
-    tmp_header = xmalloc(sizeof(Elf32_Ehdr));
-    memset(tmp_header, 0, sizeof(Elf32_Ehdr));
-
-    fd = open(filename, O_RDONLY, 0444);
-    if (!fd)
-        return NULL;
-    read(fd, tmp_header, sizeof(Elf32_Ehdr));
-    close(fd);
-    return tmp_header;
+    return elf_read_alloc(filename, 0, sizeof(Elf32_Ehdr));
 }
 
 /* (OK)
@@ -191,29 +242,21 @@ void elf_header_free(Elf32_Ehdr *header)
  * get elf section table for specify file.
  * @filename: specify file.
  * 
- * @return: elf section table for elf file
+ * @return: elf section table for elf file, NULL with errno set.
  */
 Elf32_Shdr *elf_section_table_alloc(const char *filename)
 {
     Elf32_Ehdr *header;
     Elf32_Shdr *st;
-    int fd;
 
     /* get elf header for file */
     header = elf_header_alloc(filename);
-
-    /* Allocate memory for elf section table */
-    st = xmalloc(header->e_shentsize * header->e_shnum);
-    memset(st, 0, header->e_shentsize * header->e_shnum);
+    if (!header)
+        return NULL;
 
     /* load contents from file */
-    fd = open(filename, O_RDONLY, 0444);
-    if (!fd)
-        return NULL;
-    lseek(fd, header->e_shoff, SEEK_SET);
-    read(fd, st, header->e_shentsize * header->e_shnum);
-    /* exit */
-    close(fd);
+    st = elf_read_alloc(filename, header->e_shoff,
+                        (uint64_t)header->e_shentsize * header->e_shnum);
     elf_header_free(header);
     return st;
 }
@@ -259,13 +302,19 @@ Elf32_Shdr *elf_section_header_alloc_by_offset(const char *filename,
     Elf32_Shdr *tmp, *tmp1;
 
     header = elf_header_alloc(filename);
-    if (offset < 0 || offset > elf_header_section_numbers(header)) {
+    if (!header)
+        return NULL;
+    if (offset < 0 || offset >= elf_header_section_numbers(header)) {
         elf_header_free(header);
         return NULL;
     }
 
     /* get section table */
     st = elf_section_table_alloc(filename);
+    if (!st) {
+        elf_header_free(header);
+        return NULL;
+    }
     tmp1 = elf_section_header_get_by_index(st, offset);
     /* create a new elf section header */
     tmp = xmalloc(sizeof(Elf32_Shdr));
@@ -297,6 +346,11 @@ Elf32_Shdr *elf_section_header_alloc_by_name(const char *filename,
     header = elf_header_alloc(filename);
     /* get elf section table */
     section_table = elf_section_table_alloc(filename);
+    if (!header || !section_table) {
+        elf_header_free(header);
+        elf_section_table_free(section_table);
+        return NULL;
+    }
 
     for(i = 1; i < elf_header_section_numbers(header); i++) {
         /* current section */
@@ -305,6 +359,8 @@ Elf32_Shdr *elf_section_header_alloc_by_name(const char *filename,
 
         /* get section name */
         st_name = elf_section_name_alloc(filename, st);
+        if (!st_name)
+            break;
         /* Compare string */
         if (strcmp(st_name, name) == 0) {
             /* create new section header */
@@ -312,6 +368,7 @@ Elf32_Shdr *elf_section_header_alloc_by_name(const char *filename,
             memset(tmp, 0, sizeof(Elf32_Shdr));
             /* dumplicate contents */
             elf_section_header_dumplicate(tmp, st);
+            elf_section_name_free(st_name);
             break;
         }
         elf_section_name_free(st_name);
@@ -332,27 +389,19 @@ void elf_section_header_free(Elf32_Shdr *st)
 }
 
 /* (OK)
- * load section contents
+ * load section contents, the whole section is copied into one
+ * buffer. Large sections are better read through
+ * elf_section_stream_alloc().
  * @filename: elf file name
  * @st: Elf32 section header
  *
- * @return: the buffer of section contents.
+ * @return: the buffer of section contents, NULL with errno set.
  */
 void *elf_section_contents_alloc(const char *filename, Elf32_Shdr *st)
 {
-    char *buffer;
-    int fd;
-
-    /* allocate buffer */
-    buffer = xmalloc(st->sh_size);
-    memset(buffer, 0, st->sh_size);
-
-    fd = open(filename, O_RDONLY, 0444);
-    if (!fd)
+    if (!st)
         return NULL;
-    lseek(fd, st->sh_offset, SEEK_SET);
-    read(fd, buffer, st->sh_size);
-    return buffer;
+    return elf_read_alloc(filename, st->sh_offset, st->sh_size);
 }
 
 /* (OK) 
@@ -376,6 +425,8 @@ void *elf_section_contents_alloc_by_offset(const char *filename, int offset)
     Elf32_Shdr *tmp = elf_section_header_alloc_by_offset(filename, offset);
     char *buffer;
 
+    if (!tmp)
+        return NULL;
     buffer = elf_section_contents_alloc(filename, tmp);
     /* free Elf32_Shdr */
     elf_section_header_free(tmp);
@@ -395,6 +446,8 @@ void *elf_section_contents_alloc_by_name(const char *filename,
     Elf32_Shdr *tmp = elf_section_header_alloc_by_name(filename, name);
     char *buffer;
 
+    if (!tmp)
+        return NULL;
     buffer = elf_section_contents_alloc(filename, tmp);
     /* free Elf32_Shdr */
     elf_section_header_free(tmp);
@@ -406,7 +459,7 @@ void *elf_section_contents_alloc_by_name(const char *filename,
  * @filename: elf file name
  * @st: section header
  *
- * @return: section name
+ * @return: section name, NULL if it can't be read.
  */
 char *elf_section_name_alloc(const char *filename, Elf32_Shdr *st)
 {
@@ -415,23 +468,37 @@ char *elf_section_name_alloc(const char *filename, Elf32_Shdr *st)
     Elf32_Shdr *strtab;
     char *contents;
     char *tmp1, *tmp2;
+    size_t len;
 
     /* get elf header */
     header = elf_header_alloc(filename);
     /* get elf section table */
     section_table = elf_section_table_alloc(filename);
+    if (!header || !section_table ||
+        header->e_shstrndx >= header->e_shnum) {
+        elf_section_table_free(section_table);
+        elf_header_free(header);
+        return NULL;
+    }
     /* get section header for .strtab */
     strtab = elf_section_header_get_by_index(section_table, 
                                              header->e_shstrndx);
     /* get section contents for .strtab */
     contents = elf_section_contents_alloc(filename, strtab); 
+    if (!contents || st->sh_name >= strtab->sh_size) {
+        elf_section_contents_free(contents);
+        elf_section_table_free(section_table);
+        elf_header_free(header);
+        return NULL;
+    }
     /* get section name */
     tmp1 = contents + st->sh_name;
+    len = strnlen(tmp1, strtab->sh_size - st->sh_name);
     /* create new name */
-    tmp2 = xmalloc(strlen(tmp1) + 1);
-    memset(tmp2, 0, strlen(tmp1) + 1);
+    tmp2 = xmalloc(len + 1);
     /* dumplcate name from strtab */
-    strncpy(tmp2, tmp1, strlen(tmp1) + 1);
+    memcpy(tmp2, tmp1, len);
+    tmp2[len] = '\0';
 
     elf_section_contents_free(contents);
     elf_section_table_free(section_table);
@@ -447,3 +514,559 @@ void elf_section_name_free(void *name)
 {
     xfree(name);
 }
+
+/* ---------------------------------------
+ *   section stream (struct elf_section_stream)
+ *
+ *   Section contents are mapped one window at a time, the previous
+ *   window is unmapped first. Memory use stays at one window however
+ *   large the section is, and nothing is copied.
+ * ---------------------------------------
+ */
+
+/* (OK)
+ * open section of file for reading in windows.
+ * @filename: elf file name.
+ * @st: section header.
+ * @window: bytes per window, 0 for ELF_STREAM_WINDOW.
+ *
+ * @return: stream, NULL with errno set, EINVAL if section doesn't
+ *          fit in file.
+ */
+struct elf_section_stream *elf_section_stream_alloc(const char *filename,
+      Elf32_Shdr *st, size_t window)
+{
+    struct elf_section_stream *s;
+    struct stat sb;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &sb) < 0) {
+        close(fd);
+        return NULL;
+    }
+    /* a window past end of file would fault on access, not fail */
+    if (st->sh_type != SHT_NOBITS &&
+        (uint64_t)st->sh_offset + st->sh_size > (uint64_t)sb.st_size) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    s = xmalloc(sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->fd = fd;
+    s->offset = st->sh_offset;
+    s->size = st->sh_type == SHT_NOBITS ? 0 : st->sh_size;
+    s->window = window ? window : ELF_STREAM_WINDOW;
+    return s;
+}
+
+/* (OK)
+ * map next window of section.
+ * @s: stream.
+ * @len: set to bytes on window.
+ *
+ * @return: window contents, valid until next call. NULL at end of
+ *          section or on failure, with errno set then.
+ */
+const void *elf_section_stream_next(struct elf_section_stream *s,
+      size_t *len)
+{
+    uint64_t pos = s->offset + s->pos, start;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t delta;
+
+    if (s->map) {
+        munmap(s->map, s->map_size);
+        s->map = NULL;
+    }
+    if (s->pos >= s->size)
+        return NULL;
+
+    /* mappings start on a page, skip what's before the window */
+    start = pos & ~(uint64_t)(page - 1);
+    delta = pos - start;
+    *len = s->size - s->pos < s->window ? s->size - s->pos : s->window;
+    s->map_size = delta + *len;
+    s->map = mmap(NULL, s->map_size, PROT_READ, MAP_PRIVATE, s->fd, start);
+    if (s->map == MAP_FAILED) {
+        s->map = NULL;
+        return NULL;
+    }
+    s->pos += *len;
+    return (unsigned char *)s->map + delta;
+}
+
+/* (OK)
+ * close section stream.
+ * @s: stream.
+ */
+void elf_section_stream_free(struct elf_section_stream *s)
+{
+    if (!s)
+        return;
+    if (s->map)
+        munmap(s->map, s->map_size);
+    close(s->fd);
+    xfree(s);
+}
+
+/* --------------------------------------- 
+ *   elf file handle (struct elf_file)
+ *
+ *   The whole file is mapped read-only once, the header, section
+ *   table and section name string table are pointers into the
+ *   mapping. Nothing is copied, and only the pages that a caller
+ *   really touches are read from disk.
+ * ---------------------------------------
+ */
+
+/*
+ * string table is terminated, so no string on it runs off the end
+ */
+static int elf_strtab_terminated(const char *strtab, size_t size)
+{
+    struct stats_clock c;
+    int ok;
+
+    stats_begin(&c);
+    ok = !size || !strtab[size - 1];
+    stats_end(&c, STATS_STRINGS);
+    return ok;
+}
+
+/*
+ * Structural check of a freshly mapped file: header tables, every
+ * section and segment range, section links and the type of section
+ * they link to, section names and string table termination. It
+ * costs one pass over the section and program header tables,
+ * symbols themselves aren't visited.
+ *
+ * A section name table without terminator is cut back to its last
+ * NUL, so the checked accessors stay safe on a file which fails.
+ *
+ * @return: 1 if accessors may skip their checks.
+ */
+static int elf_file_validate(struct elf_file *ef)
+{
+    Elf32_Ehdr *header = ef->header;
+    int i, ok = 1;
+
+    if (header->e_shnum && (!ef->section_table ||
+                            header->e_shentsize != sizeof(Elf32_Shdr)))
+        return 0;
+    if (header->e_phnum && (!ef->program_table ||
+                            header->e_phentsize != sizeof(Elf32_Phdr)))
+        return 0;
+
+    if (ef->shstrtab &&
+        !elf_strtab_terminated(ef->shstrtab, ef->shstrtab_size)) {
+        while (ef->shstrtab_size && ef->shstrtab[ef->shstrtab_size - 1])
+            ef->shstrtab_size--;
+        ok = 0;
+    }
+    if (ef->section_numbers > 1 && !ef->shstrtab)
+        ok = 0;
+
+    for (i = 1; i < ef->section_numbers && ok; i++) {
+        Elf32_Shdr *st = ef->section_table + i;
+        Elf32_Shdr *link;
+
+        if (st->sh_name >= ef->shstrtab_size || st->sh_link >= (Elf32_Word)
+            ef->section_numbers)
+            ok = 0;
+        else if (st->sh_type != SHT_NOBITS &&
+                 (uint64_t)st->sh_offset + st->sh_size > ef->size)
+            ok = 0;
+        else if (st->sh_type == SHT_STRTAB &&
+                 !elf_strtab_terminated((char *)ef->map + st->sh_offset,
+                                        st->sh_size))
+            ok = 0;
+        else if (st->sh_type == SHT_SYMTAB || st->sh_type == SHT_DYNSYM) {
+            link = ef->section_table + st->sh_link;
+            if (st->sh_size % sizeof(Elf32_Sym) ||
+                link->sh_type != SHT_STRTAB)
+                ok = 0;
+        } else if (st->sh_type == SHT_REL || st->sh_type == SHT_RELA) {
+            /* symbol accessors trust this link, it has to be a table */
+            link = ef->section_table + st->sh_link;
+            if (st->sh_link && link->sh_type != SHT_SYMTAB &&
+                link->sh_type != SHT_DYNSYM)
+                ok = 0;
+        } else if (st->sh_type == SHT_DYNAMIC) {
+            link = ef->section_table + st->sh_link;
+            if (link->sh_type != SHT_STRTAB)
+                ok = 0;
+        }
+    }
+
+    for (i = 0; i < ef->program_numbers && ok; i++) {
+        Elf32_Phdr *ph = ef->program_table + i;
+
+        if ((uint64_t)ph->p_offset + ph->p_filesz > ef->size)
+            ok = 0;
+    }
+    return ok;
+}
+
+/* (OK)
+ * map elf file and build a file handle.
+ * @filename: elf file name.
+ *
+ * @return: elf file handle, NULL on failure with errno set.
+ */
+struct elf_file *elf_file_alloc(const char *filename)
+{
+    struct stats_clock c;
+    struct elf_file *ef;
+    struct stat sb;
+    int fd;
+
+    stats_begin(&c);
+    stats_add(STATS_OPENS, 1);
+    fd = open(filename, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &sb) < 0) {
+        close(fd);
+        fd = -1;
+    }
+    stats_end(&c, STATS_OPEN);
+    if (fd < 0)
+        return NULL;
+    ef = elf_file_alloc_fd(filename, fd, sb.st_size, sb.st_dev, sb.st_ino,
+                           (uint64_t)sb.st_mtim.tv_sec * 1000000000 +
+                           sb.st_mtim.tv_nsec);
+    close(fd);
+    return ef;
+}
+
+/* (OK)
+ * map elf file which caller has opened and stat'ed already, e.g. by
+ * a batch of asynchronous opens.
+ * @filename: elf file name.
+ * @fd: descriptor of file, left open.
+ * @size: size of file.
+ * @dev: device of file.
+ * @ino: inode of file.
+ * @mtime: modification time of file in ns.
+ *
+ * @return: elf file handle, NULL on failure with errno set.
+ */
+struct elf_file *elf_file_alloc_fd(const char *filename, int fd,
+                                   uint64_t size, uint64_t dev, uint64_t ino,
+                                   uint64_t mtime)
+{
+    struct stats_clock c;
+    struct elf_file *ef;
+    unsigned char *map;
+
+    if (size < sizeof(Elf32_Ehdr)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    /* 32-bit hosts can't map files beyond their address space */
+    if (size > SIZE_MAX) {
+        errno = EFBIG;
+        return NULL;
+    }
+    stats_begin(&c);
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    stats_end(&c, STATS_OPEN);
+    if (map == MAP_FAILED)
+        return NULL;
+    stats_add(STATS_MMAPS, 1);
+    stats_add(STATS_MAPPED, size);
+
+    ef = elf_file_alloc_mem(filename, map, size);
+    if (!ef) {
+        stats_unmap(map, size);
+        munmap(map, size);
+        errno = EINVAL;
+        return NULL;
+    }
+    ef->borrowed = 0;
+    ef->dev = dev;
+    ef->ino = ino;
+    ef->mtime = mtime;
+    return ef;
+}
+
+/* (OK)
+ * alloc elf file handle on memory mapped by someone else, such as
+ * a member of a mapped archive.
+ * @filename: name of file.
+ * @map: ELF image.
+ * @size: size of @map.
+ *
+ * @return: elf file handle, NULL with errno EINVAL if @map isn't an
+ *          ELF32 image. @map must outlive the handle.
+ */
+struct elf_file *elf_file_alloc_mem(const char *filename, const void *map,
+                                    size_t size)
+{
+    struct stats_clock c;
+    struct elf_file *ef;
+    Elf32_Ehdr *header = (Elf32_Ehdr *)map;
+
+    stats_begin(&c);
+    stats_add(STATS_FILES, 1);
+    if (size < sizeof(Elf32_Ehdr) || elf_header_check_magic(header) ||
+        elf_header_file_class(header) != ELFCLASS32) {
+        stats_end(&c, STATS_HEADER);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    ef = xmalloc(sizeof(struct elf_file));
+    memset(ef, 0, sizeof(struct elf_file));
+    ef->filename = filename;
+    ef->map = (unsigned char *)map;
+    ef->size = size;
+    ef->header = header;
+    ef->borrowed = 1;
+
+    /* section table must lay inside of file */
+    if (header->e_shoff && header->e_shnum &&
+        (uint64_t)header->e_shoff + header->e_shnum * sizeof(Elf32_Shdr) <=
+        ef->size) {
+        ef->section_table = (Elf32_Shdr *)(ef->map + header->e_shoff);
+        ef->section_numbers = header->e_shnum;
+    }
+
+    /* program header table must lay inside of file too */
+    if (header->e_phoff && header->e_phnum &&
+        (uint64_t)header->e_phoff + header->e_phnum * sizeof(Elf32_Phdr) <=
+        ef->size) {
+        ef->program_table = (Elf32_Phdr *)(ef->map + header->e_phoff);
+        ef->program_numbers = header->e_phnum;
+    }
+
+    /* section name string table */
+    if (header->e_shstrndx < ef->section_numbers) {
+        Elf32_Shdr *st = ef->section_table + header->e_shstrndx;
+
+        if ((uint64_t)st->sh_offset + st->sh_size <= ef->size) {
+            ef->shstrtab = (char *)ef->map + st->sh_offset;
+            ef->shstrtab_size = st->sh_size;
+        }
+    }
+    stats_end(&c, STATS_HEADER);
+
+    stats_begin(&c);
+    ef->validated = elf_file_validate(ef);
+    stats_end(&c, STATS_SECTIONS);
+    return ef;
+}
+
+/* (OK)
+ * unmap elf file and free handle.
+ * @ef: elf file handle, borrowed mapping is left alone.
+ */
+void elf_file_free(struct elf_file *ef)
+{
+    if (!ef)
+        return;
+    if (!ef->borrowed) {
+        stats_unmap(ef->map, ef->size);
+        munmap(ef->map, ef->size);
+    }
+    xfree(ef);
+}
+
+/* (OK)
+ * get section header from file handle.
+ * @ef: elf file handle.
+ * @index: index on section table.
+ *
+ * @return: section header, NULL if index is out of table.
+ */
+Elf32_Shdr *elf_file_section(struct elf_file *ef, int index)
+{
+    if (index < 0 || index >= ef->section_numbers)
+        return NULL;
+    return ef->section_table + index;
+}
+
+/* (OK)
+ * get section name straight from mapped section name string table.
+ * @ef: elf file handle.
+ * @st: section header.
+ *
+ * @return: section name, never NULL.
+ */
+const char *elf_file_section_name(struct elf_file *ef, Elf32_Shdr *st)
+{
+    if (ef->validated)
+        return ef->shstrtab + st->sh_name;
+    if (!ef->shstrtab || st->sh_name >= ef->shstrtab_size)
+        return "";
+    return ef->shstrtab + st->sh_name;
+}
+
+/* (OK)
+ * get section contents on mapping.
+ * @ef: elf file handle.
+ * @st: section header.
+ *
+ * @return: contents of section, NULL for SHT_NOBITS or out of file.
+ */
+const void *elf_file_section_contents(struct elf_file *ef, Elf32_Shdr *st)
+{
+    if (ef->validated)
+        return st->sh_type == SHT_NOBITS ? NULL : ef->map + st->sh_offset;
+    if (st->sh_type == SHT_NOBITS ||
+        (uint64_t)st->sh_offset + st->sh_size > ef->size)
+        return NULL;
+    return ef->map + st->sh_offset;
+}
+
+/* (OK)
+ * get program header from file handle.
+ * @ef: elf file handle.
+ * @index: index on program header table.
+ *
+ * @return: program header, NULL if index is out of table.
+ */
+Elf32_Phdr *elf_file_program_header(struct elf_file *ef, int index)
+{
+    if (index < 0 || index >= ef->program_numbers)
+        return NULL;
+    return ef->program_table + index;
+}
+
+/* (OK)
+ * find first section of given type.
+ * @ef: elf file handle.
+ * @type: section type, SHT_*.
+ *
+ * @return: section header, NULL if file hasn't such section.
+ */
+Elf32_Shdr *elf_file_section_by_type(struct elf_file *ef, Elf32_Word type)
+{
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++)
+        if (ef->section_table[i].sh_type == type)
+            return ef->section_table + i;
+    return NULL;
+}
+
+/* (OK)
+ * find first section with given name.
+ * @ef: elf file handle.
+ * @name: section name, e.g. ".debug_line".
+ *
+ * @return: section header, NULL if file hasn't such section.
+ */
+Elf32_Shdr *elf_file_section_by_name(struct elf_file *ef, const char *name)
+{
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++)
+        if (!strcmp(elf_file_section_name(ef, ef->section_table + i), name))
+            return ef->section_table + i;
+    return NULL;
+}
+
+/* (OK)
+ * find GNU build-id note.
+ * @ef: elf file handle.
+ * @id: set to build-id bytes on mapping.
+ *
+ * @return: length of build-id, 0 if file has none.
+ */
+int elf_file_build_id(struct elf_file *ef, const unsigned char **id)
+{
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = ef->section_table + i;
+        const unsigned char *p, *end;
+
+        if (st->sh_type != SHT_NOTE ||
+            !(p = elf_file_section_contents(ef, st)))
+            continue;
+        end = p + st->sh_size;
+        while (p + sizeof(Elf32_Nhdr) <= end) {
+            const Elf32_Nhdr *note = (const Elf32_Nhdr *)p;
+            const char *name = (const char *)(note + 1);
+            const unsigned char *desc;
+
+            desc = (const unsigned char *)name + ((note->n_namesz + 3) & ~3);
+            if (desc + note->n_descsz > end || desc < p)
+                break;
+            if (note->n_namesz == 4 && !memcmp(name, ELF_NOTE_GNU, 4) &&
+                note->n_type == NT_GNU_BUILD_ID && note->n_descsz) {
+                *id = desc;
+                return note->n_descsz;
+            }
+            p = desc + ((note->n_descsz + 3) & ~3);
+        }
+    }
+    return 0;
+}
+
+/* (OK)
+ * number of symbols on symbol table.
+ * @ef: elf file handle.
+ * @symtab: SHT_SYMTAB or SHT_DYNSYM section header.
+ *
+ * @return: entries on symbol table, 0 if section isn't a symbol
+ *          table or is outside of file.
+ */
+int elf_file_symbol_numbers(struct elf_file *ef, Elf32_Shdr *symtab)
+{
+    if (symtab->sh_type != SHT_SYMTAB && symtab->sh_type != SHT_DYNSYM)
+        return 0;
+    if (ef->validated)
+        return symtab->sh_size / sizeof(Elf32_Sym);
+    if (!elf_file_section_contents(ef, symtab))
+        return 0;
+    return symtab->sh_size / sizeof(Elf32_Sym);
+}
+
+/* (OK)
+ * get symbol from symbol table.
+ * @ef: elf file handle.
+ * @symtab: symbol table section header.
+ * @index: index on symbol table.
+ *
+ * @return: symbol on mapping.
+ */
+Elf32_Sym *elf_file_symbol(struct elf_file *ef, Elf32_Shdr *symtab, int index)
+{
+    return (Elf32_Sym *)(ef->map + symtab->sh_offset) + index;
+}
+
+/* (OK)
+ * get symbol name straight from mapped string table of symbol table.
+ * @ef: elf file handle.
+ * @symtab: symbol table section header.
+ * @sym: symbol.
+ *
+ * @return: symbol name, never NULL.
+ */
+const char *elf_file_symbol_name(struct elf_file *ef, Elf32_Shdr *symtab,
+      Elf32_Sym *sym)
+{
+    Elf32_Shdr *strtab;
+    const char *contents;
+
+    /* st_name is per symbol data, not structure, so it stays checked */
+    if (ef->validated) {
+        strtab = ef->section_table + symtab->sh_link;
+        if (sym->st_name >= strtab->sh_size)
+            return "";
+        return (const char *)ef->map + strtab->sh_offset + sym->st_name;
+    }
+
+    strtab = elf_file_section(ef, symtab->sh_link);
+    if (!strtab || sym->st_name >= strtab->sh_size)
+        return "";
+    contents = elf_file_section_contents(ef, strtab);
+    if (!contents || !memchr(contents + sym->st_name, 0,
+                             strtab->sh_size - sym->st_name))
+        return "";
+    return contents + sym->st_name;
+}
@@ -0,0 +1,636 @@
+/*
+ * batch loading of many elf files
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <linux/stat.h>
+#include <linux/io_uring.h>
+
+#include <xmalloc.h>
+#include <elf_batch.h>
+#include <trace.h>
+#include <log.h>
+
+/* ---------------------------------------
+ *   window of up to @depth files, each step waits for all of them
+ *
+ *   open          openat
+ *   stat, head    statx + read of ELF_BATCH_HEADER_SIZE bytes
+ *   table         read of section table, if outside of head
+ *   names         read of section name string table, if outside
+ *
+ * With io_uring a step is one submission of the whole window, so
+ * hundreds of opens and reads are in flight at once. The pread
+ * backend runs the same steps one syscall after the other. Either
+ * way, what elf_file_alloc_fd() touches first is in page cache by
+ * the time the callback maps the file.
+ * ---------------------------------------
+ */
+
+#ifndef AT_EMPTY_PATH
+#define AT_EMPTY_PATH    0x1000    /* fcntl.h keeps it for _GNU_SOURCE */
+#endif
+
+#define IO_OPEN    0
+#define IO_STAT    1
+#define IO_READ    2
+
+#define IO_PENDING INT_MIN    /* res of request not run yet */
+
+/*
+ * one request of a step
+ * @slot: file slot on window.
+ * @res: bytes read, or negative errno, IO_PENDING until it has run.
+ */
+struct elf_batch_io {
+    int      op;
+    int      slot;
+    void     *buf;
+    uint32_t len;
+    uint64_t off;
+    int      res;
+};
+
+#ifdef __NR_io_uring_setup
+
+/*
+ * io_uring instance, driven through raw syscalls so no library is
+ * needed.
+ */
+struct elf_uring {
+    int                 fd;
+    unsigned            entries;
+    unsigned            *sq_head;
+    unsigned            *sq_tail;
+    unsigned            *sq_mask;
+    unsigned            *sq_array;
+    unsigned            *cq_head;
+    unsigned            *cq_tail;
+    unsigned            *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void                *sq_ring;
+    void                *cq_ring;
+    size_t              sq_ring_size;
+    size_t              cq_ring_size;
+    size_t              sqes_size;
+    struct statx        *stx;
+};
+
+static void elf_uring_free(struct elf_uring *r)
+{
+    if (!r)
+        return;
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ring && r->cq_ring != r->sq_ring)
+        munmap(r->cq_ring, r->cq_ring_size);
+    if (r->sq_ring)
+        munmap(r->sq_ring, r->sq_ring_size);
+    if (r->fd >= 0)
+        close(r->fd);
+    xfree(r->stx);
+    xfree(r);
+}
+
+/*
+ * check that kernel knows every opcode a batch needs
+ */
+static int elf_uring_probe(int fd)
+{
+    static const int ops[] = { IORING_OP_OPENAT, IORING_OP_STATX,
+                               IORING_OP_READ };
+    struct io_uring_probe *probe;
+    size_t size = sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op);
+    int i, ok = 1;
+
+    probe = xmalloc(size);
+    memset(probe, 0, size);
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                256) < 0) {
+        xfree(probe);
+        return 0;
+    }
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        if (ops[i] > probe->last_op ||
+            !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            ok = 0;
+    xfree(probe);
+    return ok;
+}
+
+/*
+ * set up ring, NULL if kernel has no usable io_uring (too old,
+ * disabled by sysctl or filtered by seccomp).
+ */
+static struct elf_uring *elf_uring_alloc(int depth)
+{
+    struct io_uring_params p;
+    struct elf_uring *r;
+    unsigned char *sq, *cq;
+
+    r = xmalloc(sizeof(*r));
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+    /* a file takes two entries on the stat step */
+    r->fd = syscall(__NR_io_uring_setup, depth * 2, &p);
+    if (r->fd < 0 || !elf_uring_probe(r->fd))
+        goto fail;
+    r->entries = p.sq_entries;
+
+    r->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_ring_size = p.cq_off.cqes +
+                      p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (r->cq_ring_size > r->sq_ring_size)
+            r->sq_ring_size = r->cq_ring_size;
+        r->cq_ring_size = r->sq_ring_size;
+    }
+    r->sq_ring = mmap(NULL, r->sq_ring_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ring == MAP_FAILED) {
+        r->sq_ring = NULL;
+        goto fail;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        r->cq_ring = r->sq_ring;
+    } else {
+        r->cq_ring = mmap(NULL, r->cq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, r->fd,
+                          IORING_OFF_CQ_RING);
+        if (r->cq_ring == MAP_FAILED) {
+            r->cq_ring = NULL;
+            goto fail;
+        }
+    }
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        goto fail;
+    }
+
+    sq = r->sq_ring;
+    cq = r->cq_ring;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    r->stx = xmalloc(sizeof(struct statx) * depth);
+    return r;
+
+fail:
+    elf_uring_free(r);
+    return NULL;
+}
+
+/*
+ * queue one request, ring has room as steps are cut to its size
+ */
+static void elf_uring_queue(struct elf_uring *r, struct elf_batch *b,
+                            struct elf_batch_io *io, uint64_t user)
+{
+    struct elf_batch_file *bf = &b->files[io->slot];
+    unsigned tail = *r->sq_tail, index = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[index];
+
+    memset(sqe, 0, sizeof(*sqe));
+    switch (io->op) {
+    case IO_OPEN:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uintptr_t)bf->filename;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        break;
+    case IO_STAT:
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = bf->fd;
+        sqe->addr = (uintptr_t)"";
+        sqe->len = STATX_SIZE | STATX_INO | STATX_MTIME;
+        sqe->off = (uintptr_t)&r->stx[io->slot];
+        sqe->statx_flags = AT_EMPTY_PATH;
+        break;
+    default:
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = bf->fd;
+        sqe->addr = (uintptr_t)io->buf;
+        sqe->len = io->len;
+        sqe->off = io->off;
+        break;
+    }
+    sqe->user_data = user;
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * submit requests and wait for all of them.
+ * @return: 0, or -1 if the ring failed and nothing is known.
+ */
+static int elf_uring_run(struct elf_uring *r, struct elf_batch *b,
+                         struct elf_batch_io *io, int n)
+{
+    int first, i;
+
+    for (first = 0; first < n; first += r->entries) {
+        int count = n - first < (int)r->entries ? n - first : r->entries;
+        int pending = count, submit = count;
+
+        for (i = 0; i < count; i++)
+            elf_uring_queue(r, b, &io[first + i], first + i);
+        while (pending) {
+            unsigned head = *r->cq_head, tail;
+            int ret;
+
+            ret = syscall(__NR_io_uring_enter, r->fd, submit, pending,
+                          IORING_ENTER_GETEVENTS, NULL, 0);
+            if (ret < 0 && errno != EINTR)
+                return -1;
+            if (ret > 0)
+                submit -= ret < submit ? ret : submit;
+
+            tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++) {
+                struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+
+                io[cqe->user_data].res = cqe->res;
+                pending--;
+            }
+            __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+    return 0;
+}
+
+#else
+
+struct elf_uring;
+
+static struct elf_uring *elf_uring_alloc(int depth)
+{
+    return NULL;
+}
+
+static void elf_uring_free(struct elf_uring *r)
+{
+}
+
+static int elf_uring_run(struct elf_uring *r, struct elf_batch *b,
+                         struct elf_batch_io *io, int n)
+{
+    return -1;
+}
+
+#endif
+
+/*
+ * run requests one syscall after the other, those which have a
+ * result already are left alone
+ */
+static void elf_pread_run(struct elf_batch *b, struct elf_batch_io *io,
+                          int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[io[i].slot];
+        struct stat sb;
+        ssize_t ret;
+
+        if (io[i].res != IO_PENDING)
+            continue;
+        switch (io[i].op) {
+        case IO_OPEN:
+            io[i].res = open(bf->filename, O_RDONLY | O_CLOEXEC);
+            break;
+        case IO_STAT:
+            io[i].res = fstat(bf->fd, &sb);
+            if (!io[i].res) {
+                bf->size = sb.st_size;
+                bf->dev = sb.st_dev;
+                bf->ino = sb.st_ino;
+                bf->mtime = (uint64_t)sb.st_mtim.tv_sec * 1000000000 +
+                            sb.st_mtim.tv_nsec;
+            }
+            break;
+        default:
+            ret = pread(bf->fd, io[i].buf, io[i].len, io[i].off);
+            io[i].res = ret;
+            break;
+        }
+        if (io[i].res < 0)
+            io[i].res = -errno;
+    }
+}
+
+/*
+ * run one step on the backend, then record results on files
+ */
+static void elf_batch_step(struct elf_batch *b, struct elf_batch_io *io,
+                           int n)
+{
+    int i;
+
+    if (!n)
+        return;
+    for (i = 0; i < n; i++)
+        io[i].res = IO_PENDING;
+    if (b->ring && elf_uring_run(b->ring, b, io, n)) {
+        /*
+         * ring broke down, finish on pread. Opens it completed keep
+         * their descriptors, stats are redone as their statx buffers
+         * go with the ring.
+         */
+        for (i = 0; i < n; i++)
+            if (io[i].op == IO_STAT)
+                io[i].res = IO_PENDING;
+        elf_uring_free(b->ring);
+        b->ring = NULL;
+        b->backend = ELF_BATCH_PREAD;
+    }
+    if (!b->ring)
+        elf_pread_run(b, io, n);
+
+    for (i = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[io[i].slot];
+
+        if (io[i].res < 0) {
+            if (!bf->err)
+                bf->err = -io[i].res;
+            continue;
+        }
+        if (io[i].op == IO_OPEN) {
+            bf->fd = io[i].res;
+        }
+#ifdef __NR_io_uring_setup
+        else if (io[i].op == IO_STAT && b->ring) {
+            struct statx *stx = &b->ring->stx[io[i].slot];
+
+            bf->size = stx->stx_size;
+            bf->dev = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+            bf->ino = stx->stx_ino;
+            bf->mtime = (uint64_t)stx->stx_mtime.tv_sec * 1000000000 +
+                        stx->stx_mtime.tv_nsec;
+        }
+#endif
+        else if (io[i].op == IO_READ && io[i].buf == bf->header) {
+            bf->header_size = io[i].res;
+        } else if (io[i].op == IO_READ) {
+            bf->buf_size = io[i].res;
+        }
+    }
+}
+
+/*
+ * queue read of file range unless head holds it already, the data
+ * goes into file's scratch buffer.
+ */
+static int elf_batch_read(struct elf_batch_file *bf, struct elf_batch_io *io,
+                          int slot, uint64_t off, uint64_t len)
+{
+    if (bf->err || !len || off + len > bf->size ||
+        off + len <= bf->header_size || len > UINT32_MAX)
+        return 0;
+    if (len > bf->buf_max) {
+        xfree(bf->buf);
+        bf->buf = xmalloc(len);
+        bf->buf_max = len;
+    }
+    io->op = IO_READ;
+    io->slot = slot;
+    io->buf = bf->buf;
+    io->len = len;
+    io->off = off;
+    return 1;
+}
+
+/*
+ * section table of file from head or scratch buffer, NULL if it
+ * couldn't be read
+ */
+static Elf32_Shdr *elf_batch_table(struct elf_batch_file *bf,
+                                   Elf32_Ehdr *eh)
+{
+    size_t size = eh->e_shnum * sizeof(Elf32_Shdr);
+
+    if ((uint64_t)eh->e_shoff + size <= bf->header_size)
+        return (Elf32_Shdr *)(bf->header + eh->e_shoff);
+    if (bf->buf_size >= size)
+        return (Elf32_Shdr *)bf->buf;
+    return NULL;
+}
+
+/*
+ * ELF32 header of file, NULL if it isn't one or has no sane table
+ */
+static Elf32_Ehdr *elf_batch_header(struct elf_batch_file *bf)
+{
+    Elf32_Ehdr *eh = (Elf32_Ehdr *)bf->header;
+
+    if (bf->err || bf->header_size < sizeof(Elf32_Ehdr) ||
+        elf_header_check_magic(eh) ||
+        elf_header_file_class(eh) != ELFCLASS32 ||
+        !eh->e_shoff || !eh->e_shnum ||
+        eh->e_shentsize != sizeof(Elf32_Shdr) ||
+        eh->e_shstrndx >= eh->e_shnum)
+        return NULL;
+    return eh;
+}
+
+/*
+ * load one window of files
+ */
+static void elf_batch_window(struct elf_batch *b, const char **filenames,
+                             int n, struct elf_batch_io *io)
+{
+    int i, k;
+
+    for (i = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[i];
+
+        bf->filename = filenames[i];
+        bf->fd = -1;
+        bf->err = 0;
+        bf->size = bf->dev = bf->ino = bf->mtime = 0;
+        bf->header = b->headers + (size_t)i * ELF_BATCH_HEADER_SIZE;
+        bf->header_size = 0;
+        bf->buf_size = 0;
+        io[i].op = IO_OPEN;
+        io[i].slot = i;
+    }
+    elf_batch_step(b, io, n);
+
+    for (i = 0, k = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[i];
+
+        if (bf->err)
+            continue;
+        io[k].op = IO_STAT;
+        io[k++].slot = i;
+        io[k].op = IO_READ;
+        io[k].slot = i;
+        io[k].buf = bf->header;
+        io[k].len = ELF_BATCH_HEADER_SIZE;
+        io[k++].off = 0;
+    }
+    elf_batch_step(b, io, k);
+
+    for (i = 0, k = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[i];
+        Elf32_Ehdr *eh = elf_batch_header(bf);
+
+        if (eh)
+            k += elf_batch_read(bf, &io[k], i, eh->e_shoff,
+                                eh->e_shnum * sizeof(Elf32_Shdr));
+    }
+    elf_batch_step(b, io, k);
+
+    for (i = 0, k = 0; i < n; i++) {
+        struct elf_batch_file *bf = &b->files[i];
+        Elf32_Ehdr *eh = elf_batch_header(bf);
+        Elf32_Shdr *table;
+
+        if (!eh || bf->err || !(table = elf_batch_table(bf, eh)))
+            continue;
+        k += elf_batch_read(bf, &io[k], i, table[eh->e_shstrndx].sh_offset,
+                            table[eh->e_shstrndx].sh_size);
+    }
+    elf_batch_step(b, io, k);
+}
+
+/* (OK)
+ * batch loader on given backend.
+ * @backend: ELF_BATCH_AUTO picks io_uring when kernel allows it.
+ *           A ring which can't be set up falls back to pread.
+ * @depth: files loaded at once, 0 for ELF_BATCH_DEPTH.
+ *
+ * @return: batch loader.
+ */
+struct elf_batch *elf_batch_alloc(int backend, int depth)
+{
+    struct elf_batch *b;
+
+    if (depth <= 0)
+        depth = ELF_BATCH_DEPTH;
+    b = xmalloc(sizeof(*b));
+    memset(b, 0, sizeof(*b));
+    b->depth = depth;
+    b->backend = ELF_BATCH_PREAD;
+    if (backend != ELF_BATCH_PREAD && (b->ring = elf_uring_alloc(depth)))
+        b->backend = ELF_BATCH_URING;
+    else if (backend == ELF_BATCH_URING)
+        print_warn("io_uring unavailable, opening files with pread");
+    b->files = xmalloc(sizeof(struct elf_batch_file) * depth);
+    memset(b->files, 0, sizeof(struct elf_batch_file) * depth);
+    b->headers = xmalloc((size_t)depth * ELF_BATCH_HEADER_SIZE);
+    return b;
+}
+
+/* (OK)
+ * free batch loader.
+ * @b: batch loader.
+ */
+void elf_batch_free(struct elf_batch *b)
+{
+    int i;
+
+    if (!b)
+        return;
+    elf_uring_free(b->ring);
+    for (i = 0; i < b->depth; i++)
+        xfree(b->files[i].buf);
+    xfree(b->files);
+    xfree(b->headers);
+    xfree(b);
+}
+
+/* (OK)
+ * backend name.
+ * @b: batch loader.
+ *
+ * @return: "io_uring" or "pread".
+ */
+const char *elf_batch_backend_name(struct elf_batch *b)
+{
+    return b->backend == ELF_BATCH_URING ? "io_uring" : "pread";
+}
+
+/* (OK)
+ * load files window by window and call function on each of them in
+ * order. Descriptors are closed once the callback returns.
+ * @b: batch loader.
+ * @filenames: file names.
+ * @numbers: number of files.
+ * @fn: callback, gets the file, its index on @filenames and @data.
+ *      @bf->err is set if file couldn't be opened or read.
+ * @data: callback data.
+ */
+void elf_batch_run(struct elf_batch *b, const char **filenames, int numbers,
+                   void (*fn)(struct elf_batch_file *bf, int index,
+                              void *data), void *data)
+{
+    struct trace_clock t;
+    struct elf_batch_io *io;
+    int first, i;
+
+    io = xmalloc(sizeof(struct elf_batch_io) * b->depth * 2);
+    memset(io, 0, sizeof(struct elf_batch_io) * b->depth * 2);
+    for (first = 0; first < numbers; first += b->depth) {
+        int n = numbers - first < b->depth ? numbers - first : b->depth;
+
+        print_dbg("window of %d files from %s on %s", n, filenames[first],
+                  elf_batch_backend_name(b));
+        trace_begin(&t);
+        elf_batch_window(b, filenames + first, n, io);
+        trace_end(&t, TRACE_IO, "window", NULL);
+        for (i = 0; i < n; i++) {
+            struct elf_batch_file *bf = &b->files[i];
+
+            fn(bf, first + i, data);
+            if (bf->fd >= 0)
+                close(bf->fd);
+            bf->fd = -1;
+        }
+    }
+    xfree(io);
+}
+
+/* (OK)
+ * elf file handle of batch file, the mapping outlives descriptor.
+ * @bf: batch file, in callback.
+ *
+ * @return: elf file handle, NULL on failure with errno set.
+ */
+struct elf_file *elf_batch_elf(struct elf_batch_file *bf)
+{
+    if (bf->err) {
+        errno = bf->err;
+        return NULL;
+    }
+    return elf_file_alloc_fd(bf->filename, bf->fd, bf->size, bf->dev,
+                             bf->ino, bf->mtime);
+}
@@ -0,0 +1,668 @@
+/*
+ * content hashes: XXH3 64 and SHA-256
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <hash.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HASH_X86    1
+#endif
+
+/* ---------------------------------------
+ *   kernels
+ *
+ * The bulk of both hashes is one loop over 64 byte blocks: the XXH3
+ * stripe accumulate/scramble and the SHA-256 compression function.
+ * Each has a portable C kernel and x86 kernels built with target
+ * attributes, so the rest of the tree needs no -m flags. The kernel
+ * is picked on first use from what the CPU supports;
+ * UTILSE_HASH=scalar forces the portable ones, to check the others
+ * against them.
+ */
+
+static uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static uint32_t read32_be(const unsigned char *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int hash_scalar_only(void)
+{
+    const char *env = getenv("UTILSE_HASH");
+
+    return env && !strcmp(env, "scalar");
+}
+
+/* ---------------------------------------
+ *   XXH3 64
+ */
+
+#define PRIME32_1    0x9E3779B1U
+#define PRIME32_2    0x85EBCA77U
+#define PRIME32_3    0xC2B2AE3DU
+#define PRIME64_1    0x9E3779B185EBCA87ULL
+#define PRIME64_2    0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3    0x165667B19E3779F9ULL
+#define PRIME64_4    0x85EBCA77C2B2AE63ULL
+#define PRIME64_5    0x27D4EB2F165667C5ULL
+#define PRIME_MX1    0x165667919E3779F9ULL
+#define PRIME_MX2    0x9FB21C651E98DF25ULL
+
+#define XXH3_SECRET_SIZE      192
+#define XXH3_SECRET_MIN       136
+#define XXH3_STRIPE           64
+#define XXH3_STRIPES          ((XXH3_SECRET_SIZE - XXH3_STRIPE) / 8)
+#define XXH3_BLOCK            (XXH3_STRIPE * XXH3_STRIPES)
+#define XXH3_MIDSIZE_MAX      240
+
+static const unsigned char XXH3_SECRET[XXH3_SECRET_SIZE]
+    __attribute__((aligned(64))) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe,
+    0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb,
+    0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78,
+    0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e,
+    0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb,
+    0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e,
+    0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f,
+    0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31,
+    0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3,
+    0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49,
+    0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc,
+    0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28,
+    0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* fold 128 bit product of a and b to 64 bit */
+static uint64_t mul128_fold64(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 p = (unsigned __int128)a * b;
+
+    return (uint64_t)p ^ (uint64_t)(p >> 64);
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    uint64_t hi = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    uint64_t lo = (cross << 32) | (lo_lo & 0xffffffff);
+
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t xxh64_avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static uint64_t xxh3_avalanche(uint64_t h)
+{
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+static uint64_t xxh3_rrmxmx(uint64_t h, uint64_t len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static uint64_t xxh3_mix16(const unsigned char *p, const unsigned char *secret)
+{
+    return mul128_fold64(read64(p) ^ read64(secret),
+                         read64(p + 8) ^ read64(secret + 8));
+}
+
+static uint64_t xxh3_short(const unsigned char *p, size_t len)
+{
+    const unsigned char *secret = XXH3_SECRET;
+
+    if (len > 8) {
+        uint64_t lo = read64(p) ^ (read64(secret + 24) ^ read64(secret + 32));
+        uint64_t hi = read64(p + len - 8) ^
+                      (read64(secret + 40) ^ read64(secret + 48));
+
+        return xxh3_avalanche(len + __builtin_bswap64(lo) + hi +
+                              mul128_fold64(lo, hi));
+    }
+    if (len >= 4) {
+        uint64_t v = read32(p + len - 4) + ((uint64_t)read32(p) << 32);
+
+        return xxh3_rrmxmx(v ^ (read64(secret + 8) ^ read64(secret + 16)),
+                           len);
+    }
+    if (len) {
+        uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[len >> 1] << 24) |
+                     p[len - 1] | ((uint32_t)len << 8);
+
+        return xxh64_avalanche(v ^ (uint64_t)(read32(secret) ^
+                                              read32(secret + 4)));
+    }
+    return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+/* 17 to 240 bytes */
+static uint64_t xxh3_mid(const unsigned char *p, size_t len)
+{
+    const unsigned char *secret = XXH3_SECRET;
+    uint64_t acc = len * PRIME64_1;
+    int i;
+
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += xxh3_mix16(p + 48, secret + 96);
+                    acc += xxh3_mix16(p + len - 64, secret + 112);
+                }
+                acc += xxh3_mix16(p + 32, secret + 64);
+                acc += xxh3_mix16(p + len - 48, secret + 80);
+            }
+            acc += xxh3_mix16(p + 16, secret + 32);
+            acc += xxh3_mix16(p + len - 32, secret + 48);
+        }
+        acc += xxh3_mix16(p, secret);
+        acc += xxh3_mix16(p + len - 16, secret + 16);
+        return xxh3_avalanche(acc);
+    }
+
+    for (i = 0; i < 8; i++)
+        acc += xxh3_mix16(p + 16 * i, secret + 16 * i);
+    acc = xxh3_avalanche(acc);
+    for (i = 8; i < (int)(len / 16); i++)
+        acc += xxh3_mix16(p + 16 * i, secret + 16 * (i - 8) + 3);
+    acc += xxh3_mix16(p + len - 16, secret + XXH3_SECRET_MIN - 17);
+    return xxh3_avalanche(acc);
+}
+
+/*
+ * long input kernel
+ * @accumulate: fold @stripes stripes of 64 bytes into acc, stripe N
+ *              keyed with secret + 8 * N.
+ * @scramble: mix acc with secret at end of every block.
+ */
+struct xxh3_kernel {
+    const char *name;
+    void       (*accumulate)(uint64_t *acc, const unsigned char *p,
+                             const unsigned char *secret, size_t stripes);
+    void       (*scramble)(uint64_t *acc, const unsigned char *secret);
+};
+
+static void xxh3_accumulate_scalar(uint64_t *acc, const unsigned char *p,
+                                   const unsigned char *secret,
+                                   size_t stripes)
+{
+    size_t n;
+    int i;
+
+    for (n = 0; n < stripes; n++, p += XXH3_STRIPE, secret += 8) {
+        for (i = 0; i < 8; i++) {
+            uint64_t v = read64(p + 8 * i);
+            uint64_t k = v ^ read64(secret + 8 * i);
+
+            acc[i ^ 1] += v;
+            acc[i] += (k & 0xffffffff) * (k >> 32);
+        }
+    }
+}
+
+static void xxh3_scramble_scalar(uint64_t *acc, const unsigned char *secret)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        uint64_t a = acc[i];
+
+        a ^= a >> 47;
+        a ^= read64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+#ifdef HASH_X86
+__attribute__((target("sse2")))
+static void xxh3_accumulate_sse2(uint64_t *acc, const unsigned char *p,
+                                 const unsigned char *secret, size_t stripes)
+{
+    __m128i a[4];
+    size_t n;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        a[i] = _mm_loadu_si128((const __m128i *)acc + i);
+    for (n = 0; n < stripes; n++, p += XXH3_STRIPE, secret += 8) {
+        for (i = 0; i < 4; i++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)p + i);
+            __m128i k = _mm_xor_si128(v,
+                    _mm_loadu_si128((const __m128i *)secret + i));
+            __m128i hi = _mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1));
+
+            a[i] = _mm_add_epi64(a[i], _mm_mul_epu32(k, hi));
+            a[i] = _mm_add_epi64(a[i],
+                    _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        }
+    }
+    for (i = 0; i < 4; i++)
+        _mm_storeu_si128((__m128i *)acc + i, a[i]);
+}
+
+__attribute__((target("sse2")))
+static void xxh3_scramble_sse2(uint64_t *acc, const unsigned char *secret)
+{
+    const __m128i prime = _mm_set1_epi32(PRIME32_1);
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i *)acc + i);
+        __m128i k, lo, hi;
+
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        k = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)secret + i));
+        lo = _mm_mul_epu32(k, prime);
+        hi = _mm_mul_epu32(_mm_shuffle_epi32(k, _MM_SHUFFLE(0, 3, 0, 1)),
+                           prime);
+        _mm_storeu_si128((__m128i *)acc + i,
+                         _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+}
+
+__attribute__((target("avx2")))
+static void xxh3_accumulate_avx2(uint64_t *acc, const unsigned char *p,
+                                 const unsigned char *secret, size_t stripes)
+{
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)acc + 1);
+    size_t n;
+
+    for (n = 0; n < stripes; n++, p += XXH3_STRIPE, secret += 8) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)p + 1);
+        __m256i k0 = _mm256_xor_si256(v0,
+                _mm256_loadu_si256((const __m256i *)secret));
+        __m256i k1 = _mm256_xor_si256(v1,
+                _mm256_loadu_si256((const __m256i *)secret + 1));
+
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0,
+                _mm256_srli_epi64(k0, 32)));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1,
+                _mm256_srli_epi64(k1, 32)));
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(v0,
+                _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(v1,
+                _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)acc + 1, a1);
+}
+
+__attribute__((target("avx2")))
+static void xxh3_scramble_avx2(uint64_t *acc, const unsigned char *secret)
+{
+    const __m256i prime = _mm256_set1_epi32(PRIME32_1);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)acc + i);
+        __m256i k, lo, hi;
+
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        k = _mm256_xor_si256(a,
+                _mm256_loadu_si256((const __m256i *)secret + i));
+        lo = _mm256_mul_epu32(k, prime);
+        hi = _mm256_mul_epu32(_mm256_srli_epi64(k, 32), prime);
+        _mm256_storeu_si256((__m256i *)acc + i,
+                            _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+}
+#endif
+
+static const struct xxh3_kernel XXH3_KERNELS[] = {
+    { "scalar", xxh3_accumulate_scalar, xxh3_scramble_scalar },
+#ifdef HASH_X86
+    { "sse2",   xxh3_accumulate_sse2,   xxh3_scramble_sse2 },
+    { "avx2",   xxh3_accumulate_avx2,   xxh3_scramble_avx2 },
+#endif
+};
+
+static const struct xxh3_kernel *xxh3_kernel;
+
+static const struct xxh3_kernel *xxh3_pick(void)
+{
+    const struct xxh3_kernel *k = __atomic_load_n(&xxh3_kernel,
+                                                  __ATOMIC_ACQUIRE);
+
+    if (k)
+        return k;
+    k = &XXH3_KERNELS[0];
+#ifdef HASH_X86
+    if (!hash_scalar_only()) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            k = &XXH3_KERNELS[2];
+        else if (__builtin_cpu_supports("sse2"))
+            k = &XXH3_KERNELS[1];
+    }
+#endif
+    /* threads racing here pick the same kernel */
+    __atomic_store_n(&xxh3_kernel, k, __ATOMIC_RELEASE);
+    return k;
+}
+
+static uint64_t xxh3_long(const unsigned char *p, size_t len)
+{
+    const struct xxh3_kernel *k = xxh3_pick();
+    const unsigned char *secret = XXH3_SECRET;
+    uint64_t acc[8] __attribute__((aligned(32))) = {
+        PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+        PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1,
+    };
+    size_t blocks = (len - 1) / XXH3_BLOCK, n;
+    uint64_t h = len * PRIME64_1;
+    int i;
+
+    for (n = 0; n < blocks; n++) {
+        k->accumulate(acc, p + n * XXH3_BLOCK, secret, XXH3_STRIPES);
+        k->scramble(acc, secret + XXH3_SECRET_SIZE - XXH3_STRIPE);
+    }
+    /* partial block, then last stripe of input with a shifted secret */
+    k->accumulate(acc, p + blocks * XXH3_BLOCK, secret,
+                  ((len - 1) - blocks * XXH3_BLOCK) / XXH3_STRIPE);
+    k->accumulate(acc, p + len - XXH3_STRIPE,
+                  secret + XXH3_SECRET_SIZE - XXH3_STRIPE - 7, 1);
+
+    for (i = 0; i < 4; i++)
+        h += mul128_fold64(acc[2 * i] ^ read64(secret + 11 + 16 * i),
+                           acc[2 * i + 1] ^ read64(secret + 19 + 16 * i));
+    return xxh3_avalanche(h);
+}
+
+/* (OK)
+ * XXH3 64 bit hash, seed 0.
+ * @data: bytes, may be NULL if @len is 0.
+ * @len: number of bytes.
+ *
+ * @return: hash, same as xxhsum -H3 and XXH3_64bits().
+ */
+uint64_t hash_xxh3(const void *data, size_t len)
+{
+    if (len <= 16)
+        return xxh3_short(data, len);
+    if (len <= XXH3_MIDSIZE_MAX)
+        return xxh3_mid(data, len);
+    return xxh3_long(data, len);
+}
+
+/* (OK)
+ * name of XXH3 kernel used on this CPU.
+ */
+const char *hash_xxh3_kernel(void)
+{
+    return xxh3_pick()->name;
+}
+
+/* ---------------------------------------
+ *   SHA-256
+ */
+
+static const uint32_t SHA256_K[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/*
+ * SHA-256 kernel
+ * @blocks: run compression function over @n blocks of 64 bytes.
+ */
+struct sha256_kernel {
+    const char *name;
+    void       (*blocks)(uint32_t *state, const unsigned char *p, size_t n);
+};
+
+static uint32_t rotr32(uint32_t x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_blocks_scalar(uint32_t *state, const unsigned char *p,
+                                 size_t n)
+{
+    uint32_t w[64], s[8], t1, t2;
+    int i;
+
+    for (; n; n--, p += 64) {
+        for (i = 0; i < 16; i++)
+            w[i] = read32_be(p + 4 * i);
+        for (i = 16; i < 64; i++)
+            w[i] = w[i - 16] + w[i - 7] +
+                   (rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^
+                    (w[i - 15] >> 3)) +
+                   (rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^
+                    (w[i - 2] >> 10));
+        memcpy(s, state, sizeof(s));
+        for (i = 0; i < 64; i++) {
+            t1 = s[7] + (rotr32(s[4], 6) ^ rotr32(s[4], 11) ^
+                         rotr32(s[4], 25)) +
+                 ((s[4] & s[5]) ^ (~s[4] & s[6])) + SHA256_K[i] + w[i];
+            t2 = (rotr32(s[0], 2) ^ rotr32(s[0], 13) ^ rotr32(s[0], 22)) +
+                 ((s[0] & s[1]) ^ (s[0] & s[2]) ^ (s[1] & s[2]));
+            s[7] = s[6];
+            s[6] = s[5];
+            s[5] = s[4];
+            s[4] = s[3] + t1;
+            s[3] = s[2];
+            s[2] = s[1];
+            s[1] = s[0];
+            s[0] = t1 + t2;
+        }
+        for (i = 0; i < 8; i++)
+            state[i] += s[i];
+    }
+}
+
+#ifdef HASH_X86
+/*
+ * SHA extensions take the state as ABEF and CDGH halves and run two
+ * rounds per instruction. Message words are kept as four vectors of
+ * four, msg1/msg2 extend the schedule four words at a time.
+ */
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_sha(uint32_t *state, const unsigned char *p,
+                              size_t n)
+{
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                        0x0405060700010203ULL);
+    __m128i s0, s1, tmp, save0, save1, m, w[4];
+    int g;
+
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xb1);
+    s1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state + 1),
+                           0x1b);
+    s0 = _mm_alignr_epi8(tmp, s1, 8);
+    s1 = _mm_blend_epi16(s1, tmp, 0xf0);
+
+    for (; n; n--, p += 64) {
+        save0 = s0;
+        save1 = s1;
+#pragma GCC unroll 16
+        for (g = 0; g < 16; g++) {
+            if (g < 4)
+                w[g] = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)p + g), swap);
+            m = _mm_add_epi32(w[g & 3],
+                    _mm_load_si128((const __m128i *)SHA256_K + g));
+            s1 = _mm_sha256rnds2_epu32(s1, s0, m);
+            if (g >= 3 && g <= 14) {
+                tmp = _mm_alignr_epi8(w[g & 3], w[(g - 1) & 3], 4);
+                w[(g + 1) & 3] = _mm_sha256msg2_epu32(
+                        _mm_add_epi32(w[(g + 1) & 3], tmp), w[g & 3]);
+            }
+            s0 = _mm_sha256rnds2_epu32(s0, s1, _mm_shuffle_epi32(m, 0x0e));
+            if (g >= 1 && g <= 12)
+                w[(g - 1) & 3] = _mm_sha256msg1_epu32(w[(g - 1) & 3],
+                                                      w[g & 3]);
+        }
+        s0 = _mm_add_epi32(s0, save0);
+        s1 = _mm_add_epi32(s1, save1);
+    }
+
+    tmp = _mm_shuffle_epi32(s0, 0x1b);
+    s1 = _mm_shuffle_epi32(s1, 0xb1);
+    s0 = _mm_blend_epi16(tmp, s1, 0xf0);
+    s1 = _mm_alignr_epi8(s1, tmp, 8);
+    _mm_storeu_si128((__m128i *)state, s0);
+    _mm_storeu_si128((__m128i *)state + 1, s1);
+}
+#endif
+
+static const struct sha256_kernel SHA256_KERNELS[] = {
+    { "scalar", sha256_blocks_scalar },
+#ifdef HASH_X86
+    { "sha",    sha256_blocks_sha },
+#endif
+};
+
+static const struct sha256_kernel *sha256_kernel;
+
+static const struct sha256_kernel *sha256_pick(void)
+{
+    const struct sha256_kernel *k = __atomic_load_n(&sha256_kernel,
+                                                    __ATOMIC_ACQUIRE);
+
+    if (k)
+        return k;
+    k = &SHA256_KERNELS[0];
+#ifdef HASH_X86
+    if (!hash_scalar_only()) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sha") &&
+            __builtin_cpu_supports("sse4.1"))
+            k = &SHA256_KERNELS[1];
+    }
+#endif
+    __atomic_store_n(&sha256_kernel, k, __ATOMIC_RELEASE);
+    return k;
+}
+
+/* (OK)
+ * SHA-256 digest.
+ * @data: bytes, may be NULL if @len is 0.
+ * @len: number of bytes.
+ * @digest: takes HASH_SHA256_SIZE bytes.
+ */
+void hash_sha256(const void *data, size_t len,
+                 unsigned char digest[HASH_SHA256_SIZE])
+{
+    const struct sha256_kernel *k = sha256_pick();
+    uint32_t state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    unsigned char tail[128];
+    uint64_t bits = (uint64_t)len * 8;
+    size_t full = len / 64, rest = len % 64, pad;
+    int i;
+
+    if (full)
+        k->blocks(state, data, full);
+
+    /* 0x80, zeros and length in bits fill one or two more blocks */
+    pad = rest < 56 ? 64 : 128;
+    memset(tail, 0, sizeof(tail));
+    if (rest)
+        memcpy(tail, (const unsigned char *)data + full * 64, rest);
+    tail[rest] = 0x80;
+    for (i = 0; i < 8; i++)
+        tail[pad - 1 - i] = bits >> (8 * i);
+    k->blocks(state, tail, pad / 64);
+
+    for (i = 0; i < 8; i++) {
+        digest[4 * i] = state[i] >> 24;
+        digest[4 * i + 1] = state[i] >> 16;
+        digest[4 * i + 2] = state[i] >> 8;
+        digest[4 * i + 3] = state[i];
+    }
+}
+
+/* (OK)
+ * name of SHA-256 kernel used on this CPU.
+ */
+const char *hash_sha256_kernel(void)
+{
+    return sha256_pick()->name;
+}
@@ -0,0 +1,334 @@
+/*
+ * streaming JSON writer
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <string.h>
+#include <stdio.h>
+
+#include <xmalloc.h>
+#include <json.h>
+
+/*
+ * bytes which can't be copied into a string as they are: control
+ * characters, quote, backslash and everything outside ASCII, which
+ * has to be checked for well-formed UTF-8.
+ */
+static const unsigned char json_special[256] = {
+    [0 ... 0x1f]    = 1,
+    ['"']           = 1,
+    ['\\']          = 1,
+    [0x80 ... 0xff] = 1,
+};
+
+static const char json_digits[] = "0123456789abcdef";
+
+/* (OK)
+ * write out buffered output.
+ * @w: writer.
+ */
+void json_flush(struct json_writer *w)
+{
+    if (w->len)
+        fwrite(w->buf, 1, w->len, w->fp);
+    w->len = 0;
+}
+
+/*
+ * append bytes to output buffer, large runs bypass the buffer.
+ */
+static void json_put(struct json_writer *w, const void *data, size_t len)
+{
+    if (w->len + len > JSON_BUFFER_SIZE) {
+        json_flush(w);
+        if (len > JSON_BUFFER_SIZE) {
+            fwrite(data, 1, len, w->fp);
+            return;
+        }
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static inline void json_putc(struct json_writer *w, char c)
+{
+    if (w->len == JSON_BUFFER_SIZE)
+        json_flush(w);
+    w->buf[w->len++] = c;
+}
+
+/*
+ * length of well-formed UTF-8 sequence at @s, 0 if malformed.
+ */
+static size_t json_utf8_length(const unsigned char *s, size_t len)
+{
+    unsigned char lo = 0x80, hi = 0xbf;
+    size_t n, i;
+
+    if (s[0] >= 0xc2 && s[0] <= 0xdf)
+        n = 2;
+    else if (s[0] >= 0xe0 && s[0] <= 0xef) {
+        n = 3;
+        if (s[0] == 0xe0)
+            lo = 0xa0;
+        else if (s[0] == 0xed)
+            hi = 0x9f;
+    } else if (s[0] >= 0xf0 && s[0] <= 0xf4) {
+        n = 4;
+        if (s[0] == 0xf0)
+            lo = 0x90;
+        else if (s[0] == 0xf4)
+            hi = 0x8f;
+    } else
+        return 0;
+
+    if (n > len || s[1] < lo || s[1] > hi)
+        return 0;
+    for (i = 2; i < n; i++)
+        if (s[i] < 0x80 || s[i] > 0xbf)
+            return 0;
+    return n;
+}
+
+/*
+ * write string contents escaped. Runs of plain ASCII are copied in
+ * one go, bytes of malformed UTF-8 are written as \u00XX so that
+ * output stays valid whatever the string table holds.
+ */
+static void json_escape(struct json_writer *w, const unsigned char *s,
+      size_t len)
+{
+    char esc[6] = { '\\', 'u', '0', '0' };
+    size_t i = 0, run, n;
+
+    while (i < len) {
+        for (run = i; run < len && !json_special[s[run]]; run++)
+            ;
+        if (run > i)
+            json_put(w, s + i, run - i);
+        if (run == len)
+            break;
+        i = run;
+
+        if (s[i] >= 0x80 && (n = json_utf8_length(s + i, len - i))) {
+            json_put(w, s + i, n);
+            i += n;
+            continue;
+        }
+        switch (s[i]) {
+        case '"':
+        case '\\':
+            esc[1] = s[i];
+            json_put(w, esc, 2);
+            break;
+        case '\n':
+            json_put(w, "\\n", 2);
+            break;
+        case '\t':
+            json_put(w, "\\t", 2);
+            break;
+        case '\r':
+            json_put(w, "\\r", 2);
+            break;
+        default:
+            esc[1] = 'u';
+            esc[4] = json_digits[s[i] >> 4];
+            esc[5] = json_digits[s[i] & 0xf];
+            json_put(w, esc, 6);
+            break;
+        }
+        i++;
+    }
+}
+
+/*
+ * write separator and key of next field, keys are plain ASCII.
+ */
+static void json_key(struct json_writer *w, const char *key)
+{
+    if (w->fields++)
+        json_putc(w, ',');
+    json_putc(w, '"');
+    json_put(w, key, strlen(key));
+    json_put(w, "\":", 2);
+}
+
+/* (OK)
+ * writer on stream.
+ * @fp: output stream.
+ *
+ * @return: writer, NULL on failure.
+ */
+struct json_writer *json_writer_alloc(FILE *fp)
+{
+    struct json_writer *w;
+
+    w = xmalloc(sizeof(*w));
+    if (!w)
+        return NULL;
+    w->buf = xmalloc(JSON_BUFFER_SIZE);
+    if (!w->buf) {
+        xfree(w);
+        return NULL;
+    }
+    w->fp = fp;
+    w->len = 0;
+    w->fields = 0;
+    return w;
+}
+
+/* (OK)
+ * flush and free writer, the stream is left open.
+ * @w: writer.
+ */
+void json_writer_free(struct json_writer *w)
+{
+    if (!w)
+        return;
+    json_flush(w);
+    xfree(w->buf);
+    xfree(w);
+}
+
+/* (OK)
+ * start object.
+ * @w: writer.
+ */
+void json_begin(struct json_writer *w)
+{
+    json_putc(w, '{');
+    w->fields = 0;
+}
+
+/* (OK)
+ * end object, each object takes one line.
+ * @w: writer.
+ */
+void json_end(struct json_writer *w)
+{
+    json_put(w, "}\n", 2);
+}
+
+/* (OK)
+ * string field of given length.
+ * @w: writer.
+ * @key: field name.
+ * @value: string, needn't be terminated.
+ * @len: length of string.
+ */
+void json_strn(struct json_writer *w, const char *key, const char *value,
+      size_t len)
+{
+    json_key(w, key);
+    json_putc(w, '"');
+    json_escape(w, (const unsigned char *)value, len);
+    json_putc(w, '"');
+}
+
+/* (OK)
+ * string field.
+ * @w: writer.
+ * @key: field name.
+ * @value: string, NULL is written as null.
+ */
+void json_str(struct json_writer *w, const char *key, const char *value)
+{
+    if (!value) {
+        json_key(w, key);
+        json_put(w, "null", 4);
+        return;
+    }
+    json_strn(w, key, value, strlen(value));
+}
+
+/* (OK)
+ * unsigned number field.
+ * @w: writer.
+ * @key: field name.
+ * @value: number.
+ */
+void json_u64(struct json_writer *w, const char *key, uint64_t value)
+{
+    char buf[20];
+    int i = sizeof(buf);
+
+    json_key(w, key);
+    do {
+        buf[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    json_put(w, buf + i, sizeof(buf) - i);
+}
+
+/* (OK)
+ * signed number field.
+ * @w: writer.
+ * @key: field name.
+ * @value: number.
+ */
+void json_i64(struct json_writer *w, const char *key, int64_t value)
+{
+    char buf[21];
+    uint64_t u = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    int i = sizeof(buf);
+
+    json_key(w, key);
+    do {
+        buf[--i] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (value < 0)
+        buf[--i] = '-';
+    json_put(w, buf + i, sizeof(buf) - i);
+}
+
+/* (OK)
+ * boolean field.
+ * @w: writer.
+ * @key: field name.
+ * @value: zero for false.
+ */
+void json_bool(struct json_writer *w, const char *key, int value)
+{
+    json_key(w, key);
+    if (value)
+        json_put(w, "true", 4);
+    else
+        json_put(w, "false", 5);
+}
+
+/* (OK)
+ * string field of bytes as lowercase hex digits.
+ * @w: writer.
+ * @key: field name.
+ * @data: bytes.
+ * @len: number of bytes.
+ */
+void json_hex(struct json_writer *w, const char *key,
+      const unsigned char *data, size_t len)
+{
+    char buf[64];
+    size_t i, n = 0;
+
+    json_key(w, key);
+    json_putc(w, '"');
+    for (i = 0; i < len; i++) {
+        buf[n++] = json_digits[data[i] >> 4];
+        buf[n++] = json_digits[data[i] & 0xf];
+        if (n == sizeof(buf)) {
+            json_put(w, buf, n);
+            n = 0;
+        }
+    }
+    json_put(w, buf, n);
+    json_putc(w, '"');
+}
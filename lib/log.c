@@ -0,0 +1,674 @@
+/*
+ * asynchronous logging
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <ring.h>
+#include <log.h>
+
+/* ---------------------------------------
+ *   print_log() on any thread                         log thread
+ *
+ *   [record|arg|arg|...] -> ring of thread -> format, write
+ *
+ * The caller doesn't format. It walks the conversions of format and
+ * copies what they take into its ring: integers as 8 bytes, floating
+ * point as is, strings as length and bytes. The log thread walks the
+ * same conversions again and formats one conversion at a time.
+ * Formatting and the write never run on the thread which logged.
+ *
+ * Levels above log_level are dropped by the macros before any
+ * argument is evaluated, so disabled debug messages cost a compare.
+ */
+
+#define LOG_STRING_MAX     1024     /* bytes kept of a %s argument */
+#define LOG_LINE_MAX       8192
+#define LOG_SPEC_MAX       64
+
+/* length modifiers */
+#define LOG_LEN_NONE       0
+#define LOG_LEN_HH         1
+#define LOG_LEN_H          2
+#define LOG_LEN_L          3
+#define LOG_LEN_LL         4
+#define LOG_LEN_J          5
+#define LOG_LEN_Z          6
+#define LOG_LEN_T          7
+#define LOG_LEN_LD         8
+
+static const char *LOG_LEVEL_NAMES[] = {
+    [LOG_LEVEL_ERROR]   = "error",
+    [LOG_LEVEL_WARNING] = "warning",
+    [LOG_LEVEL_INFO]    = "info",
+    [LOG_LEVEL_DEBUG]   = "debug",
+};
+
+/*
+ * message on ring, followed by its arguments
+ * @time: CLOCK_REALTIME ns when logged.
+ * @err: errno when logged, for %m.
+ */
+struct log_record {
+    uint64_t   time;
+    const char *function;
+    const char *format;
+    int32_t    level;
+    int32_t    err;
+};
+
+/*
+ * one conversion of a format
+ * @start: '%' of conversion.
+ * @end: past conversion character.
+ * @flags, @width, @precision: as written, '*' for argument.
+ */
+struct log_conv {
+    const char *start;
+    const char *end;
+    const char *flags;
+    int        flags_len;
+    const char *width;
+    int        width_len;
+    const char *precision;
+    int        precision_len;
+    int        length;
+    char       conv;
+};
+
+int log_level = LOG_LEVEL_WARNING;
+
+static FILE *log_fp;
+static struct ring_set *log_rings;
+static int log_async;
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct ring *log_ring;
+
+/*
+ * next conversion of format.
+ * @return: past literal text before conversion, NULL at end of format.
+ */
+static const char *log_next_conv(const char *p, struct log_conv *c)
+{
+    while (*p && *p != '%')
+        p++;
+    if (!*p)
+        return NULL;
+    c->start = p++;
+
+    c->flags = p;
+    while (*p && strchr("-+ #0'", *p))
+        p++;
+    c->flags_len = p - c->flags;
+    c->width = p;
+    if (*p == '*')
+        p++;
+    else
+        while (*p >= '0' && *p <= '9')
+            p++;
+    c->width_len = p - c->width;
+    c->precision = p;
+    if (*p == '.') {
+        p++;
+        if (*p == '*')
+            p++;
+        else
+            while (*p >= '0' && *p <= '9')
+                p++;
+    }
+    c->precision_len = p - c->precision;
+
+    c->length = LOG_LEN_NONE;
+    switch (*p) {
+    case 'h':
+        c->length = p[1] == 'h' ? LOG_LEN_HH : LOG_LEN_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        c->length = p[1] == 'l' ? LOG_LEN_LL : LOG_LEN_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'q':
+        c->length = LOG_LEN_LL;
+        p++;
+        break;
+    case 'j':
+        c->length = LOG_LEN_J;
+        p++;
+        break;
+    case 'z':
+        c->length = LOG_LEN_Z;
+        p++;
+        break;
+    case 't':
+        c->length = LOG_LEN_T;
+        p++;
+        break;
+    case 'L':
+        c->length = LOG_LEN_LD;
+        p++;
+        break;
+    }
+    c->conv = *p;
+    c->end = *p ? p + 1 : p;
+    return c->start;
+}
+
+static int log_star_width(struct log_conv *c)
+{
+    return c->width_len == 1 && c->width[0] == '*';
+}
+
+static int log_star_precision(struct log_conv *c)
+{
+    return c->precision_len == 2 && c->precision[1] == '*';
+}
+
+/* ---------------------------------------
+ *   encoding, on thread which logged
+ */
+
+struct log_buf {
+    char   *p;
+    size_t left;
+};
+
+static int log_put(struct log_buf *b, const void *data, size_t len)
+{
+    if (len > b->left)
+        return -1;
+    memcpy(b->p, data, len);
+    b->p += len;
+    b->left -= len;
+    return 0;
+}
+
+static int log_put_i64(struct log_buf *b, int64_t value)
+{
+    return log_put(b, &value, sizeof(value));
+}
+
+static int log_put_string(struct log_buf *b, const char *s)
+{
+    uint32_t len;
+
+    if (!s)
+        s = "(null)";
+    len = strnlen(s, LOG_STRING_MAX);
+    if (b->left < sizeof(len))
+        return -1;
+    if (len > b->left - sizeof(len))
+        len = b->left - sizeof(len);
+    log_put(b, &len, sizeof(len));
+    return log_put(b, s, len);
+}
+
+static int64_t log_signed(struct log_conv *c, va_list *ap)
+{
+    switch (c->length) {
+    case LOG_LEN_HH:
+        return (signed char)va_arg(*ap, int);
+    case LOG_LEN_H:
+        return (short)va_arg(*ap, int);
+    case LOG_LEN_L:
+        return va_arg(*ap, long);
+    case LOG_LEN_LL:
+        return va_arg(*ap, long long);
+    case LOG_LEN_J:
+        return va_arg(*ap, intmax_t);
+    case LOG_LEN_Z:
+        return va_arg(*ap, ssize_t);
+    case LOG_LEN_T:
+        return va_arg(*ap, ptrdiff_t);
+    }
+    return va_arg(*ap, int);
+}
+
+static uint64_t log_unsigned(struct log_conv *c, va_list *ap)
+{
+    switch (c->length) {
+    case LOG_LEN_HH:
+        return (unsigned char)va_arg(*ap, unsigned int);
+    case LOG_LEN_H:
+        return (unsigned short)va_arg(*ap, unsigned int);
+    case LOG_LEN_L:
+        return va_arg(*ap, unsigned long);
+    case LOG_LEN_LL:
+        return va_arg(*ap, unsigned long long);
+    case LOG_LEN_J:
+        return va_arg(*ap, uintmax_t);
+    case LOG_LEN_Z:
+        return va_arg(*ap, size_t);
+    case LOG_LEN_T:
+        return va_arg(*ap, ptrdiff_t);
+    }
+    return va_arg(*ap, unsigned int);
+}
+
+/*
+ * copy arguments of format into buffer. Stops at the first argument
+ * which doesn't fit or a conversion it doesn't know, the formatter
+ * stops at the same place.
+ * @return: bytes of arguments.
+ */
+static size_t log_encode(char *buf, size_t size, const char *format,
+                         va_list *ap)
+{
+    struct log_buf b = { buf, size };
+    struct log_conv c;
+    const char *p = format;
+
+    while ((p = log_next_conv(p, &c))) {
+        p = c.end;
+        if (log_star_width(&c) && log_put_i64(&b, va_arg(*ap, int)))
+            break;
+        if (log_star_precision(&c) && log_put_i64(&b, va_arg(*ap, int)))
+            break;
+        switch (c.conv) {
+        case 'd':
+        case 'i':
+            if (log_put_i64(&b, log_signed(&c, ap)))
+                goto out;
+            continue;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if (log_put_i64(&b, log_unsigned(&c, ap)))
+                goto out;
+            continue;
+        case 'c':
+            if (log_put_i64(&b, va_arg(*ap, int)))
+                goto out;
+            continue;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (c.length == LOG_LEN_LD) {
+                long double value = va_arg(*ap, long double);
+
+                if (log_put(&b, &value, sizeof(value)))
+                    goto out;
+            } else {
+                double value = va_arg(*ap, double);
+
+                if (log_put(&b, &value, sizeof(value)))
+                    goto out;
+            }
+            continue;
+        case 's':
+            if (log_put_string(&b, va_arg(*ap, const char *)))
+                goto out;
+            continue;
+        case 'p':
+            if (log_put_i64(&b, (intptr_t)va_arg(*ap, void *)))
+                goto out;
+            continue;
+        case 'n':
+            (void)va_arg(*ap, void *);
+            continue;
+        case '%':
+        case 'm':
+            continue;
+        }
+        break;
+    }
+out:
+    return b.p - buf;
+}
+
+/* ---------------------------------------
+ *   formatting, on log thread
+ */
+
+struct log_line {
+    char   buf[LOG_LINE_MAX];
+    size_t len;
+};
+
+static void log_append(struct log_line *l, const char *s, size_t len)
+{
+    if (len > sizeof(l->buf) - 1 - l->len)
+        len = sizeof(l->buf) - 1 - l->len;
+    memcpy(l->buf + l->len, s, len);
+    l->len += len;
+}
+
+static void log_appendf(struct log_line *l, const char *format, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, format);
+    n = vsnprintf(l->buf + l->len, sizeof(l->buf) - l->len, format, ap);
+    va_end(ap);
+    if (n > 0)
+        l->len += (size_t)n < sizeof(l->buf) - l->len ?
+                  (size_t)n : sizeof(l->buf) - 1 - l->len;
+}
+
+/*
+ * take next argument off record.
+ * @return: 0 if there was one.
+ */
+static int log_take(const char **args, const char *end, void *data,
+                    size_t len)
+{
+    if ((size_t)(end - *args) < len)
+        return -1;
+    memcpy(data, *args, len);
+    *args += len;
+    return 0;
+}
+
+/*
+ * printf spec of conversion taking one argument, stars resolved
+ * and integers widened to long long.
+ */
+static int log_spec(char *spec, struct log_conv *c, const char **args,
+                    const char *end)
+{
+    int64_t star;
+    int n = 0;
+
+    spec[n++] = '%';
+    memcpy(spec + n, c->flags, c->flags_len);
+    n += c->flags_len;
+    if (log_star_width(c)) {
+        if (log_take(args, end, &star, sizeof(star)))
+            return -1;
+        n += sprintf(spec + n, "%d", (int)star);
+    } else {
+        memcpy(spec + n, c->width, c->width_len);
+        n += c->width_len;
+    }
+    if (log_star_precision(c)) {
+        if (log_take(args, end, &star, sizeof(star)))
+            return -1;
+        n += sprintf(spec + n, ".%d", (int)star);
+    } else {
+        memcpy(spec + n, c->precision, c->precision_len);
+        n += c->precision_len;
+    }
+    if (strchr("diuoxX", c->conv)) {
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+    } else if (c->length == LOG_LEN_LD) {
+        spec[n++] = 'L';
+    }
+    spec[n++] = c->conv;
+    spec[n] = '\0';
+    return 0;
+}
+
+static void log_format(struct log_line *l, const struct log_record *rec,
+                       const char *args, const char *end)
+{
+    const char *p = rec->format, *text;
+    char spec[LOG_SPEC_MAX];
+    struct log_conv c;
+
+    for (text = p; (p = log_next_conv(p, &c)); text = p = c.end) {
+        int64_t value;
+
+        log_append(l, text, c.start - text);
+        /* a spec longer than any sane one is printed as is */
+        if (c.end - c.start > LOG_SPEC_MAX - 8)
+            break;
+        if (c.conv == '%') {
+            log_append(l, "%", 1);
+            continue;
+        }
+        if (c.conv == 'm') {
+            log_append(l, strerror(rec->err), strlen(strerror(rec->err)));
+            continue;
+        }
+        if (c.conv == 'n')
+            continue;
+        if (log_spec(spec, &c, &args, end))
+            break;
+
+        switch (c.conv) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            if (log_take(&args, end, &value, sizeof(value)))
+                goto out;
+            if (c.conv == 'c')
+                log_appendf(l, spec, (int)value);
+            else
+                log_appendf(l, spec, (long long)value);
+            continue;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (c.length == LOG_LEN_LD) {
+                long double ld;
+
+                if (log_take(&args, end, &ld, sizeof(ld)))
+                    goto out;
+                log_appendf(l, spec, ld);
+            } else {
+                double d;
+
+                if (log_take(&args, end, &d, sizeof(d)))
+                    goto out;
+                log_appendf(l, spec, d);
+            }
+            continue;
+        case 's': {
+            char s[LOG_STRING_MAX + 1];
+            uint32_t len;
+
+            if (log_take(&args, end, &len, sizeof(len)) ||
+                log_take(&args, end, s, len))
+                goto out;
+            s[len] = '\0';
+            log_appendf(l, spec, s);
+            continue;
+        }
+        case 'p':
+            if (log_take(&args, end, &value, sizeof(value)))
+                goto out;
+            log_appendf(l, spec, (void *)(intptr_t)value);
+            continue;
+        }
+        break;
+    }
+out:
+    /* rest of format, if arguments ran out */
+    if (p)
+        log_append(l, c.start, strlen(c.start));
+    else
+        log_append(l, text, strlen(text));
+}
+
+/*
+ * format and write one message.
+ * @id: thread number.
+ */
+static void log_write_record(const struct log_record *rec, size_t len,
+                             int id)
+{
+    static struct log_line line;
+    struct log_line *l = &line;
+    time_t sec = rec->time / 1000000000ULL;
+    struct tm tm;
+
+    localtime_r(&sec, &tm);
+    l->len = strftime(l->buf, sizeof(l->buf), "%Y-%m-%d %H:%M:%S", &tm);
+    log_appendf(l, ".%06u [%d] %s %s: ",
+                (unsigned)(rec->time % 1000000000ULL / 1000), id,
+                LOG_LEVEL_NAMES[rec->level], rec->function);
+    log_format(l, rec, (const char *)(rec + 1), (const char *)rec + len);
+    if (!l->len || l->buf[l->len - 1] != '\n')
+        l->buf[l->len++] = '\n';
+    fwrite(l->buf, 1, l->len, log_fp);
+}
+
+static void log_write(struct ring *r, const void *record, size_t len,
+                      void *data)
+{
+    log_write_record(record, len, r->id);
+}
+
+static void log_idle(void *data)
+{
+    fflush(log_fp);
+}
+
+/*
+ * stop log thread at exit, after every message has been written.
+ */
+static void log_exit(void)
+{
+    pthread_mutex_lock(&log_lock);
+    if (log_async) {
+        __atomic_store_n(&log_async, 0, __ATOMIC_RELEASE);
+        ring_set_stop(log_rings);
+    }
+    fflush(log_fp);
+    pthread_mutex_unlock(&log_lock);
+}
+
+static void log_start(void)
+{
+    const char *name = getenv("UTILSE_LOG_FILE");
+
+    log_fp = name ? fopen(name, "a") : NULL;
+    if (!log_fp)
+        log_fp = stderr;
+    /* without a log thread messages are written where logged */
+    log_rings = ring_set_alloc(LOG_RING_SIZE, log_write, log_idle, NULL);
+    if (log_rings)
+        log_async = 1;
+    atexit(log_exit);
+}
+
+/* level from environment, before anything is logged */
+static void __attribute__((constructor)) log_init(void)
+{
+    const char *level = getenv("UTILSE_LOG");
+    int i;
+
+    if (!level)
+        return;
+    for (i = 0; i <= LOG_LEVEL_DEBUG; i++)
+        if (!strcmp(level, LOG_LEVEL_NAMES[i]) ||
+            (level[0] == '0' + i && !level[1]))
+            log_level = i;
+}
+
+/* (OK)
+ * set level, messages above it are dropped.
+ * @level: LOG_LEVEL_*.
+ */
+void log_set_level(int level)
+{
+    log_level = level;
+}
+
+/* (OK)
+ * log message, use the print_* macros of log.h. Only the arguments
+ * are copied here, formatting and writing happen on the log thread.
+ * Precision of %s isn't applied before copying, strings are kept up
+ * to LOG_STRING_MAX bytes. Wide characters aren't supported.
+ * @level: LOG_LEVEL_*.
+ * @function: function logging, must stay valid.
+ * @format: printf format, must stay valid.
+ */
+void print_log(int level, const char *function, const char *format, ...)
+{
+    char buf[LOG_RECORD_MAX];
+    struct log_record *rec = (struct log_record *)buf;
+    struct timespec ts;
+    struct ring *r;
+    va_list ap;
+    size_t len;
+    uint64_t pos;
+
+    if (level > log_level || level < 0)
+        return;
+    rec->err = errno;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->time = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->level = level;
+    rec->function = function;
+    rec->format = format;
+    va_start(ap, format);
+    len = sizeof(*rec) + log_encode(buf + sizeof(*rec),
+                                    sizeof(buf) - sizeof(*rec), format, &ap);
+    va_end(ap);
+
+    pthread_once(&log_once, log_start);
+    if (!__atomic_load_n(&log_async, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&log_lock);
+        log_write_record(rec, len, -1);
+        pthread_mutex_unlock(&log_lock);
+        errno = rec->err;
+        return;
+    }
+    r = log_ring;
+    if (!r)
+        r = log_ring = ring_attach(log_rings);
+    pos = ring_reserve(r, len);
+    ring_put(r, pos, buf, len);
+    ring_commit(r);
+    errno = rec->err;
+}
+
+/* (OK)
+ * wait until messages logged so far, on any thread, are written.
+ */
+void log_flush(void)
+{
+    struct ring *r;
+
+    if (__atomic_load_n(&log_async, __ATOMIC_ACQUIRE)) {
+        for (r = __atomic_load_n(&log_rings->rings, __ATOMIC_ACQUIRE); r;
+             r = r->next) {
+            uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+            while (__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) < head)
+                sched_yield();
+        }
+    }
+    if (log_fp)
+        fflush(log_fp);
+}
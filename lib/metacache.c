@@ -0,0 +1,477 @@
+/*
+ * on-disk metadata cache
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <xmalloc.h>
+#include <metacache.h>
+#include <log.h>
+
+/* ---------------------------------------
+ *   <dir>/<build-id>.meta        file has a GNU build-id
+ *   <dir>/<dev>-<inode>.meta     file hasn't, mtime is checked
+ *
+ *   header | blob | blob | ... | blob table
+ *
+ *   Entries are written to a temporary file and renamed over the
+ *   old one, so concurrent runs never see half an entry. Entries
+ *   are only valid on the host that wrote them.
+ * ---------------------------------------
+ */
+
+/*
+ * Path of cache entry of ELF file.
+ * @return: 1 if entry is keyed by inode, else 0.
+ */
+static int metacache_path(const char *dir, struct elf_file *ef, char *buf,
+                          size_t size)
+{
+    const unsigned char *id;
+    int i, len, n;
+
+    len = elf_file_build_id(ef, &id);
+    if (!len) {
+        snprintf(buf, size, "%s/%llx-%llx.meta", dir,
+                 (unsigned long long)ef->dev, (unsigned long long)ef->ino);
+        return 1;
+    }
+    n = snprintf(buf, size, "%s/", dir);
+    for (i = 0; i < len && n + 3 < (int)size; i++)
+        n += snprintf(buf + n, size - n, "%02x", id[i]);
+    snprintf(buf + n, size - n, ".meta");
+    return 0;
+}
+
+/*
+ * Check header and blob table of mapped entry.
+ * @return: 0 if entry belongs to ELF file.
+ */
+static int metacache_check(struct metacache *mc, struct elf_file *ef,
+                           int by_inode)
+{
+    struct metacache_header *h = mc->header;
+    int i;
+
+    if (mc->size < sizeof(*h) || memcmp(h->magic, METACACHE_MAGIC, 8) ||
+        h->file_size != ef->size || h->by_inode != (uint32_t)by_inode ||
+        (by_inode && h->mtime != ef->mtime))
+        return -1;
+    if (h->blob_table > mc->size || (h->blob_table & 7) ||
+        h->blob_numbers > (mc->size - h->blob_table) /
+                          sizeof(struct metacache_blob))
+        return -1;
+    mc->blobs = (struct metacache_blob *)(mc->map + h->blob_table);
+    for (i = 0; i < (int)h->blob_numbers; i++) {
+        struct metacache_blob *b = &mc->blobs[i];
+
+        if ((b->offset & 7) || b->offset > mc->size ||
+            b->size > mc->size - b->offset)
+            return -1;
+    }
+    return 0;
+}
+
+/* (OK)
+ * map cache entry of ELF file.
+ * @dir: cache directory.
+ * @ef: elf file handle opened from a file.
+ *
+ * @return: cache entry, NULL if there is none or it is stale.
+ */
+struct metacache *metacache_alloc(const char *dir, struct elf_file *ef)
+{
+    struct metacache *mc;
+    char path[4096];
+    struct stat sb;
+    void *map;
+    int fd, by_inode;
+
+    if (ef->borrowed)
+        return NULL;
+    by_inode = metacache_path(dir, ef, path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &sb) < 0 || !sb.st_size) {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    mc = xmalloc(sizeof(struct metacache));
+    mc->map = map;
+    mc->size = sb.st_size;
+    mc->header = map;
+    if (metacache_check(mc, ef, by_inode)) {
+        print_dbg("%s: stale entry for %s", path, ef->filename);
+        metacache_free(mc);
+        return NULL;
+    }
+    return mc;
+}
+
+/* (OK)
+ * unmap cache entry, nothing loaded from it may be used after.
+ */
+void metacache_free(struct metacache *mc)
+{
+    if (!mc)
+        return;
+    munmap(mc->map, mc->size);
+    xfree(mc);
+}
+
+/* (OK)
+ * contents of blob.
+ * @mc: cache entry.
+ * @tag: METACACHE_*.
+ * @size: set to size of blob.
+ *
+ * @return: blob on mapping, NULL if entry hasn't one.
+ */
+const void *metacache_blob(struct metacache *mc, uint32_t tag,
+                           uint64_t *size)
+{
+    int i;
+
+    for (i = 0; i < (int)mc->header->blob_numbers; i++) {
+        if (mc->blobs[i].tag == tag) {
+            *size = mc->blobs[i].size;
+            return mc->map + mc->blobs[i].offset;
+        }
+    }
+    return NULL;
+}
+
+/* (OK)
+ * start a new cache entry.
+ * @dir: cache directory, created if missing.
+ * @ef: elf file handle opened from a file.
+ *
+ * @return: writer, NULL if entry can't be written.
+ */
+struct metacache_writer *metacache_writer_alloc(const char *dir,
+                                                struct elf_file *ef)
+{
+    struct metacache_writer *w;
+    char path[4096];
+    int fd;
+
+    if (ef->borrowed)
+        return NULL;
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+        return NULL;
+
+    w = xmalloc(sizeof(struct metacache_writer));
+    memset(w, 0, sizeof(*w));
+    w->header.by_inode = metacache_path(dir, ef, path, sizeof(path));
+    w->path = xmalloc(strlen(path) + 1);
+    strcpy(w->path, path);
+    w->tmp = xmalloc(strlen(path) + 8);
+    sprintf(w->tmp, "%s.XXXXXX", path);
+    fd = mkstemp(w->tmp);
+    /* entries are shared, mkstemp() makes them private */
+    if (fd >= 0)
+        fchmod(fd, 0644);
+    if (fd < 0 || !(w->fp = fdopen(fd, "w"))) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(w->tmp);
+        }
+        xfree(w->path);
+        xfree(w->tmp);
+        xfree(w);
+        return NULL;
+    }
+    memcpy(w->header.magic, METACACHE_MAGIC, 8);
+    w->header.file_size = ef->size;
+    w->header.mtime = ef->mtime;
+    /* header is written on commit */
+    w->pos = sizeof(struct metacache_header);
+    fseek(w->fp, w->pos, SEEK_SET);
+    return w;
+}
+
+static void metacache_align(struct metacache_writer *w)
+{
+    static const char zero[8];
+
+    if (w->pos & 7) {
+        fwrite(zero, 1, 8 - (w->pos & 7), w->fp);
+        w->pos += 8 - (w->pos & 7);
+    }
+}
+
+/* (OK)
+ * start blob.
+ * @w: writer.
+ * @tag: METACACHE_*, appended data goes into blob until next one.
+ */
+void metacache_begin(struct metacache_writer *w, uint32_t tag)
+{
+    struct metacache_blob *b;
+    int n = w->header.blob_numbers;
+
+    if (n == w->blob_max) {
+        struct metacache_blob *tmp;
+
+        w->blob_max = w->blob_max ? w->blob_max * 2 : 8;
+        tmp = xmalloc(sizeof(struct metacache_blob) * w->blob_max);
+        if (w->blobs) {
+            memcpy(tmp, w->blobs, sizeof(struct metacache_blob) * n);
+            xfree(w->blobs);
+        }
+        w->blobs = tmp;
+    }
+    metacache_align(w);
+    b = &w->blobs[w->header.blob_numbers++];
+    b->tag = tag;
+    b->reserved = 0;
+    b->offset = w->pos;
+    b->size = 0;
+}
+
+/* (OK)
+ * append data to current blob.
+ */
+void metacache_append(struct metacache_writer *w, const void *data,
+                      uint64_t size)
+{
+    if (!w->header.blob_numbers || !size)
+        return;
+    fwrite(data, 1, size, w->fp);
+    w->pos += size;
+    w->blobs[w->header.blob_numbers - 1].size += size;
+}
+
+/* (OK)
+ * copy blobs of old entry, so tools caching different things don't
+ * evict each other.
+ * @w: writer.
+ * @mc: old entry of same file.
+ *
+ * Blobs whose tag @w already has are left out.
+ */
+void metacache_copy(struct metacache_writer *w, struct metacache *mc)
+{
+    int i, j, n = w->header.blob_numbers;
+
+    for (i = 0; i < (int)mc->header->blob_numbers; i++) {
+        struct metacache_blob *b = &mc->blobs[i];
+
+        for (j = 0; j < n; j++)
+            if (w->blobs[j].tag == b->tag)
+                break;
+        if (j < n)
+            continue;
+        metacache_begin(w, b->tag);
+        metacache_append(w, mc->map + b->offset, b->size);
+    }
+}
+
+/* (OK)
+ * write blob table and header, then publish entry.
+ * @w: writer, freed.
+ *
+ * @return: 0 on success, -1 if entry couldn't be written.
+ */
+int metacache_commit(struct metacache_writer *w)
+{
+    int ret = 0;
+
+    metacache_align(w);
+    w->header.blob_table = w->pos;
+    fwrite(w->blobs, sizeof(struct metacache_blob), w->header.blob_numbers,
+           w->fp);
+    if (fseek(w->fp, 0, SEEK_SET) ||
+        fwrite(&w->header, sizeof(w->header), 1, w->fp) != 1)
+        ret = -1;
+    if (fclose(w->fp) || ret || rename(w->tmp, w->path)) {
+        unlink(w->tmp);
+        ret = -1;
+    }
+    xfree(w->blobs);
+    xfree(w->path);
+    xfree(w->tmp);
+    xfree(w);
+    return ret;
+}
+
+/*
+ * offset of string on ELF mapping, UINT64_MAX for NULL.
+ */
+static uint64_t metacache_str(struct elf_file *ef, const char *str)
+{
+    const unsigned char *p = (const unsigned char *)str;
+
+    if (!p || p < ef->map || p >= ef->map + ef->size)
+        return UINT64_MAX;
+    return p - ef->map;
+}
+
+/* (OK)
+ * store decoded line tables.
+ * @w: writer.
+ * @ef: ELF file tables were decoded from.
+ * @dl: line tables.
+ */
+void metacache_save_lines(struct metacache_writer *w, struct elf_file *ef,
+                          struct dwarf_line *dl)
+{
+    uint64_t rows = 0, files = 0;
+    int i, j;
+
+    metacache_begin(w, METACACHE_LINE_CUS);
+    for (i = 0; i < dl->cu_numbers; i++) {
+        struct dwarf_line_cu *cu = &dl->cus[i];
+        struct metacache_line_cu rec;
+
+        memset(&rec, 0, sizeof(rec));
+        rec.offset = cu->offset;
+        rec.version = cu->version;
+        rec.row_first = rows;
+        rec.row_numbers = cu->row_numbers;
+        rec.file_first = files;
+        rec.file_numbers = cu->file_numbers;
+        metacache_append(w, &rec, sizeof(rec));
+        rows += cu->row_numbers;
+        files += cu->file_numbers;
+    }
+
+    metacache_begin(w, METACACHE_LINE_FILES);
+    for (i = 0; i < dl->cu_numbers; i++) {
+        for (j = 0; j < dl->cus[i].file_numbers; j++) {
+            struct metacache_line_file rec;
+
+            rec.name = metacache_str(ef, dl->cus[i].files[j].name);
+            rec.dir = metacache_str(ef, dl->cus[i].files[j].dir);
+            metacache_append(w, &rec, sizeof(rec));
+        }
+    }
+
+    /* rows are plain data and go as they are */
+    metacache_begin(w, METACACHE_LINE_ROWS);
+    for (i = 0; i < dl->cu_numbers; i++)
+        metacache_append(w, dl->cus[i].rows,
+                         sizeof(struct dwarf_line_row) * dl->cus[i].row_numbers);
+
+    metacache_begin(w, METACACHE_LINE_SEQS);
+    for (i = 0; i < dl->seq_numbers; i++) {
+        struct dwarf_line_seq *seq = &dl->seqs[i];
+        struct metacache_line_seq rec;
+
+        rec.low = seq->low;
+        rec.high = seq->high;
+        rec.cu = seq->cu - dl->cus;
+        rec.first = seq->first;
+        rec.last = seq->last;
+        rec.reserved = 0;
+        metacache_append(w, &rec, sizeof(rec));
+    }
+}
+
+static const char *metacache_load_str(struct elf_file *ef, uint64_t offset)
+{
+    if (offset >= ef->size)
+        return NULL;
+    return (const char *)ef->map + offset;
+}
+
+/* (OK)
+ * line tables from cache entry.
+ * @mc: cache entry, must outlive the tables.
+ * @ef: ELF file of entry, strings point into its mapping.
+ *
+ * @return: line tables whose rows stay on @mc, NULL if entry has
+ *          none or they don't fit.
+ */
+struct dwarf_line *metacache_load_lines(struct metacache *mc,
+                                        struct elf_file *ef)
+{
+    const struct metacache_line_cu *cus;
+    const struct metacache_line_file *files;
+    const struct metacache_line_seq *seqs;
+    struct dwarf_line_row *rows;
+    uint64_t cu_size, file_size, row_size, seq_size;
+    uint64_t cu_numbers, file_numbers, row_numbers, seq_numbers;
+    struct dwarf_line *dl;
+    int i, j;
+
+    cus = metacache_blob(mc, METACACHE_LINE_CUS, &cu_size);
+    files = metacache_blob(mc, METACACHE_LINE_FILES, &file_size);
+    rows = (struct dwarf_line_row *)metacache_blob(mc, METACACHE_LINE_ROWS,
+                                                   &row_size);
+    seqs = metacache_blob(mc, METACACHE_LINE_SEQS, &seq_size);
+    if (!cus || !files || !rows || !seqs)
+        return NULL;
+    cu_numbers = cu_size / sizeof(*cus);
+    file_numbers = file_size / sizeof(*files);
+    row_numbers = row_size / sizeof(*rows);
+    seq_numbers = seq_size / sizeof(*seqs);
+    for (i = 0; i < (int)cu_numbers; i++)
+        if (cus[i].row_first + cus[i].row_numbers > row_numbers ||
+            (uint64_t)cus[i].file_first + cus[i].file_numbers > file_numbers)
+            return NULL;
+    for (i = 0; i < (int)seq_numbers; i++)
+        if (seqs[i].cu >= cu_numbers || seqs[i].first < 0 ||
+            seqs[i].last > (int32_t)cus[seqs[i].cu].row_numbers ||
+            seqs[i].first > seqs[i].last)
+            return NULL;
+
+    dl = xmalloc(sizeof(struct dwarf_line));
+    dl->borrowed = 1;
+    dl->cu_numbers = cu_numbers;
+    dl->cus = xmalloc(sizeof(struct dwarf_line_cu) * (cu_numbers ?
+                                                      cu_numbers : 1));
+    for (i = 0; i < (int)cu_numbers; i++) {
+        struct dwarf_line_cu *cu = &dl->cus[i];
+
+        cu->offset = cus[i].offset;
+        cu->version = cus[i].version;
+        cu->rows = rows + cus[i].row_first;
+        cu->row_numbers = cus[i].row_numbers;
+        cu->file_numbers = cus[i].file_numbers;
+        cu->files = xmalloc(sizeof(struct dwarf_line_file) *
+                            (cu->file_numbers ? cu->file_numbers : 1));
+        for (j = 0; j < cu->file_numbers; j++) {
+            const struct metacache_line_file *f = &files[cus[i].file_first + j];
+
+            cu->files[j].name = metacache_load_str(ef, f->name);
+            cu->files[j].dir = metacache_load_str(ef, f->dir);
+        }
+    }
+
+    dl->seq_numbers = seq_numbers;
+    dl->seqs = xmalloc(sizeof(struct dwarf_line_seq) * (seq_numbers ?
+                                                        seq_numbers : 1));
+    for (i = 0; i < (int)seq_numbers; i++) {
+        dl->seqs[i].low = seqs[i].low;
+        dl->seqs[i].high = seqs[i].high;
+        dl->seqs[i].cu = &dl->cus[seqs[i].cu];
+        dl->seqs[i].first = seqs[i].first;
+        dl->seqs[i].last = seqs[i].last;
+    }
+    dwarf_line_index(dl);
+    return dl;
+}
@@ -0,0 +1,94 @@
+/*
+ * LSD radix sort
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <radix.h>
+
+#define RADIX_BITS     8
+#define RADIX_BUCKETS  (1 << RADIX_BITS)
+#define RADIX_PASSES   (64 / RADIX_BITS)
+
+/*
+ * LSD radix sort of 64-bit keys.
+ * @keys: keys, sorted ascending in place.
+ * @vals: payload, permuted along with keys.
+ * @n: number of elements.
+ *
+ * The sort is stable. Histograms of all digits are built in a
+ * single read pass, and a digit which is equal on every key (the
+ * upper half of 32-bit addresses, say) costs no scatter pass.
+ */
+void radix_sort_u64(uint64_t *keys, uint32_t *vals, size_t n)
+{
+    size_t (*count)[RADIX_BUCKETS];
+    uint64_t *kbuf, *ksrc = keys, *kdst;
+    uint32_t *vbuf, *vsrc = vals, *vdst;
+    size_t i;
+    int pass;
+
+    if (n < 2)
+        return;
+
+    count = xmalloc(sizeof(*count) * RADIX_PASSES);
+    memset(count, 0, sizeof(*count) * RADIX_PASSES);
+    for (i = 0; i < n; i++) {
+        uint64_t k = keys[i];
+
+        for (pass = 0; pass < RADIX_PASSES; pass++)
+            count[pass][(k >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+    }
+
+    kbuf = kdst = xmalloc(sizeof(uint64_t) * n);
+    vbuf = vdst = xmalloc(sizeof(uint32_t) * n);
+
+    for (pass = 0; pass < RADIX_PASSES; pass++) {
+        size_t *c = count[pass];
+        int shift = pass * RADIX_BITS;
+        size_t sum = 0, tmp;
+        int b;
+
+        /* every key has the same digit, nothing to do */
+        if (c[(ksrc[0] >> shift) & (RADIX_BUCKETS - 1)] == n)
+            continue;
+
+        for (b = 0; b < RADIX_BUCKETS; b++) {
+            tmp = c[b];
+            c[b] = sum;
+            sum += tmp;
+        }
+        for (i = 0; i < n; i++) {
+            size_t pos = c[(ksrc[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+
+            kdst[pos] = ksrc[i];
+            vdst[pos] = vsrc[i];
+        }
+        /* swap source and destination */
+        kdst = ksrc;
+        ksrc = kdst == keys ? kbuf : keys;
+        vdst = vsrc;
+        vsrc = vdst == vals ? vbuf : vals;
+    }
+
+    /* odd number of scatter passes leaves result on buffers */
+    if (ksrc != keys) {
+        memcpy(keys, ksrc, sizeof(uint64_t) * n);
+        memcpy(vals, vsrc, sizeof(uint32_t) * n);
+    }
+    xfree(kbuf);
+    xfree(vbuf);
+    xfree(count);
+}
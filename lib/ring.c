@@ -0,0 +1,262 @@
+/*
+ * per thread rings drained by one thread
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include <xmalloc.h>
+#include <ring.h>
+
+/* ---------------------------------------
+ *   every thread appends records to its own ring, one thread drains
+ *
+ *   thread 0  [len|record|len|record| ... ]  head ->  <- tail
+ *   thread 1  [len|record| ... ]                        \
+ *   ...                                                  drain -> fn()
+ *
+ * A ring has a single producer, the thread owning it, and a single
+ * consumer, the drain thread, so head and tail are plain atomic
+ * stores and appending never takes a lock. A full ring makes its
+ * owner yield until the drain thread has made room, records are
+ * never dropped. Rings of exited threads are handed to new threads,
+ * so short-lived workers don't pile up rings.
+ */
+
+/* length word ahead of every record, records are 8 byte aligned */
+#define RING_HEADER    8
+
+static size_t ring_record_size(size_t len)
+{
+    return RING_HEADER + ((len + 7) & ~(size_t)7);
+}
+
+static void ring_get(struct ring *r, uint64_t pos, void *data, size_t len)
+{
+    size_t off = pos & (r->set->size - 1);
+    size_t n = r->set->size - off;
+
+    if (n > len)
+        n = len;
+    memcpy(data, r->buf + off, n);
+    memcpy((char *)data + n, r->buf, len - n);
+}
+
+/* (OK)
+ * copy into record reserved by ring_reserve().
+ * @r: ring of calling thread.
+ * @pos: position in record, from ring_reserve() on.
+ * @data: bytes.
+ * @len: number of bytes.
+ */
+void ring_put(struct ring *r, uint64_t pos, const void *data, size_t len)
+{
+    size_t off = pos & (r->set->size - 1);
+    size_t n = r->set->size - off;
+
+    if (!len)
+        return;
+    if (n > len)
+        n = len;
+    memcpy(r->buf + off, data, n);
+    memcpy(r->buf, (const char *)data + n, len - n);
+}
+
+/* (OK)
+ * reserve record at head of ring. If the ring is full the calling
+ * thread yields until the drain thread has made room.
+ * @r: ring of calling thread.
+ * @len: bytes of record, at most RING_RECORD_MAX.
+ *
+ * @return: position of record for ring_put().
+ */
+uint64_t ring_reserve(struct ring *r, size_t len)
+{
+    uint32_t word = len;
+    uint64_t head = r->head;
+
+    r->pending = ring_record_size(len);
+    while (r->pending > r->set->size -
+                        (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))) {
+        r->waits++;
+        sched_yield();
+    }
+    ring_put(r, head, &word, sizeof(word));
+    return head + RING_HEADER;
+}
+
+/* (OK)
+ * hand record reserved last to the drain thread.
+ * @r: ring of calling thread.
+ */
+void ring_commit(struct ring *r)
+{
+    __atomic_store_n(&r->head, r->head + r->pending, __ATOMIC_RELEASE);
+}
+
+/* thread exited, its ring goes to the next new thread */
+static void ring_release(void *arg)
+{
+    struct ring *r = arg;
+
+    __atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+/* (OK)
+ * ring of calling thread, taken over from an exited thread or added
+ * to set. Callers keep it in a thread local, this is the slow path.
+ * @s: set of rings.
+ *
+ * @return: ring.
+ */
+struct ring *ring_attach(struct ring_set *s)
+{
+    struct ring *r;
+
+    for (r = __atomic_load_n(&s->rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        int unused = 0;
+
+        if (__atomic_compare_exchange_n(&r->used, &unused, 1, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if (!r) {
+        r = xmalloc(sizeof(*r));
+        memset(r, 0, sizeof(*r));
+        r->buf = xmalloc(s->size);
+        r->set = s;
+        r->used = 1;
+        r->main = pthread_equal(pthread_self(), s->owner);
+        r->id = __atomic_fetch_add(&s->ring_numbers, 1, __ATOMIC_RELAXED);
+        r->next = __atomic_load_n(&s->rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&s->rings, &r->next, r, 0,
+                                            __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED))
+            ;
+    }
+    pthread_setspecific(s->key, r);
+    return r;
+}
+
+/*
+ * hand records on every ring to fn().
+ * @return: number of records.
+ */
+static int ring_drain(struct ring_set *s)
+{
+    struct ring *r;
+    int n = 0;
+
+    for (r = __atomic_load_n(&s->rings, __ATOMIC_ACQUIRE); r; r = r->next) {
+        uint64_t tail = r->tail;
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            uint32_t len;
+
+            ring_get(r, tail, &len, sizeof(len));
+            ring_get(r, tail + RING_HEADER, s->record, len);
+            s->fn(r, s->record, len, s->data);
+            tail += ring_record_size(len);
+            /* room for a waiting owner as soon as possible */
+            __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+            n++;
+        }
+    }
+    return n;
+}
+
+static void *ring_drain_thread(void *arg)
+{
+    struct ring_set *s = arg;
+    struct timespec ts = { 0, RING_DRAIN_NS };
+
+    while (!__atomic_load_n(&s->stop, __ATOMIC_ACQUIRE)) {
+        if (ring_drain(s))
+            continue;
+        if (s->idle)
+            s->idle(s->data);
+        nanosleep(&ts, NULL);
+    }
+    /* records added before stop was seen */
+    ring_drain(s);
+    return NULL;
+}
+
+/* (OK)
+ * set of per thread rings and the thread draining them.
+ * @size: bytes per ring, power of two.
+ * @fn: called on drain thread with every record, in order per ring.
+ * @idle: called on drain thread when all rings are empty, may be NULL.
+ * @data: passed to @fn and @idle.
+ *
+ * @return: set, NULL with errno set if drain thread couldn't start.
+ */
+struct ring_set *ring_set_alloc(size_t size,
+      void (*fn)(struct ring *r, const void *record, size_t len, void *data),
+      void (*idle)(void *data), void *data)
+{
+    struct ring_set *s;
+    int err;
+
+    s = xmalloc(sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->size = size;
+    s->fn = fn;
+    s->idle = idle;
+    s->data = data;
+    s->owner = pthread_self();
+    s->record = xmalloc(RING_RECORD_MAX);
+    pthread_key_create(&s->key, ring_release);
+    err = pthread_create(&s->thread, NULL, ring_drain_thread, s);
+    if (err) {
+        pthread_key_delete(s->key);
+        xfree(s->record);
+        xfree(s);
+        errno = err;
+        return NULL;
+    }
+    return s;
+}
+
+/* (OK)
+ * hand remaining records to fn() and stop drain thread. Threads
+ * appending records must be done.
+ * @s: set of rings.
+ */
+void ring_set_stop(struct ring_set *s)
+{
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(s->thread, NULL);
+}
+
+/* (OK)
+ * free stopped set and its rings.
+ * @s: set of rings.
+ */
+void ring_set_free(struct ring_set *s)
+{
+    struct ring *r, *next;
+
+    for (r = s->rings; r; r = next) {
+        next = r->next;
+        xfree(r->buf);
+        xfree(r);
+    }
+    pthread_key_delete(s->key);
+    xfree(s->record);
+    xfree(s);
+}
@@ -0,0 +1,500 @@
+/*
+ * size profile: every byte of an ELF file attributed to a section,
+ * symbol or compile unit
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include <elf.h>
+#include <dwarf.h>
+#include <radix.h>
+#include <hash.h>
+#include <xmalloc.h>
+#include <size_profile.h>
+
+/* ---------------------------------------
+ *   symbols (or units) -> ranges -> radix sort -> one walk per section
+ *
+ *   .text  [ foo ][ bar ]   [ baz   ]       gaps -> "[section .text]"
+ *                    [alias]                overlaps go to first range
+ *
+ * The symbol table is read once, each symbol becomes a range in
+ * section-local offsets keyed by section index << 32 | start, so
+ * relocatable objects, whose sections all start at 0, need no
+ * special case. One radix sort orders ranges of every section and a
+ * single walk clips overlaps and aliases against a cursor, so each
+ * byte is counted once no matter how many symbols claim it.
+ */
+
+/* names made up here, not found in the file */
+#define SIZE_PROFILE_HEADERS     "[ELF headers]"
+#define SIZE_PROFILE_UNMAPPED    "[unmapped]"
+
+/*
+ * ranges of rows in section-local offsets
+ * @keys: section index << 32 | offset of start.
+ * @ends: offset just past range, same section.
+ * @rows: row of range.
+ */
+struct size_ranges {
+    uint64_t *keys;
+    uint32_t *ends;
+    uint32_t *rows;
+    int      numbers;
+    int      max;
+};
+
+static uint32_t size_profile_hash(const char *name)
+{
+    return hash_xxh3(name, strlen(name));
+}
+
+static void size_profile_grow(struct size_profile *p)
+{
+    int i;
+
+    xfree(p->table);
+    p->table_size = p->table_size ? p->table_size * 2 : 1024;
+    p->table = xmalloc(sizeof(int) * p->table_size);
+    memset(p->table, 0, sizeof(int) * p->table_size);
+    for (i = 0; i < p->row_numbers; i++) {
+        int h = p->rows[i].hash & (p->table_size - 1);
+
+        while (p->table[h])
+            h = (h + 1) & (p->table_size - 1);
+        p->table[h] = i + 1;
+    }
+}
+
+/* (OK)
+ * row of name.
+ * @p: profile.
+ * @name: row name.
+ *
+ * @return: index on rows, -1 if profile has no such row.
+ */
+int size_profile_find(struct size_profile *p, const char *name)
+{
+    uint32_t hash = size_profile_hash(name);
+    int h;
+
+    if (!p->table_size)
+        return -1;
+    for (h = hash & (p->table_size - 1); p->table[h];
+         h = (h + 1) & (p->table_size - 1)) {
+        struct size_profile_row *row = &p->rows[p->table[h] - 1];
+
+        if (row->hash == hash && !strcmp(row->name, name))
+            return p->table[h] - 1;
+    }
+    return -1;
+}
+
+/*
+ * row of name, added if missing. Symbols of one name, like local
+ * statics of many objects, share a row.
+ * @owned: name was allocated and goes with the profile, it is freed
+ *         here if the row exists.
+ */
+static int size_profile_row(struct size_profile *p, const char *name,
+                            int owned)
+{
+    struct size_profile_row *row;
+    int index = size_profile_find(p, name);
+    int h;
+
+    if (index >= 0) {
+        if (owned)
+            xfree((char *)name);
+        return index;
+    }
+    if (p->row_numbers == p->row_max) {
+        struct size_profile_row *tmp;
+
+        p->row_max = p->row_max ? p->row_max * 2 : 256;
+        tmp = xmalloc(sizeof(struct size_profile_row) * p->row_max);
+        if (p->rows) {
+            memcpy(tmp, p->rows,
+                   sizeof(struct size_profile_row) * p->row_numbers);
+            xfree(p->rows);
+        }
+        p->rows = tmp;
+    }
+    row = &p->rows[p->row_numbers++];
+    row->name = name;
+    row->file = 0;
+    row->vm = 0;
+    row->hash = size_profile_hash(name);
+    row->owned = owned;
+
+    /* table stays at most half full */
+    if (p->row_numbers * 2 > p->table_size) {
+        size_profile_grow(p);
+    } else {
+        h = row->hash & (p->table_size - 1);
+        while (p->table[h])
+            h = (h + 1) & (p->table_size - 1);
+        p->table[h] = p->row_numbers;
+    }
+    return p->row_numbers - 1;
+}
+
+/* "[section NAME]" row, bytes of section nothing else claimed */
+static int size_profile_section_row(struct size_profile *p,
+                                    const char *section)
+{
+    char *name = xmalloc(strlen(section) + sizeof("[section ]"));
+
+    sprintf(name, "[section %s]", section);
+    return size_profile_row(p, name, 1);
+}
+
+static void size_profile_add(struct size_profile *p, int index,
+                             uint64_t file, uint64_t vm)
+{
+    p->rows[index].file += file;
+    p->rows[index].vm += vm;
+    p->file += file;
+    p->vm += vm;
+}
+
+static void size_ranges_add(struct size_ranges *r, int section,
+                            uint32_t start, uint32_t end, int row)
+{
+    if (r->numbers == r->max) {
+        uint64_t *keys;
+        uint32_t *ends, *rows;
+
+        r->max = r->max ? r->max * 2 : 1024;
+        keys = xmalloc(sizeof(uint64_t) * r->max);
+        ends = xmalloc(sizeof(uint32_t) * r->max);
+        rows = xmalloc(sizeof(uint32_t) * r->max);
+        if (r->numbers) {
+            memcpy(keys, r->keys, sizeof(uint64_t) * r->numbers);
+            memcpy(ends, r->ends, sizeof(uint32_t) * r->numbers);
+            memcpy(rows, r->rows, sizeof(uint32_t) * r->numbers);
+        }
+        xfree(r->keys);
+        xfree(r->ends);
+        xfree(r->rows);
+        r->keys = keys;
+        r->ends = ends;
+        r->rows = rows;
+    }
+    r->keys[r->numbers] = ((uint64_t)section << 32) | start;
+    r->ends[r->numbers] = end;
+    r->rows[r->numbers] = row;
+    r->numbers++;
+}
+
+static void size_ranges_free(struct size_ranges *r)
+{
+    xfree(r->keys);
+    xfree(r->ends);
+    xfree(r->rows);
+}
+
+/*
+ * Sections are rows of their own, allocated ones count for the
+ * memory image, ones with contents for the file.
+ */
+static void size_profile_sections(struct size_profile *p)
+{
+    struct elf_file *ef = p->ef;
+    int i;
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        size_profile_add(p, size_profile_row(p,
+                         elf_file_section_name(ef, st), 0),
+                         st->sh_type == SHT_NOBITS ? 0 : st->sh_size,
+                         (st->sh_flags & SHF_ALLOC) ? st->sh_size : 0);
+    }
+}
+
+/*
+ * One pass over the symbol table, .dynsym if the file is stripped.
+ * Defined symbols with a size in allocated sections become ranges.
+ */
+static void size_profile_symbols(struct size_profile *p,
+                                 struct size_ranges *r)
+{
+    struct elf_file *ef = p->ef;
+    int reloc = ef->header->e_type == ET_REL;
+    uint64_t tls = 0;
+    Elf32_Shdr *symtab;
+    int i, n;
+
+    symtab = elf_file_section_by_type(ef, SHT_SYMTAB);
+    if (!symtab)
+        symtab = elf_file_section_by_type(ef, SHT_DYNSYM);
+    if (!symtab)
+        return;
+    /* TLS symbols are offsets on the TLS segment */
+    for (i = 0; i < ef->program_numbers; i++) {
+        Elf32_Phdr *ph = elf_file_program_header(ef, i);
+
+        if (ph && ph->p_type == PT_TLS)
+            tls = ph->p_vaddr;
+    }
+
+    n = elf_file_symbol_numbers(ef, symtab);
+    for (i = 1; i < n; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, symtab, i);
+        int type = ELF32_ST_TYPE(sym->st_info);
+        const char *name;
+        uint64_t start, end;
+        Elf32_Shdr *st;
+
+        if (!sym->st_size || sym->st_shndx == SHN_UNDEF ||
+            sym->st_shndx >= ef->section_numbers ||
+            type == STT_SECTION || type == STT_FILE)
+            continue;
+        st = elf_file_section(ef, sym->st_shndx);
+        if (!(st->sh_flags & SHF_ALLOC))
+            continue;
+        start = sym->st_value;
+        if (type == STT_TLS && !reloc)
+            start += tls;
+        if (!reloc) {
+            if (start < st->sh_addr)
+                continue;
+            start -= st->sh_addr;
+        }
+        if (start >= st->sh_size)
+            continue;
+        end = start + sym->st_size;
+        if (end > st->sh_size)
+            end = st->sh_size;
+        name = elf_file_symbol_name(ef, symtab, sym);
+        if (!name || !name[0])
+            continue;
+        size_ranges_add(r, sym->st_shndx, start, end,
+                        size_profile_row(p, name, 0));
+    }
+}
+
+/* name of unit DIE, "[unit OFFSET]" if it has none */
+static int size_profile_unit_row(struct size_profile *p,
+                                 struct dwarf_info *di, struct dwarf_cu *cu)
+{
+    struct dwarf_die root = { cu->die_offset, NULL, -1, 0 };
+    struct dwarf_attr attr;
+    char *name;
+
+    if (!dwarf_die_attr(di, cu, &root, DW_AT_name, &attr) && attr.str &&
+        attr.str[0])
+        return size_profile_row(p, attr.str, 0);
+    name = xmalloc(32);
+    snprintf(name, 32, "[unit 0x%llx]", (unsigned long long)cu->offset);
+    return size_profile_row(p, name, 1);
+}
+
+/*
+ * Address ranges of compile units become ranges of the allocated
+ * sections they fall in. Units of a relocatable object can't be told
+ * apart by address; with one unit it takes every allocated section.
+ */
+static void size_profile_units(struct size_profile *p,
+                               struct size_ranges *r)
+{
+    struct elf_file *ef = p->ef;
+    struct dwarf_info *di;
+    uint64_t *addrs;
+    uint32_t *sections;
+    int *rows;
+    int i, j, n = 0;
+
+    di = dwarf_info_alloc(ef);
+    if (!di)
+        return;
+    rows = xmalloc(sizeof(int) * (di->cu_numbers ? di->cu_numbers : 1));
+    for (i = 0; i < di->cu_numbers; i++)
+        rows[i] = -1;
+
+    if (ef->header->e_type == ET_REL) {
+        for (i = 1; di->cu_numbers == 1 && i < ef->section_numbers; i++) {
+            Elf32_Shdr *st = elf_file_section(ef, i);
+
+            if (!(st->sh_flags & SHF_ALLOC) || !st->sh_size)
+                continue;
+            if (rows[0] < 0)
+                rows[0] = size_profile_unit_row(p, di, &di->cus[0]);
+            size_ranges_add(r, i, 0, st->sh_size, rows[0]);
+        }
+        xfree(rows);
+        dwarf_info_free(di);
+        return;
+    }
+
+    /* allocated sections by address; .tbss overlaps what follows it */
+    addrs = xmalloc(sizeof(uint64_t) * ef->section_numbers);
+    sections = xmalloc(sizeof(uint32_t) * ef->section_numbers);
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+
+        if (!(st->sh_flags & SHF_ALLOC) || !st->sh_size ||
+            ((st->sh_flags & SHF_TLS) && st->sh_type == SHT_NOBITS))
+            continue;
+        addrs[n] = st->sh_addr;
+        sections[n++] = i;
+    }
+    radix_sort_u64(addrs, sections, n);
+
+    /* first lookup builds the sorted unit range table */
+    dwarf_info_cu_by_address(di, 0);
+    for (i = 0; i < di->arange_numbers; i++) {
+        struct dwarf_arange *a = &di->arange_table[i];
+        int lo = 0, hi = n;
+
+        /* last section starting at or below range */
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+
+            if (addrs[mid] <= a->low)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (j = lo ? lo - 1 : 0; j < n && addrs[j] < a->high; j++) {
+            Elf32_Shdr *st = elf_file_section(ef, sections[j]);
+            uint64_t start = a->low > st->sh_addr ? a->low : st->sh_addr;
+            uint64_t end = st->sh_addr + st->sh_size;
+
+            if (a->high < end)
+                end = a->high;
+            if (start >= end)
+                continue;
+            if (rows[a->cu] < 0)
+                rows[a->cu] = size_profile_unit_row(p, di, &di->cus[a->cu]);
+            size_ranges_add(r, sections[j], start - st->sh_addr,
+                            end - st->sh_addr, rows[a->cu]);
+        }
+    }
+    xfree(addrs);
+    xfree(sections);
+    xfree(rows);
+    dwarf_info_free(di);
+}
+
+/*
+ * Sort ranges and walk them section by section. A range only counts
+ * from where the ranges before it ended, what no range covers goes
+ * to the section's own row, and so do sections without ranges.
+ */
+static void size_profile_merge(struct size_profile *p, struct size_ranges *r)
+{
+    struct elf_file *ef = p->ef;
+    uint32_t *order;
+    int i, j = 0;
+
+    order = xmalloc(sizeof(uint32_t) * (r->numbers ? r->numbers : 1));
+    for (i = 0; i < r->numbers; i++)
+        order[i] = i;
+    /* stable, so the first of equal ranges in table order wins */
+    radix_sort_u64(r->keys, order, r->numbers);
+
+    for (i = 1; i < ef->section_numbers; i++) {
+        Elf32_Shdr *st = elf_file_section(ef, i);
+        int nobits = st->sh_type == SHT_NOBITS;
+        uint64_t cursor = 0, covered = 0;
+
+        for (; j < r->numbers && (r->keys[j] >> 32) == (uint64_t)i; j++) {
+            uint64_t start = r->keys[j] & 0xffffffff;
+            uint64_t end = r->ends[order[j]];
+
+            if (start < cursor)
+                start = cursor;
+            if (end <= start)
+                continue;
+            size_profile_add(p, r->rows[order[j]], nobits ? 0 : end - start,
+                             end - start);
+            covered += end - start;
+            cursor = end;
+        }
+        if (covered == st->sh_size ||
+            (nobits && !(st->sh_flags & SHF_ALLOC)))
+            continue;
+        size_profile_add(p, size_profile_section_row(p,
+                         elf_file_section_name(ef, st)),
+                         nobits ? 0 : st->sh_size - covered,
+                         (st->sh_flags & SHF_ALLOC) ?
+                         st->sh_size - covered : 0);
+    }
+    xfree(order);
+}
+
+/* (OK)
+ * attribute every byte of ELF file.
+ * @ef: elf file handle, names of rows point into its mapping.
+ * @source: SIZE_PROFILE_SECTIONS, SIZE_PROFILE_SYMBOLS or
+ *          SIZE_PROFILE_UNITS. Units fall back to sections' rows when
+ *          file has no DWARF.
+ *
+ * @return: profile, rows in no particular order.
+ */
+struct size_profile *size_profile_alloc(struct elf_file *ef, int source)
+{
+    Elf32_Ehdr *header = ef->header;
+    struct size_profile *p;
+    struct size_ranges r;
+    uint64_t headers;
+
+    p = xmalloc(sizeof(*p));
+    memset(p, 0, sizeof(*p));
+    p->ef = ef;
+    p->source = source;
+
+    if (source == SIZE_PROFILE_SECTIONS) {
+        size_profile_sections(p);
+    } else {
+        memset(&r, 0, sizeof(r));
+        if (source == SIZE_PROFILE_SYMBOLS)
+            size_profile_symbols(p, &r);
+        else
+            size_profile_units(p, &r);
+        size_profile_merge(p, &r);
+        size_ranges_free(&r);
+    }
+
+    headers = header->e_ehsize +
+              (uint64_t)header->e_phentsize * header->e_phnum +
+              (uint64_t)header->e_shentsize * header->e_shnum;
+    size_profile_add(p, size_profile_row(p, SIZE_PROFILE_HEADERS, 0),
+                     headers, 0);
+    /* alignment padding and anything else outside of sections */
+    if (ef->size > p->file)
+        size_profile_add(p, size_profile_row(p, SIZE_PROFILE_UNMAPPED, 0),
+                         ef->size - p->file, 0);
+    return p;
+}
+
+/* (OK)
+ * free profile, the ELF file stays.
+ * @p: profile.
+ */
+void size_profile_free(struct size_profile *p)
+{
+    int i;
+
+    if (!p)
+        return;
+    for (i = 0; i < p->row_numbers; i++)
+        if (p->rows[i].owned)
+            xfree((char *)p->rows[i].name);
+    xfree(p->rows);
+    xfree(p->table);
+    xfree(p);
+}
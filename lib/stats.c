@@ -0,0 +1,292 @@
+/*
+ * run time statistics
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <stats.h>
+#include <trace.h>
+
+#define STATS_STREAM_BUFFER    (64 * 1024)
+#define STATS_PAGEMAP_BATCH    512    /* pagemap entries per read */
+#define STATS_PAGE_PRESENT     (1ULL << 63)
+
+static const char *STATS_PHASE_NAMES[STATS_PHASES] = {
+    [STATS_OPEN]     = "open",
+    [STATS_HEADER]   = "header",
+    [STATS_SECTIONS] = "section table",
+    [STATS_STRINGS]  = "string tables",
+    [STATS_SYMBOLS]  = "symbols",
+    [STATS_DWARF]    = "dwarf",
+    [STATS_FORMAT]   = "formatting",
+    [STATS_HASH]     = "hashing",
+    [STATS_OUTPUT]   = "output",
+};
+
+int stats_enabled;
+
+static uint64_t stats_start;
+static struct rusage stats_start_usage;
+static uint64_t stats_wall[STATS_PHASES];
+static uint64_t stats_cpu[STATS_PHASES];
+static uint64_t stats_counters[STATS_COUNTERS];
+static int stats_pagemap = -1;
+
+/* time of phases ended on this thread, see struct stats_clock */
+static __thread uint64_t stats_nested_wall;
+static __thread uint64_t stats_nested_cpu;
+
+static uint64_t stats_clock_ns(clockid_t id)
+{
+    struct timespec ts;
+
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* (OK)
+ * start keeping statistics, phases and counters before this call
+ * aren't counted.
+ */
+void stats_enable(void)
+{
+    stats_start = stats_clock_ns(CLOCK_MONOTONIC);
+    getrusage(RUSAGE_SELF, &stats_start_usage);
+    stats_pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    stats_enabled = 1;
+}
+
+/* (OK)
+ * start phase, use stats_begin().
+ * @c: clock of phase.
+ */
+void __stats_begin(struct stats_clock *c)
+{
+    c->wall = stats_clock_ns(CLOCK_MONOTONIC);
+    c->cpu = stats_clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    c->nested_wall = stats_nested_wall;
+    c->nested_cpu = stats_nested_cpu;
+}
+
+/* (OK)
+ * end phase, use stats_end(). Time of phases which began and ended
+ * inside it is left to them, so phases never count twice.
+ * @c: clock of phase from stats_begin().
+ * @phase: STATS_* phase.
+ */
+void __stats_end(struct stats_clock *c, int phase)
+{
+    uint64_t now = stats_clock_ns(CLOCK_MONOTONIC);
+    uint64_t wall = now - c->wall;
+    uint64_t cpu = stats_clock_ns(CLOCK_THREAD_CPUTIME_ID) - c->cpu;
+
+    __atomic_fetch_add(&stats_wall[phase],
+                       wall - (stats_nested_wall - c->nested_wall),
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats_cpu[phase],
+                       cpu - (stats_nested_cpu - c->nested_cpu),
+                       __ATOMIC_RELAXED);
+    stats_nested_wall = c->nested_wall + wall;
+    stats_nested_cpu = c->nested_cpu + cpu;
+#ifdef CONFIG_TRACE
+    /* spans of the trace keep nested phases inside, as they ran */
+    if (trace_enabled)
+        __trace_span(TRACE_PHASE, STATS_PHASE_NAMES[phase], NULL,
+                     c->wall, now);
+#endif
+}
+
+/* (OK)
+ * add to counter, use stats_add().
+ * @counter: STATS_* counter.
+ * @n: amount.
+ */
+void __stats_add(int counter, uint64_t n)
+{
+    __atomic_fetch_add(&stats_counters[counter], n, __ATOMIC_RELAXED);
+}
+
+/* (OK)
+ * count pages of mapping present in page table, use stats_unmap().
+ * Fault-around maps cached neighbours of a faulting page too, so it
+ * is an upper bound of what was read.
+ * @map: page aligned mapping about to be unmapped.
+ * @size: bytes of mapping.
+ */
+void __stats_unmap(const void *map, size_t size)
+{
+    uint64_t entries[STATS_PAGEMAP_BATCH], touched = 0;
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t first = (uintptr_t)map / page;
+    uint64_t pages = (size + page - 1) / page, i = 0;
+
+    if (stats_pagemap < 0)
+        return;
+    while (i < pages) {
+        size_t n = pages - i < STATS_PAGEMAP_BATCH ? pages - i :
+                   STATS_PAGEMAP_BATCH;
+        ssize_t got = pread(stats_pagemap, entries, n * sizeof(uint64_t),
+                            (first + i) * sizeof(uint64_t));
+        size_t j;
+
+        if (got <= 0)
+            break;
+        n = got / sizeof(uint64_t);
+        for (j = 0; j < n; j++)
+            if (entries[j] & STATS_PAGE_PRESENT)
+                touched++;
+        i += n;
+    }
+    __stats_add(STATS_TOUCHED, touched * page);
+}
+
+static ssize_t stats_stream_write(void *cookie, const char *buf, size_t size)
+{
+    struct stats_clock c;
+    size_t done = 0;
+
+    stats_begin(&c);
+    while (done < size) {
+        ssize_t n = write((int)(long)cookie, buf + done, size - done);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        done += n;
+    }
+    stats_end(&c, STATS_OUTPUT);
+    return done ? (ssize_t)done : -1;
+}
+
+/* (OK)
+ * stream on descriptor whose writes are timed as STATS_OUTPUT, e.g.
+ * to take over stdout. Buffered as stdio would buffer the descriptor.
+ * @fd: descriptor, left open when stream is closed.
+ *
+ * @return: stream, NULL on failure.
+ */
+FILE *stats_stream(int fd)
+{
+    cookie_io_functions_t io = { .write = stats_stream_write };
+    FILE *fp;
+    char *buf;
+
+    fp = fopencookie((void *)(long)fd, "w", io);
+    if (!fp)
+        return NULL;
+    /* glibc ignores the size unless given the buffer, kept till exit */
+    buf = malloc(STATS_STREAM_BUFFER);
+    if (buf)
+        setvbuf(fp, buf, isatty(fd) ? _IOLBF : _IOFBF, STATS_STREAM_BUFFER);
+    return fp;
+}
+
+/*
+ * read and write syscalls of process so far from /proc/self/io.
+ * @return: 0 on success.
+ */
+static int stats_syscalls(uint64_t *reads, uint64_t *writes)
+{
+    char key[32];
+    unsigned long long value;
+    FILE *fp;
+    int found = 0;
+
+    fp = fopen("/proc/self/io", "r");
+    if (!fp)
+        return -1;
+    while (fscanf(fp, "%31s %llu", key, &value) == 2) {
+        if (!strcmp(key, "syscr:")) {
+            *reads = value;
+            found++;
+        } else if (!strcmp(key, "syscw:")) {
+            *writes = value;
+            found++;
+        }
+    }
+    fclose(fp);
+    return found == 2 ? 0 : -1;
+}
+
+static uint64_t stats_timeval_ns(struct timeval *tv)
+{
+    return (uint64_t)tv->tv_sec * 1000000000ULL + tv->tv_usec * 1000ULL;
+}
+
+/* (OK)
+ * print time per phase and counters. Phase times are summed over
+ * threads, so with parallel loading they may add up to more than
+ * the wall time of the run.
+ * @fp: stream to print on.
+ * @tool: tool name for heading.
+ */
+void stats_report(FILE *fp, const char *tool)
+{
+    uint64_t wall, cpu, reads, writes;
+    struct rusage usage;
+    int i;
+
+    if (!stats_enabled)
+        return;
+    wall = stats_clock_ns(CLOCK_MONOTONIC) - stats_start;
+    getrusage(RUSAGE_SELF, &usage);
+    cpu = stats_timeval_ns(&usage.ru_utime) +
+          stats_timeval_ns(&usage.ru_stime) -
+          stats_timeval_ns(&stats_start_usage.ru_utime) -
+          stats_timeval_ns(&stats_start_usage.ru_stime);
+
+    fprintf(fp, "%s: statistics\n", tool);
+    fprintf(fp, "  %-16s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (i = 0; i < STATS_PHASES; i++)
+        fprintf(fp, "  %-16s %12.3f %12.3f\n", STATS_PHASE_NAMES[i],
+                stats_wall[i] / 1e6, stats_cpu[i] / 1e6);
+    fprintf(fp, "  %-16s %12.3f %12.3f\n", "total", wall / 1e6, cpu / 1e6);
+
+    fprintf(fp, "  %-16s %12llu\n", "files",
+            (unsigned long long)stats_counters[STATS_FILES]);
+    fprintf(fp, "  %-16s %12llu\n", "opens",
+            (unsigned long long)stats_counters[STATS_OPENS]);
+    fprintf(fp, "  %-16s %12llu\n", "mmaps",
+            (unsigned long long)stats_counters[STATS_MMAPS]);
+    fprintf(fp, "  %-16s %12llu\n", "bytes mapped",
+            (unsigned long long)stats_counters[STATS_MAPPED]);
+    if (stats_pagemap >= 0)
+        fprintf(fp, "  %-16s %12llu\n", "bytes touched",
+                (unsigned long long)stats_counters[STATS_TOUCHED]);
+    fprintf(fp, "  %-16s %12ld\n", "page faults",
+            usage.ru_minflt + usage.ru_majflt -
+            stats_start_usage.ru_minflt - stats_start_usage.ru_majflt);
+    fprintf(fp, "  %-16s %12ld\n", "major faults",
+            usage.ru_majflt - stats_start_usage.ru_majflt);
+    if (!stats_syscalls(&reads, &writes)) {
+        fprintf(fp, "  %-16s %12llu\n", "read syscalls",
+                (unsigned long long)reads);
+        fprintf(fp, "  %-16s %12llu\n", "write syscalls",
+                (unsigned long long)writes);
+    }
+    fprintf(fp, "  %-16s %12llu\n", "allocations",
+            (unsigned long long)stats_counters[STATS_ALLOCS]);
+    fprintf(fp, "  %-16s %12llu\n", "bytes allocated",
+            (unsigned long long)stats_counters[STATS_ALLOCATED]);
+}
@@ -0,0 +1,366 @@
+/*
+ * address to symbol and source line
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmalloc.h>
+#include <radix.h>
+#include <symbolize.h>
+
+/*
+ * Index defined function symbols by address, the fallback name of
+ * addresses without DWARF.
+ */
+static void symbolizer_index_funcs(struct symbolizer *s)
+{
+    struct elf_file *ef = s->ef;
+    int i, n = 0, numbers;
+
+    if (!s->symtab)
+        return;
+
+    numbers = elf_file_symbol_numbers(ef, s->symtab);
+    s->funcs = xmalloc(sizeof(uint32_t) * (numbers ? numbers : 1));
+    s->func_low = xmalloc(sizeof(uint64_t) * (numbers ? numbers : 1));
+    for (i = 1; i < numbers; i++) {
+        Elf32_Sym *sym = elf_file_symbol(ef, s->symtab, i);
+
+        if (ELF32_ST_TYPE(sym->st_info) != STT_FUNC &&
+            ELF32_ST_TYPE(sym->st_info) != STT_GNU_IFUNC)
+            continue;
+        if (sym->st_shndx == SHN_UNDEF)
+            continue;
+        s->func_low[n] = sym->st_value;
+        s->funcs[n++] = i;
+    }
+    radix_sort_u64(s->func_low, s->funcs, n);
+    s->func_numbers = n;
+}
+
+/*
+ * Take function index and line rows from cache entry.
+ * @return: 0 if entry has all of them.
+ */
+static int symbolizer_load(struct symbolizer *s, struct metacache *mc)
+{
+    uint64_t low_size, index_size;
+    int i, numbers;
+
+    s->func_low = (uint64_t *)metacache_blob(mc, METACACHE_FUNC_LOW,
+                                             &low_size);
+    s->funcs = (uint32_t *)metacache_blob(mc, METACACHE_FUNC_INDEX,
+                                          &index_size);
+    if (!s->func_low || !s->funcs ||
+        low_size / sizeof(uint64_t) != index_size / sizeof(uint32_t))
+        return -1;
+    s->func_numbers = index_size / sizeof(uint32_t);
+    numbers = s->symtab ? elf_file_symbol_numbers(s->ef, s->symtab) : 0;
+    for (i = 0; i < s->func_numbers; i++)
+        if (s->funcs[i] >= (uint32_t)numbers)
+            return -1;
+
+    /* a binary without .debug_line is cached without line blobs */
+    if (elf_file_section_by_name(s->ef, ".debug_line")) {
+        s->line = metacache_load_lines(mc, s->ef);
+        if (!s->line)
+            return -1;
+    }
+    s->cache = mc;
+    return 0;
+}
+
+/*
+ * Build indexes, loading them from cache directory when an entry of
+ * binary is there and storing them when it isn't.
+ */
+static void symbolizer_index(struct symbolizer *s, const char *cache_dir)
+{
+    struct metacache_writer *w;
+    struct metacache *mc = NULL;
+
+    if (cache_dir && (mc = metacache_alloc(cache_dir, s->ef))) {
+        if (!symbolizer_load(s, mc))
+            return;
+        s->func_low = NULL;
+        s->funcs = NULL;
+        s->func_numbers = 0;
+    }
+
+    s->line = dwarf_line_alloc(s->ef);
+    symbolizer_index_funcs(s);
+    if (cache_dir && (w = metacache_writer_alloc(cache_dir, s->ef))) {
+        metacache_begin(w, METACACHE_FUNC_LOW);
+        metacache_append(w, s->func_low, sizeof(uint64_t) * s->func_numbers);
+        metacache_begin(w, METACACHE_FUNC_INDEX);
+        metacache_append(w, s->funcs, sizeof(uint32_t) * s->func_numbers);
+        if (s->line)
+            metacache_save_lines(w, s->ef, s->line);
+        if (mc)
+            metacache_copy(w, mc);
+        metacache_commit(w);
+    }
+    metacache_free(mc);
+}
+
+/* (OK)
+ * map binary and build its indexes.
+ * @filename: ELF file.
+ * @cache_dir: metadata cache directory, NULL to always build.
+ *
+ * @return: symbolizer, NULL if file isn't an ELF file.
+ */
+struct symbolizer *symbolizer_alloc(const char *filename,
+                                    const char *cache_dir)
+{
+    struct symbolizer *s;
+    const unsigned char *id;
+    int i, len;
+
+    s = xmalloc(sizeof(struct symbolizer));
+    memset(s, 0, sizeof(*s));
+    s->ef = elf_file_alloc(filename);
+    if (!s->ef) {
+        xfree(s);
+        return NULL;
+    }
+    s->symtab = elf_file_section_by_type(s->ef, SHT_SYMTAB);
+    if (!s->symtab)
+        s->symtab = elf_file_section_by_type(s->ef, SHT_DYNSYM);
+    s->info = dwarf_info_alloc(s->ef);
+    symbolizer_index(s, cache_dir);
+
+    len = elf_file_build_id(s->ef, &id);
+    s->build_id = xmalloc(len * 2 + 1);
+    for (i = 0; i < len; i++)
+        sprintf(s->build_id + i * 2, "%02x", id[i]);
+    s->build_id[len * 2] = 0;
+    return s;
+}
+
+/* (OK)
+ * unmap binary and free its indexes.
+ */
+void symbolizer_free(struct symbolizer *s)
+{
+    if (!s)
+        return;
+    dwarf_line_free(s->line);
+    dwarf_info_free(s->info);
+    if (!s->cache) {
+        xfree(s->funcs);
+        xfree(s->func_low);
+    }
+    metacache_free(s->cache);
+    xfree(s->build_id);
+    elf_file_free(s->ef);
+    xfree(s);
+}
+
+/*
+ * Function symbol covering address. Like GNU addr2line a symbol
+ * covers up to the next one, alignment padding after a function
+ * is reported as part of it, but never past its section.
+ */
+static const char *symbolizer_function(struct symbolizer *s,
+                                       uint64_t address)
+{
+    int lo = 0, hi = s->func_numbers;
+    Elf32_Shdr *st;
+    Elf32_Sym *sym;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (s->func_low[mid] <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!lo)
+        return NULL;
+    sym = elf_file_symbol(s->ef, s->symtab, s->funcs[lo - 1]);
+    st = elf_file_section(s->ef, sym->st_shndx);
+    if (!st || address >= (uint64_t)st->sh_addr + st->sh_size)
+        return NULL;
+    return elf_file_symbol_name(s->ef, s->symtab, sym);
+}
+
+/*
+ * line table of unit, matched through DW_AT_stmt_list
+ */
+static struct dwarf_line_cu *symbolizer_line_cu(struct symbolizer *s,
+                                                struct dwarf_cu *cu)
+{
+    struct dwarf_attr attr;
+    int lo = 0, hi;
+
+    if (!s->line || dwarf_die_attr(s->info, cu, &cu->dies[0],
+                                   DW_AT_stmt_list, &attr))
+        return NULL;
+    hi = s->line->cu_numbers;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (s->line->cus[mid].offset < attr.value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == s->line->cu_numbers || s->line->cus[lo].offset != attr.value)
+        return NULL;
+    return &s->line->cus[lo];
+}
+
+#define SYMBOLIZE_MAX_INLINES    64
+
+/*
+ * Expand inlined frames from DWARF. Frame 0 keeps its line table
+ * location, each outer frame takes the call site of the frame it
+ * inlined.
+ * @return: number of frames.
+ */
+static int symbolizer_inlines(struct symbolizer *s, uint64_t address,
+                              struct symbolize_frame *frames, int max)
+{
+    struct dwarf_info *di = s->info;
+    struct dwarf_line_cu *lcu;
+    struct dwarf_func *func;
+    struct dwarf_cu *cu;
+    struct dwarf_attr attr;
+    int chain[SYMBOLIZE_MAX_INLINES];
+    const char *name, *comp_dir = NULL;
+    int i, n;
+
+    cu = dwarf_info_cu_by_address(di, address);
+    if (!cu || dwarf_cu_parse(di, cu) < 0)
+        return 1;
+    if (!dwarf_die_attr(di, cu, &cu->dies[0], DW_AT_comp_dir, &attr))
+        comp_dir = attr.str;
+    if (frames[0].file)
+        frames[0].comp_dir = comp_dir;
+
+    func = dwarf_cu_function(di, cu, address);
+    if (!func)
+        return 1;
+    /* the innermost name is wanted even when frames aren't */
+    n = dwarf_func_inlines(di, cu, func, address, chain,
+                           max > 1 ? (max - 1 < SYMBOLIZE_MAX_INLINES ?
+                           max - 1 : SYMBOLIZE_MAX_INLINES) : 1);
+    if (max < 2) {
+        name = dwarf_die_name(di, cu, &cu->dies[n ? chain[0] : func->die]);
+        if (name)
+            frames[0].function = name;
+        return 1;
+    }
+    chain[n++] = func->die;
+
+    lcu = symbolizer_line_cu(s, cu);
+    for (i = 0; i < n; i++) {
+        struct symbolize_frame *frame = &frames[i];
+
+        if (i) {
+            struct dwarf_die *call = &cu->dies[chain[i - 1]];
+            struct dwarf_line_file *file = NULL;
+
+            memset(frame, 0, sizeof(*frame));
+            if (lcu && !dwarf_die_attr(di, cu, call, DW_AT_call_file, &attr))
+                file = dwarf_line_file(lcu, attr.value);
+            if (file) {
+                frame->file = file->name;
+                frame->dir = file->dir;
+                frame->comp_dir = comp_dir;
+            }
+            if (!dwarf_die_attr(di, cu, call, DW_AT_call_line, &attr))
+                frame->line = attr.value;
+            if (!dwarf_die_attr(di, cu, call, DW_AT_GNU_discriminator,
+                                &attr))
+                frame->discriminator = attr.value;
+        }
+        name = dwarf_die_name(di, cu, &cu->dies[chain[i]]);
+        if (name || i)
+            frame->function = name;
+    }
+    return n;
+}
+
+/* (OK)
+ * frames of address.
+ * @s: symbolizer.
+ * @address: code address.
+ * @frames: frames to fill, innermost first. With room for more than
+ *          one frame, inlined calls get a frame each.
+ * @max: room on @frames.
+ *
+ * @return: number of frames filled, 0 if nothing is known of
+ *          @address.
+ */
+int symbolizer_lookup(struct symbolizer *s, uint64_t address,
+                      struct symbolize_frame *frames, int max)
+{
+    struct symbolize_frame *frame = frames;
+    struct dwarf_line_row *row;
+    struct dwarf_line_cu *lcu;
+    int n = 1;
+
+    if (max < 1)
+        return 0;
+    memset(frame, 0, sizeof(*frame));
+    frame->function = symbolizer_function(s, address);
+
+    if (s->line && (row = dwarf_line_lookup(s->line, address, &lcu))) {
+        struct dwarf_line_file *file = dwarf_line_file(lcu, row->file);
+
+        if (file) {
+            frame->file = file->name;
+            frame->dir = file->dir;
+            frame->line = row->line;
+            frame->discriminator = row->discriminator;
+        }
+    }
+
+    if (s->info)
+        n = symbolizer_inlines(s, address, frames, max);
+    return frame->function || frame->file ? n : 0;
+}
+
+/* (OK)
+ * full path of frame's file.
+ * @frame: frame from symbolizer_lookup().
+ * @buf: buffer for joined path.
+ * @size: size of @buf.
+ *
+ * @return: path, "??" if frame has no file.
+ */
+const char *symbolize_path(struct symbolize_frame *frame, char *buf,
+                           size_t size)
+{
+    const char *dir = frame->dir;
+
+    if (!frame->file)
+        return "??";
+    if (frame->file[0] == '/')
+        return frame->file;
+    if (dir && dir[0] == '/')
+        snprintf(buf, size, "%s/%s", dir, frame->file);
+    else if (dir && frame->comp_dir)
+        snprintf(buf, size, "%s/%s/%s", frame->comp_dir, dir, frame->file);
+    else if (dir || frame->comp_dir)
+        snprintf(buf, size, "%s/%s", dir ? dir : frame->comp_dir,
+                 frame->file);
+    else
+        return frame->file;
+    return buf;
+}
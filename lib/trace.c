@@ -0,0 +1,302 @@
+/*
+ * trace events of batch runs
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xmalloc.h>
+#include <ring.h>
+#include <stats.h>
+#include <trace.h>
+
+/*
+ * Every thread appends spans to its own ring of ring.h, binary, and
+ * the drain thread formats them into the file. The file is in the
+ * Chrome trace event format, which chrome://tracing and Perfetto
+ * open as one track per thread.
+ */
+
+#define TRACE_NAME_MAX     4095
+#define TRACE_BUFFER_SIZE  (1024 * 1024)   /* stdio buffer of file */
+
+static const char *TRACE_CATEGORY_NAMES[TRACE_CATEGORIES] = {
+    [TRACE_FILE]  = "file",
+    [TRACE_PHASE] = "phase",
+    [TRACE_IO]    = "io",
+};
+
+/*
+ * span on ring, followed by name and archive name
+ */
+struct trace_event {
+    uint64_t begin;
+    uint64_t end;
+    uint16_t name_len;
+    uint16_t archive_len;
+    uint8_t  cat;
+    uint8_t  archive;
+};
+
+int trace_enabled;
+
+static FILE *trace_fp;
+static char *trace_buffer;
+static uint64_t trace_start;
+static uint64_t trace_events;
+static int trace_pid;
+static struct ring_set *trace_rings;
+static __thread struct ring *trace_ring;
+
+static uint64_t trace_clock_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* (OK)
+ * add span to trace, use trace_end() or phase hooks of stats.h.
+ * @cat: TRACE_* category.
+ * @name: span name, file name for TRACE_FILE.
+ * @archive: archive holding file, NULL if none.
+ * @begin: start in CLOCK_MONOTONIC ns.
+ * @end: end in CLOCK_MONOTONIC ns.
+ */
+void __trace_span(int cat, const char *name, const char *archive,
+                  uint64_t begin, uint64_t end)
+{
+    struct ring *r = trace_ring;
+    struct trace_event ev;
+    uint64_t pos;
+
+    if (!r)
+        r = trace_ring = ring_attach(trace_rings);
+    ev.begin = begin;
+    ev.end = end;
+    ev.name_len = strnlen(name, TRACE_NAME_MAX);
+    ev.archive_len = archive ? strnlen(archive, TRACE_NAME_MAX) : 0;
+    ev.cat = cat;
+    ev.archive = archive != NULL;
+    pos = ring_reserve(r, sizeof(ev) + ev.name_len + ev.archive_len);
+    ring_put(r, pos, &ev, sizeof(ev));
+    ring_put(r, pos + sizeof(ev), name, ev.name_len);
+    ring_put(r, pos + sizeof(ev) + ev.name_len, archive, ev.archive_len);
+    ring_commit(r);
+}
+
+/* (OK)
+ * start span, use trace_begin().
+ * @t: clock of span.
+ */
+void __trace_begin(struct trace_clock *t)
+{
+    t->begin = trace_clock_ns();
+}
+
+/* (OK)
+ * end span, use trace_end().
+ * @t: clock of span from trace_begin().
+ * @cat: TRACE_* category.
+ * @name: span name.
+ * @archive: archive holding file, NULL if none.
+ */
+void __trace_end(struct trace_clock *t, int cat, const char *name,
+                 const char *archive)
+{
+    __trace_span(cat, name, archive, t->begin, trace_clock_ns());
+}
+
+/* JSON string, escaped, of @len bytes at @s */
+static char *trace_put_string(char *p, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t i;
+
+    *p++ = '"';
+    for (i = 0; i < len; i++) {
+        unsigned char c = s[i];
+
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 15];
+            p += 6;
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    return p;
+}
+
+static char *trace_put_u64(char *p, uint64_t value)
+{
+    char digits[20];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+/* microseconds, as trace format wants, with ns as fraction */
+static char *trace_put_us(char *p, const char *key, uint64_t ns)
+{
+    size_t len = strlen(key);
+
+    memcpy(p, key, len);
+    p = trace_put_u64(p + len, ns / 1000);
+    *p++ = '.';
+    *p++ = '0' + ns / 100 % 10;
+    *p++ = '0' + ns / 10 % 10;
+    *p++ = '0' + ns % 10;
+    return p;
+}
+
+static char *trace_put(char *p, const char *s)
+{
+    size_t len = strlen(s);
+
+    memcpy(p, s, len);
+    return p + len;
+}
+
+/*
+ * write one span, on drain thread. Formatted by hand, it has to keep
+ * up with every thread of the run.
+ */
+static void trace_write_event(struct ring *r, const void *record, size_t len,
+                              void *data)
+{
+    /* escaping takes at most 6 bytes per byte of names */
+    static char line[12 * TRACE_NAME_MAX + 256];
+    const struct trace_event *ev = record;
+    const char *name = (const char *)(ev + 1);
+    uint64_t begin = ev->begin > trace_start ? ev->begin - trace_start : 0;
+    char *p = line;
+
+    p = trace_put(p, trace_events++ ? ",\n{\"name\":" : "\n{\"name\":");
+    p = trace_put_string(p, name, ev->name_len);
+    p = trace_put(p, ",\"cat\":\"");
+    p = trace_put(p, TRACE_CATEGORY_NAMES[ev->cat]);
+    p = trace_put(p, "\",\"ph\":\"X\"");
+    p = trace_put_us(p, ",\"ts\":", begin);
+    p = trace_put_us(p, ",\"dur\":",
+                     ev->end > ev->begin ? ev->end - ev->begin : 0);
+    p = trace_put(p, ",\"pid\":");
+    p = trace_put_u64(p, trace_pid);
+    p = trace_put(p, ",\"tid\":");
+    p = trace_put_u64(p, r->id);
+    if (ev->archive) {
+        p = trace_put(p, ",\"args\":{\"archive\":");
+        p = trace_put_string(p, name + ev->name_len, ev->archive_len);
+        *p++ = '}';
+    }
+    *p++ = '}';
+    fwrite_unlocked(line, 1, p - line, trace_fp);
+}
+
+/* (OK)
+ * start tracing. Spans of every thread, and phases of stats.h, are
+ * written to @filename until trace_close(). Only one trace per run.
+ * @filename: trace file, in Chrome trace event format.
+ *
+ * @return: 0 on success, -1 with errno set.
+ */
+int trace_open(const char *filename)
+{
+    trace_fp = fopen(filename, "w");
+    if (!trace_fp)
+        return -1;
+    /* glibc ignores the size unless given the buffer */
+    trace_buffer = xmalloc(TRACE_BUFFER_SIZE);
+    setvbuf(trace_fp, trace_buffer, _IOFBF, TRACE_BUFFER_SIZE);
+    fputs("{\"traceEvents\":[", trace_fp);
+
+    trace_pid = getpid();
+    trace_start = trace_clock_ns();
+    trace_rings = ring_set_alloc(TRACE_RING_SIZE, trace_write_event, NULL,
+                                 NULL);
+    if (!trace_rings) {
+        int err = errno;
+
+        fclose(trace_fp);
+        xfree(trace_buffer);
+        errno = err;
+        return -1;
+    }
+    /* phases are timed by the stats hooks */
+    stats_enable();
+    trace_enabled = 1;
+    return 0;
+}
+
+/* (OK)
+ * stop tracing, write out remaining spans and close trace file.
+ * Every thread which added spans must be done.
+ *
+ * @return: 0 on success, -1 with errno set if trace file couldn't
+ *          be written.
+ */
+int trace_close(void)
+{
+    uint64_t waits = 0;
+    struct ring *r;
+    int err;
+
+    if (!trace_enabled)
+        return 0;
+    trace_enabled = 0;
+    ring_set_stop(trace_rings);
+
+    for (r = trace_rings->rings; r; r = r->next) {
+        fputs(trace_events++ ? ",\n" : "\n", trace_fp);
+        fprintf(trace_fp, "{\"name\":\"thread_name\",\"ph\":\"M\","
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                trace_pid, r->id);
+        if (r->main)
+            fputs("\"main\"}}", trace_fp);
+        else
+            fprintf(trace_fp, "\"worker %d\"}}", r->id);
+        waits += r->waits;
+    }
+    ring_set_free(trace_rings);
+    trace_rings = NULL;
+    /* times threads waited on a full ring, their spans run long */
+    fprintf(trace_fp, "\n],\"otherData\":{\"ring_waits\":%llu}}\n",
+            (unsigned long long)waits);
+
+    err = ferror(trace_fp) ? EIO : 0;
+    if (fclose(trace_fp) && !err)
+        err = errno;
+    xfree(trace_buffer);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
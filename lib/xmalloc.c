@@ -16,11 +16,14 @@
 #include <stdlib.h>
 
 #include <xmalloc.h>
+#include <stats.h>
 
 void *xmalloc(size_t size)
 {
     void *alloc = malloc(size);
 
+    stats_add(STATS_ALLOCS, 1);
+    stats_add(STATS_ALLOCATED, size);
     if (!alloc) {
         printf("out of memory(malloc)\n");
         exit(EXIT_FAILURE);
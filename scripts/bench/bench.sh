@@ -0,0 +1,72 @@
+#!/bin/sh
+# Time objdump over synthetic inputs written by elfgen.
+#
+# Usage: bench.sh <elfgen> <objdump> <work directory> [microbench]
+#
+# Each input stresses one table and is dumped with the option which
+# walks it, best of BENCH_REPEAT runs (default 5) is reported so page
+# cache and scheduler noise stay out of the numbers. Inputs are kept
+# in the work directory and only rewritten when elfgen changes.
+#
+# Only ELF32 inputs are timed, lib/elf.c rejects ELFCLASS64. Pass
+# --class=64 to elfgen by hand for other tools.
+#
+# With microbench given, library primitives are timed afterwards on
+# an executable input, where addresses resolve to symbols and lines.
+
+elfgen=$1
+objdump=$2
+dir=$3
+microbench=$4
+repeat=${BENCH_REPEAT:-5}
+
+if [ $# -lt 3 ] || [ ! -x "$elfgen" ] || [ ! -x "$objdump" ]; then
+	echo "Usage: $0 <elfgen> <objdump> <work directory> [microbench]" >&2
+	exit 1
+fi
+mkdir -p "$dir" || exit 1
+
+# name, elfgen options, objdump options, elements
+set -- \
+	sections "--sections=30000"			"-h"	30000 \
+	symbols  "--sections=64 --symbols=500000"	"-t"	500000 \
+	relocs   "--symbols=1000 --relocs=500000"	"-r"	500000 \
+	dwarf    "--units=20000"			"-WL"	640000
+
+printf "%-10s %-6s %10s %10s %10s %12s\n" \
+	input option size ms MB/s elements/s
+while [ $# -ge 4 ]; do
+	file=$dir/$1.o
+	if [ ! -f "$file" ] || [ "$elfgen" -nt "$file" ]; then
+		"$elfgen" $2 "$file" || exit 1
+	fi
+	size=$(wc -c < "$file")
+
+	best=
+	i=0
+	while [ $i -lt $repeat ]; do
+		start=$(date +%s%N)
+		"$objdump" $3 "$file" > /dev/null || exit 1
+		end=$(date +%s%N)
+		ns=$((end - start))
+		if [ -z "$best" ] || [ $ns -lt $best ]; then
+			best=$ns
+		fi
+		i=$((i + 1))
+	done
+	[ $best -gt 0 ] || best=1
+
+	printf "%-10s %-6s %10d %6d.%03d %10d %12d\n" $1 $3 $size \
+		$((best / 1000000)) $((best / 1000 % 1000)) \
+		$((size * 1000 / best)) $(($4 * 1000000 / (best / 1000 + 1)))
+	shift 4
+done
+
+[ -n "$microbench" ] || exit 0
+file=$dir/exec.o
+if [ ! -f "$file" ] || [ "$elfgen" -nt "$file" ]; then
+	"$elfgen" --exec --sections=256 --symbols=100000 --units=4000 \
+		"$file" || exit 1
+fi
+echo
+"$microbench" "$file"
@@ -0,0 +1,541 @@
+/*
+ * elfgen: write synthetic ELF objects for benchmarks
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ *
+ * The object is relocatable and laid out as
+ *
+ *   .text.0 ... .text.N-1   code sections, .text.0 holds relocations
+ *   .rel(a).text.0          relocations against the symbols below
+ *   .debug_abbrev           one compile unit abbreviation
+ *   .debug_info             one DIE per compile unit
+ *   .debug_line             one version 4 line program per unit
+ *   .symtab .strtab         global function symbols spread on .text.*
+ *   .shstrtab
+ *
+ * With --exec the object is an executable instead: code sections get
+ * consecutive addresses and symbols and line rows point at them, so
+ * address lookups have something to find.
+ *
+ * Output only depends on the counts given, so runs are comparable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <elf.h>
+
+#define TEXT_SIZE       16      /* least bytes of each .text.N */
+#define SYMBOL_SIZE     4       /* bytes of each function symbol */
+#define LINE_ROWS       32      /* rows of each line program */
+#define SECTION_MAX     (SHN_LORESERVE - 16)
+
+struct buf {
+    unsigned char *data;
+    size_t        size;
+    size_t        max;
+};
+
+struct gen_section {
+    const char *name;
+    uint32_t   type;
+    uint64_t   flags;
+    uint32_t   link;
+    uint32_t   info;
+    uint64_t   align;
+    uint64_t   entsize;
+    uint32_t   name_offset;
+    uint64_t   addr;
+    uint64_t   offset;
+    struct buf buf;
+};
+
+static int elf64;
+static uint64_t text_base;      /* address of .text.0, 0 if relocatable */
+static struct gen_section *sections;
+static int section_numbers;
+
+static void *gen_alloc(size_t size)
+{
+    void *p = calloc(1, size ? size : 1);
+
+    if (!p) {
+        fprintf(stderr, "elfgen: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void *buf_put(struct buf *b, const void *data, size_t size)
+{
+    void *p;
+
+    if (b->size + size > b->max) {
+        size_t n = b->max ? b->max * 2 : 4096;
+
+        while (n < b->size + size)
+            n *= 2;
+        b->data = realloc(b->data, n);
+        if (!b->data) {
+            fprintf(stderr, "elfgen: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        b->max = n;
+    }
+    p = b->data + b->size;
+    if (data)
+        memcpy(p, data, size);
+    else
+        memset(p, 0, size);
+    b->size += size;
+    return p;
+}
+
+static void buf_u8(struct buf *b, uint8_t v)
+{
+    buf_put(b, &v, 1);
+}
+
+static void buf_u16(struct buf *b, uint16_t v)
+{
+    buf_put(b, &v, 2);
+}
+
+static void buf_u32(struct buf *b, uint32_t v)
+{
+    buf_put(b, &v, 4);
+}
+
+static void buf_addr(struct buf *b, uint64_t v)
+{
+    if (elf64)
+        buf_put(b, &v, 8);
+    else
+        buf_u32(b, v);
+}
+
+static void buf_str(struct buf *b, const char *s)
+{
+    buf_put(b, s, strlen(s) + 1);
+}
+
+static uint32_t strtab_add(struct buf *b, const char *s)
+{
+    uint32_t offset = b->size;
+
+    buf_str(b, s);
+    return offset;
+}
+
+static struct gen_section *section_add(const char *name, uint32_t type,
+                                       uint64_t flags, uint64_t align)
+{
+    struct gen_section *s = &sections[section_numbers++];
+
+    s->name = name;
+    s->type = type;
+    s->flags = flags;
+    s->align = align;
+    return s;
+}
+
+/*
+ * one compile unit DIE per unit, pointing at its line program.
+ */
+static void gen_debug_info(struct buf *abbrev, struct buf *info, int cus,
+                           const uint32_t *line_offsets)
+{
+    static const unsigned char abbrevs[] = {
+        1, 0x11, 0,     /* DW_TAG_compile_unit, DW_CHILDREN_no */
+        0x03, 0x08,     /* DW_AT_name, DW_FORM_string */
+        0x10, 0x17,     /* DW_AT_stmt_list, DW_FORM_sec_offset */
+        0x11, 0x01,     /* DW_AT_low_pc, DW_FORM_addr */
+        0x12, 0x06,     /* DW_AT_high_pc, DW_FORM_data4 */
+        0, 0,
+        0,
+    };
+    char name[32];
+    int i;
+
+    buf_put(abbrev, abbrevs, sizeof(abbrevs));
+    for (i = 0; i < cus; i++) {
+        size_t start = info->size;
+
+        snprintf(name, sizeof(name), "unit%d.c", i);
+        buf_u32(info, 0);
+        buf_u16(info, 4);
+        buf_u32(info, 0);
+        buf_u8(info, elf64 ? 8 : 4);
+        buf_u8(info, 1);
+        buf_str(info, name);
+        buf_u32(info, line_offsets[i]);
+        buf_addr(info, text_base + (uint64_t)i * LINE_ROWS * 4);
+        buf_u32(info, LINE_ROWS * 4);
+        *(uint32_t *)(info->data + start) = info->size - start - 4;
+    }
+}
+
+/*
+ * version 4 line program per unit, a row every 4 bytes and line.
+ */
+static void gen_debug_line(struct buf *line, int cus, uint32_t *offsets)
+{
+    static const unsigned char opcode_lengths[] = {
+        0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1,
+    };
+    char name[32];
+    int i, j;
+
+    for (i = 0; i < cus; i++) {
+        size_t start = line->size, header;
+
+        offsets[i] = start;
+        snprintf(name, sizeof(name), "unit%d.c", i);
+        buf_u32(line, 0);
+        buf_u16(line, 4);
+        buf_u32(line, 0);
+        header = line->size;
+        buf_u8(line, 1);                /* minimum_instruction_length */
+        buf_u8(line, 1);                /* maximum_operations_per_insn */
+        buf_u8(line, 1);                /* default_is_stmt */
+        buf_u8(line, (uint8_t)-5);      /* line_base */
+        buf_u8(line, 14);               /* line_range */
+        buf_u8(line, 13);               /* opcode_base */
+        buf_put(line, opcode_lengths, sizeof(opcode_lengths));
+        buf_str(line, "/bench");
+        buf_u8(line, 0);
+        buf_str(line, name);
+        buf_u8(line, 1);
+        buf_u8(line, 0);
+        buf_u8(line, 0);
+        buf_u8(line, 0);
+        *(uint32_t *)(line->data + header - 4) = line->size - header;
+
+        /* DW_LNE_set_address */
+        buf_u8(line, 0);
+        buf_u8(line, 1 + (elf64 ? 8 : 4));
+        buf_u8(line, 2);
+        buf_addr(line, text_base + (uint64_t)i * LINE_ROWS * 4);
+        buf_u8(line, 1);                /* DW_LNS_copy */
+        for (j = 1; j < LINE_ROWS; j++)
+            buf_u8(line, (1 + 5) + 14 * 4 + 13);
+        /* DW_LNE_end_sequence */
+        buf_u8(line, 0);
+        buf_u8(line, 1);
+        buf_u8(line, 1);
+        *(uint32_t *)(line->data + start) = line->size - start - 4;
+    }
+}
+
+static void gen_symbol(struct buf *symtab, uint32_t name, uint64_t value,
+                       uint64_t size, int bind, int type, uint16_t shndx)
+{
+    if (elf64) {
+        Elf64_Sym *sym = buf_put(symtab, NULL, sizeof(*sym));
+
+        sym->st_name = name;
+        sym->st_value = value;
+        sym->st_size = size;
+        sym->st_info = ELF64_ST_INFO(bind, type);
+        sym->st_shndx = shndx;
+    } else {
+        Elf32_Sym *sym = buf_put(symtab, NULL, sizeof(*sym));
+
+        sym->st_name = name;
+        sym->st_value = value;
+        sym->st_size = size;
+        sym->st_info = ELF32_ST_INFO(bind, type);
+        sym->st_shndx = shndx;
+    }
+}
+
+static void gen_reloc(struct buf *rel, uint64_t offset, uint32_t symbol)
+{
+    if (elf64) {
+        Elf64_Rela *r = buf_put(rel, NULL, sizeof(*r));
+
+        r->r_offset = offset;
+        r->r_info = ELF64_R_INFO(symbol, R_X86_64_64);
+        r->r_addend = 0;
+    } else {
+        Elf32_Rel *r = buf_put(rel, NULL, sizeof(*r));
+
+        r->r_offset = offset;
+        r->r_info = ELF32_R_INFO(symbol, R_386_32);
+    }
+}
+
+static void write_header(FILE *fp, uint64_t shoff, int shstrndx)
+{
+    unsigned char ident[EI_NIDENT] = {
+        ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3,
+        0, ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV,
+    };
+
+    ident[EI_CLASS] = elf64 ? ELFCLASS64 : ELFCLASS32;
+    if (elf64) {
+        Elf64_Ehdr eh;
+
+        memset(&eh, 0, sizeof(eh));
+        memcpy(eh.e_ident, ident, EI_NIDENT);
+        eh.e_type = text_base ? ET_EXEC : ET_REL;
+        eh.e_machine = EM_X86_64;
+        eh.e_version = EV_CURRENT;
+        eh.e_shoff = shoff;
+        eh.e_ehsize = sizeof(eh);
+        eh.e_shentsize = sizeof(Elf64_Shdr);
+        eh.e_shnum = section_numbers;
+        eh.e_shstrndx = shstrndx;
+        fwrite(&eh, sizeof(eh), 1, fp);
+    } else {
+        Elf32_Ehdr eh;
+
+        memset(&eh, 0, sizeof(eh));
+        memcpy(eh.e_ident, ident, EI_NIDENT);
+        eh.e_type = text_base ? ET_EXEC : ET_REL;
+        eh.e_machine = EM_386;
+        eh.e_version = EV_CURRENT;
+        eh.e_shoff = shoff;
+        eh.e_ehsize = sizeof(eh);
+        eh.e_shentsize = sizeof(Elf32_Shdr);
+        eh.e_shnum = section_numbers;
+        eh.e_shstrndx = shstrndx;
+        fwrite(&eh, sizeof(eh), 1, fp);
+    }
+}
+
+static void write_section_header(FILE *fp, struct gen_section *s)
+{
+    if (elf64) {
+        Elf64_Shdr sh;
+
+        memset(&sh, 0, sizeof(sh));
+        sh.sh_name = s->name_offset;
+        sh.sh_type = s->type;
+        sh.sh_flags = s->flags;
+        sh.sh_addr = s->addr;
+        sh.sh_offset = s->offset;
+        sh.sh_size = s->buf.size;
+        sh.sh_link = s->link;
+        sh.sh_info = s->info;
+        sh.sh_addralign = s->align;
+        sh.sh_entsize = s->entsize;
+        fwrite(&sh, sizeof(sh), 1, fp);
+    } else {
+        Elf32_Shdr sh;
+
+        memset(&sh, 0, sizeof(sh));
+        sh.sh_name = s->name_offset;
+        sh.sh_type = s->type;
+        sh.sh_flags = s->flags;
+        sh.sh_addr = s->addr;
+        sh.sh_offset = s->offset;
+        sh.sh_size = s->buf.size;
+        sh.sh_link = s->link;
+        sh.sh_info = s->info;
+        sh.sh_addralign = s->align;
+        sh.sh_entsize = s->entsize;
+        fwrite(&sh, sizeof(sh), 1, fp);
+    }
+}
+
+static void usage(void)
+{
+    printf("Usage: elfgen [option(s)] <output>\n");
+    printf(" Writes a synthetic relocatable ELF object\n");
+    printf(" The options are:\n");
+    printf("  -c        --class={32|64}       ELF class (default 32)\n");
+    printf("  -e        --exec                Executable with addresses assigned\n");
+    printf("  -s        --sections=<number>   Code sections (default 1)\n");
+    printf("  -n        --symbols=<number>    Function symbols (default 0)\n");
+    printf("  -r        --relocs=<number>     Relocations on .text.0 (default 0)\n");
+    printf("  -u        --units=<number>      DWARF compile units (default 0)\n");
+    printf("  -h        --help                Display this information\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const struct option long_opts[] = {
+        {"class", required_argument, NULL, 'c'},
+        {"exec", no_argument, NULL, 'e'},
+        {"sections", required_argument, NULL, 's'},
+        {"symbols", required_argument, NULL, 'n'},
+        {"relocs", required_argument, NULL, 'r'},
+        {"units", required_argument, NULL, 'u'},
+        {"help", no_argument, NULL, 'h'},
+        {0, 0, 0, 0}
+    };
+    struct gen_section *text, *rel, *symtab, *strtab, *shstrtab, *s;
+    struct buf abbrev = { 0 }, info = { 0 }, line = { 0 };
+    long texts = 1, symbols = 0, relocs = 0, units = 0;
+    uint32_t *line_offsets;
+    uint64_t offset, text_size, text0_size, width;
+    char **names, name[32];
+    int c, i, first_text, exec = 0;
+    FILE *fp;
+
+    while ((c = getopt_long(argc, argv, "c:es:n:r:u:h", long_opts,
+                            NULL)) != -1) {
+        switch (c) {
+        case 'c':
+            elf64 = atoi(optarg) == 64;
+            break;
+        case 'e':
+            exec = 1;
+            break;
+        case 's':
+            texts = atol(optarg);
+            break;
+        case 'n':
+            symbols = atol(optarg);
+            break;
+        case 'r':
+            relocs = atol(optarg);
+            break;
+        case 'u':
+            units = atol(optarg);
+            break;
+        case 'h':
+            usage();
+            return 0;
+        default:
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || texts < 1 || texts > SECTION_MAX ||
+        symbols < 0 || relocs < 0 || units < 0) {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    sections = gen_alloc(sizeof(struct gen_section) * (texts + 10));
+    names = gen_alloc(sizeof(char *) * texts);
+    section_add("", SHT_NULL, 0, 0);
+
+    /*
+     * code, every section is large enough for its share of symbols
+     * at distinct addresses, and .text.0 for every relocation too
+     */
+    width = elf64 ? 8 : 4;
+    if (exec)
+        text_base = elf64 ? 0x400000 : 0x8048000;
+    offset = text_base;
+    text_size = (symbols + texts - 1) / texts * SYMBOL_SIZE;
+    if (text_size < TEXT_SIZE)
+        text_size = TEXT_SIZE;
+    text0_size = relocs * width > text_size ? relocs * width : text_size;
+    first_text = section_numbers;
+    for (i = 0; i < texts; i++) {
+        snprintf(name, sizeof(name), ".text.%d", i);
+        names[i] = strdup(name);
+        text = section_add(names[i], SHT_PROGBITS,
+                           SHF_ALLOC | SHF_EXECINSTR, 16);
+        buf_put(&text->buf, NULL, i ? text_size : text0_size);
+        memset(text->buf.data, 0x90, text->buf.size);
+        if (exec) {
+            text->addr = offset;
+            offset += text->buf.size;
+        }
+    }
+
+    rel = NULL;
+    if (relocs) {
+        rel = section_add(elf64 ? ".rela.text.0" : ".rel.text.0",
+                          elf64 ? SHT_RELA : SHT_REL, SHF_INFO_LINK, width);
+        rel->info = first_text;
+        rel->entsize = elf64 ? sizeof(Elf64_Rela) : sizeof(Elf32_Rel);
+    }
+
+    if (units) {
+        line_offsets = gen_alloc(sizeof(uint32_t) * units);
+        gen_debug_line(&line, units, line_offsets);
+        gen_debug_info(&abbrev, &info, units, line_offsets);
+        free(line_offsets);
+        s = section_add(".debug_abbrev", SHT_PROGBITS, 0, 1);
+        s->buf = abbrev;
+        s = section_add(".debug_info", SHT_PROGBITS, 0, 1);
+        s->buf = info;
+        s = section_add(".debug_line", SHT_PROGBITS, 0, 1);
+        s->buf = line;
+    }
+
+    symtab = section_add(".symtab", SHT_SYMTAB, 0, width);
+    strtab = section_add(".strtab", SHT_STRTAB, 0, 1);
+    shstrtab = section_add(".shstrtab", SHT_STRTAB, 0, 1);
+    symtab->link = strtab - sections;
+    symtab->entsize = elf64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+
+    buf_u8(&strtab->buf, 0);
+    gen_symbol(&symtab->buf, 0, 0, 0, STB_LOCAL, STT_NOTYPE, SHN_UNDEF);
+    gen_symbol(&symtab->buf, strtab_add(&strtab->buf, "elfgen.c"), 0, 0,
+               STB_LOCAL, STT_FILE, SHN_ABS);
+    symtab->info = 2;
+    for (i = 0; i < symbols; i++) {
+        long section = i % texts;
+        uint64_t value = (i / texts) * SYMBOL_SIZE;
+
+        snprintf(name, sizeof(name), "bench_function_%d", i);
+        gen_symbol(&symtab->buf, strtab_add(&strtab->buf, name),
+                   sections[first_text + section].addr + value, SYMBOL_SIZE,
+                   STB_GLOBAL, STT_FUNC, first_text + section);
+    }
+    for (i = 0; i < relocs; i++)
+        gen_reloc(&rel->buf, i * width, symbols ? 2 + i % symbols : 0);
+    if (rel)
+        rel->link = symtab - sections;
+
+    buf_u8(&shstrtab->buf, 0);
+    for (i = 1; i < section_numbers; i++)
+        sections[i].name_offset = strtab_add(&shstrtab->buf,
+                                             sections[i].name);
+
+    /* contents follow header, section table comes last */
+    offset = elf64 ? sizeof(Elf64_Ehdr) : sizeof(Elf32_Ehdr);
+    for (i = 1; i < section_numbers; i++) {
+        s = &sections[i];
+        if (s->align > 1)
+            offset = (offset + s->align - 1) & ~(s->align - 1);
+        s->offset = offset;
+        offset += s->buf.size;
+    }
+    offset = (offset + 7) & ~7ULL;
+
+    fp = fopen(argv[optind], "wb");
+    if (!fp) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    write_header(fp, offset, shstrtab - sections);
+    for (i = 1; i < section_numbers; i++) {
+        s = &sections[i];
+        fseek(fp, s->offset, SEEK_SET);
+        if (s->buf.size)
+            fwrite(s->buf.data, 1, s->buf.size, fp);
+    }
+    fseek(fp, offset, SEEK_SET);
+    for (i = 0; i < section_numbers; i++)
+        write_section_header(fp, &sections[i]);
+    if (fclose(fp)) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < section_numbers; i++)
+        free(sections[i].buf.data);
+    for (i = 0; i < texts; i++)
+        free(names[i]);
+    free(names);
+    free(sections);
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * syscount: count file syscalls of a tool per file, LD_PRELOAD shim
+ *
+ * (C) 2017.09 <buddy.zhang@aliyun.com>
+ *
+ * The GNU C Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with the GNU C Library; if not, see
+ * <http://www.gnu.org/licenses/>
+ *
+ *   LD_PRELOAD=syscount.so SYSCOUNT_OUTPUT=counts objdump -h foo.o
+ *
+ * Opens are counted on the path, read, pread, mmap and lseek on the
+ * path the descriptor was opened with. On exit one line per path is
+ * appended to SYSCOUNT_OUTPUT, stderr if unset:
+ *
+ *   <path> open <n> read <n> pread <n> mmap <n> lseek <n>
+ *
+ * Reads the C library does inside fread() and friends don't go
+ * through the shim, fopen() itself is counted as an open.
+ */
+#undef _FORTIFY_SOURCE
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#define SYSCOUNT_PATHS     256
+#define SYSCOUNT_FDS       4096
+
+enum {
+    SYSCOUNT_OPEN,
+    SYSCOUNT_READ,
+    SYSCOUNT_PREAD,
+    SYSCOUNT_MMAP,
+    SYSCOUNT_LSEEK,
+    SYSCOUNT_CALLS,
+};
+
+static const char *syscount_names[SYSCOUNT_CALLS] = {
+    "open", "read", "pread", "mmap", "lseek",
+};
+
+struct syscount_path {
+    char          *path;
+    unsigned long counts[SYSCOUNT_CALLS];
+};
+
+static struct syscount_path paths[SYSCOUNT_PATHS];
+static int path_numbers;
+static int fd_paths[SYSCOUNT_FDS];    /* path index + 1, 0 if untracked */
+static pthread_mutex_t path_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* next definition of symbol, resolved on first call */
+#define SYSCOUNT_REAL(type, name, args)                     \
+    static type (*real_##name) args;                        \
+    if (!real_##name)                                       \
+        real_##name = (type (*) args)dlsym(RTLD_NEXT, #name)
+
+static void syscount_add(int path, int call)
+{
+    if (path >= 0)
+        __atomic_fetch_add(&paths[path].counts[call], 1, __ATOMIC_RELAXED);
+}
+
+static int syscount_path(const char *name)
+{
+    int i;
+
+    pthread_mutex_lock(&path_lock);
+    for (i = 0; i < path_numbers; i++)
+        if (!strcmp(paths[i].path, name))
+            break;
+    if (i == path_numbers) {
+        if (path_numbers == SYSCOUNT_PATHS) {
+            i = -1;
+        } else {
+            paths[i].path = strdup(name);
+            path_numbers++;
+        }
+    }
+    pthread_mutex_unlock(&path_lock);
+    return i;
+}
+
+/*
+ * count open of @name, the descriptor is attributed to it.
+ */
+static int syscount_open(const char *name, int fd)
+{
+    int path = syscount_path(name);
+
+    syscount_add(path, SYSCOUNT_OPEN);
+    if (fd >= 0 && fd < SYSCOUNT_FDS)
+        __atomic_store_n(&fd_paths[fd], path + 1, __ATOMIC_RELAXED);
+    return fd;
+}
+
+static void syscount_fd(int fd, int call)
+{
+    if (fd >= 0 && fd < SYSCOUNT_FDS)
+        syscount_add(__atomic_load_n(&fd_paths[fd], __ATOMIC_RELAXED) - 1,
+                     call);
+}
+
+static mode_t syscount_mode(int flags, va_list args)
+{
+    return flags & (O_CREAT | O_TMPFILE) ? va_arg(args, mode_t) : 0;
+}
+
+int open(const char *name, int flags, ...)
+{
+    SYSCOUNT_REAL(int, open, (const char *, int, ...));
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = syscount_mode(flags, args);
+    va_end(args);
+    return syscount_open(name, real_open(name, flags, mode));
+}
+
+int open64(const char *name, int flags, ...)
+{
+    SYSCOUNT_REAL(int, open64, (const char *, int, ...));
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = syscount_mode(flags, args);
+    va_end(args);
+    return syscount_open(name, real_open64(name, flags, mode));
+}
+
+int openat(int dirfd, const char *name, int flags, ...)
+{
+    SYSCOUNT_REAL(int, openat, (int, const char *, int, ...));
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = syscount_mode(flags, args);
+    va_end(args);
+    return syscount_open(name, real_openat(dirfd, name, flags, mode));
+}
+
+int openat64(int dirfd, const char *name, int flags, ...)
+{
+    SYSCOUNT_REAL(int, openat64, (int, const char *, int, ...));
+    va_list args;
+    mode_t mode;
+
+    va_start(args, flags);
+    mode = syscount_mode(flags, args);
+    va_end(args);
+    return syscount_open(name, real_openat64(dirfd, name, flags, mode));
+}
+
+FILE *fopen(const char *name, const char *mode)
+{
+    SYSCOUNT_REAL(FILE *, fopen, (const char *, const char *));
+    FILE *fp = real_fopen(name, mode);
+
+    syscount_open(name, fp ? fileno(fp) : -1);
+    return fp;
+}
+
+FILE *fopen64(const char *name, const char *mode)
+{
+    SYSCOUNT_REAL(FILE *, fopen64, (const char *, const char *));
+    FILE *fp = real_fopen64(name, mode);
+
+    syscount_open(name, fp ? fileno(fp) : -1);
+    return fp;
+}
+
+int close(int fd)
+{
+    SYSCOUNT_REAL(int, close, (int));
+
+    if (fd >= 0 && fd < SYSCOUNT_FDS)
+        __atomic_store_n(&fd_paths[fd], 0, __ATOMIC_RELAXED);
+    return real_close(fd);
+}
+
+ssize_t read(int fd, void *buf, size_t count)
+{
+    SYSCOUNT_REAL(ssize_t, read, (int, void *, size_t));
+
+    syscount_fd(fd, SYSCOUNT_READ);
+    return real_read(fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset)
+{
+    SYSCOUNT_REAL(ssize_t, pread, (int, void *, size_t, off_t));
+
+    syscount_fd(fd, SYSCOUNT_PREAD);
+    return real_pread(fd, buf, count, offset);
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset)
+{
+    SYSCOUNT_REAL(ssize_t, pread64, (int, void *, size_t, off64_t));
+
+    syscount_fd(fd, SYSCOUNT_PREAD);
+    return real_pread64(fd, buf, count, offset);
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd,
+           off_t offset)
+{
+    SYSCOUNT_REAL(void *, mmap, (void *, size_t, int, int, int, off_t));
+
+    syscount_fd(fd, SYSCOUNT_MMAP);
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+void *mmap64(void *addr, size_t length, int prot, int flags, int fd,
+             off64_t offset)
+{
+    SYSCOUNT_REAL(void *, mmap64, (void *, size_t, int, int, int, off64_t));
+
+    syscount_fd(fd, SYSCOUNT_MMAP);
+    return real_mmap64(addr, length, prot, flags, fd, offset);
+}
+
+off_t lseek(int fd, off_t offset, int whence)
+{
+    SYSCOUNT_REAL(off_t, lseek, (int, off_t, int));
+
+    syscount_fd(fd, SYSCOUNT_LSEEK);
+    return real_lseek(fd, offset, whence);
+}
+
+off64_t lseek64(int fd, off64_t offset, int whence)
+{
+    SYSCOUNT_REAL(off64_t, lseek64, (int, off64_t, int));
+
+    syscount_fd(fd, SYSCOUNT_LSEEK);
+    return real_lseek64(fd, offset, whence);
+}
+
+static void __attribute__((destructor)) syscount_report(void)
+{
+    SYSCOUNT_REAL(int, open, (const char *, int, ...));
+    const char *output = getenv("SYSCOUNT_OUTPUT");
+    char line[4096];
+    int i, j, fd = 2, len;
+
+    if (output)
+        fd = real_open(output, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        return;
+    for (i = 0; i < path_numbers; i++) {
+        len = snprintf(line, sizeof(line), "%s", paths[i].path);
+        for (j = 0; j < SYSCOUNT_CALLS; j++)
+            len += snprintf(line + len, sizeof(line) - len, " %s %lu",
+                            syscount_names[j], paths[i].counts[j]);
+        if (len < (int)sizeof(line) - 1) {
+            line[len++] = '\n';
+            if (write(fd, line, len) != len)
+                break;
+        }
+    }
+    if (output)
+        close(fd);
+}
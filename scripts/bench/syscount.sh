@@ -0,0 +1,71 @@
+#!/bin/sh
+# Check file syscalls of the tools against per file budgets.
+#
+# Usage: syscount.sh <syscount.so> <tool directory> <file(s)>
+#
+# Every mode below is run on each file alone under the syscount
+# shim, and the opens, reads, preads, mmaps and lseeks on that file
+# are compared with the mode's budget. Exits 1 if any count is over,
+# so redundant opens and reads can't creep back into lib/ unnoticed.
+#
+# nm and size are run with --io=pread, opens and reads issued on an
+# io_uring don't pass through the C library and can't be counted.
+
+shim=$1
+tools=$2
+shift 2
+
+if [ ! -f "$shim" ] || [ ! -d "$tools" ] || [ $# -eq 0 ]; then
+	echo "Usage: $0 <syscount.so> <tool directory> <file(s)>" >&2
+	exit 1
+fi
+case $shim in
+/*) ;;
+*) shim=$(pwd)/$shim ;;
+esac
+
+# mode, then budget of open read pread mmap lseek
+budgets="
+objdump -h		1 0 1 1 0
+objdump -t		1 0 1 1 0
+objdump -r		1 0 1 1 0
+objdump -x		1 0 1 1 0
+objdump -WL		1 0 1 1 0
+nm --io=pread		1 0 3 1 0
+size --io=pread		1 0 3 1 0
+"
+
+files="$*"
+out=$(mktemp) || exit 1
+trap 'rm -f "$out"' EXIT
+ret=0
+
+printf "%-18s %-14s %6s %6s %6s %6s %6s\n" \
+	mode file open read pread mmap lseek
+while read tool option open read pread mmap lseek; do
+	[ -n "$tool" ] && [ -x "$tools/$tool" ] || continue
+	for file in $files; do
+		: > "$out"
+		LD_PRELOAD=$shim SYSCOUNT_OUTPUT=$out \
+			"$tools/$tool" $option "$file" > /dev/null 2>&1
+		set -- $(awk -v f="$file" '$1 == f {
+			print $3, $5, $7, $9, $11 }' "$out")
+		if [ $# -ne 5 ]; then
+			echo "syscount: $tool $option $file: no counts" >&2
+			ret=1
+			continue
+		fi
+
+		status=ok
+		[ $1 -le $open ] && [ $2 -le $read ] && [ $3 -le $pread ] &&
+			[ $4 -le $mmap ] && [ $5 -le $lseek ] || status=OVER
+		[ $status = ok ] || ret=1
+		printf "%-18s %-14s %6d %6d %6d %6d %6d %s\n" "$tool $option" \
+			"$(basename "$file")" $1 $2 $3 $4 $5 $status
+	done
+done <<EOF
+$budgets
+EOF
+
+[ $ret -eq 0 ] || echo "syscount: file syscalls over budget" >&2
+exit $ret